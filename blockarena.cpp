@@ -0,0 +1,74 @@
+#include "blockarena.hh"
+
+// Create all squares of the arena in the scene. The scene owns them.
+void BlockArena::initialize(QGraphicsScene* scene, int capacity, double side,
+                            const QPen& pen)
+{
+    blocks_.clear();
+    blocks_.reserve(capacity);
+    free_blocks_.clear();
+    free_blocks_.reserve(capacity);
+
+    for (int i = 0; i < capacity; ++i)
+    {
+        QGraphicsRectItem* block = scene->addRect(0, 0, side, side, pen);
+        block->hide();
+
+        blocks_.push_back(block);
+    }
+
+    reset();
+}
+
+// Get a free square and show it with the brush.
+QGraphicsRectItem* BlockArena::acquire(const QBrush& brush)
+{
+    if (free_blocks_.empty())
+    {
+        return NULL;
+    }
+
+    QGraphicsRectItem* block = free_blocks_.back();
+    free_blocks_.pop_back();
+
+    block->setBrush(brush);
+    block->show();
+
+    return block;
+}
+
+// Hide square and put it back to the free squares.
+void BlockArena::release(QGraphicsRectItem* block)
+{
+    // Already free.
+    if (block == NULL || !block->isVisible())
+    {
+        return;
+    }
+
+    block->hide();
+    free_blocks_.push_back(block);
+}
+
+// Hide all squares and make them free.
+void BlockArena::reset()
+{
+    free_blocks_.clear();
+
+    // Reverse order so squares are acquired in creation order.
+    for (int i = blocks_.size() - 1; i >= 0; --i)
+    {
+        blocks_.at(i)->hide();
+        free_blocks_.push_back(blocks_.at(i));
+    }
+}
+
+int BlockArena::capacity() const
+{
+    return blocks_.size();
+}
+
+int BlockArena::num_in_use() const
+{
+    return blocks_.size() - free_blocks_.size();
+}
@@ -0,0 +1,42 @@
+#ifndef BLOCKARENA_HH
+#define BLOCKARENA_HH
+
+#include <QGraphicsScene>
+#include <QGraphicsRectItem>
+#include <vector>
+
+// Squares of a scene allocated once and reused for the whole program.
+// acquire() shows a free square and release() hides it again, so placing,
+// moving and removing tetrominos never creates or deletes scene items.
+// reset() gives every square back at the start of a game.
+class BlockArena
+{
+public:
+    BlockArena() = default;
+
+    // Create capacity hidden squares of the given size in the scene.
+    void initialize(QGraphicsScene* scene, int capacity, double side,
+                    const QPen& pen);
+
+    // Show a free square with the brush. Returns NULL if all squares
+    // are in use.
+    QGraphicsRectItem* acquire(const QBrush& brush);
+
+    // Hide the square and make it free.
+    void release(QGraphicsRectItem* block);
+
+    // Release all squares.
+    void reset();
+
+    int capacity() const;
+    int num_in_use() const;
+
+private:
+    std::vector<QGraphicsRectItem*> blocks_;
+
+    // Squares which can be acquired. Reserved to capacity so releasing
+    // never allocates.
+    std::vector<QGraphicsRectItem*> free_blocks_;
+};
+
+#endif // BLOCKARENA_HH
@@ -0,0 +1,191 @@
+#ifndef BOARD_HH
+#define BOARD_HH
+
+#include "zobrist.hh"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// Coordinates of each squares in tetromino or in the grid with x axis
+// is to the right and y direction is to below.
+struct Coord
+{
+    int x = 0;
+    int y = 0;
+
+    constexpr Coord():
+        x(0), y(0)
+    {
+    }
+
+    constexpr Coord(int p_x, int p_y):
+        x(p_x), y(p_y)
+    {
+    }
+};
+
+// Squares fixed in the playing area. Each row is a bit mask where bit x is
+// set if the cell in column x is occupied.
+struct Board
+{
+    static constexpr int ROWS = 24;
+    static constexpr int COLUMNS = 12;
+
+    static_assert(ROWS <= Zobrist::MAX_ROWS && COLUMNS <= Zobrist::MAX_COLUMNS,
+                  "Zobrist keys must cover the board");
+
+    // Mask with a bit for every column.
+    static constexpr uint16_t FULL_ROW = (1 << COLUMNS) - 1;
+
+    std::array<uint16_t, ROWS> rows = {};
+
+    // Palette index of each occupied cell. Zero for empty cells.
+    std::array<std::array<uint8_t, COLUMNS>, ROWS> colors = {};
+
+    // Zobrist hash of the occupied cells. The colors are not included since
+    // they do not change the game.
+    uint64_t hash = 0;
+
+    bool is_occupied(int x, int y) const
+    {
+        return (rows[y] >> x) & 1;
+    }
+
+    void set(int x, int y, int color)
+    {
+        if (!is_occupied(x, y))
+        {
+            hash ^= Zobrist::cell(x, y);
+        }
+
+        rows[y] |= 1 << x;
+        colors[y][x] = color;
+    }
+
+    // Replace row y with the mask and colors of another row.
+    void copy_row(int y, uint16_t mask, const std::array<uint8_t, COLUMNS>& row_colors)
+    {
+        hash ^= Zobrist::row(y, rows[y]) ^ Zobrist::row(y, mask);
+
+        rows[y] = mask;
+        colors[y] = row_colors;
+    }
+
+    // Push every row up and put the masks in the bottom rows with the color.
+    // The top rows are pushed out of the board. The keys of the cells depend
+    // on the row, so the hash is computed again.
+    void push_up(const uint16_t* masks, int num_rows, uint8_t color)
+    {
+        std::copy(rows.begin() + num_rows, rows.end(), rows.begin());
+        std::copy(colors.begin() + num_rows, colors.end(), colors.begin());
+
+        for (int i = 0; i < num_rows; ++i)
+        {
+            int y = ROWS - num_rows + i;
+            rows[y] = masks[i];
+
+            for (int x = 0; x < COLUMNS; ++x)
+            {
+                colors[y][x] = ((masks[i] >> x) & 1) ? color : 0;
+            }
+        }
+
+        hash = 0;
+
+        for (int y = 0; y < ROWS; ++y)
+        {
+            hash ^= Zobrist::row(y, rows[y]);
+        }
+    }
+
+    // Remove the full rows and move the rows above them down. Returns the
+    // number of removed rows.
+    int remove_full_rows()
+    {
+        int removed = 0;
+        int target = ROWS - 1;
+
+        for (int row = ROWS - 1; row >= 0; --row)
+        {
+            if (rows[row] == FULL_ROW)
+            {
+                removed += 1;
+                continue;
+            }
+
+            if (target != row)
+            {
+                copy_row(target, rows[row], colors[row]);
+            }
+
+            target -= 1;
+        }
+
+        for (; target >= 0; --target)
+        {
+            copy_row(target, 0, {});
+        }
+
+        return removed;
+    }
+};
+
+// The moving tetromino.
+struct Piece
+{
+    static constexpr int NUM_SQUARE = 4;
+
+    int type = 0;
+
+    // Palette index of the color.
+    int color = 0;
+
+    std::array<Coord, NUM_SQUARE> squares = {};
+
+    // Outer most rows and columns of the squares.
+    int bottom = 0;
+    int left = 0;
+    int right = 0;
+    int up = 0;
+
+    // Occupied columns of each row from the row up, so the board is tested
+    // with one mask operation for each row instead of each square.
+    std::array<uint16_t, NUM_SQUARE> masks = {};
+
+    // Update the outer most rows and columns and the masks after the
+    // squares changed.
+    void update_extent()
+    {
+        bottom = -1;
+        up = Board::ROWS;
+        left = Board::COLUMNS;
+        right = -1;
+
+        for (const Coord& c : squares)
+        {
+            up = std::min(up, c.y);
+            bottom = std::max(bottom, c.y);
+            left = std::min(left, c.x);
+            right = std::max(right, c.x);
+        }
+
+        masks.fill(0);
+
+        // Squares further apart than a tetromino, as in a damaged state,
+        // have no mask.
+        for (const Coord& c : squares)
+        {
+            if (c.y - up < NUM_SQUARE && c.x >= 0 && c.x < Board::COLUMNS)
+            {
+                masks[c.y - up] |= 1 << c.x;
+            }
+        }
+    }
+
+    int height() const
+    {
+        return bottom - up + 1;
+    }
+};
+
+#endif // BOARD_HH
@@ -0,0 +1,202 @@
+#include "botplugin.hh"
+#include "tracer.hh"
+#include <QFileInfo>
+#include <algorithm>
+#include <array>
+
+BotPlugin::~BotPlugin()
+{
+    unload();
+}
+
+bool BotPlugin::load(const QString& file_name)
+{
+    unload();
+
+    file_name_ = file_name;
+    modified_ = QFileInfo(file_name).lastModified();
+
+    library_.setFileName(file_name);
+
+    if (!library_.load())
+    {
+        error_ = library_.errorString();
+        return false;
+    }
+
+    auto version = reinterpret_cast<tetris_bot_abi_version_function>(
+                library_.resolve("tetris_bot_abi_version"));
+    create_ = reinterpret_cast<tetris_bot_create_function>(
+                library_.resolve("tetris_bot_create"));
+    decide_ = reinterpret_cast<tetris_bot_decide_function>(
+                library_.resolve("tetris_bot_decide"));
+    destroy_ = reinterpret_cast<tetris_bot_destroy_function>(
+                library_.resolve("tetris_bot_destroy"));
+
+    if (version == NULL || create_ == NULL || decide_ == NULL || destroy_ == NULL)
+    {
+        error_ = "A function of the plugin is missing.";
+        unload();
+        return false;
+    }
+
+    if (version() != TETRIS_BOT_ABI_VERSION)
+    {
+        error_ = QString("The plugin has version %1 of the interface, not %2.")
+                .arg(version()).arg(TETRIS_BOT_ABI_VERSION);
+        unload();
+        return false;
+    }
+
+    return true;
+}
+
+// The state of the last game is destroyed before the library is unloaded,
+// since its code is in the library.
+bool BotPlugin::begin_game()
+{
+    if (has_bot_)
+    {
+        destroy_(bot_);
+        bot_ = NULL;
+        has_bot_ = false;
+    }
+
+    if (!library_.isLoaded() || QFileInfo(file_name_).lastModified() != modified_)
+    {
+        if (!load(file_name_))
+        {
+            return false;
+        }
+    }
+
+    bot_ = create_();
+    has_bot_ = true;
+
+    return true;
+}
+
+template <typename Rules>
+bool BotPlugin::decide(const GameCore<Rules>& game, int budget_ms, BotMove& move)
+{
+    TRACE_SCOPE("bot plugin decide");
+
+    move = BotMove();
+
+    if (!has_bot_ || !game.is_piece_active())
+    {
+        return false;
+    }
+
+    // The view points at the rows of the game, nothing is copied.
+    tetris_bot_view view;
+    view.rows = game.board().rows.data();
+    view.num_rows = Board::ROWS;
+    view.num_columns = Board::COLUMNS;
+    view.moving = game.current().type;
+    view.next = game.next().type;
+    view.hold = game.is_hold_empty() ? -1 : game.hold().type;
+    view.can_hold = game.can_hold();
+    view.budget_ms = budget_ms;
+
+    tetris_bot_placement placement = {};
+
+    if (decide_(bot_, &view, &placement) != 1)
+    {
+        return false;
+    }
+
+    MoveGenerator<Rules>& generator = std::get<MoveGenerator<Rules>>(generators_);
+    generator.generate(game);
+
+    const typename MoveGenerator<Rules>::Placement* found = find(generator, placement);
+
+    if (found == NULL)
+    {
+        return false;
+    }
+
+    move.hold = found->hold;
+    generator.inputs(*found, move.path);
+
+    // The path of the generator has the hold, the move only the rest.
+    if (move.hold && !move.path.empty() && move.path.front() == GameEngine::HOLD)
+    {
+        move.path.erase(move.path.begin());
+    }
+
+    return true;
+}
+
+void BotPlugin::unload()
+{
+    if (has_bot_)
+    {
+        destroy_(bot_);
+        bot_ = NULL;
+        has_bot_ = false;
+    }
+
+    create_ = NULL;
+    decide_ = NULL;
+    destroy_ = NULL;
+
+    if (library_.isLoaded())
+    {
+        library_.unload();
+    }
+}
+
+// A placement is the same if its squares are in the same rows and columns,
+// whatever the order of the squares.
+template <typename Rules>
+const typename MoveGenerator<Rules>::Placement* BotPlugin::find(
+        const MoveGenerator<Rules>& generator, const tetris_bot_placement& placement)
+{
+    int up = Board::ROWS;
+
+    for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+    {
+        if (placement.x[i] < 0 || placement.x[i] >= Board::COLUMNS ||
+                placement.y[i] < 0 || placement.y[i] >= Board::ROWS)
+        {
+            return NULL;
+        }
+
+        up = std::min(up, int(placement.y[i]));
+    }
+
+    std::array<uint16_t, Piece::NUM_SQUARE> masks = {};
+
+    for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+    {
+        if (placement.y[i] - up >= Piece::NUM_SQUARE)
+        {
+            return NULL;
+        }
+
+        masks.at(placement.y[i] - up) |= 1 << placement.x[i];
+    }
+
+    for (const auto& candidate : generator.placements())
+    {
+        if (candidate.hold == (placement.hold != 0) && candidate.piece.up == up &&
+                candidate.piece.masks == masks)
+        {
+            return &candidate;
+        }
+    }
+
+    return NULL;
+}
+
+
+//*****************************************************************************
+// Decisions with every set of rules.
+
+template bool BotPlugin::decide(const GameCore<ClassicRules>& game, int budget_ms,
+                                BotMove& move);
+template bool BotPlugin::decide(const GameCore<ModernRules>& game, int budget_ms,
+                                BotMove& move);
+template bool BotPlugin::decide(const GameCore<NoHoldRules>& game, int budget_ms,
+                                BotMove& move);
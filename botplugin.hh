@@ -0,0 +1,70 @@
+#ifndef BOTPLUGIN_HH
+#define BOTPLUGIN_HH
+
+#include "botpluginabi.h"
+#include "botsearch.hh"
+#include "movegenerator.hh"
+#include <QDateTime>
+#include <QLibrary>
+#include <QString>
+#include <tuple>
+#include <vector>
+
+// Bot in a shared library with the C interface of botpluginabi.h. The
+// plugin is called directly on the thread of the window with a view of the
+// rows of the game, so a decision costs a function call and the search of
+// the inputs which reach its placement.
+class BotPlugin
+{
+public:
+    BotPlugin() = default;
+    ~BotPlugin();
+
+    BotPlugin(const BotPlugin&) = delete;
+    BotPlugin& operator=(const BotPlugin&) = delete;
+
+    // Load the library. Returns false if it cannot be loaded, misses a
+    // function or was built for another version of the interface.
+    bool load(const QString& file_name);
+
+    // Start a game with a new state of the bot. The library is loaded
+    // again first if the file changed since it was loaded. Returns false
+    // if the plugin cannot be used.
+    bool begin_game();
+
+    // Move of the moving tetromino of the game, with the moves of its rules.
+    // Returns false and an empty move, which drops the tetromino, if the
+    // plugin gave no placement or one the tetromino cannot reach.
+    template <typename Rules>
+    bool decide(const GameCore<Rules>& game, int budget_ms, BotMove& move);
+
+    // Why the last load failed.
+    const QString& error() const { return error_; }
+
+private:
+    void unload();
+
+    // Find the placement with the squares among those of the generator.
+    template <typename Rules>
+    static const typename MoveGenerator<Rules>::Placement* find(
+            const MoveGenerator<Rules>& generator, const tetris_bot_placement& placement);
+
+    QLibrary library_;
+    QString file_name_ = "";
+    QDateTime modified_;
+    QString error_ = "";
+
+    tetris_bot_create_function create_ = NULL;
+    tetris_bot_decide_function decide_ = NULL;
+    tetris_bot_destroy_function destroy_ = NULL;
+
+    // State of the bot for the current game.
+    void* bot_ = NULL;
+    bool has_bot_ = false;
+
+    // Generator of each set of rules, kept so deciding does not allocate.
+    std::tuple<MoveGenerator<ClassicRules>, MoveGenerator<ModernRules>,
+               MoveGenerator<NoHoldRules>> generators_;
+};
+
+#endif // BOTPLUGIN_HH
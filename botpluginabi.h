@@ -0,0 +1,72 @@
+#ifndef BOTPLUGINABI_H
+#define BOTPLUGINABI_H
+
+/* C interface of bot plugins, shared libraries loaded by the game with
+ * --bot-plugin <file>. A plugin is built on its own with any compiler and
+ * only needs this header.
+ *
+ * The plugin exports these functions with C linkage:
+ *
+ *   int32_t tetris_bot_abi_version(void);
+ *     Returns TETRIS_BOT_ABI_VERSION of the header it was built with. The
+ *     game does not use a plugin with another version.
+ *
+ *   void* tetris_bot_create(void);
+ *     State of the bot for a new game, given to every decide. May be NULL.
+ *
+ *   int32_t tetris_bot_decide(void* bot, const struct tetris_bot_view* view,
+ *                             struct tetris_bot_placement* placement);
+ *     Where the moving tetromino goes. Returns 1 if the placement was
+ *     written, 0 to drop the tetromino where it appears. Called on the
+ *     thread of the window, so it should return within the budget.
+ *
+ *   void tetris_bot_destroy(void* bot);
+ *     The game ended.
+ *
+ * The library is loaded again before a game if the file changed, so a bot
+ * can be rebuilt while the game runs.
+ */
+
+#include <stdint.h>
+
+#define TETRIS_BOT_ABI_VERSION 1
+
+/* The game at the moment of the decision. The pointers point into the game
+ * itself and are only valid during the call. */
+struct tetris_bot_view
+{
+    /* Rows of the board from the top. Bit x is set if the cell in column x
+     * is occupied. */
+    const uint16_t* rows;
+    int32_t num_rows;
+    int32_t num_columns;
+
+    /* Tetromino kinds from 0 to 6 in the order of the game. The hold is -1
+     * when empty. Can hold is 0 after a hold until the tetromino locks. */
+    int32_t moving;
+    int32_t next;
+    int32_t hold;
+    int32_t can_hold;
+
+    int32_t budget_ms;
+};
+
+/* Where the tetromino locks. */
+struct tetris_bot_placement
+{
+    /* 1 to hold first and place the tetromino which comes from the hold,
+     * or the next one when the hold is empty. */
+    int32_t hold;
+
+    /* Column and row of each square, the row counted from the top. */
+    int32_t x[4];
+    int32_t y[4];
+};
+
+typedef int32_t (*tetris_bot_abi_version_function)(void);
+typedef void* (*tetris_bot_create_function)(void);
+typedef int32_t (*tetris_bot_decide_function)(void* bot, const struct tetris_bot_view* view,
+                                              struct tetris_bot_placement* placement);
+typedef void (*tetris_bot_destroy_function)(void* bot);
+
+#endif /* BOTPLUGINABI_H */
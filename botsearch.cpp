@@ -0,0 +1,573 @@
+#include "botsearch.hh"
+#include "tracer.hh"
+#include <algorithm>
+#include <bitset>
+#include <climits>
+#include <cstdlib>
+
+namespace
+{
+
+// Added to the board hash for each depth, so the table keeps the scores of
+// different depths apart.
+const uint64_t DEPTH_KEY = 0x9E3779B97F4A7C15ULL;
+
+// Lock the tetromino and remove full rows. Returns the number of removed
+// rows, or -1 if the tetromino is not in the playing area.
+int lock_piece(Board& board, const Piece& piece)
+{
+    for (const Coord& c : piece.squares)
+    {
+        if (c.y < 0)
+        {
+            return -1;
+        }
+
+        board.set(c.x, c.y, piece.color);
+    }
+
+    return board.remove_full_rows();
+}
+
+}
+
+// Hold and the path. Without a path the tetromino is dropped where it is.
+std::vector<GameEngine::Input> BotMove::inputs() const
+{
+    std::vector<GameEngine::Input> inputs;
+
+    if (hold)
+    {
+        inputs.push_back(GameEngine::HOLD);
+    }
+
+    if (path.empty())
+    {
+        // Hard fall only moves the tetromino and the gravity locks it.
+        inputs.push_back(GameEngine::HARD_FALL);
+        inputs.push_back(GameEngine::GRAVITY);
+    }
+    else
+    {
+        inputs.insert(inputs.end(), path.begin(), path.end());
+    }
+
+    return inputs;
+}
+
+template <typename Rules>
+BotSearchCore<Rules>::BotSearchCore(int table_size_log2, int num_threads) :
+    table_(table_size_log2), scores_(new std::atomic<int>[MAX_CANDIDATES]),
+    contexts_(std::max(num_threads, 1))
+{
+    candidates_.reserve(MAX_CANDIDATES);
+
+    for (int i = 1; i < int(contexts_.size()); ++i)
+    {
+        helpers_.emplace_back(&BotSearchCore::run_helper, this, i);
+    }
+}
+
+// Scores in the table were found with the old weights.
+template <typename Rules>
+void BotSearchCore<Rules>::set_weights(const BotWeights& weights)
+{
+    wait_for_helpers();
+
+    weights_ = weights;
+    table_.clear();
+}
+
+template <typename Rules>
+BotSearchCore<Rules>::~BotSearchCore()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        aborted_ = true;
+    }
+
+    job_ready_.notify_all();
+
+    for (std::thread& helper : helpers_)
+    {
+        helper.join();
+    }
+}
+
+// Depth 1 is scored when the candidates are made, so there is always a
+// move. Each deeper depth is searched by all threads. A depth cut by the
+// deadline is still used if the best candidate of the previous depth
+// finished, since the best of the finished candidates is then at least as
+// good as the move already found.
+template <typename Rules>
+typename BotSearchCore<Rules>::Result BotSearchCore<Rules>::search(
+        const GameCore<Rules>& engine, int budget_ms)
+{
+    wait_for_helpers();
+
+    deadline_ = Clock::now() + std::chrono::milliseconds(budget_ms);
+    aborted_ = false;
+    nodes_ = 0;
+    table_.new_search();
+
+    const Board& board = engine.board();
+    int next = engine.next().type;
+
+    candidates_.clear();
+    add_candidates(board, engine.current().type, false, &next, 1);
+
+    // An empty hold takes the moving tetromino and the next one comes.
+    if (engine.can_hold())
+    {
+        if (engine.is_hold_empty())
+        {
+            add_candidates(board, next, true, NULL, 0);
+        }
+        else
+        {
+            add_candidates(board, engine.hold().type, true, &next, 1);
+        }
+    }
+
+    Result result;
+
+    if (candidates_.empty())
+    {
+        return result;
+    }
+
+    auto by_score = [](const Candidate& first, const Candidate& second)
+    {
+        return first.placement.score > second.placement.score;
+    };
+
+    std::stable_sort(candidates_.begin(), candidates_.end(), by_score);
+    result.depth = 1;
+
+    // Helpers of a cut depth may still read the candidates, so they are
+    // not moved after a cut.
+    int chosen = 0;
+
+    for (int depth = 2; depth <= MAX_DEPTH; ++depth)
+    {
+        bool finished = search_depth(depth);
+
+        // Candidates of the depth in the order of the previous depth.
+        int best = -1;
+
+        for (int i = 0; i < int(candidates_.size()); ++i)
+        {
+            int score = scores_[i].load(std::memory_order_relaxed);
+
+            if (score != UNFINISHED && (best < 0 ||
+                    score > scores_[best].load(std::memory_order_relaxed)))
+            {
+                best = i;
+            }
+        }
+
+        if (!finished)
+        {
+            if (scores_[0].load(std::memory_order_relaxed) != UNFINISHED)
+            {
+                chosen = best;
+            }
+
+            break;
+        }
+
+        for (int i = 0; i < int(candidates_.size()); ++i)
+        {
+            candidates_.at(i).placement.score = scores_[i].load(std::memory_order_relaxed);
+        }
+
+        std::stable_sort(candidates_.begin(), candidates_.end(), by_score);
+        result.depth = depth;
+    }
+
+    result.move = move_of(candidates_.at(chosen));
+    result.nodes = nodes_;
+
+    return result;
+}
+
+template <typename Rules>
+void BotSearchCore<Rules>::add_candidates(const Board& board, int type, bool hold,
+                                          const int* known, int num_known)
+{
+    Generator& generator = root_generators_.at(hold);
+    generator.generate(board, type, 0);
+
+    for (int i = 0; i < int(generator.placements().size()); ++i)
+    {
+        if (int(candidates_.size()) == MAX_CANDIDATES)
+        {
+            return;
+        }
+
+        Candidate candidate;
+        Placement& placement = candidate.placement;
+
+        placement.board = board;
+        placement.lines = lock_piece(placement.board, generator.placements().at(i).piece);
+        placement.index = i;
+
+        if (placement.lines < 0)
+        {
+            continue;
+        }
+
+        placement.score = weights_.get(BotWeights::LINES) * placement.lines +
+                evaluate(placement.board, weights_);
+
+        candidate.hold = hold;
+        candidate.num_known = num_known;
+        std::copy(known, known + num_known, candidate.known.begin());
+
+        candidates_.push_back(candidate);
+    }
+}
+
+// The caller searches with the helpers and waits for them only until the
+// deadline. When the caller runs out of candidates every candidate is taken,
+// so the job is closed and a helper which wakes later does not join it.
+template <typename Rules>
+bool BotSearchCore<Rules>::search_depth(int depth)
+{
+    for (int i = 0; i < int(candidates_.size()); ++i)
+    {
+        scores_[i].store(UNFINISHED, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        depth_ = depth;
+        next_candidate_ = 0;
+        job_open_ = true;
+        job_ += 1;
+    }
+
+    job_ready_.notify_all();
+
+    search_candidates(contexts_.at(0));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_open_ = false;
+
+    if (!job_done_.wait_until(lock, deadline_, [this]() { return busy_helpers_ == 0; }))
+    {
+        aborted_ = true;
+    }
+
+    return !aborted_;
+}
+
+template <typename Rules>
+void BotSearchCore<Rules>::search_candidates(Context& context)
+{
+    context.nodes = 0;
+
+    for (int i = next_candidate_++; i < int(candidates_.size()); i = next_candidate_++)
+    {
+        const Candidate& candidate = candidates_.at(i);
+        int score = weights_.get(BotWeights::LINES) * candidate.placement.lines +
+                search_known(context, candidate.placement.board, candidate.known.data(),
+                             candidate.num_known, depth_ - 1);
+
+        if (is_out_of_time())
+        {
+            break;
+        }
+
+        scores_[i].store(score, std::memory_order_relaxed);
+    }
+
+    nodes_ += context.nodes;
+}
+
+template <typename Rules>
+void BotSearchCore<Rules>::run_helper(int index)
+{
+    Tracer::instance().set_thread_name("bot helper");
+
+    int last_job = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            job_ready_.wait(lock, [&]() { return stopping_ || job_ != last_job; });
+
+            if (stopping_)
+            {
+                return;
+            }
+
+            last_job = job_;
+
+            if (!job_open_)
+            {
+                continue;
+            }
+
+            busy_helpers_ += 1;
+        }
+
+        search_candidates(contexts_.at(index));
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_helpers_ -= 1;
+        }
+
+        job_done_.notify_all();
+    }
+}
+
+// Helpers still searching a cut depth stop at their next position, since
+// the search is aborted.
+template <typename Rules>
+void BotSearchCore<Rules>::wait_for_helpers()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_done_.wait(lock, [this]() { return busy_helpers_ == 0; });
+}
+
+template <typename Rules>
+BotMove BotSearchCore<Rules>::move_of(const Candidate& candidate)
+{
+    Generator& generator = root_generators_.at(candidate.hold);
+
+    BotMove move;
+    move.hold = candidate.hold;
+    generator.inputs(generator.placements().at(candidate.placement.index), move.path);
+
+    return move;
+}
+
+// Sum of the column heights, holes under the top square of each column and
+// height differences of neighbouring columns.
+int BotSearchBase::evaluate(const Board& board, const BotWeights& weights)
+{
+    std::array<int, Board::COLUMNS> heights = {};
+    uint16_t covered = 0;
+    int holes = 0;
+
+    for (int y = 0; y < Board::ROWS; ++y)
+    {
+        uint16_t row = board.rows.at(y);
+        uint16_t new_columns = row & ~covered;
+
+        for (int x = 0; new_columns != 0; ++x, new_columns >>= 1)
+        {
+            if (new_columns & 1)
+            {
+                heights.at(x) = Board::ROWS - y;
+            }
+        }
+
+        holes += std::bitset<16>(covered & ~row).count();
+        covered |= row;
+    }
+
+    int height = 0;
+    int bumpiness = 0;
+
+    for (int x = 0; x < Board::COLUMNS; ++x)
+    {
+        height += heights.at(x);
+
+        if (x > 0)
+        {
+            bumpiness += std::abs(heights.at(x) - heights.at(x - 1));
+        }
+    }
+
+    return weights.get(BotWeights::HEIGHT) * height +
+            weights.get(BotWeights::HOLES) * holes +
+            weights.get(BotWeights::BUMPINESS) * bumpiness;
+}
+
+int BotSearchBase::evaluate_placement(const Board& board, const Piece& piece,
+                                      const BotWeights& weights)
+{
+    Board after = board;
+    int lines = lock_piece(after, piece);
+
+    if (lines < 0)
+    {
+        return LOSS;
+    }
+
+    return weights.get(BotWeights::LINES) * lines + evaluate(after, weights);
+}
+
+// The generator finds each placement once with its inputs, which are only
+// needed for the move of the best placement.
+template <typename Rules>
+void BotSearchCore<Rules>::generate(Context& context, int depth, const Board& board,
+                                    int type, std::vector<Placement>& placements)
+{
+    placements.clear();
+
+    Generator& generator = context.generators.at(depth);
+    generator.generate(board, type, 0);
+
+    for (int i = 0; i < int(generator.placements().size()); ++i)
+    {
+        Placement placement;
+        placement.board = board;
+        placement.lines = lock_piece(placement.board, generator.placements().at(i).piece);
+        placement.index = i;
+
+        if (placement.lines >= 0)
+        {
+            placements.push_back(placement);
+        }
+    }
+}
+
+template <typename Rules>
+int BotSearchCore<Rules>::search_known(Context& context, const Board& board,
+                                       const int* types, int num_known, int depth)
+{
+    if (depth == 0)
+    {
+        return evaluate(board, weights_);
+    }
+
+    if (num_known == 0)
+    {
+        return search_unknown(context, board, depth);
+    }
+
+    context.nodes += 1;
+
+    std::vector<Placement>& placements = context.placements.at(depth);
+    generate(context, depth, board, types[0], placements);
+
+    int best = LOSS;
+
+    for (const Placement& placement : placements)
+    {
+        int score = weights_.get(BotWeights::LINES) * placement.lines +
+                search_known(context, placement.board, types + 1, num_known - 1,
+                             depth - 1);
+
+        if (is_out_of_time())
+        {
+            return 0;
+        }
+
+        best = std::max(best, score);
+    }
+
+    return best;
+}
+
+// Only the BEAM_WIDTH placements with the best board score are searched
+// deeper for each tetromino.
+template <typename Rules>
+int BotSearchCore<Rules>::search_unknown(Context& context, const Board& board, int depth)
+{
+    uint64_t key = board.hash + DEPTH_KEY * depth;
+    TranspositionTable::Entry entry;
+
+    if (table_.probe(key, entry) && entry.depth == depth)
+    {
+        return entry.score;
+    }
+
+    context.nodes += 1;
+
+    std::vector<Placement>& placements = context.placements.at(depth);
+    int64_t total = 0;
+
+    for (int type = 0; type < GameEngine::NUMBER_OF_TETROMINOS; ++type)
+    {
+        generate(context, depth, board, type, placements);
+
+        if (placements.empty())
+        {
+            total += LOSS;
+            continue;
+        }
+
+        for (Placement& placement : placements)
+        {
+            placement.score = weights_.get(BotWeights::LINES) * placement.lines +
+                    evaluate(placement.board, weights_);
+        }
+
+        int best = INT_MIN;
+
+        if (depth == 1)
+        {
+            for (const Placement& placement : placements)
+            {
+                best = std::max(best, placement.score);
+            }
+
+            total += best;
+            continue;
+        }
+
+        int width = std::min<int>(BEAM_WIDTH, placements.size());
+
+        std::partial_sort(placements.begin(), placements.begin() + width,
+                          placements.end(),
+                          [](const Placement& first, const Placement& second)
+                          {
+                              return first.score > second.score;
+                          });
+
+        for (int i = 0; i < width; ++i)
+        {
+            const Placement& placement = placements.at(i);
+            int score = weights_.get(BotWeights::LINES) * placement.lines +
+                    search_unknown(context, placement.board, depth - 1);
+
+            if (is_out_of_time())
+            {
+                return 0;
+            }
+
+            best = std::max(best, score);
+        }
+
+        total += best;
+    }
+
+    entry.score = int(total / GameEngine::NUMBER_OF_TETROMINOS);
+    entry.depth = depth;
+    table_.store(key, entry);
+
+    return entry.score;
+}
+
+// Every thread checks the clock, so the deadline holds even if the caller
+// is the only thread which runs.
+template <typename Rules>
+bool BotSearchCore<Rules>::is_out_of_time()
+{
+    if (aborted_.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+
+    if (Clock::now() >= deadline_)
+    {
+        aborted_ = true;
+    }
+
+    return aborted_.load(std::memory_order_relaxed);
+}
+
+
+//*****************************************************************************
+// The searches of every set of rules.
+
+template class BotSearchCore<ClassicRules>;
+template class BotSearchCore<ModernRules>;
+template class BotSearchCore<NoHoldRules>;
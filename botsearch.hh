@@ -0,0 +1,226 @@
+#ifndef BOTSEARCH_HH
+#define BOTSEARCH_HH
+
+#include "botweights.hh"
+#include "gameengine.hh"
+#include "movegenerator.hh"
+#include "transpositiontable.hh"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Where the bot places the moving tetromino, as the inputs which put it
+// there.
+struct BotMove
+{
+    bool hold = false;
+
+    // Shortest inputs from the appear position which lock the tetromino,
+    // as found by the move generator.
+    std::vector<GameEngine::Input> path;
+
+    // Inputs of the whole move with the hold.
+    std::vector<GameEngine::Input> inputs() const;
+};
+
+// Constants and board scores of the search, which do not depend on the
+// rules of the game.
+class BotSearchBase
+{
+public:
+    // Placements kept for each unknown tetromino.
+    static constexpr int BEAM_WIDTH = 6;
+
+    static constexpr int MAX_DEPTH = 6;
+
+    // Score of a lost game.
+    static constexpr int LOSS = -1000000000;
+
+    struct Result
+    {
+        BotMove move;
+
+        // Deepest finished depth in tetrominos.
+        int depth = 0;
+        int64_t nodes = 0;
+    };
+
+    // Score of a board for the bot, higher is better.
+    static int evaluate(const Board& board, const BotWeights& weights);
+
+    // Score of the board after locking the tetromino, with the removed
+    // rows, or LOSS if the tetromino is not in the playing area.
+    static int evaluate_placement(const Board& board, const Piece& piece,
+                                  const BotWeights& weights);
+};
+
+// Searches the placement of the moving tetromino for a bot, with the moves
+// of a set of rules from gamerules.hh.
+//
+// The bot knows what the player sees: the moving, next and hold
+// tetrominos. Deeper than those the score is the average over the seven
+// tetrominos which may come. The search is deepened one tetromino at a
+// time until the time budget is used, and the move of the deepest finished
+// depth is returned.
+//
+// The placements of the moving and the hold tetromino are the root
+// candidates. At each depth the threads take the candidates one at a time,
+// best of the previous depth first, so the work spreads over the threads
+// however long each candidate takes. The thread which called search
+// searches too and returns at the deadline whether or not the other threads
+// have finished, so a loaded machine gives a shallower move but not a late
+// one. Positions deeper than the known tetrominos are kept in the
+// transposition table between searches, so the next tetromino starts from
+// the positions searched for this one.
+template <typename Rules>
+class BotSearchCore : public BotSearchBase
+{
+public:
+    // Table of positions after the known tetrominos, and the number of
+    // threads searching with the caller of search.
+    explicit BotSearchCore(int table_size_log2, int num_threads = 1);
+    ~BotSearchCore();
+
+    BotSearchCore(const BotSearchCore&) = delete;
+    BotSearchCore& operator=(const BotSearchCore&) = delete;
+
+    // Search the move for the game within the budget. The game must have a
+    // moving tetromino.
+    Result search(const GameCore<Rules>& engine, int budget_ms);
+
+    // Weights of the board score. Not called during a search.
+    void set_weights(const BotWeights& weights);
+
+private:
+    using Generator = MoveGenerator<Rules>;
+
+    // Most placements of the moving and the hold tetromino together.
+    static constexpr int MAX_CANDIDATES = 1024;
+
+    // Score of a candidate not searched yet at the depth.
+    static constexpr int UNFINISHED = INT32_MIN;
+
+    // Tetromino placed on a board.
+    struct Placement
+    {
+        Board board;
+        int lines = 0;
+
+        // Index of the placement in the generator of the depth.
+        int index = 0;
+
+        // Score of the board after the placement, for choosing the beam.
+        int score = 0;
+    };
+
+    // Placement of the moving or the hold tetromino and the known
+    // tetrominos which come after it.
+    struct Candidate
+    {
+        Placement placement;
+        bool hold = false;
+        std::array<int, 1> known = {};
+        int num_known = 0;
+    };
+
+    // Everything a thread changes while searching.
+    struct Context
+    {
+        // Generators and placements of each depth, reused so searching
+        // does not allocate.
+        std::vector<Generator> generators = std::vector<Generator>(MAX_DEPTH + 1);
+        std::vector<std::vector<Placement>> placements =
+                std::vector<std::vector<Placement>>(MAX_DEPTH + 1);
+
+        int64_t nodes = 0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // Placements of the tetromino, with depth 1 scores, added to the
+    // candidates.
+    void add_candidates(const Board& board, int type, bool hold,
+                        const int* known, int num_known);
+
+    // Search the candidates at the depth with all threads. Returns true if
+    // every candidate finished before the deadline.
+    bool search_depth(int depth);
+
+    // Take candidates until none is left or the time is over.
+    void search_candidates(Context& context);
+
+    // Loop of a helper thread: wait for a depth and search it.
+    void run_helper(int index);
+
+    // Wait until the helper threads have left the last depth.
+    void wait_for_helpers();
+
+    BotMove move_of(const Candidate& candidate);
+
+    // Every placement of the tetromino reachable from the appear position,
+    // with the generator of the depth.
+    void generate(Context& context, int depth, const Board& board, int type,
+                  std::vector<Placement>& placements);
+
+    // Best score after placing the known tetrominos in order and then
+    // depth tetrominos in all.
+    int search_known(Context& context, const Board& board, const int* types,
+                     int num_known, int depth);
+
+    // Average score over the tetrominos which may come.
+    int search_unknown(Context& context, const Board& board, int depth);
+
+    bool is_out_of_time();
+
+    BotWeights weights_;
+    TranspositionTable table_;
+
+    // Root placements with and without hold, for the inputs of the move.
+    std::array<Generator, 2> root_generators_;
+    std::vector<Candidate> candidates_;
+
+    // Score of each candidate at the depth searched, UNFINISHED until a
+    // thread has searched it.
+    std::unique_ptr<std::atomic<int>[]> scores_;
+
+    // Context 0 is the thread which calls search, the others belong to the
+    // helper threads.
+    std::vector<Context> contexts_;
+    std::vector<std::thread> helpers_;
+
+    // Depth given to the helpers. Set under the mutex before job_ changes.
+    int depth_ = 0;
+    int job_ = 0;
+
+    // Helpers join a job only while it is open and count themselves busy
+    // when they join, so the caller closes the job and waits only for the
+    // helpers which took part.
+    bool job_open_ = false;
+    int busy_helpers_ = 0;
+    bool stopping_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable job_ready_;
+    std::condition_variable job_done_;
+
+    std::atomic<int> next_candidate_ {0};
+    std::atomic<bool> aborted_ {false};
+    std::atomic<int64_t> nodes_ {0};
+    Clock::time_point deadline_;
+};
+
+// The search of the bot of the game.
+using BotSearch = BotSearchCore<ClassicRules>;
+
+// The searches are compiled in botsearch.cpp.
+extern template class BotSearchCore<ClassicRules>;
+extern template class BotSearchCore<ModernRules>;
+extern template class BotSearchCore<NoHoldRules>;
+
+#endif // BOTSEARCH_HH
@@ -0,0 +1,82 @@
+#include "botweights.hh"
+#include <fstream>
+
+namespace
+{
+const std::string WEIGHTS_HEADER = "tetris-bot-weights 1";
+}
+
+const std::array<const char*, BotWeights::NUMBER_OF_WEIGHTS> BotWeights::NAMES =
+{"height", "lines", "holes", "bumpiness"};
+
+// Read the weights. Nothing is changed if the file is not valid.
+bool BotWeights::read(const std::string& file_name)
+{
+    std::ifstream file;
+    file.open(file_name);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::string line = "";
+    std::getline(file, line);
+
+    if (line != WEIGHTS_HEADER)
+    {
+        return false;
+    }
+
+    BotWeights weights = *this;
+    std::string name = "";
+    int value = 0;
+
+    while (file >> name >> value)
+    {
+        int index = 0;
+
+        while (index < NUMBER_OF_WEIGHTS && name != NAMES.at(index))
+        {
+            index += 1;
+        }
+
+        if (index == NUMBER_OF_WEIGHTS)
+        {
+            return false;
+        }
+
+        weights.values.at(index) = value;
+    }
+
+    if (!file.eof())
+    {
+        return false;
+    }
+
+    *this = weights;
+
+    return true;
+}
+
+bool BotWeights::write(const std::string& file_name) const
+{
+    std::ofstream file;
+    file.open(file_name);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << WEIGHTS_HEADER << '\n';
+
+    for (int i = 0; i < NUMBER_OF_WEIGHTS; ++i)
+    {
+        file << NAMES.at(i) << ' ' << values.at(i) << '\n';
+    }
+
+    file.close();
+
+    return !file.fail();
+}
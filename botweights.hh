@@ -0,0 +1,35 @@
+#ifndef BOTWEIGHTS_HH
+#define BOTWEIGHTS_HH
+
+#include <array>
+#include <string>
+
+// Weights of the board score of the bots in thousandths. The defaults are
+// from the well known hand tuned bots. Tuned weights are written by the
+// tuner tool and read by the game.
+//
+// File format, one value per line:
+//   tetris-bot-weights 1
+//   <name> <weight>
+// with a line for each weight in any order. Weights without a line keep
+// their default.
+struct BotWeights
+{
+    enum Weight {HEIGHT,
+                 LINES,
+                 HOLES,
+                 BUMPINESS,
+                 NUMBER_OF_WEIGHTS};
+
+    // Names of the weights in the file.
+    static const std::array<const char*, NUMBER_OF_WEIGHTS> NAMES;
+
+    std::array<int, NUMBER_OF_WEIGHTS> values = {-510, 760, -357, -184};
+
+    int get(Weight weight) const { return values.at(weight); }
+
+    bool read(const std::string& file_name);
+    bool write(const std::string& file_name) const;
+};
+
+#endif // BOTWEIGHTS_HH
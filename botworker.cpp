@@ -0,0 +1,90 @@
+#include "botworker.hh"
+#include "tracer.hh"
+#include <algorithm>
+#include <chrono>
+
+BotWorker::~BotWorker()
+{
+    stop();
+}
+
+// The thread reads the weights when it starts.
+void BotWorker::set_weights(const BotWeights& weights)
+{
+    weights_ = weights;
+}
+
+void BotWorker::start()
+{
+    if (running_)
+    {
+        return;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&BotWorker::run, this);
+}
+
+void BotWorker::stop()
+{
+    running_ = false;
+
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+bool BotWorker::post(const Request& request)
+{
+    return requests_.push(request);
+}
+
+bool BotWorker::take(Reply& reply)
+{
+    return replies_.pop(reply);
+}
+
+// The thread sleeps a millisecond when there is nothing to do. A move is
+// needed at most a few times per second, so polling costs nothing.
+void BotWorker::run()
+{
+    Tracer::instance().set_thread_name("bot");
+
+    int cores = std::thread::hardware_concurrency();
+    BotSearch search(TABLE_SIZE_LOG2, std::max(1, std::min(cores - 1, MAX_SEARCH_THREADS)));
+    search.set_weights(weights_);
+
+    GameEngine engine;
+    Request request;
+
+    while (running_)
+    {
+        if (!requests_.pop(request))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        Reply reply;
+        reply.id = request.id;
+
+        // A state which cannot be searched gets the move which drops the
+        // tetromino where it is.
+        if (engine.load_state(request.state) && engine.is_piece_active())
+        {
+            TRACE_SCOPE("bot search");
+
+            BotSearch::Result result = search.search(engine, request.budget_ms);
+
+            reply.move = result.move;
+            reply.depth = result.depth;
+            reply.nodes = result.nodes;
+        }
+
+        while (!replies_.push(reply) && running_)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
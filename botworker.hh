@@ -0,0 +1,72 @@
+#ifndef BOTWORKER_HH
+#define BOTWORKER_HH
+
+#include "botsearch.hh"
+#include "spscqueue.hh"
+#include <atomic>
+#include <thread>
+
+// Runs the bot search on its own thread. The game posts the state when a
+// new tetromino appears and takes the move when it is ready. States and
+// moves go through lock free queues, so the game thread never waits for
+// the search.
+class BotWorker
+{
+public:
+    // Size of the transposition table of the search.
+    static constexpr int TABLE_SIZE_LOG2 = 16;
+
+    // Most threads searching with the worker thread. One core is left for
+    // the game.
+    static constexpr int MAX_SEARCH_THREADS = 4;
+
+    struct Request
+    {
+        // Returned with the reply so old replies can be ignored.
+        uint32_t id = 0;
+
+        GameEngine::State state = {};
+        int budget_ms = 0;
+    };
+
+    struct Reply
+    {
+        uint32_t id = 0;
+        BotMove move;
+        int depth = 0;
+        int64_t nodes = 0;
+    };
+
+    BotWorker() = default;
+    ~BotWorker();
+
+    BotWorker(const BotWorker&) = delete;
+    BotWorker& operator=(const BotWorker&) = delete;
+
+    // Weights of the bot from the next start.
+    void set_weights(const BotWeights& weights);
+
+    void start();
+
+    // Wait until the search in progress ends and stop the thread.
+    void stop();
+
+    // Called by the game thread. Returns false if the queue is full.
+    bool post(const Request& request);
+
+    // Called by the game thread. Returns false if no move is ready.
+    bool take(Reply& reply);
+
+private:
+    void run();
+
+    BotWeights weights_;
+
+    SpscQueue<Request, 4> requests_;
+    SpscQueue<Reply, 4> replies_;
+
+    std::atomic<bool> running_ {false};
+    std::thread thread_;
+};
+
+#endif // BOTWORKER_HH
@@ -0,0 +1,48 @@
+# Rules of the game without the window. Shared by the game and the tools.
+
+INCLUDEPATH += $$PWD
+
+# The bot searches on its own thread.
+CONFIG += thread
+
+SOURCES += \
+        $$PWD/botsearch.cpp \
+        $$PWD/botweights.cpp \
+        $$PWD/botworker.cpp \
+        $$PWD/finesse.cpp \
+        $$PWD/gameengine.cpp \
+        $$PWD/gamerules.cpp \
+        $$PWD/movegenerator.cpp \
+        $$PWD/perfectclear.cpp \
+        $$PWD/pieceset.cpp \
+        $$PWD/replay.cpp \
+        $$PWD/replayarchive.cpp \
+        $$PWD/rewindbuffer.cpp \
+        $$PWD/snapshot.cpp \
+        $$PWD/spectatorstream.cpp \
+        $$PWD/tracer.cpp \
+        $$PWD/transpositiontable.cpp \
+        $$PWD/versussession.cpp
+
+HEADERS += \
+        $$PWD/board.hh \
+        $$PWD/botsearch.hh \
+        $$PWD/botweights.hh \
+        $$PWD/botworker.hh \
+        $$PWD/finesse.hh \
+        $$PWD/gameengine.hh \
+        $$PWD/gamerules.hh \
+        $$PWD/movegenerator.hh \
+        $$PWD/palette.hh \
+        $$PWD/perfectclear.hh \
+        $$PWD/pieceset.hh \
+        $$PWD/replay.hh \
+        $$PWD/replayarchive.hh \
+        $$PWD/rewindbuffer.hh \
+        $$PWD/snapshot.hh \
+        $$PWD/spectatorstream.hh \
+        $$PWD/spscqueue.hh \
+        $$PWD/tracer.hh \
+        $$PWD/transpositiontable.hh \
+        $$PWD/versussession.hh \
+        $$PWD/zobrist.hh
@@ -0,0 +1,200 @@
+#include "externalbot.hh"
+#include "perfcounters.hh"
+#include <QProcess>
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+
+const char PROTOCOL_HEADER[] = "tetris-bot 1\n";
+
+// Time the program has to start, and to quit after its input is closed.
+const int START_WAIT_MS = 3000;
+const int EXIT_WAIT_MS = 500;
+
+}
+
+ExternalBot::ExternalBot(QObject* parent) :
+    QObject(parent)
+{
+}
+
+// Closing the input asks the program to quit. It is killed if it does
+// not.
+ExternalBot::~ExternalBot()
+{
+    if (process_ == NULL || !running_)
+    {
+        return;
+    }
+
+    process_->disconnect(this);
+    process_->closeWriteChannel();
+
+    if (!process_->waitForFinished(EXIT_WAIT_MS))
+    {
+        process_->kill();
+        process_->waitForFinished(EXIT_WAIT_MS);
+    }
+}
+
+// The errors of the program go to the errors of the game, so bot authors
+// see them.
+bool ExternalBot::start(const QString& program)
+{
+    process_ = new QProcess(this);
+    process_->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+    connect(process_, &QProcess::readyReadStandardOutput,
+            this, &ExternalBot::read_replies);
+    connect(process_, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ExternalBot::process_finished);
+
+    process_->start(program, QStringList());
+
+    if (!process_->waitForStarted(START_WAIT_MS))
+    {
+        return false;
+    }
+
+    running_ = true;
+    process_->write(PROTOCOL_HEADER);
+
+    return true;
+}
+
+// The line is made in a stack buffer, so a message costs one write.
+bool ExternalBot::post(const BotWorker::Request& request)
+{
+    if (!running_ || !engine_.load_state(request.state) || !engine_.is_piece_active())
+    {
+        return false;
+    }
+
+    char line[64 + Board::ROWS * 3];
+    int length = snprintf(line, sizeof(line), "piece %u %d %d %d %c %d ",
+                          request.id, request.budget_ms, engine_.current().type,
+                          engine_.next().type,
+                          engine_.is_hold_empty() ? '-' : char('0' + engine_.hold().type),
+                          engine_.can_hold() ? 1 : 0);
+
+    for (uint16_t row : engine_.board().rows)
+    {
+        length += snprintf(line + length, sizeof(line) - length, "%03x", row);
+    }
+
+    line[length++] = '\n';
+
+    Pending pending;
+    pending.id = request.id;
+    pending.budget_ms = request.budget_ms;
+    pending.clock.start();
+    pending_.push_back(pending);
+
+    process_->write(line, length);
+
+    return true;
+}
+
+// Pieces are answered in the order they were sent, so only the oldest
+// one is checked for its time.
+bool ExternalBot::take(BotWorker::Reply& reply)
+{
+    while (!pending_.empty() && (!running_ ||
+            pending_.front().clock.elapsed() > pending_.front().budget_ms + GRACE_MS))
+    {
+        if (running_)
+        {
+            PerfCounters::add(PerfCounters::BOT_TIMEOUTS, 1);
+        }
+
+        BotWorker::Reply dropped;
+        dropped.id = pending_.front().id;
+        replies_.push_back(dropped);
+
+        pending_.pop_front();
+    }
+
+    if (replies_.empty())
+    {
+        return false;
+    }
+
+    reply = replies_.front();
+    replies_.pop_front();
+
+    return true;
+}
+
+// Lines may arrive split, so the bytes are kept until a whole line is
+// received.
+void ExternalBot::read_replies()
+{
+    received_.append(process_->readAllStandardOutput());
+
+    int start = 0;
+
+    for (int end = received_.indexOf('\n', start); end >= 0;
+         end = received_.indexOf('\n', start))
+    {
+        read_reply(received_.mid(start, end - start));
+        start = end + 1;
+    }
+
+    received_.remove(0, start);
+}
+
+// A move for a piece which is not waiting any more came too late and is
+// ignored. A move with an unknown input drops the tetromino.
+void ExternalBot::read_reply(const QByteArray& line)
+{
+    QList<QByteArray> parts = line.trimmed().split(' ');
+
+    if (parts.size() != 3 || parts.at(0) != "move")
+    {
+        return;
+    }
+
+    bool valid = false;
+    uint32_t id = parts.at(1).toUInt(&valid);
+
+    auto pending = std::find_if(pending_.begin(), pending_.end(),
+                                [id](const Pending& piece) { return piece.id == id; });
+
+    if (!valid || pending == pending_.end())
+    {
+        return;
+    }
+
+    PerfCounters::set(PerfCounters::BOT_LATENCY_US, pending->clock.nsecsElapsed() / 1000);
+    pending_.erase(pending);
+
+    BotWorker::Reply reply;
+    reply.id = id;
+
+    if (parts.at(2) != "-")
+    {
+        for (char letter : parts.at(2))
+        {
+            GameEngine::Input input;
+
+            if (!GameEngine::input_from_letter(letter, input) || input == GameEngine::SPAWN)
+            {
+                reply.move.path.clear();
+                break;
+            }
+
+            reply.move.path.push_back(input);
+        }
+    }
+
+    replies_.push_back(reply);
+}
+
+void ExternalBot::process_finished()
+{
+    running_ = false;
+
+    emit stopped();
+}
@@ -0,0 +1,89 @@
+#ifndef EXTERNALBOT_HH
+#define EXTERNALBOT_HH
+
+#include "botworker.hh"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <deque>
+
+class QProcess;
+
+// Bot played by another program, so bots can be written with any tools.
+// The program gets the game on its standard input and writes its moves on
+// its standard output, one message on each line. It runs in its own
+// process, so a bot which crashes or hangs only loses its moves: the game
+// drops the tetromino where it is.
+//
+// The first line to the bot is the version of the protocol:
+//   tetris-bot 1
+//
+// Game to bot, for each tetromino:
+//   piece <id> <budget ms> <moving> <next> <hold> <can hold> <rows>
+// The tetrominos are numbers of GameEngine::Tetromino_kind, and the hold is
+// - when empty. Can hold is 0 or 1. The rows are the rows of the board from
+// the top, each three hex digits of a mask with bit x set if the cell in
+// column x is occupied.
+//
+// Bot to game:
+//   move <id> <inputs>
+// The inputs are the key letters of recorded games (A D W R S C F G) from
+// where the tetromino appears, or - for none, which drops it there.
+//
+// The game sends a piece as soon as it knows where the tetromino appears,
+// usually while the move before it is still shown, so the bot thinks ahead.
+// A move which does not come within the budget and GRACE_MS is given up.
+class ExternalBot : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Time over the budget before the tetromino is dropped.
+    static constexpr int GRACE_MS = 100;
+
+    explicit ExternalBot(QObject* parent = 0);
+    ~ExternalBot();
+
+    // Returns false if the program cannot be started.
+    bool start(const QString& program);
+
+    // Same as the bot worker. Post returns false if the program is not
+    // running. Take gives a move without inputs for a piece whose time is
+    // over.
+    bool post(const BotWorker::Request& request);
+    bool take(BotWorker::Reply& reply);
+
+signals:
+    // The program ended or crashed.
+    void stopped();
+
+private slots:
+    void read_replies();
+    void process_finished();
+
+private:
+    // Piece sent to the bot and waiting for its move.
+    struct Pending
+    {
+        uint32_t id = 0;
+        int budget_ms = 0;
+        QElapsedTimer clock;
+    };
+
+    void read_reply(const QByteArray& line);
+
+    QProcess* process_ = NULL;
+    bool running_ = false;
+
+    // Bytes of a line which has not arrived completely.
+    QByteArray received_;
+
+    std::deque<Pending> pending_;
+    std::deque<BotWorker::Reply> replies_;
+
+    // Reads the states of the requests.
+    GameEngine engine_;
+};
+
+#endif // EXTERNALBOT_HH
@@ -0,0 +1,97 @@
+#include "finesse.hh"
+#include "tracer.hh"
+
+void FinesseAnalyzer::reset()
+{
+    has_start_ = false;
+    keys_ = 0;
+    held_ = false;
+    dropped_ = false;
+    totals_ = Totals();
+}
+
+// A hold which makes the next tetromino appear continues the same
+// tetromino, since the fewest keys are counted with the hold.
+void FinesseAnalyzer::record(GameEngine::Input input, int result,
+                             const GameEngine& engine)
+{
+    if ((result & GameEngine::SPAWNED) && !(result & GameEngine::HELD))
+    {
+        start_ = engine;
+        has_start_ = true;
+        keys_ = 0;
+        held_ = false;
+        dropped_ = false;
+    }
+    else if (input != GameEngine::SPAWN && input != GameEngine::GRAVITY)
+    {
+        keys_ += 1;
+        held_ |= (result & GameEngine::HELD) != 0;
+        dropped_ |= input == GameEngine::HARD_FALL || input == GameEngine::SOFT_FALL;
+    }
+
+    if (result & GameEngine::LOCKED)
+    {
+        if (has_start_)
+        {
+            compare(last_piece_);
+        }
+
+        has_start_ = false;
+    }
+
+    if (engine.is_piece_active())
+    {
+        last_piece_ = engine.current();
+    }
+}
+
+double FinesseAnalyzer::keys_per_piece() const
+{
+    if (totals_.pieces == 0)
+    {
+        return 0;
+    }
+
+    return double(totals_.keys) / totals_.pieces;
+}
+
+// The placement is the one with the same rows at the same height. A
+// tetromino which locked somewhere the generator cannot reach, such as a
+// held tetromino which appeared on occupied cells, is not compared.
+void FinesseAnalyzer::compare(const Piece& locked)
+{
+    TRACE_SCOPE("finesse compare");
+
+    generator_.generate(start_);
+
+    for (const MoveGenerator<ClassicRules>::Placement& placement : generator_.placements())
+    {
+        const Piece& piece = placement.piece;
+
+        if (placement.hold != held_ || piece.type != locked.type ||
+                piece.up != locked.up || piece.masks != locked.masks)
+        {
+            continue;
+        }
+
+        generator_.key_inputs(placement, path_);
+
+        // Gravity takes the tetromino down without falls, so a player who
+        // did not wait needed one fall.
+        int minimum = dropped_ ? 1 : 0;
+
+        for (GameEngine::Input input : path_)
+        {
+            minimum += input != GameEngine::GRAVITY && input != GameEngine::HARD_FALL &&
+                    input != GameEngine::SOFT_FALL;
+        }
+
+        totals_.pieces += 1;
+        totals_.keys += keys_;
+        totals_.minimum_keys += minimum;
+        totals_.faults += keys_ > minimum;
+
+        return;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef FINESSE_HH
+#define FINESSE_HH
+
+#include "gameengine.hh"
+#include "movegenerator.hh"
+#include <vector>
+
+// Compares the keys the player pressed for each tetromino with the fewest
+// keys which lock it at the same place, as found by the move generator from
+// where the tetromino appeared. A tetromino which took more keys than needed
+// is a fault.
+//
+// Gravity is not a key: the timer gives it. A player who made the tetromino
+// fall instead of waiting needed one fall, which the fewest keys then count.
+// The comparison is done once at each lock from a copy of the game taken
+// when the tetromino appeared, so the other inputs only count keys.
+class FinesseAnalyzer
+{
+public:
+    struct Totals
+    {
+        // Tetrominos compared, the keys pressed for them and the fewest
+        // keys which would have placed them.
+        int pieces = 0;
+        int keys = 0;
+        int minimum_keys = 0;
+
+        // Tetrominos which took more keys than the fewest.
+        int faults = 0;
+    };
+
+    // Start a new game.
+    void reset();
+
+    // Called after every input given to the game with its result.
+    void record(GameEngine::Input input, int result, const GameEngine& engine);
+
+    const Totals& totals() const { return totals_; }
+
+    double keys_per_piece() const;
+
+private:
+    // Compare the keys of the locked tetromino with the fewest.
+    void compare(const Piece& locked);
+
+    MoveGenerator<ClassicRules> generator_;
+    std::vector<GameEngine::Input> path_;
+
+    // Game when the moving tetromino appeared, before any key.
+    GameEngine start_;
+    bool has_start_ = false;
+
+    // Moving tetromino after the last input, where it locks.
+    Piece last_piece_;
+
+    int keys_ = 0;
+    bool held_ = false;
+
+    // A fall was pressed for the moving tetromino.
+    bool dropped_ = false;
+
+    Totals totals_;
+};
+
+#endif // FINESSE_HH
@@ -0,0 +1,1185 @@
+#include "gameengine.hh"
+#include "tracer.hh"
+#include <algorithm>
+
+namespace
+{
+
+// Writes values to a saved state in little endian order.
+class StateWriter
+{
+public:
+    explicit StateWriter(uint8_t* data):
+        data_(data)
+    {
+    }
+
+    void put(uint32_t value, int num_bytes)
+    {
+        for (int i = 0; i < num_bytes; ++i)
+        {
+            data_[position_++] = uint8_t(value >> (8 * i));
+        }
+    }
+
+private:
+    uint8_t* data_;
+    int position_ = 0;
+};
+
+// Columns of a mask moved to the right, or to the left if negative.
+uint16_t shift_mask(uint16_t mask, int delta_x)
+{
+    return delta_x < 0 ? mask >> -delta_x : mask << delta_x;
+}
+
+// True if the tetromino moved by the columns and rows is on an occupied
+// cell. One mask test for each row of the tetromino. Rows above the board
+// are empty, and the caller checks the sides and the bottom.
+bool overlaps(const Board& board, const Piece& piece, int delta_x, int delta_y)
+{
+    for (int row = 0; row < piece.height(); ++row)
+    {
+        int y = piece.up + row + delta_y;
+
+        if (y >= 0 && (board.rows[y] & shift_mask(piece.masks[row], delta_x)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Reads values written by StateWriter.
+class StateReader
+{
+public:
+    explicit StateReader(const uint8_t* data):
+        data_(data)
+    {
+    }
+
+    uint32_t get(int num_bytes)
+    {
+        uint32_t value = 0;
+
+        for (int i = 0; i < num_bytes; ++i)
+        {
+            value |= uint32_t(data_[position_++]) << (8 * i);
+        }
+
+        return value;
+    }
+
+    // Signed value of one byte.
+    int get_small()
+    {
+        return int8_t(get(1));
+    }
+
+private:
+    const uint8_t* data_;
+    int position_ = 0;
+};
+
+}
+
+//*****************************************************************************
+// Functions related to setup the game.
+
+// Setup value for start the game.
+template <typename Rules>
+void GameCore<Rules>::reset(uint32_t seed, Mode mode)
+{
+    board_ = Board();
+
+    curr_tetro_ = Piece();
+    next_tetro_ = Piece();
+    hold_tetro_ = Piece();
+
+    // The generator must not start from zero.
+    random_state_ = seed % 2147483646u + 1;
+    bag_ = 0;
+    garbage_random_ = (seed ^ 0x5A5A5A5Au) % 2147483646u + 1;
+
+    piece_active_ = false;
+    game_over_ = false;
+    can_hold_ = Rules::Hold::ENABLED;
+    is_hold_empty_ = true;
+    completed_ = false;
+
+    mode_ = mode;
+    garbage_rows_ = 0;
+    garbage_to_come_ = 0;
+    locks_to_garbage_ = DigRace::INTERVAL;
+    last_hole_ = 0;
+
+    playing_level_ = 0;
+    playing_points_ = 0;
+    total_lines_removed_ = 0;
+    tetris_points_ = 0;
+    num_turn_ = 0;
+    last_rows_removed_ = 0;
+    playing_speed_ = Rules::Gravity::speed(0);
+
+    set_all_rows_dirty();
+
+    prepare_next_tetromino();
+
+    last_hole_ = minstd_next(garbage_random_) % COLUMNS;
+
+    switch (mode_)
+    {
+    case DIG_RACE:
+        start_race<DigRace>();
+        break;
+
+    case CHEESE_RACE:
+        start_race<CheeseRace>();
+        break;
+
+    default:
+        start_race<NoRace>();
+        break;
+    }
+}
+
+// Apply one input of the player or the timer.
+template <typename Rules>
+int GameCore<Rules>::apply(Input input)
+{
+    if (game_over_)
+    {
+        return NOTHING;
+    }
+
+    // A new tetromino can only drop when there is no moving one.
+    if (input == SPAWN)
+    {
+        if (piece_active_)
+        {
+            return NOTHING;
+        }
+
+        return continue_game() ? SPAWNED : GAME_OVER;
+    }
+
+    if (!piece_active_)
+    {
+        return NOTHING;
+    }
+
+    switch (input)
+    {
+    case LEFT:
+        if (!can_move_left(board_, curr_tetro_))
+        {
+            return NOTHING;
+        }
+
+        move_piece(curr_tetro_, -1, 0);
+        return MOVED;
+
+    case RIGHT:
+        if (!can_move_right(board_, curr_tetro_))
+        {
+            return NOTHING;
+        }
+
+        move_piece(curr_tetro_, 1, 0);
+        return MOVED;
+
+    case ROTATE:
+    {
+        // Every turn is counted for calculate points, also the
+        // turns which are not possible.
+        num_turn_ += 1;
+
+        return rotate_counterclockwise(board_, curr_tetro_) ? MOVED : NOTHING;
+    }
+
+    case REFLECT:
+        return reflect_vertical_axis(board_, curr_tetro_) ? MOVED : NOTHING;
+
+    case SOFT_FALL:
+        move_soft_fall(board_, curr_tetro_);
+        return MOVED;
+
+    case HARD_FALL:
+        move_hard_fall(board_, curr_tetro_);
+        return MOVED;
+
+    case HOLD:
+        return exchange_tetromino();
+
+    case GRAVITY:
+        if (can_move_down(board_, curr_tetro_))
+        {
+            move_piece(curr_tetro_, 0, 1);
+            return MOVED;
+        }
+
+        return update_game();
+
+    default:
+        return NOTHING;
+    }
+}
+
+// Find the input of a key letter used in recorded games.
+bool GameCoreBase::input_from_letter(char letter, Input& input)
+{
+    for (int i = 0; i < NUMBER_OF_INPUTS; ++i)
+    {
+        if (INPUT_LETTERS.at(i) == letter)
+        {
+            input = static_cast<Input>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Garbage rows from the other player or a training mode.
+template <typename Rules>
+int GameCore<Rules>::add_garbage(int num_rows, int hole_column)
+{
+    // The column may come from the other player over the network.
+    if (hole_column < 0 || hole_column >= COLUMNS)
+    {
+        return NOTHING;
+    }
+
+    std::array<uint16_t, ROWS> masks;
+    num_rows = std::min(num_rows, int(ROWS));
+
+    for (int i = 0; i < num_rows; ++i)
+    {
+        masks.at(i) = Board::FULL_ROW & ~(1 << hole_column);
+    }
+
+    return raise_board(masks.data(), num_rows);
+}
+
+
+//*****************************************************************************
+// Functions related to status of the game.
+
+// Make the next tetromino the moving one. Returns false if it
+// can not get into the playing area and the game is over.
+template <typename Rules>
+bool GameCore<Rules>::continue_game()
+{
+    make_new_tetromino();
+
+    // Game is over when tetromino the get into playing area.
+    if (is_blocked(board_, curr_tetro_))
+    {
+        game_over_ = true;
+        piece_active_ = false;
+
+        make_appear_over();
+        return false;
+    }
+
+    can_hold_ = Rules::Hold::ENABLED;
+    piece_active_ = true;
+
+    return true;
+}
+
+// Create new tetromino for next drop.
+template <typename Rules>
+void GameCore<Rules>::make_new_tetromino()
+{
+    curr_tetro_ = make_piece(next_tetro_.type, next_tetro_.color);
+    num_turn_ = 0;
+
+    prepare_next_tetromino();
+}
+
+// Prepare information of the next tetromino.
+template <typename Rules>
+void GameCore<Rules>::prepare_next_tetromino()
+{
+    int type = 0;
+    int color_index = 0;
+
+    Rules::Randomizer::next(random_state_, bag_, type, color_index);
+
+    next_tetro_ = make_piece(type, playing_level_ * NUM_COLOR_IN_LEVEL + color_index);
+}
+
+// Put the part of tetromino which fits in the playing area to the
+// board when it can not get into playing area.
+template <typename Rules>
+void GameCore<Rules>::make_appear_over()
+{
+    // Find how many square need to move up to fit in
+    // playing area.
+    int move_up = 1;
+    while (curr_tetro_.bottom - move_up >= 0)
+    {
+        bool found_suitable_position = true;
+        for (int i = 0; i < NUM_SQUARE; ++i)
+        {
+            Coord c(curr_tetro_.squares.at(i));
+            c.y -= move_up;
+
+            // Check only part apper on the scene.
+            if (c.y >= 0 && board_.is_occupied(c.x, c.y))
+            {
+                found_suitable_position = false;
+                break;
+            }
+        }
+
+        if (found_suitable_position)
+        {
+            break;
+        }
+
+        // Try moving up one unit.
+        move_up += 1;
+    }
+
+    // Move up tetromino for fit in playing area.
+    if (curr_tetro_.bottom - move_up >= 0)
+    {
+        for (int i = 0; i < NUM_SQUARE; ++i)
+        {
+            Coord c(curr_tetro_.squares.at(i));
+            c.y -= move_up;
+
+            if (c.y >= 0)
+            {
+                board_.set(c.x, c.y, curr_tetro_.color);
+                dirty_rows_ |= 1u << c.y;
+            }
+        }
+    }
+}
+
+// Lock the tetromino which can not move down and calculate points.
+template <typename Rules>
+int GameCore<Rules>::update_game()
+{
+    update_grid();
+    piece_active_ = false;
+
+    last_rows_removed_ = remove_full_row();
+
+    int result = LOCKED | update_player_score(last_rows_removed_);
+
+    switch (mode_)
+    {
+    case DIG_RACE:
+        return result | update_race<DigRace>();
+
+    case CHEESE_RACE:
+        return result | update_race<CheeseRace>();
+
+    default:
+        return result | update_race<NoRace>();
+    }
+}
+
+// Add squares of the moving tetromino to the board.
+template <typename Rules>
+void GameCore<Rules>::update_grid()
+{
+    TRACE_SCOPE("update_grid");
+
+    for (int i = 0; i < NUM_SQUARE; ++i)
+    {
+        Coord c(curr_tetro_.squares.at(i));
+
+        board_.set(c.x, c.y, curr_tetro_.color);
+        dirty_rows_ |= 1u << c.y;
+    }
+}
+
+// Remove full row and move the grid down.
+template <typename Rules>
+int GameCore<Rules>::remove_full_row()
+{
+    TRACE_SCOPE("remove_full_row");
+
+    int total_remove_row = 0;
+    int lowest_row_remove = -1;
+    int num_row_remove = 0;
+
+    do
+    {
+        move_grid_down(num_row_remove, lowest_row_remove);
+
+        total_remove_row += num_row_remove;
+
+        // Set up values for next round of finding.
+        num_row_remove = 0;
+        lowest_row_remove = -1;
+
+        // Find complete row.
+        for (int row = curr_tetro_.bottom; row >= curr_tetro_.up; --row)
+        {
+            if (board_.rows.at(row) == Board::FULL_ROW)
+            {
+                num_row_remove += 1;
+                if (lowest_row_remove < row)
+                {
+                    lowest_row_remove = row;
+                }
+            }
+        }
+    }
+    while (num_row_remove != 0);
+
+    return total_remove_row;
+}
+
+// Move every row above the lowest removed row down by the number of
+// removed rows.
+template <typename Rules>
+void GameCore<Rules>::move_grid_down(int num_row_remove, int lowest_row_remove)
+{
+    if (num_row_remove <= 0)
+    {
+        return;
+    }
+
+    TRACE_SCOPE("move_grid_down");
+
+    // Removed garbage rows are the ones under the garbage top.
+    int garbage_top = ROWS - garbage_rows_;
+    int highest_row_remove = lowest_row_remove - num_row_remove + 1;
+
+    if (lowest_row_remove >= garbage_top)
+    {
+        garbage_rows_ -= lowest_row_remove -
+                std::max(garbage_top, highest_row_remove) + 1;
+    }
+
+    for (int row = lowest_row_remove; row >= 0; --row)
+    {
+        if (row - num_row_remove < 0)
+        {
+            // No square going to fill this row.
+            board_.copy_row(row, 0, {});
+        }
+        else
+        {
+            board_.copy_row(row, board_.rows.at(row - num_row_remove),
+                            board_.colors.at(row - num_row_remove));
+        }
+    }
+
+    dirty_rows_ |= (2u << lowest_row_remove) - 1;
+}
+
+// Update player score after each drop and update leve.
+// Returns LEVEL_UP or MAX_LEVEL when the level threshold is reached.
+template <typename Rules>
+int GameCore<Rules>::update_player_score(int num_row_remove)
+{
+    playing_points_ += calculate_point(num_row_remove, num_turn_, playing_level_);
+    total_lines_removed_ += num_row_remove;
+
+    if (num_row_remove >= 4)
+    {
+        tetris_points_ += 1;
+    }
+
+    if (playing_points_ >= Rules::Gravity::threshold(playing_level_))
+    {
+        return update_level() ? LEVEL_UP : MAX_LEVEL;
+    }
+
+    return NOTHING;
+}
+
+// Update playing level. Returns false if already in the maximum level.
+template <typename Rules>
+bool GameCore<Rules>::update_level()
+{
+    if (playing_level_ < NUM_LEVELS - 1)
+    {
+        playing_level_ += 1;
+
+        // Increasing fall speed.
+        playing_speed_ = Rules::Gravity::speed(playing_level_);
+
+        return true;
+    }
+
+    return false;
+}
+
+// Exchange current playing tetromino to hold position and move
+// hold tetromino to plaing area.
+template <typename Rules>
+int GameCore<Rules>::exchange_tetromino()
+{
+    // In one drop can only hold one time.
+    if (!Rules::Hold::ENABLED || !can_hold_)
+    {
+        return NOTHING;
+    }
+
+    int result = HELD;
+    Piece temp = curr_tetro_;
+
+    if (!is_hold_empty_)
+    {
+        // Hold tetromino appears at the top without resetting the turns.
+        curr_tetro_ = make_piece(hold_tetro_.type, hold_tetro_.color);
+    }
+    else
+    {
+        result |= continue_game() ? SPAWNED : GAME_OVER;
+    }
+
+    hold_tetro_ = make_piece(temp.type, temp.color);
+
+    is_hold_empty_ = false;
+    can_hold_ = false;
+
+    return result;
+}
+
+
+//*****************************************************************************
+// Functions related to the races.
+
+// Push the rows up in one move of the masks and the colors. The game is over
+// if a square is pushed out or the moving tetromino cannot go up, the same
+// tests as for a new tetromino.
+template <typename Rules>
+int GameCore<Rules>::raise_board(const uint16_t* masks, int num_rows)
+{
+    if (game_over_ || num_rows <= 0)
+    {
+        return NOTHING;
+    }
+
+    TRACE_SCOPE("raise_board");
+
+    bool pushed_out = false;
+
+    for (int row = 0; row < num_rows; ++row)
+    {
+        pushed_out |= board_.rows.at(row) != 0;
+    }
+
+    board_.push_up(masks, num_rows, GARBAGE_COLOR);
+    garbage_rows_ = std::min(garbage_rows_ + num_rows, int(ROWS));
+    set_all_rows_dirty();
+
+    // The moving tetromino stays where it is unless the rows come under
+    // its squares.
+    while (piece_active_ && !pushed_out && is_blocked(board_, curr_tetro_))
+    {
+        if (curr_tetro_.up <= 0)
+        {
+            pushed_out = true;
+            break;
+        }
+
+        move_piece(curr_tetro_, 0, -1);
+    }
+
+    if (pushed_out)
+    {
+        game_over_ = true;
+        piece_active_ = false;
+
+        return GAME_OVER;
+    }
+
+    return MOVED;
+}
+
+// Garbage rows on the board at the start of the race.
+template <typename Rules>
+template <typename Race>
+void GameCore<Rules>::start_race()
+{
+    if (!Race::ENABLED)
+    {
+        return;
+    }
+
+    garbage_to_come_ = Race::LINES;
+    add_race_garbage<Race>(Race::START_ROWS);
+}
+
+// Garbage rows of the race from the garbage random numbers.
+template <typename Rules>
+template <typename Race>
+int GameCore<Rules>::add_race_garbage(int num_rows)
+{
+    std::array<uint16_t, ROWS> masks;
+    num_rows = std::min({num_rows, garbage_to_come_, int(ROWS)});
+
+    for (int i = 0; i < num_rows; ++i)
+    {
+        uint32_t random = minstd_next(garbage_random_);
+
+        if (Race::moves_hole(random))
+        {
+            last_hole_ = (last_hole_ + 1 + (random >> 8) % (COLUMNS - 1)) % COLUMNS;
+        }
+
+        masks.at(i) = Board::FULL_ROW & ~(1 << last_hole_);
+    }
+
+    garbage_to_come_ -= num_rows;
+
+    return raise_board(masks.data(), num_rows);
+}
+
+// Bring more garbage after a lock, or complete the race when all garbage
+// rows are removed.
+template <typename Rules>
+template <typename Race>
+int GameCore<Rules>::update_race()
+{
+    if (!Race::ENABLED)
+    {
+        return NOTHING;
+    }
+
+    if (garbage_rows_ == 0 && garbage_to_come_ == 0)
+    {
+        completed_ = true;
+        game_over_ = true;
+
+        return GAME_OVER | COMPLETED;
+    }
+
+    return add_race_garbage<Race>(Race::rows_after_lock(garbage_rows_, locks_to_garbage_));
+}
+
+// Compact hash of the state. Each value is mixed in with the
+// splitmix64 finalizer.
+template <typename Rules>
+uint64_t GameCore<Rules>::state_hash() const
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+
+    auto mix = [&hash](uint64_t value)
+    {
+        hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+        hash ^= hash >> 30;
+        hash *= 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 27;
+        hash *= 0x94D049BB133111EBull;
+        hash ^= hash >> 31;
+    };
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        uint64_t row_value = board_.rows.at(row);
+        mix(row_value);
+
+        for (int col = 0; col < COLUMNS; ++col)
+        {
+            if (board_.is_occupied(col, row))
+            {
+                mix((uint64_t(row) << 16) | (col << 8) | board_.colors.at(row).at(col));
+            }
+        }
+    }
+
+    const Piece* pieces[3] = {&curr_tetro_, &next_tetro_, &hold_tetro_};
+
+    for (const Piece* piece : pieces)
+    {
+        mix((uint64_t(piece->type) << 8) | piece->color);
+    }
+
+    if (piece_active_)
+    {
+        for (const Coord& c : curr_tetro_.squares)
+        {
+            mix((uint64_t(c.x) << 8) | c.y);
+        }
+    }
+
+    mix((uint64_t(piece_active_) << 3) | (game_over_ << 2) |
+        (can_hold_ << 1) | uint64_t(is_hold_empty_));
+    mix((uint64_t(playing_level_) << 32) | uint32_t(playing_speed_));
+    mix((uint64_t(playing_points_) << 32) | uint32_t(total_lines_removed_));
+    mix((uint64_t(tetris_points_) << 32) | uint32_t(num_turn_));
+    mix(random_state_);
+
+    // Normal games keep the hashes they had before the races.
+    if (mode_ != NORMAL)
+    {
+        mix((uint64_t(mode_) << 40) | (uint64_t(completed_) << 32) |
+            (last_hole_ << 24) | (garbage_rows_ << 16) | garbage_to_come_);
+        mix((uint64_t(garbage_random_) << 32) | uint32_t(locks_to_garbage_));
+    }
+
+    // Only randomizers with a bag change it.
+    if (bag_ != 0)
+    {
+        mix(bag_);
+    }
+
+    return hash;
+}
+
+// Write every value which changes the game. The state of the window such
+// as the playing time is saved by the caller.
+template <typename Rules>
+void GameCore<Rules>::save_state(State& state) const
+{
+    StateWriter writer(state.data());
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        writer.put(board_.rows.at(row), 2);
+    }
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        for (int col = 0; col < COLUMNS; ++col)
+        {
+            writer.put(board_.colors.at(row).at(col), 1);
+        }
+    }
+
+    const Piece* pieces[3] = {&curr_tetro_, &next_tetro_, &hold_tetro_};
+
+    for (const Piece* piece : pieces)
+    {
+        writer.put(piece->type, 1);
+        writer.put(piece->color, 1);
+
+        for (const Coord& c : piece->squares)
+        {
+            writer.put(uint8_t(c.x), 1);
+            writer.put(uint8_t(c.y), 1);
+        }
+
+        writer.put(uint8_t(piece->bottom), 1);
+        writer.put(uint8_t(piece->left), 1);
+        writer.put(uint8_t(piece->right), 1);
+        writer.put(uint8_t(piece->up), 1);
+    }
+
+    writer.put((completed_ << 4) | (piece_active_ << 3) | (game_over_ << 2) |
+               (can_hold_ << 1) | is_hold_empty_, 1);
+
+    writer.put(playing_level_, 4);
+    writer.put(playing_points_, 4);
+    writer.put(total_lines_removed_, 4);
+    writer.put(tetris_points_, 4);
+    writer.put(num_turn_, 4);
+    writer.put(last_rows_removed_, 4);
+    writer.put(playing_speed_, 4);
+
+    writer.put(random_state_, 4);
+
+    writer.put(mode_, 1);
+    writer.put(last_hole_, 1);
+    writer.put(garbage_random_, 4);
+    writer.put(garbage_rows_, 4);
+    writer.put(garbage_to_come_, 4);
+    writer.put(locks_to_garbage_, 4);
+
+    writer.put(bag_, 4);
+}
+
+// Read the state to a new game and check every value before it is used.
+template <typename Rules>
+bool GameCore<Rules>::load_state(const State& state)
+{
+    StateReader reader(state.data());
+    GameCore loaded;
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        uint16_t mask = reader.get(2);
+
+        if (mask & ~Board::FULL_ROW)
+        {
+            return false;
+        }
+
+        loaded.board_.rows.at(row) = mask;
+        loaded.board_.hash ^= Zobrist::row(row, mask);
+    }
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        for (int col = 0; col < COLUMNS; ++col)
+        {
+            int color = reader.get(1);
+
+            if (color >= NUM_COLORS)
+            {
+                return false;
+            }
+
+            loaded.board_.colors.at(row).at(col) = color;
+        }
+    }
+
+    Piece* pieces[3] = {&loaded.curr_tetro_, &loaded.next_tetro_, &loaded.hold_tetro_};
+
+    for (Piece* piece : pieces)
+    {
+        piece->type = reader.get(1);
+        piece->color = reader.get(1);
+
+        if (piece->type >= NUMBER_OF_TETROMINOS || piece->color >= NUM_COLORS)
+        {
+            return false;
+        }
+
+        bool unused = true;
+
+        for (Coord& c : piece->squares)
+        {
+            c.x = reader.get_small();
+            c.y = reader.get_small();
+
+            if (c.x < 0 || c.x >= COLUMNS || c.y < 0 || c.y >= ROWS)
+            {
+                return false;
+            }
+
+            unused = unused && c.x == 0 && c.y == 0;
+        }
+
+        // A tetromino which never appeared, such as the empty hold, has
+        // all squares at zero. Any other must be a tetromino, which also
+        // keeps its rows within the masks.
+        if (!unused && !has_shape(*piece))
+        {
+            return false;
+        }
+
+        // The extent is computed from the squares and the masks are not
+        // saved.
+        reader.get(4);
+        piece->update_extent();
+    }
+
+    int flags = reader.get(1);
+    loaded.completed_ = flags & 16;
+    loaded.piece_active_ = flags & 8;
+    loaded.game_over_ = flags & 4;
+    loaded.can_hold_ = flags & 2;
+    loaded.is_hold_empty_ = flags & 1;
+
+    loaded.playing_level_ = int32_t(reader.get(4));
+    loaded.playing_points_ = int32_t(reader.get(4));
+    loaded.total_lines_removed_ = int32_t(reader.get(4));
+    loaded.tetris_points_ = int32_t(reader.get(4));
+    loaded.num_turn_ = int32_t(reader.get(4));
+    loaded.last_rows_removed_ = int32_t(reader.get(4));
+    loaded.playing_speed_ = int32_t(reader.get(4));
+
+    loaded.random_state_ = reader.get(4);
+
+    int mode = reader.get(1);
+    loaded.last_hole_ = reader.get(1);
+    loaded.garbage_random_ = reader.get(4);
+    loaded.garbage_rows_ = int32_t(reader.get(4));
+    loaded.garbage_to_come_ = int32_t(reader.get(4));
+    loaded.locks_to_garbage_ = int32_t(reader.get(4));
+
+    loaded.bag_ = reader.get(4);
+
+    if (loaded.playing_level_ < 0 || loaded.playing_level_ >= NUM_LEVELS ||
+            loaded.random_state_ == 0 || loaded.random_state_ >= 2147483647u ||
+            loaded.garbage_random_ == 0 || loaded.garbage_random_ >= 2147483647u)
+    {
+        return false;
+    }
+
+    // The speed only changes with the level. The points are not checked,
+    // since turning a tetromino many times takes points away, even below
+    // zero or below the threshold of the level reached.
+    if (loaded.playing_speed_ != Rules::Gravity::speed(loaded.playing_level_))
+    {
+        return false;
+    }
+
+    // Each tetris removes at least four lines, and one lock at most as
+    // many rows as a tetromino has.
+    if (loaded.total_lines_removed_ < 0 || loaded.tetris_points_ < 0 ||
+            loaded.tetris_points_ > loaded.total_lines_removed_ / 4 ||
+            loaded.num_turn_ < 0 || loaded.last_rows_removed_ < 0 ||
+            loaded.last_rows_removed_ > NUM_SQUARE)
+    {
+        return false;
+    }
+
+    // The next tetromino is always made, the others when they are used.
+    if (!has_shape(loaded.next_tetro_) ||
+            (loaded.piece_active_ && !has_shape(loaded.curr_tetro_)) ||
+            (!loaded.is_hold_empty_ && !has_shape(loaded.hold_tetro_)))
+    {
+        return false;
+    }
+
+    if (mode >= NUMBER_OF_MODES || loaded.last_hole_ >= COLUMNS ||
+            loaded.garbage_rows_ < 0 || loaded.garbage_rows_ > ROWS ||
+            loaded.garbage_to_come_ < 0 || loaded.locks_to_garbage_ < 0 ||
+            loaded.locks_to_garbage_ > DigRace::INTERVAL ||
+            loaded.bag_ >= (1u << NUMBER_OF_TETROMINOS))
+    {
+        return false;
+    }
+
+    loaded.mode_ = static_cast<Mode>(mode);
+
+    // The moving tetromino may be on the squares of the board, as the held
+    // tetromino appears at the top without a test.
+
+    // Everything is drawn again.
+    loaded.set_all_rows_dirty();
+
+    *this = loaded;
+    return true;
+}
+
+// Zobrist hash of the board with the moving tetromino and the hold.
+template <typename Rules>
+uint64_t GameCore<Rules>::zobrist_hash() const
+{
+    uint64_t hash = board_.hash ^
+            Zobrist::hold(hold_tetro_.type, is_hold_empty_, can_hold_);
+
+    if (piece_active_)
+    {
+        hash ^= piece_hash(curr_tetro_);
+    }
+
+    return hash;
+}
+
+// Keys of the squares are xored so the same squares give the same hash
+// whatever order the squares are in after turns.
+uint64_t GameCoreBase::piece_hash(const Piece& piece)
+{
+    uint64_t hash = Zobrist::piece_type(piece.type);
+
+    for (const Coord& c : piece.squares)
+    {
+        hash ^= Zobrist::piece_cell(c.x, c.y);
+    }
+
+    return hash;
+}
+
+// Rows changed since the last call.
+template <typename Rules>
+uint32_t GameCore<Rules>::take_dirty_rows()
+{
+    uint32_t rows = dirty_rows_;
+    dirty_rows_ = 0;
+
+    return rows;
+}
+
+
+//*****************************************************************************
+// Rules which only depend on the board and the moving tetromino.
+
+// Tetromino of the type with its squares aligned to the center at the
+// top of the playing area.
+Piece GameCoreBase::make_piece(int type, int color)
+{
+    const PieceSet::Shape& shape = PieceSet::tetrominos().shape(type);
+    const PieceSet::Orientation& appear = shape.orientations.at(0);
+
+    Piece piece;
+    piece.type = type;
+    piece.color = color;
+
+    for (int i = 0; i < NUM_SQUARE; ++i)
+    {
+        piece.squares.at(i) = appear.cells.at(i);
+        piece.squares.at(i).x += shape.spawn_x;
+    }
+
+    for (int row = 0; row < appear.height; ++row)
+    {
+        piece.masks.at(row) = appear.masks.at(row) << shape.spawn_x;
+    }
+
+    piece.up = 0;
+    piece.bottom = appear.height - 1;
+    piece.left = shape.spawn_x;
+    piece.right = shape.spawn_x + appear.width - 1;
+
+    return piece;
+}
+
+// Compare the rows of the squares in the box around them with the rows of
+// each orientation of the type.
+bool GameCoreBase::has_shape(const Piece& piece)
+{
+    if (piece.type < 0 || piece.type >= NUMBER_OF_TETROMINOS)
+    {
+        return false;
+    }
+
+    int up = ROWS;
+    int left = COLUMNS;
+
+    for (const Coord& c : piece.squares)
+    {
+        up = std::min(up, c.y);
+        left = std::min(left, c.x);
+    }
+
+    std::array<uint16_t, NUM_SQUARE> masks = {};
+
+    for (const Coord& c : piece.squares)
+    {
+        // Wider or higher than any tetromino.
+        if (c.y - up >= NUM_SQUARE || c.x - left >= NUM_SQUARE)
+        {
+            return false;
+        }
+
+        masks.at(c.y - up) |= 1 << (c.x - left);
+    }
+
+    const PieceSet::Shape& shape = PieceSet::tetrominos().shape(piece.type);
+
+    for (int o = 0; o < shape.num_orientations; ++o)
+    {
+        const PieceSet::Orientation& orientation = shape.orientations.at(o);
+        bool same = true;
+
+        for (int row = 0; row < NUM_SQUARE; ++row)
+        {
+            uint16_t expected = row < orientation.height ? orientation.masks.at(row) : 0;
+            same = same && masks.at(row) == expected;
+        }
+
+        if (same)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Check if possible moving down.
+bool GameCoreBase::can_move_down(const Board& board, const Piece& piece)
+{
+    if (piece.bottom + 1 >= ROWS)
+    {
+        return false;
+    }
+
+    return !overlaps(board, piece, 0, 1);
+}
+
+// Check if possible move to the left.
+bool GameCoreBase::can_move_left(const Board& board, const Piece& piece)
+{
+    // The border is on the left.
+    if (piece.left - 1 < 0)
+    {
+        return false;
+    }
+
+    // There are other tetrominos on the left.
+    return !overlaps(board, piece, -1, 0);
+}
+
+// Check if possible move to the right.
+bool GameCoreBase::can_move_right(const Board& board, const Piece& piece)
+{
+    // The border is on the right.
+    if (piece.right + 1 >= COLUMNS)
+    {
+        return false;
+    }
+
+    // There are other tetrominos on the right.
+    return !overlaps(board, piece, 1, 0);
+}
+
+// Move tetromino without checking the board.
+void GameCoreBase::move_piece(Piece& piece, int delta_x, int delta_y)
+{
+    for (Coord& c : piece.squares)
+    {
+        c.x += delta_x;
+        c.y += delta_y;
+    }
+
+    for (int row = 0; row < piece.height(); ++row)
+    {
+        piece.masks[row] = shift_mask(piece.masks[row], delta_x);
+    }
+
+    piece.left += delta_x;
+    piece.right += delta_x;
+    piece.bottom += delta_y;
+    piece.up += delta_y;
+}
+
+// Move tetromino down six square if possible.
+// if not then move as low as possible.
+void GameCoreBase::move_soft_fall(const Board& board, Piece& piece)
+{
+    // Move lowst as possible.
+    if (piece.bottom + MOVE_SOFT >= ROWS)
+    {
+        move_hard_fall(board, piece);
+        return;
+    }
+
+    for (int j = 1; j <= MOVE_SOFT; ++j)
+    {
+        if (overlaps(board, piece, 0, j))
+        {
+            // Move to lowest possible.
+            move_hard_fall(board, piece);
+            return;
+        }
+    }
+
+    move_piece(piece, 0, MOVE_SOFT);
+}
+
+// Move down as lowest as possible
+void GameCoreBase::move_hard_fall(const Board& board, Piece& piece)
+{
+    int deltaY = 0;
+
+    // Find distance to move down.
+    while (piece.bottom + deltaY + 1 < ROWS && !overlaps(board, piece, 0, deltaY + 1))
+    {
+        deltaY += 1;
+    }
+
+    move_piece(piece, 0, deltaY);
+}
+
+// True if a square of the tetromino is on an occupied cell.
+bool GameCoreBase::is_blocked(const Board& board, const Piece& piece)
+{
+    return overlaps(board, piece, 0, 0);
+}
+
+
+//*****************************************************************************
+// The engines of every set of rules.
+
+template class GameCore<ClassicRules>;
+template class GameCore<ModernRules>;
+template class GameCore<NoHoldRules>;
@@ -0,0 +1,294 @@
+#ifndef GAMEENGINE_HH
+#define GAMEENGINE_HH
+
+#include "board.hh"
+#include "gamerules.hh"
+#include "pieceset.hh"
+#include <array>
+#include <cstdint>
+
+// Rules of the game without any drawing, so the same game can be played by
+// the window, replayed by the tools or simulated by the bots.
+
+// Everything which is the same with all sets of rules: the inputs, the
+// results, the tetrominos, the saved state and the moves which only depend
+// on the board.
+class GameCoreBase
+{
+public:
+    // Constants for different tetrominos and the number of them
+    enum Tetromino_kind {HORIZONTAL,
+                         LEFT_CORNER,
+                         RIGHT_CORNER,
+                         SQUARE,
+                         STEP_UP_RIGHT,
+                         PYRAMID,
+                         STEP_UP_LEFT,
+                         NUMBER_OF_TETROMINOS};
+
+    // Everything which can change the game. The letters are the keys used
+    // for the same action and are used when a game is recorded.
+    enum Input {SPAWN,
+                LEFT,
+                RIGHT,
+                ROTATE,
+                REFLECT,
+                SOFT_FALL,
+                HARD_FALL,
+                HOLD,
+                GRAVITY,
+                NUMBER_OF_INPUTS};
+
+    // What happened after an input. Combined as bits.
+    enum Result {NOTHING = 0,
+                 MOVED = 1,
+                 LOCKED = 2,
+                 SPAWNED = 4,
+                 HELD = 8,
+                 LEVEL_UP = 16,
+                 MAX_LEVEL = 32,
+                 GAME_OVER = 64,
+                 COMPLETED = 128};
+
+    // Kinds of games. In the races the board has garbage rows with one
+    // empty cell each and the game is completed when all are removed. Each
+    // mode has its race in gamerules.hh.
+    enum Mode {NORMAL,
+               DIG_RACE,
+               CHEESE_RACE,
+               NUMBER_OF_MODES};
+
+    static constexpr int ROWS = Board::ROWS;
+    static constexpr int COLUMNS = Board::COLUMNS;
+    static constexpr int NUM_SQUARE = Piece::NUM_SQUARE;
+
+    // Number of levels and the colors in each level. A palette index is
+    // level * NUM_COLOR_IN_LEVEL + color in level.
+    static constexpr int NUM_LEVELS = 8;
+    static constexpr int NUM_COLOR_IN_LEVEL = 5;
+
+    // Garbage rows have their own color after the colors of the levels.
+    static constexpr int GARBAGE_COLOR = NUM_LEVELS * NUM_COLOR_IN_LEVEL;
+    static constexpr int NUM_COLORS = GARBAGE_COLOR + 1;
+
+    // Move down six square if possible in soft fall movement.
+    static constexpr int MOVE_SOFT = 6;
+
+    // Size of the state saved by save_state: the rows and the colors of the
+    // board, the three tetrominos, the flags, the counters and the state of
+    // the random numbers, the mode with its garbage counters and the bag of
+    // the randomizer.
+    static constexpr int PIECE_STATE_SIZE = 2 + 2 * NUM_SQUARE + 4;
+    static constexpr int STATE_SIZE = ROWS * 2 + ROWS * COLUMNS +
+            3 * PIECE_STATE_SIZE + 1 + 7 * 4 + 4 + 2 + 4 * 4 + 4;
+
+    using State = std::array<uint8_t, STATE_SIZE>;
+
+    // Key letter of each input used in recorded games.
+    static constexpr std::array<char, NUMBER_OF_INPUTS> INPUT_LETTERS =
+    {'T', 'A', 'D', 'W', 'R', 'S', 'C', 'F', 'G'};
+
+    // Input of a key letter. Returns false for unknown letters.
+    static bool input_from_letter(char letter, Input& input);
+
+    //*************************************************************************
+    // Rules which only depend on the board and the moving tetromino.
+    // Also used by the bots for searching moves.
+
+    // Tetromino in its appear position at the top of the playing area.
+    static Piece make_piece(int type, int color);
+
+    // True if the squares are an orientation of the tetromino of the type,
+    // anywhere in the playing area.
+    static bool has_shape(const Piece& piece);
+
+    static bool can_move_down(const Board& board, const Piece& piece);
+    static bool can_move_left(const Board& board, const Piece& piece);
+    static bool can_move_right(const Board& board, const Piece& piece);
+    static void move_piece(Piece& piece, int delta_x, int delta_y);
+    static void move_soft_fall(const Board& board, Piece& piece);
+    static void move_hard_fall(const Board& board, Piece& piece);
+
+    // True if a square of the tetromino is on an occupied cell.
+    static bool is_blocked(const Board& board, const Piece& piece);
+
+    // Zobrist keys of the squares and the type of a tetromino.
+    static uint64_t piece_hash(const Piece& piece);
+};
+
+// The game with a set of rules from gamerules.hh. The rules are types, so
+// each set is compiled to its own engine.
+template <typename Rules>
+class GameCore : public GameCoreBase
+{
+public:
+    GameCore() = default;
+
+    // Start a new game. The same seed always gives the same tetrominos,
+    // also in the races.
+    void reset(uint32_t seed, Mode mode = NORMAL);
+
+    // Apply one input and return the Result bits.
+    int apply(Input input);
+
+    // Raise the board by the rows with an empty cell in the column. The
+    // moving tetromino goes up if the rows come under it. Returns GAME_OVER
+    // if squares are pushed out of the top, NOTHING for a column outside
+    // the board, otherwise MOVED.
+    int add_garbage(int num_rows, int hole_column);
+
+    //*************************************************************************
+    // Turns of the rotation system of the rules.
+
+    static bool rotate_counterclockwise(const Board& board, Piece& piece)
+    {
+        return Rules::Rotation::rotate_counterclockwise(board, piece);
+    }
+
+    static bool reflect_vertical_axis(const Board& board, Piece& piece)
+    {
+        return Rules::Rotation::reflect_vertical_axis(board, piece);
+    }
+
+    // Points for a locked tetromino.
+    static int calculate_point(int num_row_remove, int num_turn, int level = 0)
+    {
+        return Rules::Scoring::points(num_row_remove, num_turn, level);
+    }
+
+    //*************************************************************************
+    // State of the game.
+
+    const Board& board() const { return board_; }
+    const Piece& current() const { return curr_tetro_; }
+    const Piece& next() const { return next_tetro_; }
+    const Piece& hold() const { return hold_tetro_; }
+
+    bool is_piece_active() const { return piece_active_; }
+    bool is_over() const { return game_over_; }
+    bool can_hold() const { return can_hold_; }
+    bool is_hold_empty() const { return is_hold_empty_; }
+
+    // True if the race ended by removing all garbage rows.
+    bool is_completed() const { return completed_; }
+
+    int level() const { return playing_level_; }
+    int points() const { return playing_points_; }
+    int lines_removed() const { return total_lines_removed_; }
+    int tetris_points() const { return tetris_points_; }
+    int num_turn() const { return num_turn_; }
+    int speed() const { return playing_speed_; }
+    Mode mode() const { return mode_; }
+
+    // Garbage rows on the board and still to come in a race.
+    int garbage_left() const { return garbage_rows_ + garbage_to_come_; }
+
+    // Rows of lines removed by the last lock.
+    int last_rows_removed() const { return last_rows_removed_; }
+
+    // Rows of the board changed since the last call, one bit for each row.
+    uint32_t take_dirty_rows();
+
+    // Mark all rows changed so the whole board is drawn again.
+    void set_all_rows_dirty() { dirty_rows_ = (1u << ROWS) - 1; }
+
+    // Compact hash of the whole state of the game.
+    uint64_t state_hash() const;
+
+    // Write the whole state of the game in a fixed size byte array.
+    void save_state(State& state) const;
+
+    // Continue from a saved state. Returns false and does not change the
+    // game if the state could not come from a game: squares which are not
+    // a tetromino, a speed which is not the speed of the level or
+    // counters out of their range.
+    bool load_state(const State& state);
+
+    // Zobrist hash of the position for the search of the bots: the board,
+    // the moving tetromino and the hold. Scores and colors are not included.
+    uint64_t zobrist_hash() const;
+
+private:
+    // Functions related to status of the game.
+    bool continue_game();
+    void make_new_tetromino();
+    void make_appear_over();
+    int update_game();
+    void update_grid();
+    int remove_full_row();
+    void move_grid_down(int num_row_remove, int lowest_row_remove);
+    int update_player_score(int num_row_remove);
+    bool update_level();
+    int exchange_tetromino();
+    void prepare_next_tetromino();
+
+    // Functions related to the races. Race is the race of the mode.
+    int raise_board(const uint16_t* masks, int num_rows);
+
+    template <typename Race>
+    void start_race();
+
+    template <typename Race>
+    int add_race_garbage(int num_rows);
+
+    template <typename Race>
+    int update_race();
+
+    Board board_;
+
+    // Tetromino moved by the player, the next one and the hold one.
+    Piece curr_tetro_;
+    Piece next_tetro_;
+    Piece hold_tetro_;
+
+    // Random numbers which are the same on every platform: the minimal
+    // standard linear congruential generator.
+    uint32_t random_state_ = 1;
+
+    // Types left in the bag of the randomizer, if it uses one.
+    uint32_t bag_ = 0;
+
+    // Garbage has its own random numbers so a race has the same tetrominos
+    // as a normal game with the seed.
+    uint32_t garbage_random_ = 1;
+
+    bool piece_active_ = false;
+    bool game_over_ = false;
+    bool can_hold_ = true;
+    bool is_hold_empty_ = true;
+    bool completed_ = false;
+
+    Mode mode_ = NORMAL;
+
+    // Garbage rows are always the lowest rows of the board, since rows
+    // above them are only removed or moved down.
+    int garbage_rows_ = 0;
+    int garbage_to_come_ = 0;
+    int locks_to_garbage_ = 0;
+
+    // Column of the empty cell in the last garbage row.
+    int last_hole_ = 0;
+
+    // Calculate and store points.
+    int playing_level_ = 0;
+    int playing_points_ = 0;
+    int total_lines_removed_ = 0;
+    int tetris_points_ = 0;
+    int num_turn_ = 0;
+    int last_rows_removed_ = 0;
+
+    // Change by each level.
+    int playing_speed_ = Rules::Gravity::speed(0);
+
+    uint32_t dirty_rows_ = 0;
+};
+
+// The engines are compiled in gameengine.cpp.
+extern template class GameCore<ClassicRules>;
+extern template class GameCore<ModernRules>;
+extern template class GameCore<NoHoldRules>;
+
+// The game of the window, the replays and the bots.
+using GameEngine = GameCore<ClassicRules>;
+
+#endif // GAMEENGINE_HH
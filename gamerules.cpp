@@ -0,0 +1,144 @@
+#include "gamerules.hh"
+#include <cmath>
+#include <utility>
+
+namespace
+{
+
+using Squares = std::array<Coord, Piece::NUM_SQUARE>;
+
+// Check if the squares are in the playing area on empty cells.
+bool fits(const Board& board, const Squares& squares)
+{
+    for (const Coord& c : squares)
+    {
+        if (c.x < 0 || c.x >= Board::COLUMNS || c.y < 0 || c.y >= Board::ROWS)
+        {
+            return false;
+        }
+
+        if (board.is_occupied(c.x, c.y))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Squares turned 90 degree counter-clockwise around the center of the
+// squares.
+Squares rotated(const Piece& piece)
+{
+    Squares rotation_result;
+    std::array<std::pair<double, double>, Piece::NUM_SQUARE> coord_convert;
+    std::pair<double, double> rotation_center = std::make_pair(0, 0);
+
+    // Convert coordinates to real number.
+    for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+    {
+        Coord c(piece.squares.at(i));
+
+        coord_convert.at(i) = std::make_pair(c.x + 0.5, c.y + 0.5);
+
+        rotation_center.first += coord_convert.at(i).first;
+        rotation_center.second += coord_convert.at(i).second;
+    }
+
+    rotation_center.first /= Piece::NUM_SQUARE;
+    rotation_center.second /= Piece::NUM_SQUARE;
+
+    // Rotation and convert coordinate back to integer.
+    for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+    {
+        Coord c;
+        c.x = ceil(rotation_center.first +
+            (coord_convert.at(i).second - rotation_center.second)) - 1;
+
+        c.y = ceil(rotation_center.second -
+            (coord_convert.at(i).first - rotation_center.first)) - 1;
+
+        rotation_result.at(i) = c;
+    }
+
+    return rotation_result;
+}
+
+// Squares reflected in the vertical axis through the center of the
+// tetromino.
+Squares reflected(const Piece& piece)
+{
+    Squares reflection_result;
+    double rotation_center = (double(piece.right + piece.left) / 2) + 0.5;
+
+    for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+    {
+        Coord c;
+        c.x = 2 * rotation_center - (piece.squares.at(i).x + 0.5);
+        c.y = piece.squares.at(i).y;
+
+        reflection_result.at(i) = c;
+    }
+
+    return reflection_result;
+}
+
+// Move the tetromino to the squares shifted by the first kick where they fit.
+template <std::size_t N>
+bool place_with_kicks(const Board& board, Piece& piece, const Squares& squares,
+                      const std::array<Coord, N>& kicks)
+{
+    for (const Coord& kick : kicks)
+    {
+        Squares shifted = squares;
+
+        for (Coord& c : shifted)
+        {
+            c.x += kick.x;
+            c.y += kick.y;
+        }
+
+        if (fits(board, shifted))
+        {
+            piece.squares = shifted;
+            piece.update_extent();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
+
+//*****************************************************************************
+// Classic rotation.
+
+// Rotate 90 degree counter-clockwise around the center of the squares
+// if the result fits.
+bool ClassicRotation::rotate_counterclockwise(const Board& board, Piece& piece)
+{
+    return place_with_kicks(board, piece, rotated(piece), KICKS);
+}
+
+// Reflect in the vertical axis through the center of the tetromino
+// if the result fits.
+bool ClassicRotation::reflect_vertical_axis(const Board& board, Piece& piece)
+{
+    return place_with_kicks(board, piece, reflected(piece), KICKS);
+}
+
+
+//*****************************************************************************
+// Rotation with kicks.
+
+bool KickRotation::rotate_counterclockwise(const Board& board, Piece& piece)
+{
+    return place_with_kicks(board, piece, rotated(piece), KICKS);
+}
+
+bool KickRotation::reflect_vertical_axis(const Board& board, Piece& piece)
+{
+    return place_with_kicks(board, piece, reflected(piece), KICKS);
+}
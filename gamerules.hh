@@ -0,0 +1,374 @@
+#ifndef GAMERULES_HH
+#define GAMERULES_HH
+
+#include "board.hh"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// Rules which differ between kinds of games. GameCore takes a set of them as
+// a template parameter, so each kind of game is compiled to its own engine
+// and the rules are called directly without virtual functions or flags.
+//
+// A set of rules has the types:
+//   Scoring     points of a locked tetromino
+//   Gravity     points needed for each level and the falling speed
+//   Randomizer  order of the tetrominos
+//   Rotation    turning and reflecting the moving tetromino
+//   Hold        if and how often the tetromino can be held
+//
+// Every set is compiled in gameengine.cpp.
+//
+// The races are chosen with the mode of each game instead, but they are
+// types in the same way and the engine compiles each race for every set.
+
+// Minimal standard generator, x = x * 16807 mod (2^31 - 1). Gives the same
+// numbers on every platform.
+inline uint32_t minstd_next(uint32_t& state)
+{
+    state = (uint64_t(state) * 16807u) % 2147483647u;
+    return state;
+}
+
+
+//*****************************************************************************
+// Scoring.
+
+// Points of the original game. Turning more than three times costs points
+// and four rows at once give double points.
+struct ClassicScoring
+{
+    static int points(int num_row_remove, int num_turn, int level)
+    {
+        (void)level;
+
+        // For each tetromino drop player get 100 points.
+        // The point will not be negative.
+        int point = 100;
+
+        // The player should turn as less as possible.
+        // For each turn excepts the first three turn the
+        // points is minus to 5 points.
+        if (num_turn > 3)
+        {
+            if (point - (num_turn - 3) * 5 <= 0)
+            {
+                point = 0;
+            }
+            else
+            {
+                point -= 5 * num_turn;
+            }
+        }
+
+        // Point earn from make a complete rows.
+        if (num_row_remove < 4)
+        {
+            point += num_row_remove * 1000;
+        }
+        else
+        {
+            // More point from remove large number of
+            // rows.
+            point += num_row_remove * 2000;
+        }
+
+        return point;
+    }
+};
+
+// Points for removed rows multiplied by the level, as in most modern games.
+struct GuidelineScoring
+{
+    static int points(int num_row_remove, int num_turn, int level)
+    {
+        (void)num_turn;
+
+        static constexpr std::array<int, 5> ROW_POINTS = {0, 100, 300, 500, 800};
+
+        return ROW_POINTS.at(std::min(num_row_remove, 4)) * (level + 1);
+    }
+};
+
+
+//*****************************************************************************
+// Gravity. The speed is the time in milliseconds the tetromino takes to fall
+// one row.
+
+struct ClassicGravity
+{
+    // The score player need to upgrade to the next level.
+    static constexpr std::array<int, 8> LEVEL_THRESHOLD =
+    {5000, 50000, 100000, 150000, 200000, 300000, 400000, 500000};
+
+    static int threshold(int level)
+    {
+        return LEVEL_THRESHOLD.at(level);
+    }
+
+    // The droping speed of tetromino is 650 in the first level and 70
+    // faster in each level.
+    static int speed(int level)
+    {
+        return 650 - 70 * level;
+    }
+};
+
+// Speeds of the guideline curve (0.8 - 0.007 * level) ^ level seconds, for
+// points given by GuidelineScoring.
+struct GuidelineGravity
+{
+    static constexpr std::array<int, 8> SPEEDS =
+    {1000, 793, 618, 473, 355, 262, 190, 135};
+
+    static int threshold(int level)
+    {
+        return 3000 * (level + 1) * (level + 2) / 2;
+    }
+
+    static int speed(int level)
+    {
+        return SPEEDS.at(level);
+    }
+};
+
+
+//*****************************************************************************
+// Randomizers. Each gives the type of the next tetromino and its color in the
+// level from the random state and the bag, which is the mask of the types
+// left in the current bag for the randomizers which use one.
+
+// Every tetromino is as likely every time.
+struct ClassicRandomizer
+{
+    static void next(uint32_t& random_state, uint32_t& bag, int& type, int& color)
+    {
+        (void)bag;
+
+        type = minstd_next(random_state) % 7;
+        color = (minstd_next(random_state) % 7) % 5;
+    }
+};
+
+// All seven tetrominos come once in random order before any comes again.
+struct BagRandomizer
+{
+    static constexpr uint32_t FULL_BAG = (1 << 7) - 1;
+
+    static void next(uint32_t& random_state, uint32_t& bag, int& type, int& color)
+    {
+        if (bag == 0)
+        {
+            bag = FULL_BAG;
+        }
+
+        int count = 0;
+
+        for (uint32_t left = bag; left != 0; left &= left - 1)
+        {
+            count += 1;
+        }
+
+        // Take the chosen type out of the bag.
+        int index = minstd_next(random_state) % count;
+
+        for (type = 0; ; ++type)
+        {
+            if (((bag >> type) & 1) && index-- == 0)
+            {
+                break;
+            }
+        }
+
+        bag &= ~(1u << type);
+        color = (minstd_next(random_state) % 7) % 5;
+    }
+};
+
+
+//*****************************************************************************
+// Rotation systems. Both functions return false and do not change the
+// tetromino if the result does not fit. KICKS are the shifts of the result
+// tried in order, so the move generator can turn many positions at once.
+
+// Turn around the center of the squares and reflect in the vertical axis
+// through the center, only where the result fits.
+struct ClassicRotation
+{
+    static constexpr std::array<Coord, 1> KICKS = {Coord(0, 0)};
+
+    static bool rotate_counterclockwise(const Board& board, Piece& piece);
+    static bool reflect_vertical_axis(const Board& board, Piece& piece);
+};
+
+// As ClassicRotation, but a result which does not fit is also tried one
+// column to the left and right and one row up, so the tetromino can turn
+// next to the walls and the stack.
+struct KickRotation
+{
+    static constexpr std::array<Coord, 4> KICKS =
+    {Coord(0, 0), Coord(-1, 0), Coord(1, 0), Coord(0, -1)};
+
+    static bool rotate_counterclockwise(const Board& board, Piece& piece);
+    static bool reflect_vertical_axis(const Board& board, Piece& piece);
+};
+
+
+//*****************************************************************************
+// Hold rules.
+
+// The moving tetromino can be held once for each tetromino.
+struct ClassicHold
+{
+    static constexpr bool ENABLED = true;
+};
+
+struct NoHold
+{
+    static constexpr bool ENABLED = false;
+};
+
+
+//*****************************************************************************
+// Races. START_ROWS garbage rows are on the board at the start and LINES
+// come in all. rows_after_lock gives the garbage rows which come up after a
+// lock, and moves_hole if the empty cell of the next row goes to another
+// column.
+
+// The normal game without garbage.
+struct NoRace
+{
+    static constexpr bool ENABLED = false;
+    static constexpr int START_ROWS = 0;
+    static constexpr int LINES = 0;
+
+    static int rows_after_lock(int garbage_rows, int& locks_to_garbage)
+    {
+        (void)garbage_rows;
+        (void)locks_to_garbage;
+
+        return 0;
+    }
+
+    static bool moves_hole(uint32_t random)
+    {
+        (void)random;
+
+        return false;
+    }
+};
+
+// One more garbage row comes up after every INTERVAL locks, and the empty
+// cell stays in the same column most of the time.
+struct DigRace
+{
+    static constexpr bool ENABLED = true;
+    static constexpr int START_ROWS = 4;
+    static constexpr int LINES = 40;
+    static constexpr int INTERVAL = 5;
+
+    static int rows_after_lock(int garbage_rows, int& locks_to_garbage)
+    {
+        (void)garbage_rows;
+
+        locks_to_garbage -= 1;
+
+        if (locks_to_garbage > 0)
+        {
+            return 0;
+        }
+
+        locks_to_garbage = INTERVAL;
+
+        return 1;
+    }
+
+    static bool moves_hole(uint32_t random)
+    {
+        return random % 10 < 3;
+    }
+};
+
+// The board is filled again to START_ROWS garbage rows after a lock until
+// all have come, and every row has the empty cell in a new column.
+struct CheeseRace
+{
+    static constexpr bool ENABLED = true;
+    static constexpr int START_ROWS = 10;
+    static constexpr int LINES = 18;
+
+    static int rows_after_lock(int garbage_rows, int& locks_to_garbage)
+    {
+        (void)locks_to_garbage;
+
+        return START_ROWS - garbage_rows;
+    }
+
+    static bool moves_hole(uint32_t random)
+    {
+        (void)random;
+
+        return true;
+    }
+};
+
+
+//*****************************************************************************
+// Sets of rules.
+
+// Rules of the original game. Used by GameEngine, the replays and the bots.
+struct ClassicRules
+{
+    using Scoring = ClassicScoring;
+    using Gravity = ClassicGravity;
+    using Randomizer = ClassicRandomizer;
+    using Rotation = ClassicRotation;
+    using Hold = ClassicHold;
+};
+
+// Rules close to the modern games.
+struct ModernRules
+{
+    using Scoring = GuidelineScoring;
+    using Gravity = GuidelineGravity;
+    using Randomizer = BagRandomizer;
+    using Rotation = KickRotation;
+    using Hold = ClassicHold;
+};
+
+// The original game without hold, for comparing how much hold helps.
+struct NoHoldRules
+{
+    using Scoring = ClassicScoring;
+    using Gravity = ClassicGravity;
+    using Randomizer = ClassicRandomizer;
+    using Rotation = ClassicRotation;
+    using Hold = NoHold;
+};
+
+// The sets by name, for the tools which play with any of them.
+enum RulesName {CLASSIC_RULES,
+                MODERN_RULES,
+                NO_HOLD_RULES,
+                NUMBER_OF_RULES};
+
+constexpr std::array<const char*, NUMBER_OF_RULES> RULES_NAMES =
+{"classic", "modern", "nohold"};
+
+// Set of the name. Returns false for unknown names.
+inline bool rules_from_name(const char* name, RulesName& rules)
+{
+    for (int r = 0; r < NUMBER_OF_RULES; ++r)
+    {
+        if (strcmp(name, RULES_NAMES.at(r)) == 0)
+        {
+            rules = static_cast<RulesName>(r);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif // GAMERULES_HH
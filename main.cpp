@@ -1,11 +1,131 @@
 #include "mainwindow.hh"
+#include "tracer.hh"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // Command line options.
+    QCommandLineParser parser;
+    parser.addHelpOption();
+
+    QCommandLineOption trace_option("trace",
+            "Record a Chrome trace of the game slots to <file>.", "file");
+    parser.addOption(trace_option);
+
+    QCommandLineOption spectate_option("spectate",
+            "Publish the game to spectator viewers at <name>.", "name");
+    parser.addOption(spectate_option);
+
+    QCommandLineOption versus_host_option("versus-host",
+            "Host a versus game named <name> for another game to join.", "name");
+    parser.addOption(versus_host_option);
+
+    QCommandLineOption versus_join_option("versus-join",
+            "Join the versus game named <name>.", "name");
+    parser.addOption(versus_join_option);
+
+    QCommandLineOption versus_bot_option("versus-bot",
+            "Play against a bot with the same tetrominos.");
+    parser.addOption(versus_bot_option);
+
+    QCommandLineOption bot_program_option("bot-program",
+            "Play against the bot <program>, which gets the game on its input "
+            "and writes its moves.", "program");
+    parser.addOption(bot_program_option);
+
+    QCommandLineOption bot_plugin_option("bot-plugin",
+            "Play against the bot in the shared library <file>.", "file");
+    parser.addOption(bot_plugin_option);
+
+    QCommandLineOption bot_weights_option("bot-weights",
+            "Read the weights of the bot from <file>, as written by the tuner.", "file");
+    parser.addOption(bot_weights_option);
+
+    QCommandLineOption dig_race_option("dig-race",
+            "Race to remove garbage rows which keep coming up.");
+    parser.addOption(dig_race_option);
+
+    QCommandLineOption cheese_race_option("cheese-race",
+            "Race to remove garbage rows with empty cells in every column.");
+    parser.addOption(cheese_race_option);
+
+    QCommandLineOption replay_option("replay",
+            "Watch the replay <file>, a .replay or .rpa file.", "file");
+    parser.addOption(replay_option);
+
+    parser.process(a);
+
+    if (parser.isSet(trace_option))
+    {
+        Tracer::instance().start(parser.value(trace_option).toStdString());
+        Tracer::instance().set_thread_name("GUI");
+    }
+
     MainWindow w;
     w.show();
 
-    return a.exec();
+    if (parser.isSet(dig_race_option))
+    {
+        w.set_game_mode(GameEngine::DIG_RACE);
+    }
+    else if (parser.isSet(cheese_race_option))
+    {
+        w.set_game_mode(GameEngine::CHEESE_RACE);
+    }
+
+    if (parser.isSet(spectate_option))
+    {
+        w.start_spectator_server(parser.value(spectate_option));
+    }
+
+    if (parser.isSet(replay_option))
+    {
+        w.open_replay(parser.value(replay_option));
+    }
+    else if (parser.isSet(versus_host_option))
+    {
+        w.start_versus(true, parser.value(versus_host_option));
+    }
+    else if (parser.isSet(versus_join_option))
+    {
+        w.start_versus(false, parser.value(versus_join_option));
+    }
+    else if (parser.isSet(bot_plugin_option))
+    {
+        w.enable_bot_plugin(parser.value(bot_plugin_option));
+    }
+    else if (parser.isSet(bot_program_option))
+    {
+        w.enable_external_bot(parser.value(bot_program_option));
+    }
+    else if (parser.isSet(versus_bot_option))
+    {
+        if (parser.isSet(bot_weights_option))
+        {
+            BotWeights weights;
+            QString file_name = parser.value(bot_weights_option);
+
+            // The bot plays with the default weights if the file is bad.
+            if (weights.read(file_name.toStdString()))
+            {
+                w.set_bot_weights(weights);
+            }
+            else
+            {
+                qWarning() << "Can not read bot weights from" << file_name;
+            }
+        }
+
+        w.enable_bot();
+    }
+
+    int result = a.exec();
+
+    Tracer::instance().stop();
+
+    return result;
 }
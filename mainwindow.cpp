@@ -1,7 +1,15 @@
 #include "mainwindow.hh"
 #include "ui_mainwindow.h"
+#include "tracer.hh"
+#include "perfcounters.hh"
+#include "snapshot.hh"
 #include <QDebug>
 #include <QKeyEvent>
+#include <QDir>
+#include <QDateTime>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <utility>
 
@@ -41,17 +49,33 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->close_game_push_button, &QPushButton::clicked,
             this, &MainWindow::quit_game);
 
+    // Connection for refreshing the performance HUD.
+    connect(&hud_timer_, &QTimer::timeout,
+            this, &MainWindow::update_hud);
+
+    // Connection for the ticks of versus mode.
+    versus_timer_.setTimerType(Qt::PreciseTimer);
+    connect(&versus_timer_, &QTimer::timeout,
+            this, &MainWindow::versus_tick);
+
+    // Connection for the inputs of the bot.
+    connect(&bot_timer_, &QTimer::timeout,
+            this, &MainWindow::bot_tick);
+
+    // Connection for the refreshes of the replay viewer.
+    viewer_timer_.setTimerType(Qt::PreciseTimer);
+    connect(&viewer_timer_, &QTimer::timeout,
+            this, &MainWindow::viewer_tick);
+
 
     //*************************************************************************
     // Setting random engine ready for the first real call.
 
     int seed = time(0); // You can change seed value for testing purposes
     randomEng.seed(seed);
-    distr = std::uniform_int_distribution<int>(0, NUMBER_OF_TETROMINOS - 1);
-    distr(randomEng);
+    randomEng();
     // Wiping out the first random number (which is almost always 0)
-    // After the above settings, you can use randomEng to draw the next falling
-    // tetromino by calling: distr(randomEng) in a suitable method.
+    // After the above settings, randomEng gives the seed of each game.
 
 
     //*************************************************************************
@@ -60,11 +84,17 @@ MainWindow::MainWindow(QWidget *parent) :
     // Setting for displaying on window.
     initialize_window();
 
+    // Time the repaint of the playing area.
+    ui->graphicsView->viewport()->installEventFilter(this);
+
     // Read score board information stored.
     get_high_scores();
 
     // Start the game.
     initialize_game();
+
+    // Continue the game left when the program was closed.
+    restore_snapshot();
 }
 
 MainWindow::~MainWindow()
@@ -75,12 +105,14 @@ MainWindow::~MainWindow()
 //*****************************************************************************
 // Function related to setup the game.
 
-// Clear all the scene.
+// Clear all the scene. The squares stay in the scenes hidden for
+// the next game.
 void MainWindow::clear_scene()
 {
-    scene_->clear();
-    next_scene_->clear();
-    hold_scene_->clear();
+    PerfCounters::add(PerfCounters::SQUARES_HIDDEN, block_arena_.num_in_use());
+    block_arena_.reset();
+    next_arena_.reset();
+    hold_arena_.reset();
 }
 
 // Set up window for program
@@ -136,6 +168,22 @@ void MainWindow::initialize_window()
                               BORDER_DOWN_HOLD_VIEW - 1);
 
 
+    //*************************************************************************
+    // Create all squares used in the game once. Every cell in the grid,
+    // the moving tetromino and its hint can have a square at the same time.
+
+    block_arena_.initialize(scene_, ROWS * COLUMNS + 2 * NUM_SQUARE,
+                            SQUARE_SIDE, BLACK_PEN);
+    next_arena_.initialize(next_scene_, NUM_SQUARE, SQUARE_SIDE / 1.2, BLACK_PEN);
+    hold_arena_.initialize(hold_scene_, NUM_SQUARE, SQUARE_SIDE / 2, BLACK_PEN);
+
+    for (int index = 0; index < GameEngine::NUM_COLORS; ++index)
+    {
+        palette_brushes_.at(index) = QBrush(QColor(Palette::color(index)));
+    }
+    hint_brush_ = QBrush(QColor(128, 128, 128, 96));
+
+
     //*************************************************************************
     // Setup position for display lines removed.
 
@@ -288,6 +336,20 @@ void MainWindow::initialize_window()
     ui->number_sec_lcd->setStyleSheet("background-color:blue;");
     ui->number_min_lcd->setStyleSheet("background-color:blue;");
     ui->number_hou_lcd->setStyleSheet("background-color:blue;");
+
+
+    // ************************************************************************
+    // Set up the performance HUD over the playing area. Hidden by default.
+
+    hud_label_ = new QLabel(ui->centralWidget);
+    hud_label_->setStyleSheet("QLabel { background-color : rgba(0, 0, 0, 160); "
+                              "color : lime; font : 8pt monospace; }");
+    hud_label_->setGeometry(LEFT_MARGIN_PLAYING_VIEW + 2,
+                            TOP_MARGIN_PLAYING_VIEW + 2,
+                            BORDER_RIGHT_PLAYING_VIEW - 2, 180);
+    hud_label_->setAlignment(Qt::AlignLeft | Qt::AlignTop);
+    hud_label_->setAttribute(Qt::WA_TransparentForMouseEvents);
+    hud_label_->hide();
 }
 
 // Setup value for start the game.
@@ -295,22 +357,40 @@ void MainWindow::initialize_game()
 {
     clear_scene();
 
-    // Initialize tetromino.
-    curr_tetro_ = Tetromino();
+    // Initialize tetromino and grid.
+    curr_blocks_.fill(NULL);
+    hint_blocks_.fill(NULL);
 
-    left_ = 0;
-    right_ = 0;
-    up_ = 0;
-    bottom_ = 0;
+    for (std::array<QGraphicsRectItem*, COLUMNS>& row : grid_)
+    {
+        row.fill(NULL);
+    }
+
+    // The game of the opponent is shown only in versus mode.
+    if (opponent_view_ != NULL)
+    {
+        opponent_view_->hide();
+    }
+
+    bot_timer_.stop();
+    bot_game_ = false;
+
+    // Every game has its own seed so it can be replayed.
+    uint32_t seed = randomEng();
+
+    engine_.reset(seed, game_mode_);
+    replay_.start(seed, game_mode_);
+    replay_complete_ = true;
+    practice_ = false;
+    finesse_.reset();
 
-    // Initailize next tetromino.
-    next_tetro_  = Tetromino();
+    // Races start with garbage rows.
+    draw_grid();
 
-    // Initailize hold tetromino.
-    hold_tetro_ = Tetromino();
+    rewind_.clear();
+    store_rewind_point();
 
-    // Initialize grid.
-    grid_ = std::vector<std::vector<Square>>(ROWS, std::vector<Square>(COLUMNS, Square()));
+    publish_game();
 
     // Time related information in the game.
     minute_ = 0;
@@ -321,16 +401,10 @@ void MainWindow::initialize_game()
     ui->number_min_lcd->display(0);
     ui->number_sec_lcd->display(0);
 
-    // Player related information in the game.
-    playing_level_ = 0;
-    total_lines_removed_ = 0;
-    playing_points_ = 0;
-    tetris_points_ = 0;
-    playing_speed_ = STARTING_SPEED;
-    num_turn_ = 0;
-
     // Setup information for the game.
     ui->start_game_push_button->setEnabled(true);
+    ui->automatic_radio_button->setEnabled(true);
+    ui->manual_radio_button->setEnabled(true);
     ui->automatic_radio_button->setChecked(play_automatic_);
     ui->fall_button->setEnabled(true);
     ui->name_edit_push_button->setEnabled(true);
@@ -341,17 +415,7 @@ void MainWindow::initialize_game()
     ui->tetris_point_label->setText(QString("TETRIS\n0"));
 
     game_started_ = false;
-    game_over_ = false;
     game_running_ = false;
-
-    can_hold_ = true;
-    is_hold_empty_ = true;
-    hold_tetro_.type = 0;
-
-    next_tetro_.type = distr(randomEng) % NUMBER_OF_TETROMINOS;
-
-    int random_color_index = distr(randomEng) % NUM_CORLOR_IN_LEVEL;
-    next_tetro_.color = COLOR_CODE_SET.at(playing_level_).at(random_color_index);
 }
 
 //*****************************************************************************
@@ -360,12 +424,95 @@ void MainWindow::initialize_game()
 // Getting key command and move the tetromino.
 void MainWindow::keyPressEvent(QKeyEvent *event)
 {
+    if (event->key() == Qt::Key_H)
+    {
+        // Show or hide performance HUD.
+        toggle_hud();
+        return;
+    }
+
+    if (viewer_)
+    {
+        // Keys control the replay instead of a tetromino.
+        switch (event->key())
+        {
+        case Qt::Key_Space:
+            toggle_viewer_pause();
+            break;
+        case Qt::Key_Plus: case Qt::Key_Equal:
+            set_viewer_speed(viewer_speed_ + 1);
+            break;
+        case Qt::Key_Minus:
+            set_viewer_speed(viewer_speed_ - 1);
+            break;
+        case Qt::Key_Right: case Qt::Key_Period:
+            step_viewer(true);
+            break;
+        case Qt::Key_Left: case Qt::Key_Comma:
+            step_viewer(false);
+            break;
+        case Qt::Key_Escape:
+            leave_viewer();
+            break;
+        }
+
+        return;
+    }
+
+    if (event->key() == Qt::Key_P)
+    {
+        // Show or hide where to place for a perfect clear.
+        toggle_perfect_clear_hints();
+        return;
+    }
+
+    if (event->key() == Qt::Key_U)
+    {
+        TRACE_SCOPE("keyPressEvent rewind_game");
+
+        // Undo the last placed tetromino.
+        rewind_game();
+        return;
+    }
+
+    if (versus_)
+    {
+        // Keys are given to the session one in each tick.
+        switch (event->key())
+        {
+        case Qt::Key_A: case Qt::Key_4:
+            versus_inputs_.push_back(GameEngine::LEFT);
+            break;
+        case Qt::Key_D: case Qt::Key_6:
+            versus_inputs_.push_back(GameEngine::RIGHT);
+            break;
+        case Qt::Key_W: case Qt::Key_8:
+            versus_inputs_.push_back(GameEngine::ROTATE);
+            break;
+        case Qt::Key_S: case Qt::Key_5:
+            versus_inputs_.push_back(GameEngine::SOFT_FALL);
+            break;
+        case Qt::Key_C: case Qt::Key_7:
+            versus_inputs_.push_back(GameEngine::HARD_FALL);
+            break;
+        case Qt::Key_F: case Qt::Key_9:
+            versus_inputs_.push_back(GameEngine::HOLD);
+            break;
+        case Qt::Key_R: case Qt::Key_3:
+            versus_inputs_.push_back(GameEngine::REFLECT);
+            break;
+        }
+
+        return;
+    }
 
     if (!timer_.isActive())
     {
         if (game_running_ && !play_automatic_ &&
                 event->key() == Qt::Key_T)
         {
+            TRACE_SCOPE("keyPressEvent on_fall_button_clicked");
+
             // Drop new tetromino by press key board.
             on_fall_button_clicked();
         }
@@ -376,11 +523,10 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     if (event->key() == Qt::Key_A ||
         event->key() == Qt::Key_4)
     {
-        if (can_move_left())
-        {
-           // Move to the left one square.
-           move_left();
-        }
+        TRACE_SCOPE("keyPressEvent move_left");
+
+        // Move to the left one square.
+        move_tetromino(GameEngine::LEFT);
 
         return;
     }
@@ -388,11 +534,10 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     if (event->key() == Qt::Key_D ||
         event->key() == Qt::Key_6)
     {
-        if (can_move_right())
-        {
-            // Move to the right one square.
-            move_right();
-        }
+        TRACE_SCOPE("keyPressEvent move_right");
+
+        // Move to the right one square.
+        move_tetromino(GameEngine::RIGHT);
 
         return;
     }
@@ -400,28 +545,30 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     if (event->key() == Qt::Key_W ||
         event->key() == Qt::Key_8)
     {
-        // Rotation
-        rotate_counterclockwise();
-
-        // Used for calculate points.
-        num_turn_ += 1;
+        TRACE_SCOPE("keyPressEvent rotate_counterclockwise");
 
+        // Rotation. Every turn is counted for calculate points.
+        move_tetromino(GameEngine::ROTATE);
         return;
     }
 
     if (event->key() == Qt::Key_S ||
         event->key() == Qt::Key_5)
     {
+        TRACE_SCOPE("keyPressEvent move_soft_fall");
+
         // Fall down 5 unit.
-        move_soft_fall();
+        move_tetromino(GameEngine::SOFT_FALL);
         return;
     }
 
     if (event->key() == Qt::Key_C ||
         event->key() == Qt::Key_7)
     {
+        TRACE_SCOPE("keyPressEvent move_hard_fall");
+
         // Fall to the bottom.
-        move_hard_fall();
+        move_tetromino(GameEngine::HARD_FALL);
         return;
 
     }
@@ -429,6 +576,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     if (event->key() == Qt::Key_F ||
         event->key() == Qt::Key_9)
     {
+        TRACE_SCOPE("keyPressEvent exchange_tetromino");
+
         // hold tetromino.
         exchange_tetromino();
         return;
@@ -437,8 +586,10 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     if (event->key() == Qt::Key_R ||
         event->key() == Qt::Key_3)
     {
+        TRACE_SCOPE("keyPressEvent reflect_vertical_axis");
+
         // Reflection tetromino.
-        reflect_vertical_axis();
+        move_tetromino(GameEngine::REFLECT);
         return;
     }
 
@@ -448,20 +599,56 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
 //*****************************************************************************
 // Functions related to status of the game.
 
-// Update grid calculate scores and continue play
+// Give input to the game engine and record it.
+int MainWindow::apply_input(GameEngine::Input input)
+{
+    int result = engine_.apply(input);
+    replay_.record(input, result, engine_);
+    finesse_.record(input, result, engine_);
+
+    publish_game();
+
+    return result;
+}
+
+// Draw the locked tetromino calculate scores and continue play
 // game.
-void MainWindow::update_game()
+void MainWindow::update_game(int result)
 {
-    // Add new squares to the grid..
-    update_grid();
+    TRACE_SCOPE("update_game");
+
+    QElapsedTimer update_clock;
+    update_clock.start();
 
-    int num_row_remove = remove_full_row();
+    // Squares of the locked tetromino are now drawn in the grid.
+    release_current_tetromino();
+    draw_grid();
 
-    // Calculate point and possible update for the
+    store_rewind_point();
+
+    // Display point and possible update for the
     // scoreboard.
-    update_player_score(num_row_remove);
+    update_player_score(result);
     update_score_board();
 
+    // Record counters of the locked tetromino before the next one is made.
+    int64_t allocations = PerfCounters::get(PerfCounters::HEAP_ALLOCATIONS);
+
+    PerfCounters::set(PerfCounters::UPDATE_GAME_NS, update_clock.nsecsElapsed());
+    PerfCounters::set(PerfCounters::ALLOCATIONS_LAST_PIECE,
+                      allocations - allocations_at_lock_);
+    PerfCounters::add(PerfCounters::PIECES_LOCKED, 1);
+
+    allocations_at_lock_ = allocations;
+
+    // A race ends when a lock removes the last garbage row or the garbage
+    // pushes squares out.
+    if (result & GameEngine::GAME_OVER)
+    {
+        finish_game();
+        return;
+    }
+
     // Continue playing.
     if (play_automatic_)
     {
@@ -473,130 +660,47 @@ void MainWindow::update_game()
     }
 }
 
-// Move the square of tetromino from the scene and replace
-// by the square in that positon of the grid.
-void MainWindow::update_grid()
+// Draw rows of the grid which changed in the game engine.
+void MainWindow::draw_grid()
 {
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        Coord c(curr_tetro_.squares.at(i).pos);
-        QBrush brush = QBrush(curr_tetro_.squares.at(i).block->brush());
-
-        grid_.at(c.y).at(c.x).pos = Coord(c.x, c.y);
-        grid_.at(c.y).at(c.x).block = scene_->addRect(0, 0, SQUARE_SIDE,
-                                        SQUARE_SIDE, BLACK_PEN, brush);
-
-        grid_.at(c.y).at(c.x).block->setPos(c.x * SQUARE_SIDE,
-                                            c.y * SQUARE_SIDE);
-
-        scene_->removeItem(curr_tetro_.squares.at(i).block);
-    }
-}
+    TRACE_SCOPE("draw_grid");
 
-// Remove full row and move the grid down.
-int MainWindow::remove_full_row()
-{
-    int total_remove_row = 0;
-    int lowest_row_remove = -1;
-    int num_row_remove = 0;
+    const Board& board = engine_.board();
+    uint32_t dirty_rows = engine_.take_dirty_rows();
 
-    do
+    for (int row = 0; row < ROWS; ++row)
     {
-        move_grid_down(num_row_remove, lowest_row_remove);
-
-        total_remove_row += num_row_remove;
-
-        // Set up values for next round of finding.
-        num_row_remove = 0;
-        lowest_row_remove = -1;
-
-        // Find complete row.
-        for (int row = bottom_; row  >= up_; --row)
+        if (!((dirty_rows >> row) & 1))
         {
-            bool full_row = true;
-            for (int col = 0; col < COLUMNS; ++col)
-            {
-                if (grid_.at(row).at(col).block == NULL)
-                {
-                    full_row = false;
-                    break;
-                }
-            }
-
-            if (full_row)
-            {
-                num_row_remove += 1;
-                if (lowest_row_remove < row)
-                {
-                    lowest_row_remove = row;
-                }
-            }
+            continue;
         }
-    }
-    while (num_row_remove != 0);
-
-    return total_remove_row;
-}
-
-// Move the grid down.
-void MainWindow::move_grid_down(int num_row_remove, int lowest_row_remove)
-{
-    if (num_row_remove <= 0)
-    {
-        return;
-    }
 
-    // Remove complete row.
-    for (int row = lowest_row_remove; row >= 0; --row)
-    {
         for (int col = 0; col < COLUMNS; ++col)
         {
-            // Check if there is a square above.
-            bool square_above = true;
+            QGraphicsRectItem*& block = grid_.at(row).at(col);
 
-            if (row - num_row_remove < 0)
+            if (!board.is_occupied(col, row))
             {
-                square_above = false;
-            }
-            else
-            {
-                if (grid_.at(row - num_row_remove).at(col).block == NULL)
+                // No square in this position any more.
+                if (block != NULL)
                 {
-                    square_above = false;
+                    remove_square(block);
+                    block = NULL;
                 }
+
+                continue;
             }
 
-            if (!square_above)
-            {
-                // Remove square in current position since no square will going
-                // fill it position.
-                if (grid_.at(row).at(col).block != NULL)
-                {
-                    scene_->removeItem(grid_.at(row).at(col).block);
-                }
+            const QBrush& brush = palette_brushes_.at(board.colors.at(row).at(col));
 
-                grid_.at(row).at(col).block = NULL;
+            if (block == NULL)
+            {
+                block = add_square(brush);
+                block->setPos(col * SQUARE_SIDE, row * SQUARE_SIDE);
             }
-            else
+            else if (block->brush() != brush)
             {
-                // There is a square above will move to current position the grid.
-
-                // Remove square in current position on the grid.
-                if (grid_.at(row).at(col).block != NULL)
-                {
-                    scene_->removeItem(grid_.at(row).at(col).block);
-                }
-
-                grid_.at(row).at(col).block = NULL;
-
-                // Draw new square in current positon.
-                QBrush brush = grid_.at(row - num_row_remove).at(col).block->brush();
-
-                grid_.at(row).at(col).block = scene_->addRect(0, 0, SQUARE_SIDE,
-                                                SQUARE_SIDE, BLACK_PEN, QBrush(brush));
-
-                grid_.at(row).at(col).block->setPos(col * SQUARE_SIDE,
-                                                    row * SQUARE_SIDE);
+                block->setBrush(brush);
             }
         }
     }
@@ -605,47 +709,79 @@ void MainWindow::move_grid_down(int num_row_remove, int lowest_row_remove)
 // Coninue playing the game.
 void MainWindow::continue_game()
 {
-    make_new_tetromino();
+    TRACE_SCOPE("continue_game");
+
+    int result = apply_input(GameEngine::SPAWN);
 
     // Finish the game if game is over.
-    if (is_over())
+    if (result & GameEngine::GAME_OVER)
     {
-        make_appear_over();
+        draw_grid();
         finish_game();
         return;
     }
 
-    // Set up value for continue playing.
-    can_hold_ = true;
-    game_running_ = true;
-
-    // Continue playing.
-    make_appear();
-    draw_next_tetromino();
-    timer_.start(playing_speed_);
+    if (result & GameEngine::SPAWNED)
+    {
+        show_new_tetromino();
+    }
 }
 
-// Game is over when tetromino the get into playing area.
-bool MainWindow::is_over()
+// Setup when game is finish.
+void MainWindow::finish_game()
 {
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    timer_.stop();
+    playing_timer_.stop();
+
+    QString message = "Game finish.";
+
+    if (engine_.is_completed())
+    {
+        message = QString("Race complete in %1:%2:%3.").arg(hour_)
+                .arg(minute_, 2, 10, QChar('0')).arg(second_, 2, 10, QChar('0'));
+    }
+
+    if (bot_game_)
     {
-        Coord c(curr_tetro_.squares.at(i).pos);
+        bot_timer_.stop();
+        bot_game_ = false;
 
-        if (grid_.at(c.y).at(c.x).block!= NULL)
+        if (!bot_engine_.is_over() && !engine_.is_completed())
         {
-            game_over_ = true;
+            message = "Game finish. The bot wins.";
         }
     }
 
-    return game_over_;
-}
+    // How many keys the player pressed for each tetromino and how many
+    // tetrominos took more keys than needed.
+    const FinesseAnalyzer::Totals& finesse = finesse_.totals();
 
-// Setup when game is finish.
-void MainWindow::finish_game()
-{
-    playing_timer_.stop();
-    ui->game_message_label->setText("Game finish.");
+    if (finesse.pieces > 0)
+    {
+        message += QString("\nKeys per piece %1 (best %2).\nFaults %3.")
+                .arg(finesse_.keys_per_piece(), 0, 'f', 2)
+                .arg(double(finesse.minimum_keys) / finesse.pieces, 0, 'f', 2)
+                .arg(finesse.faults);
+    }
+
+    if (practice_)
+    {
+        message += "\nPractice game, not in the high scores.";
+    }
+
+    ui->game_message_label->setText(message);
+    replay_.finesse = finesse;
+
+    // The result goes with the inputs, so a high score can be checked by
+    // playing them again. A rewound game has no result to check.
+    if (!practice_)
+    {
+        replay_.claim.present = true;
+        replay_.claim.player = player_name_;
+        replay_.claim.points = engine_.points();
+        replay_.claim.lines = engine_.lines_removed();
+        replay_.claim.seconds = 3600 * hour_ + 60 * minute_ + second_;
+    }
 
     game_running_ = false;
 
@@ -655,19 +791,60 @@ void MainWindow::finish_game()
     ui->player_name_line_edit->setEnabled(true);
 
     // Store highest scores information to a file for next games.
-    store_high_scores();
+    if (!practice_)
+    {
+        store_high_scores();
+    }
+
+    // Finished game is not continued.
+    std::remove(SAVED_GAME_FILE.c_str());
+
+    save_replay();
+}
+
+// Write the inputs of the finished game to RECORDED_GAMES_DIRECTORY.
+void MainWindow::save_replay()
+{
+    if (!replay_complete_)
+    {
+        return;
+    }
+
+    QString directory = QString::fromStdString(RECORDED_GAMES_DIRECTORY);
+
+    if (!QDir().mkpath(directory))
+    {
+        return;
+    }
+
+    QString file_name = directory + "/game_" +
+            QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".replay";
+
+    replay_.write(file_name.toStdString());
 }
 
 // Pause game but playing time clock will not stop.
 void MainWindow::pause_game()
 {
+    if (viewer_)
+    {
+        toggle_viewer_pause();
+        return;
+    }
+
+    if (versus_)
+    {
+        ui->game_message_label->setText("Versus game cannot pause.");
+        return;
+    }
+
     if (!game_started_)
     {
         ui->game_message_label->setText("Game has not started.");
         return;
     }
 
-    if (game_over_)
+    if (engine_.is_over())
     {
         ui->game_message_label->setText("Game is over.");
         return;
@@ -679,31 +856,35 @@ void MainWindow::pause_game()
         ui->pause_game_push_button->setText("Resume game");
 
         timer_.stop();
+        bot_timer_.stop();
 
         game_running_ = false;
 
+        // Keep the paused game if the program is closed.
+        save_snapshot();
     }
     else
     {
         ui->game_message_label->setText("Continue game.");
         ui->pause_game_push_button->setText("Pause");
 
-        // If play automatic the tetromino start dropping.
-        if (play_automatic_)
+        game_running_ = true;
+
+        if (bot_game_ && !bot_engine_.is_over())
         {
-            timer_.start(playing_speed_);
+            bot_timer_.start(BOT_INPUT_INTERVAL);
         }
-        else
+
+        // If there is already tetromino dropped it continue dropping.
+        if (engine_.is_piece_active())
         {
-            // If play manually but there is already tetromino
-            // dropped.
-            if (curr_tetro_.squares.front().block != NULL)
-            {
-                timer_.start(playing_speed_);
-            }
+            start_drop_timer();
+        }
+        else if (play_automatic_)
+        {
+            // Game restored after a tetromino was locked in manual mode.
+            continue_game();
         }
-
-        game_running_ = true;
     }
 
 }
@@ -712,927 +893,497 @@ void MainWindow::pause_game()
 void MainWindow::quit_game()
 {
     store_high_scores();
+    save_snapshot();
     close();
 }
 
-
-//*****************************************************************************
-// Function related to player information.
-
-// Calculate point after each drop.
-int MainWindow::calculate_point(int num_row_remove, int num_turn)
+// Store the state of the game for rewind.
+void MainWindow::store_rewind_point()
 {
-    // For each tetromino drop player get 100 points.
-    // The point will not be negative.
-    int point = 100;
+    rewind_.push(engine_, replay_.inputs.size(), replay_.lock_hashes.size());
+}
 
-    // The player should turn as less as possible.
-    // For each turn excepts the first three turn the
-    // points is minus to 5 points.
-    if (num_turn > 3)
+// Go back to the state before the last tetromino was locked. The items
+// in the scene are reused. The entry is removed only after its state
+// loaded, so a state which does not load keeps the history.
+//
+// A rewound game is practice from then on: the high scores are read again
+// without the places it took, and it takes no more.
+void MainWindow::rewind_game()
+{
+    if (!game_started_ || engine_.is_over() || versus_ || bot_game_)
     {
-        if (point - (num_turn - 3) * 5 <= 0)
-        {
-            point = 0;
-        }
-        else
-        {
-            point -= 5 * num_turn;
-        }
+        return;
     }
 
-    // Point earn from make a complete rows.
-    if (num_row_remove < 4)
+    const RewindBuffer::Entry* entry = rewind_.at(1);
+
+    if (entry == NULL || !engine_.load_state(entry->state))
     {
-        point += num_row_remove * 1000;
+        ui->game_message_label->setText("Nothing to rewind.");
+        return;
     }
-    else
+
+    rewind_.rewind(1);
+    timer_.stop();
+
+    if (!practice_)
     {
-        // More point from remove large number of
-        // rows.
-        point += num_row_remove * 2000;
+        practice_ = true;
+        get_high_scores();
     }
 
-    return point;
-}
+    // The replay continues from the state so it still plays the same game.
+    replay_.truncate(entry->num_inputs, entry->num_locks);
 
-// Update player score after each drop and update leve.
-void MainWindow::update_player_score(int num_row_remove)
-{
-    // Calculate point.
-    playing_points_ += calculate_point(num_row_remove, num_turn_);
-    total_lines_removed_ += num_row_remove;
+    release_current_tetromino();
+    draw_grid();
 
-    if (num_row_remove >= 4)
+    if (engine_.is_hold_empty())
     {
-        tetris_points_ += 1;
+        hold_arena_.reset();
+    }
+    else
+    {
+        draw_hold_tetromino();
     }
 
-    ui->lines_remove_label->setText(QString("LINE\n") +
-                                    QString::number(total_lines_removed_));
-
-    ui->player_score_label->setText(QString("SCORE ") +
-                                    QString::number(playing_points_));
+    draw_next_tetromino();
+    update_player_score(GameEngine::NOTHING);
 
-    ui->tetris_point_label->setText(QString("TETRIS\n") +
-                                    QString::number(tetris_points_));
+    publish_game();
 
+    ui->game_message_label->setText(QString("Rewind. %1 more possible. "
+                                            "Practice game, not in the high scores.")
+                                    .arg(rewind_.size() - 1));
 
-    if (playing_points_ >= LEVEL_THRESHOLD.at(playing_level_))
+    // Continue with the tetromino which was placed.
+    if (!game_running_)
     {
-        update_level();
+        return;
     }
-}
 
-// Update playing level.
-void MainWindow::update_level()
-{
-    // Update level.
-    if (playing_level_ < NUM_LEVELS - 1)
+    if (play_automatic_)
     {
-        playing_level_ += 1;
-
-        // Increasing fall speed.
-        // Possible update rule of increasing
-        playing_speed_ -= 70;
-
-        QString level_message = "Level up. Level " +
-                QString::number(playing_level_ + 1);
-
-        ui->game_message_label->setText(level_message);
+        continue_game();
     }
     else
     {
-        ui->game_message_label->setText("Maximum level.");
+        ui->fall_button->setEnabled(true);
     }
 }
 
-// Get player name. If no thing is provided the player
-// name is "No name".
-void MainWindow::set_player_name()
+// Send the changes of the game to the spectators. Changes are found by
+// comparing with the state published last, so new games, rewinds and
+// rollbacks need nothing special.
+void MainWindow::publish_game()
 {
-    player_name_ = ui->player_name_line_edit->text().toStdString();
-    ui->player_name_line_edit->setText("");
+    if (spectators_ != NULL)
+    {
+        spectators_->publish(engine_);
+    }
+}
 
-    QString player_name_message = QString("Welcome") +
-            QString::fromStdString(' ' + player_name_) + QString('.');
-
-    ui->game_message_label->setText(player_name_message);
-
-    if (player_name_ == "")
+// Save the game which is not finished to SAVED_GAME_FILE.
+void MainWindow::save_snapshot()
+{
+    if (!game_started_ || engine_.is_over() || versus_ || bot_game_)
     {
-        player_name_ = "No name";
+        return;
     }
-}
-
 
-//*****************************************************************************
-// Functions related to generate and display tetromino.
+    Snapshot snapshot;
+    snapshot.take(engine_, 3600 * hour_ + 60 * minute_ + second_);
+    snapshot.practice = practice_;
+    snapshot.write(SAVED_GAME_FILE);
+}
 
-// Create new tetromino for next drop.
-void MainWindow::make_new_tetromino()
+// Continue the game saved to SAVED_GAME_FILE. The game stays paused
+// until the player resume it.
+void MainWindow::restore_snapshot()
 {
-    // Getting information to make new tetromino.
-    curr_tetro_.type = next_tetro_.type;
-    curr_tetro_.color = next_tetro_.color;
-    num_turn_ = 0;
+    Snapshot snapshot;
 
-    // Assign information for tetromino based on its typed.
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    if (!snapshot.read(SAVED_GAME_FILE) || !snapshot.restore(engine_))
     {
-        curr_tetro_.squares.at(i).pos =
-                Coord(COORD_INFO.at(curr_tetro_.type).at(i));
-
-        bottom_ = BOTTOM_INFO.at(curr_tetro_.type);
-        left_ = LEFT_INFO.at(curr_tetro_.type);
-        right_ = RIGHT_INFO.at(curr_tetro_.type);
-        up_ = UP_INFO.at(curr_tetro_.type);
+        return;
     }
 
-    // Set appearance position of new tetromino.
-    set_appear_position();
+    // Saved game is continued only once.
+    std::remove(SAVED_GAME_FILE.c_str());
 
-    // Prepare information of the next tetromino.
-    next_tetro_.type = distr(randomEng) % NUMBER_OF_TETROMINOS;
-    int color_index = distr(randomEng) % NUM_CORLOR_IN_LEVEL;
-    next_tetro_.color = COLOR_CODE_SET.at(playing_level_).at(color_index);
-}
+    // The inputs before the snapshot are not known.
+    replay_complete_ = false;
+    practice_ = snapshot.practice;
+    finesse_.reset();
 
-// Align appear position of tetromino in the center.
-// Possible update for more appearing affect.
-void MainWindow::set_appear_position()
-{
-    // Align to center.
-    int deltaX = ((COLUMNS - 1) / 2) - (right_ - left_) / 2;
+    rewind_.clear();
+    store_rewind_point();
 
-    // Set square position.
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    hour_ = snapshot.playing_seconds / 3600;
+    minute_ = (snapshot.playing_seconds % 3600) / 60;
+    second_ = snapshot.playing_seconds % 60;
+
+    ui->number_hou_lcd->display(hour_);
+    ui->number_min_lcd->display(minute_);
+    ui->number_sec_lcd->display(second_);
+
+    // Draw the game.
+    draw_grid();
+
+    if (engine_.is_piece_active())
     {
-        curr_tetro_.squares.at(i).pos.x += deltaX;
+        make_appear();
     }
 
-    // Update related value.
-    left_ += deltaX;
-    right_ += deltaX;
-}
+    draw_next_tetromino();
 
-// Draw tetromino on the playing area.
-void MainWindow::make_appear()
-{
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    if (!engine_.is_hold_empty())
     {
-        Coord c(curr_tetro_.squares.at(i).pos);
-        curr_tetro_.squares.at(i).block = scene_->addRect(0, 0, SQUARE_SIDE,
-                                                          SQUARE_SIDE, BLACK_PEN,
-                                                          QBrush(curr_tetro_.color));
-
-        curr_tetro_.squares.at(i).block->setPos(c.x * SQUARE_SIDE,
-                                                c.y * SQUARE_SIDE);
+        draw_hold_tetromino();
     }
-}
 
-// Draw part of tetromino when it can not get into
-// playing area.
-void MainWindow::make_appear_over()
-{
-    // Find how many square need to move up to fit in
-    // playing area.
-    int move_up = 1;
-    while (bottom_ - move_up >= 0)
-    {
-        bool found_suitable_position = true;
-        for (int i = 0; i < NUM_SQUARE; ++i)
-        {
-            Coord c(curr_tetro_.squares.at(i).pos);
-            c.y -= move_up;
+    update_player_score(GameEngine::NOTHING);
 
-            // Check only part apper on the scene.
-            if (c.y >= 0)
-            {
-                if (grid_.at(c.y).at(c.x).block!= NULL)
-                {
-                    found_suitable_position = false;
-                    break;
-                }
-            }
-        }
+    publish_game();
 
-        if (found_suitable_position)
-        {
-            break;
-        }
+    // Continue as a paused game.
+    game_started_ = true;
+    game_running_ = false;
 
-        // Try moving up one unit.
-        move_up += 1;
-    }
+    ui->start_game_push_button->setDisabled(true);
+    ui->name_edit_push_button->setDisabled(true);
+    ui->player_name_line_edit->setDisabled(true);
+    ui->fall_button->setEnabled(!play_automatic_ && !engine_.is_piece_active());
 
-    // Move up tetromino for fit in playing area.
-    if (bottom_ - move_up >= 0)
-    {
-        for (int i = 0; i < NUM_SQUARE; ++i)
-        {
-            Coord c(curr_tetro_.squares.at(i).pos);
+    ui->pause_game_push_button->setText("Resume game");
+    ui->game_message_label->setText("Saved game restored.");
 
-            c.y -= move_up;
+    playing_timer_.start(1000);
+}
 
-            if (c.y >= 0)
-            {
-                grid_.at(c.y).at(c.x).block =
-                        scene_->addRect(0, 0,SQUARE_SIDE, SQUARE_SIDE,
-                        BLACK_PEN, QBrush(curr_tetro_.squares.at(i).block->brush()));
 
-                grid_.at(c.y).at(c.x).block->setPos(c.x * SQUARE_SIDE,
-                                                    c.y * SQUARE_SIDE);
-            }
-        }
-     }
-}
+//*****************************************************************************
+// Function related to player information.
 
-// Drop tetrmonio by time out.
-void MainWindow::make_drop_down_automatic()
+// Display player score after each drop and the level.
+void MainWindow::update_player_score(int result)
 {
-    if (can_move_down())
+    ui->lines_remove_label->setText(QString("LINE\n") +
+                                    QString::number(engine_.lines_removed()));
+
+    ui->player_score_label->setText(QString("SCORE ") +
+                                    QString::number(engine_.points()));
+
+    ui->tetris_point_label->setText(QString("TETRIS\n") +
+                                    QString::number(engine_.tetris_points()));
+
+    if (result & GameEngine::LEVEL_UP)
     {
-        move_down();
+        QString level_message = "Level up. Level " +
+                QString::number(engine_.level() + 1);
+
+        ui->game_message_label->setText(level_message);
     }
-    else
+    else if (result & GameEngine::MAX_LEVEL)
     {
-        timer_.stop();
-        update_game();
+        ui->game_message_label->setText("Maximum level.");
+    }
+    else if (engine_.mode() != GameEngine::NORMAL)
+    {
+        ui->game_message_label->setText("Garbage rows left " +
+                                        QString::number(engine_.garbage_left()));
     }
 }
 
-// Draw incoming tetromino in the next scene.
-void MainWindow::draw_next_tetromino()
+// Get player name. If no thing is provided the player
+// name is "No name".
+void MainWindow::set_player_name()
 {
-    next_scene_->clear();
-
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        next_tetro_.squares.at(i).pos = Coord(COORD_INFO.at(next_tetro_.type).at(i));
+    player_name_ = ui->player_name_line_edit->text().toStdString();
+    ui->player_name_line_edit->setText("");
 
-        Coord c(next_tetro_.squares.at(i).pos);
-        QBrush brush = QBrush(next_tetro_.color);
+    QString player_name_message = QString("Welcome") +
+            QString::fromStdString(' ' + player_name_) + QString('.');
 
-        // Align the tetromino.
-        next_tetro_.squares.at(i).block =
-                next_scene_->addRect(0, 0, SQUARE_SIDE / 1.2,
-                                     SQUARE_SIDE / 1.2, BLACK_PEN, brush);
+    ui->game_message_label->setText(player_name_message);
 
-        next_tetro_.squares.at(i).block->setPos(c.x * SQUARE_SIDE + 30,
-                                                c.y * SQUARE_SIDE + 10);
+    if (player_name_ == "")
+    {
+        player_name_ = "No name";
     }
-
 }
 
 
 //*****************************************************************************
-// Functions related to condition of moving of tetromino.
+// Functions related to generate and display tetromino.
 
-// Check if possible moving down.
-bool MainWindow::can_move_down()
+// Draw the moving tetromino on the playing area.
+void MainWindow::make_appear()
 {
-    if (bottom_ + 1 >= ROWS)
-    {
-        return false;
-    }
+    const QBrush& brush = palette_brushes_.at(engine_.current().color);
 
     for (int i = 0; i < NUM_SQUARE; ++i)
     {
-        Coord c(curr_tetro_.squares.at(i).pos);
-
-        if (grid_.at(c.y + 1).at(c.x).block!= NULL)
-        {
-            return false;
-        }
+        curr_blocks_.at(i) = add_square(brush);
     }
 
-    return true;
+    draw_current_tetromino();
+    show_perfect_clear_hint();
 }
 
-// Check if possible move to the left.
-bool MainWindow::can_move_left()
+// Display the new tetromino from the game engine and start dropping it.
+void MainWindow::show_new_tetromino()
 {
-    // The border is on the left.
-    if (left_ - 1 < 0)
-    {
-        return false;
-    }
+    game_running_ = true;
+
+    make_appear();
+    draw_next_tetromino();
+    start_drop_timer();
+}
 
-    // There are other tetrominos on the left.
+// Remove squares of the moving tetromino and its hint from the playing
+// area.
+void MainWindow::release_current_tetromino()
+{
     for (int i = 0; i < NUM_SQUARE; ++i)
     {
-        int x_index = curr_tetro_.squares.at(i).pos.x;
-        int y_index = curr_tetro_.squares.at(i).pos.y;
+        remove_square(curr_blocks_.at(i));
+        curr_blocks_.at(i) = NULL;
 
-        if (grid_.at(y_index).at(x_index - 1).block!= NULL)
+        if (hint_blocks_.at(i) != NULL)
         {
-            return false;
+            remove_square(hint_blocks_.at(i));
+            hint_blocks_.at(i) = NULL;
         }
     }
-
-    // Can move to the left.
-    return true;
 }
 
-// Check if possible move to the right.
-bool MainWindow::can_move_right()
+// Move squares of the moving tetromino to its position in the game engine.
+void MainWindow::draw_current_tetromino()
 {
-    // The border is on the right.
-    if (right_ + 1 >= COLUMNS)
-    {
-        return false;
-    }
+    const Piece& piece = engine_.current();
 
-    // There are other tetrominos on the right.
     for (int i = 0; i < NUM_SQUARE; ++i)
     {
-        int x_index = curr_tetro_.squares.at(i).pos.x;
-        int y_index = curr_tetro_.squares.at(i).pos.y;
-
-        if (grid_.at(y_index).at(x_index + 1).block!= NULL)
+        if (curr_blocks_.at(i) != NULL)
         {
-            return false;
+            curr_blocks_.at(i)->setPos(piece.squares.at(i).x * SQUARE_SIDE,
+                                       piece.squares.at(i).y * SQUARE_SIDE);
         }
     }
-
-    // Can move to the left.
-    return true;
 }
 
+// Drop tetrmonio by time out.
+void MainWindow::make_drop_down_automatic()
+{
+    // How much later than the dropping speed the timer fired.
+    PerfCounters::set(PerfCounters::TIMER_LATENESS_MS,
+                      drop_clock_.restart() - engine_.speed());
 
-//*****************************************************************************
-// Functions related to move tetromino.
+    int result = apply_input(GameEngine::GRAVITY);
 
+    if (result & GameEngine::LOCKED)
+    {
+        timer_.stop();
+        update_game(result);
+    }
+    else
+    {
+        draw_current_tetromino();
+    }
+}
 
-// Move teromino one square to the left.
-void MainWindow::move_left()
+// Draw incoming tetromino in the next scene.
+void MainWindow::draw_next_tetromino()
 {
+    TRACE_SCOPE("draw_next_tetromino");
+
+    next_arena_.reset();
+
+    const Piece& next = engine_.next();
+
     for (int i = 0; i < NUM_SQUARE; ++i)
     {
-        curr_tetro_.squares.at(i).block->moveBy(-SQUARE_SIDE, 0);
-        curr_tetro_.squares.at(i).pos.x -= 1;
+        Coord c(PieceSet::tetrominos().shape(next.type).orientations.at(0).cells.at(i));
+
+        // Align the tetromino.
+        QGraphicsRectItem* block = next_arena_.acquire(palette_brushes_.at(next.color));
+
+        block->setPos(c.x * SQUARE_SIDE + 30, c.y * SQUARE_SIDE + 10);
     }
 
-    left_ -= 1;
-    right_ -= 1;
 }
 
-// Move tetromino one square to the right.
-void MainWindow::move_right()
+// Draw hold tetromino in the hold scene.
+void MainWindow::draw_hold_tetromino()
 {
+    hold_arena_.reset();
+
+    const Piece& hold = engine_.hold();
+
     for (int i = 0; i < NUM_SQUARE; ++i)
     {
-        curr_tetro_.squares.at(i).block->moveBy(SQUARE_SIDE, 0);
-        curr_tetro_.squares.at(i).pos.x += 1;
-    }
+        Coord c(PieceSet::tetrominos().shape(hold.type).orientations.at(0).cells.at(i));
 
-    left_ += 1;
-    right_ += 1;
+        // Scale for fit in the scene.
+        QGraphicsRectItem* block = hold_arena_.acquire(palette_brushes_.at(hold.color));
+
+        block->setPos(c.x * SQUARE_SIDE / 1.4 + 10, c.y * SQUARE_SIDE / 1.4 + 15);
+    }
 }
 
-// Move tetromino one square down.
-void MainWindow::move_down()
+
+//*****************************************************************************
+// Functions related to move tetromino.
+
+// Move the tetromino in the game engine and draw it.
+void MainWindow::move_tetromino(GameEngine::Input input)
 {
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    if (apply_input(input) & GameEngine::MOVED)
     {
-       curr_tetro_.squares.at(i).block->moveBy(0, SQUARE_SIDE);
-       curr_tetro_.squares.at(i).pos.y += 1;
+        draw_current_tetromino();
     }
-
-    bottom_ += 1;
-    up_ += 1;
 }
 
-// Move tetromino down six square if possible.
-// if not then move as low as possible.
-void MainWindow::move_soft_fall()
+// Exchange current playing tetromino to hold position and move
+// hold tetromino to plaing area.
+void MainWindow::exchange_tetromino()
 {
-    // Move lowst as possible.
-    if (bottom_ + MOVE_SOFT >= ROWS)
+    int result = apply_input(GameEngine::HOLD);
+
+    // In one drop can only hold one time.
+    if (!(result & GameEngine::HELD))
     {
-        move_hard_fall();
         return;
     }
 
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    release_current_tetromino();
+    draw_hold_tetromino();
+
+    if (result & GameEngine::GAME_OVER)
+    {
+        draw_grid();
+        finish_game();
+    }
+    else if (result & GameEngine::SPAWNED)
     {
-        Coord c(curr_tetro_.squares.at(i).pos);
+        // Hold was empty so the next tetromino drops.
+        show_new_tetromino();
+    }
+    else
+    {
+        make_appear();
+    }
+}
+
+
+//*****************************************************************************
+// Functions related to button on main window.
+
+// Change to automatic playing mode.
+void MainWindow::on_automatic_radio_button_toggled(bool checked)
+{
+    ui->automatic_radio_button->setChecked(checked);
+    play_automatic_ = true;
+
+    if (game_started_ && game_running_)
+    {
+        ui->fall_button->setDisabled(true);
 
-        for (int j = 1; j <= MOVE_SOFT; ++j)
+        // Toggled button when currently playing.
+        if (!timer_.isActive())
         {
-            if (grid_.at(c.y + j).at(c.x).block!= NULL)
+            // If there are no tetromino currently drop.
+            if (!engine_.is_piece_active())
+            {
+                continue_game();
+            }
+            else
             {
-                // Move to lowest possible.
-                move_hard_fall();
-                return;
+                start_drop_timer();
             }
         }
     }
 
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        curr_tetro_.squares.at(i).block->moveBy(0, MOVE_SOFT * SQUARE_SIDE);
-        curr_tetro_.squares.at(i).pos.y += MOVE_SOFT;
-    }
+    ui->game_message_label->setText("Play automatically.");
+}
+
+// Change to manual playing mode.
+void MainWindow::on_manual_radio_button_toggled(bool checked)
+{
+    ui->manual_radio_button->setChecked(checked);
+    play_automatic_ = false;
 
-    bottom_ += MOVE_SOFT;
-    up_ += MOVE_SOFT;
+    ui->game_message_label->setText("Play maually.");
 }
 
-// Move down as lowest as possible
-void MainWindow::move_hard_fall()
+// Start the game.
+void MainWindow::on_start_game_push_button_clicked()
 {
-    int deltaY = ROWS;
+    initialize_game();
 
-    // Find distance to move down.
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        Coord c(curr_tetro_.squares.at(i).pos);
+    ui->start_game_push_button->setDisabled(true);
+    ui->name_edit_push_button->setDisabled(true);
+    ui->player_name_line_edit->setDisabled(true);
+    ui->game_message_label->setText("Game started.");
 
-        // Find how many step can go down.
-        int j = 0;
-        while (c.y + j < ROWS &&
-               grid_.at(c.y + j).at(c.x).block == NULL)
-        {
-            j += 1;
-        }
+    game_started_ = true;
+    game_running_ = true;
 
-        j -= 1;
+    playing_timer_.start(1000);
 
-        if (deltaY > j)
-        {
-            deltaY = j;
-        }
+    if (bot_enabled_)
+    {
+        begin_bot();
     }
 
-    // Move to the surface of fallen tetrimions.
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    if (play_automatic_)
     {
-        curr_tetro_.squares.at(i).block->moveBy(0, deltaY * SQUARE_SIDE);
-        curr_tetro_.squares.at(i).pos.y += deltaY;
+        ui->fall_button->setDisabled(true);
+        continue_game();
     }
 
-    // Update value.
-    bottom_ += deltaY;
-    up_ += deltaY;
 }
 
-// Calculate position of squares after rotation and check if rotation
-// is possilbe.
-bool MainWindow::rotation_calculation()
+// Button for drop new tetromino when playing maunal mode.
+void MainWindow::on_fall_button_clicked()
 {
-    std::vector<Coord> rotation_result;
-    std::vector<std::pair<double, double>> coord_convert;
-    std::pair<double, double> rotation_center = std::make_pair(0, 0);
+    // Cannot drop multiple tetriminos at the same time.
 
-    // Convert coordinates to real number.
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    if (game_started_)
     {
-        Coord c(curr_tetro_.squares.at(i).pos);
-
-        coord_convert.push_back(std::make_pair(c.x + 0.5, c.y + 0.5));
-
-        rotation_center.first += coord_convert.at(i).first;
-        rotation_center.second += coord_convert.at(i).second;
+        ui->fall_button->setDisabled(true);
+        continue_game();
     }
-
-    rotation_center.first /= NUM_SQUARE;
-    rotation_center.second /= NUM_SQUARE;
-
-    // Rotation and convert coordinate back to integer.
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    else
     {
-        Coord c;
-        c.x = ceil(rotation_center.first +
-            (coord_convert.at(i).second - rotation_center.second)) - 1;
+        ui->game_message_label->setText("Please start game.");
+    }
+}
 
-        c.y = ceil(rotation_center.second -
-            (coord_convert.at(i).first - rotation_center.first)) - 1;
 
-        rotation_result.push_back(c);
-    }
+//*****************************************************************************
+// Fuctions related to score boards.
+
+// Get information of high score player stored in file
+// and display them on the scoreboard.
+void MainWindow::get_high_scores()
+{
+    score_board_.clear();
+    int num_rows = 0;
 
-    bool can_rotate = true;
+    std::ifstream file;
+    file.open(HIGHEST_SCORES_FILE);
 
-    // Possible update for automatic move after rotation for fit it
-    // the grid.
-    for (int i = 0; i < NUM_SQUARE; ++i)
+    if (file.is_open())
     {
-        Coord c(rotation_result.at(i));
+        std::string line = "";
+        std::getline(file, line);
 
-        // There is wall on the left.
-        if (c.x < 0)
+        while (line != "")
         {
-            can_rotate = false;
-            break;
-        }
-
-        // There is wall on the right.
-        if (c.x >= COLUMNS)
-        {
-            can_rotate = false;
-            break;
-        }
-
-        // There is wall above.
-        if (c.y < 0)
-        {
-            can_rotate = false;
-            break;
-        }
-
-        // There is wall below.
-        if (c.y >= ROWS)
-        {
-            can_rotate = false;
-            break;
-        }
-
-        // There there is other tetromino.
-        if (grid_.at(c.y).at(c.x).block!= NULL)
-        {
-            can_rotate = false;
-            break;
-        }
-    }
-
-    // Update position of square in tetromino.
-    if (can_rotate)
-    {
-        for (int i = 0; i < NUM_SQUARE; ++i)
-        {
-            curr_tetro_.squares.at(i).pos.x = rotation_result.at(i).x;
-            curr_tetro_.squares.at(i).pos.y = rotation_result.at(i).y;
-        }
-    }
-
-    return can_rotate;
-}
-
-// Update value related to tetromino after rotation.
-void MainWindow::rotate_counterclockwise()
-{
-    // Rotate 90 degree counter-clockwise.
-    if (!rotation_calculation())
-    {
-        return;
-    }
-
-    // Update position information of tetromino.
-    int new_bottom = -1;
-    int new_up = ROWS;
-    int new_left = COLUMNS;
-    int new_right = -1;
-
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        if (curr_tetro_.squares.at(i).pos.y < new_up)
-        {
-            new_up = curr_tetro_.squares.at(i).pos.y;
-        }
-
-        if (curr_tetro_.squares.at(i).pos.y > new_bottom)
-        {
-            new_bottom = curr_tetro_.squares.at(i).pos.y;
-        }
-
-        if (curr_tetro_.squares.at(i).pos.x < new_left)
-        {
-            new_left = curr_tetro_.squares.at(i).pos.x;
-        }
-
-        if (curr_tetro_.squares.at(i).pos.x > new_right)
-        {
-            new_right = curr_tetro_.squares.at(i).pos.x;
-        }
-
-
-        curr_tetro_.squares.at(i).block->setPos(curr_tetro_.squares.at(i).pos.x * SQUARE_SIDE,
-                                                curr_tetro_.squares.at(i).pos.y * SQUARE_SIDE);
-    }
-
-
-    // Assigning new values.
-    bottom_ = new_bottom;
-    up_ = new_up;
-    right_ = new_right;
-    left_ = new_left;
-}
-
-// Calculate position of the squares after reflection and check if
-// reflection is possible.
-bool MainWindow::reflect_calculation()
-{
-    std::vector<Coord> reflection_result;
-    std::vector<double> coord_convert;
-    double rotation_center = 0;
-
-    // Convert coordinates to real number.
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        coord_convert.push_back(curr_tetro_.squares.at(i).pos.x + 0.5);
-    }
-
-    rotation_center = (double(right_ + left_) / 2) + 0.5;
-
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        Coord c;
-        c.x = 2 * rotation_center - coord_convert.at(i);
-        c.y = curr_tetro_.squares.at(i).pos.y;
-
-        reflection_result.push_back(c);
-    }
-
-    bool can_reflect = true;
-
-    // Possible update for automatic move after reflection for fit it
-    // the grid.
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        Coord c(reflection_result.at(i));
-
-        // There is wall on the left.
-        if (c.x < 0)
-        {
-            can_reflect = false;
-            break;
-        }
-
-        // There is wall on the right.
-        if (c.x >= COLUMNS)
-        {
-            can_reflect = false;
-            break;
-        }
-
-        // There is wall above.
-        if (c.y < 0)
-        {
-            can_reflect = false;
-            break;
-        }
-
-        // There is wall below.
-        if (c.y >= ROWS)
-        {
-            can_reflect = false;
-            break;
-        }
-
-        // There there is other tetromino.
-        if (grid_.at(c.y).at(c.x).block!= NULL)
-        {
-            can_reflect = false;
-            break;
-        }
-    }
-
-    if (can_reflect)
-    {
-        for (int i = 0; i < NUM_SQUARE; ++i)
-        {
-            curr_tetro_.squares.at(i).pos.x = reflection_result.at(i).x;
-        }
-    }
-
-    return can_reflect;
-}
-
-// Update value related to tetromino after reflection.
-void MainWindow::reflect_vertical_axis()
-{
-    if (!reflect_calculation())
-    {
-        return;
-    }
-
-    // Update position related information of tetromino.
-    int new_bottom = -1;
-    int new_up = ROWS;
-    int new_left = COLUMNS;
-    int new_right = -1;
-
-    for (int i = 0; i < NUM_SQUARE; ++i)
-    {
-        if (curr_tetro_.squares.at(i).pos.y < new_up)
-        {
-            new_up = curr_tetro_.squares.at(i).pos.y;
-        }
-
-        if (curr_tetro_.squares.at(i).pos.y > new_bottom)
-        {
-            new_bottom = curr_tetro_.squares.at(i).pos.y;
-        }
-
-        if (curr_tetro_.squares.at(i).pos.x < new_left)
-        {
-            new_left = curr_tetro_.squares.at(i).pos.x;
-        }
-
-        if (curr_tetro_.squares.at(i).pos.x > new_right)
-        {
-            new_right = curr_tetro_.squares.at(i).pos.x;
-        }
-
-
-        curr_tetro_.squares.at(i).block->setPos(curr_tetro_.squares.at(i).pos.x * SQUARE_SIDE,
-                                                    curr_tetro_.squares.at(i).pos.y * SQUARE_SIDE);
-    }
-
-    // Assign new value.
-    bottom_ = new_bottom;
-    up_ = new_up;
-    right_ = new_right;
-    left_ = new_left;
-}
-
-// Exchange current playing tetromino to hold position and move
-// hold tetromino to plaing area.
-void MainWindow::exchange_tetromino()
-{
-    // In one drop can only hold one time.
-    if (can_hold_)
-    {
-        // Exchange two tetromino.
-        int temp_type =curr_tetro_.type;
-        QColor temp_color = curr_tetro_.color;
-
-        // Remove current playing tetromino.
-        for (int i = 0; i < NUM_SQUARE; ++i)
-        {
-            scene_->removeItem(curr_tetro_.squares.at(i).block);
-        }
-
-        curr_tetro_.squares = std::vector<Square>(NUM_SQUARE, Square());
-
-        // Move hold tetromino to the playing area.
-        if (!is_hold_empty_)
-        {
-            // Store tetromino information.
-            curr_tetro_.type = hold_tetro_.type;
-            curr_tetro_.color = hold_tetro_.color;
-
-            for (int i = 0; i < NUM_SQUARE; ++i)
-            {
-                curr_tetro_.squares.at(i).pos =
-                        Coord(COORD_INFO.at(curr_tetro_.type).at(i));
-
-                bottom_ = BOTTOM_INFO.at(curr_tetro_.type);
-                left_ = LEFT_INFO.at(curr_tetro_.type);
-                right_ = RIGHT_INFO.at(curr_tetro_.type);
-                up_ = UP_INFO.at(curr_tetro_.type);
-            }
-
-            set_appear_position();
-
-            // Drawing in the playingarea.
-            for (int i = 0; i < NUM_SQUARE; ++i)
-            {
-                Coord c(curr_tetro_.squares.at(i).pos);
-                curr_tetro_.squares.at(i).block = scene_->addRect(0, 0, SQUARE_SIDE,
-                                                        SQUARE_SIDE, BLACK_PEN,
-                                                        QBrush(curr_tetro_.color));
-
-                curr_tetro_.squares.at(i).block->setPos(c.x * SQUARE_SIDE,
-                                                        c.y * SQUARE_SIDE);
-            }
-        }
-        else
-        {
-            continue_game();
-        }
-
-        hold_scene_->clear();
-
-        hold_tetro_.type = temp_type;
-        hold_tetro_.color = temp_color;
-
-        // Draw tetromino in the hold scene.
-        for (int i = 0; i < NUM_SQUARE; ++i)
-        {
-            hold_tetro_.squares.at(i).pos =
-                    Coord(COORD_INFO.at(hold_tetro_.type).at(i));
-
-            // Scale for fit in the scene.
-            hold_tetro_.squares.at(i).block = hold_scene_->addRect(0, 0, SQUARE_SIDE / 2,
-                                                            SQUARE_SIDE / 2, BLACK_PEN,
-                                                            QBrush(hold_tetro_.color));
-
-            Coord c(hold_tetro_.squares.at(i).pos);
-            hold_tetro_.squares.at(i).block->setPos(c.x * SQUARE_SIDE / 1.4 + 10,
-                                                    c.y * SQUARE_SIDE / 1.4 + 15);
-        }
-
-        // Update game control values.
-        is_hold_empty_ = false;
-        can_hold_ = false;
-    }
-}
-
-
-//*****************************************************************************
-// Functions related to button on main window.
-
-// Change to automatic playing mode.
-void MainWindow::on_automatic_radio_button_toggled(bool checked)
-{
-    ui->automatic_radio_button->setChecked(checked);
-    play_automatic_ = true;
-
-    if (game_started_ && game_running_)
-    {
-        ui->fall_button->setDisabled(true);
-
-        // Toggled button when currently playing.
-        if (!timer_.isActive())
-        {
-            // If there are no tetromino currently drop.
-            if (curr_tetro_.squares.front().block == NULL)
-            {
-                continue_game();
-            }
-            else
-            {
-                timer_.start(playing_speed_);
-            }
-        }
-    }
-
-    ui->game_message_label->setText("Play automatically.");
-}
-
-// Change to manual playing mode.
-void MainWindow::on_manual_radio_button_toggled(bool checked)
-{
-    ui->manual_radio_button->setChecked(checked);
-    play_automatic_ = false;
-
-    ui->game_message_label->setText("Play maually.");
-}
-
-// Start the game.
-void MainWindow::on_start_game_push_button_clicked()
-{
-    initialize_game();
-
-    ui->start_game_push_button->setDisabled(true);
-    ui->name_edit_push_button->setDisabled(true);
-    ui->player_name_line_edit->setDisabled(true);
-    ui->game_message_label->setText("Game started.");
-
-    game_started_ = true;
-    game_running_ = true;
-
-    playing_timer_.start(1000);
-
-    if (play_automatic_)
-    {
-        ui->fall_button->setDisabled(true);
-        continue_game();
-    }
-
-}
-
-// Button for drop new tetromino when playing maunal mode.
-void MainWindow::on_fall_button_clicked()
-{
-    // Cannot drop multiple tetriminos at the same time.
-
-    if (game_started_)
-    {
-        ui->fall_button->setDisabled(true);
-        continue_game();
-    }
-    else
-    {
-        ui->game_message_label->setText("Please start game.");
-    }
-}
-
-
-//*****************************************************************************
-// Fuctions related to score boards.
-
-// Get information of high score player stored in file
-// and display them on the scoreboard.
-void MainWindow::get_high_scores()
-{
-    score_board_.clear();
-    int num_rows = 0;
-
-    std::ifstream file;
-    file.open(HIGHEST_SCORES_FILE);
-
-    if (file.is_open())
-    {
-        std::string line = "";
-        std::getline(file, line);
-
-        while (line != "")
-        {
-            std::vector<std::string> parts = split_line(line, ',');
+            std::vector<std::string> parts = split_line(line, ',');
 
             std::string player_name = "";
             int point = 0;
@@ -1719,6 +1470,13 @@ void MainWindow::sort_score_board()
 // score higher than the score on the scoreboard.
 void MainWindow::update_score_board()
 {
+    TRACE_SCOPE("update_score_board");
+
+    if (practice_)
+    {
+        return;
+    }
+
     int rank = HIGHEST_SCORES_DISPLAY_NUM + 1;
     int curr_time = 3600 * hour_ + 60 * minute_ + second_;
 
@@ -1726,13 +1484,13 @@ void MainWindow::update_score_board()
     // on score board.
     for (int i = HIGHEST_SCORES_DISPLAY_NUM - 1; i >= 0; --i)
     {
-        if (playing_points_ > score_board_.at(i).second.first)
+        if (engine_.points() > score_board_.at(i).second.first)
         {
             rank = i;
         }
         else
         {
-            if (playing_points_ == score_board_.at(i).second.first)
+            if (engine_.points() == score_board_.at(i).second.first)
             {
                 if (curr_time < score_board_.at(i).second.second)
                 {
@@ -1755,7 +1513,7 @@ void MainWindow::update_score_board()
 
     // Update the score on score board.
     score_board_.at(rank) = std::make_pair(player_name_,
-                            std::make_pair(playing_points_, curr_time));
+                            std::make_pair(engine_.points(), curr_time));
 
     display_score_board();
 }
@@ -1845,6 +1603,8 @@ std::vector<std::pair<QString, std::pair<QString, QString>>> MainWindow::make_di
 // Store high score for later display.
 void MainWindow::store_high_scores()
 {
+    TRACE_SCOPE("store_high_scores");
+
     std::ofstream file;
     file.open(HIGHEST_SCORES_FILE);
 
@@ -1923,3 +1683,1154 @@ void MainWindow::display_playing_time()
     ui->number_sec_lcd->display(second_);
     ui->number_hou_lcd->display(hour_);
 }
+
+// Start dropping timer with the speed of the current level.
+void MainWindow::start_drop_timer()
+{
+    timer_.start(engine_.speed());
+    drop_clock_.start();
+}
+
+
+//*****************************************************************************
+// Functions related to the performance HUD.
+
+// Show a square in the playing area.
+QGraphicsRectItem* MainWindow::add_square(const QBrush& brush)
+{
+    PerfCounters::add(PerfCounters::SQUARES_SHOWN, 1);
+
+    return block_arena_.acquire(brush);
+}
+
+// Hide a square from the playing area.
+void MainWindow::remove_square(QGraphicsRectItem* block)
+{
+    PerfCounters::add(PerfCounters::SQUARES_HIDDEN, 1);
+
+    block_arena_.release(block);
+}
+
+// Time the repaint of the playing area.
+bool MainWindow::eventFilter(QObject* watched, QEvent* event)
+{
+    if (event->type() == QEvent::Paint && !timing_paint_ &&
+            watched == ui->graphicsView->viewport())
+    {
+        QElapsedTimer paint_clock;
+        paint_clock.start();
+
+        // Deliver the paint event now so its duration can be measured.
+        timing_paint_ = true;
+        QCoreApplication::sendEvent(watched, event);
+        timing_paint_ = false;
+
+        PerfCounters::set(PerfCounters::REPAINT_NS, paint_clock.nsecsElapsed());
+        PerfCounters::add(PerfCounters::REPAINTS, 1);
+
+        return true;
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
+// Show or hide the performance HUD.
+void MainWindow::toggle_hud()
+{
+    if (hud_label_->isVisible())
+    {
+        hud_timer_.stop();
+        hud_label_->hide();
+        return;
+    }
+
+    hud_squares_shown_ = PerfCounters::get(PerfCounters::SQUARES_SHOWN);
+    hud_squares_hidden_ = PerfCounters::get(PerfCounters::SQUARES_HIDDEN);
+    hud_clock_.start();
+
+    update_hud();
+
+    hud_label_->show();
+    hud_label_->raise();
+    hud_timer_.start(HUD_INTERVAL);
+}
+
+// Refresh values display on the performance HUD.
+void MainWindow::update_hud()
+{
+    PerfCounters::set(PerfCounters::SCENE_ITEMS, scene_->items().size());
+
+    // Measure how long a posted event waits in the event loop.
+    QElapsedTimer lag_clock;
+    lag_clock.start();
+
+    QTimer::singleShot(0, this, [lag_clock]()
+    {
+        PerfCounters::set(PerfCounters::EVENT_LOOP_LAG_US,
+                          lag_clock.nsecsElapsed() / 1000);
+    });
+
+    // Rates per second since the previous refresh.
+    double seconds = hud_clock_.restart() / 1000.0;
+
+    if (seconds <= 0)
+    {
+        seconds = 1;
+    }
+
+    // Squares are taken from the arena, so these count squares shown and
+    // hidden, not scene items created and removed.
+    int64_t shown = PerfCounters::get(PerfCounters::SQUARES_SHOWN);
+    int64_t hidden = PerfCounters::get(PerfCounters::SQUARES_HIDDEN);
+
+    double shown_rate = (shown - hud_squares_shown_) / seconds;
+    double hidden_rate = (hidden - hud_squares_hidden_) / seconds;
+
+    hud_squares_shown_ = shown;
+    hud_squares_hidden_ = hidden;
+
+    QString text = QString("scene items     %1\n"
+                           "shown / s       %2\n"
+                           "hidden / s      %3\n"
+                           "new / piece     %4\n"
+                           "update_game     %5 us\n"
+                           "repaint         %6 us\n"
+                           "timer late      %7 ms\n"
+                           "event loop lag  %8 us\n"
+                           "rollbacks       %9 / %10 ticks\n"
+                           "bot depth       %11 / %12 nodes\n"
+                           "bot latency     %13 us / %14 late\n"
+                           "skipped frames  %15")
+            .arg(PerfCounters::get(PerfCounters::SCENE_ITEMS))
+            .arg(shown_rate, 0, 'f', 1)
+            .arg(hidden_rate, 0, 'f', 1)
+            .arg(PerfCounters::get(PerfCounters::ALLOCATIONS_LAST_PIECE))
+            .arg(PerfCounters::get(PerfCounters::UPDATE_GAME_NS) / 1000)
+            .arg(PerfCounters::get(PerfCounters::REPAINT_NS) / 1000)
+            .arg(PerfCounters::get(PerfCounters::TIMER_LATENESS_MS))
+            .arg(PerfCounters::get(PerfCounters::EVENT_LOOP_LAG_US))
+            .arg(PerfCounters::get(PerfCounters::ROLLBACKS))
+            .arg(PerfCounters::get(PerfCounters::RESIMULATED_TICKS))
+            .arg(PerfCounters::get(PerfCounters::BOT_DEPTH))
+            .arg(PerfCounters::get(PerfCounters::BOT_NODES))
+            .arg(PerfCounters::get(PerfCounters::BOT_LATENCY_US))
+            .arg(PerfCounters::get(PerfCounters::BOT_TIMEOUTS))
+            .arg(PerfCounters::get(PerfCounters::SKIPPED_FRAMES));
+
+    hud_label_->setText(text);
+}
+
+
+//*****************************************************************************
+// Functions related to spectators.
+
+void MainWindow::start_spectator_server(const QString& name)
+{
+    spectators_ = new SpectatorServer(this);
+
+    if (!spectators_->listen(name))
+    {
+        ui->game_message_label->setText("Cannot publish the game.");
+        return;
+    }
+
+    publish_game();
+}
+
+
+//*****************************************************************************
+// Functions related to versus mode.
+
+// Connect to the other game. The one who hosts chooses the seed when the
+// other joins.
+void MainWindow::start_versus(bool host, const QString& name)
+{
+    versus_link_ = new VersusLink(this);
+
+    connect(versus_link_, &VersusLink::message_received,
+            this, &MainWindow::receive_versus_message);
+    connect(versus_link_, &VersusLink::disconnected, this, [this]()
+    {
+        opponent_left_ = true;
+    });
+
+    if (host)
+    {
+        connect(versus_link_, &VersusLink::connected, this, [this]()
+        {
+            uint32_t seed = randomEng();
+
+            versus_link_->send(VersusLink::HELLO, 0, seed);
+            begin_versus(seed, 0);
+        });
+
+        if (!versus_link_->host(name))
+        {
+            ui->game_message_label->setText("Cannot host versus game.");
+            return;
+        }
+    }
+    else
+    {
+        versus_link_->join(name);
+    }
+
+    ui->start_game_push_button->setDisabled(true);
+    ui->game_message_label->setText("Waiting for the other player.");
+}
+
+void MainWindow::receive_versus_message(int type, uint32_t tick, uint64_t value)
+{
+    if (type == VersusLink::HELLO && !versus_)
+    {
+        begin_versus(uint32_t(value), 1);
+    }
+    else if (type == VersusLink::INPUT && versus_)
+    {
+        session_.add_remote_input(tick, uint8_t(value));
+    }
+    else if (type == VersusLink::CHECKSUM && versus_)
+    {
+        VersusSession::Checksum checksum;
+        checksum.tick = tick;
+        checksum.hash = value;
+
+        session_.add_remote_checksum(checksum);
+    }
+}
+
+// Start both games. The game is driven by the ticks of the session instead
+// of the dropping timer.
+void MainWindow::begin_versus(uint32_t seed, int local_player)
+{
+    initialize_game();
+
+    session_.start(seed, local_player);
+    versus_inputs_.clear();
+    versus_checksums_.reserve(4);
+
+    versus_ = true;
+    opponent_left_ = false;
+
+    // The replay of one player cannot play the versus game.
+    replay_complete_ = false;
+
+    drawn_next_ = -1;
+    drawn_hold_ = -1;
+    drawn_points_ = -1;
+
+    show_opponent_view();
+
+    // No single player controls during the versus game.
+    ui->start_game_push_button->setDisabled(true);
+    ui->fall_button->setDisabled(true);
+    ui->automatic_radio_button->setDisabled(true);
+    ui->manual_radio_button->setDisabled(true);
+    ui->name_edit_push_button->setDisabled(true);
+    ui->player_name_line_edit->setDisabled(true);
+
+    ui->game_message_label->setText(local_player == 0 ? "Versus game started. "
+                                                        "You host."
+                                                      : "Versus game started.");
+
+    game_started_ = true;
+    game_running_ = true;
+
+    playing_timer_.start(1000);
+    versus_timer_.start(VersusSession::TICK_MS);
+}
+
+// Give at most one key to the session, send it and the checksums, and
+// draw the games.
+void MainWindow::versus_tick()
+{
+    TRACE_SCOPE("versus_tick");
+
+    uint8_t input = VersusSession::NO_INPUT;
+
+    if (!versus_inputs_.empty())
+    {
+        input = uint8_t(versus_inputs_.front());
+    }
+
+    uint32_t tick = session_.current_tick();
+
+    if (session_.advance(input))
+    {
+        if (!versus_inputs_.empty())
+        {
+            versus_inputs_.pop_front();
+        }
+
+        versus_link_->send(VersusLink::INPUT, tick, input);
+    }
+    else if (opponent_left_ && !session_.is_finished())
+    {
+        // The inputs of the opponent stopped before the game ended.
+        ui->game_message_label->setText("The other player left.");
+        leave_versus();
+        return;
+    }
+
+    int resimulated = session_.synchronize();
+
+    if (resimulated > 0)
+    {
+        PerfCounters::add(PerfCounters::ROLLBACKS, 1);
+        PerfCounters::add(PerfCounters::RESIMULATED_TICKS, resimulated);
+    }
+
+    session_.take_checksums(versus_checksums_);
+
+    for (const VersusSession::Checksum& checksum : versus_checksums_)
+    {
+        versus_link_->send(VersusLink::CHECKSUM, checksum.tick, checksum.hash);
+    }
+
+    versus_checksums_.clear();
+
+    draw_versus(resimulated > 0);
+
+    if (session_.desync_tick() >= 0)
+    {
+        ui->game_message_label->setText(QString("Games out of sync at tick %1.")
+                                        .arg(session_.desync_tick()));
+        leave_versus();
+    }
+    else if (session_.is_finished())
+    {
+        finish_versus();
+    }
+}
+
+// Draw what changed in the local game since the last tick. After a
+// rollback the rows changed in the mispredicted ticks are not known, so
+// the whole board is drawn.
+void MainWindow::draw_versus(bool rolled_back)
+{
+    GameEngine& game = session_.engine(session_.local_player());
+
+    if (rolled_back)
+    {
+        game.set_all_rows_dirty();
+    }
+
+    engine_ = game;
+    game.take_dirty_rows();
+
+    draw_latest_state();
+    draw_opponent(session_.engine(session_.remote_player()));
+
+    publish_game();
+}
+
+// Draw engine_ over what was drawn from an earlier state of the same game.
+// Only the changed rows, squares and labels are touched, so the cost does
+// not depend on how many inputs were played in between.
+void MainWindow::draw_latest_state()
+{
+    draw_grid();
+
+    if (!engine_.is_piece_active())
+    {
+        if (curr_blocks_.at(0) != NULL)
+        {
+            release_current_tetromino();
+        }
+    }
+    else if (curr_blocks_.at(0) == NULL)
+    {
+        make_appear();
+    }
+    else
+    {
+        // A new tetromino may have appeared since the last tick.
+        const QBrush& brush = palette_brushes_.at(engine_.current().color);
+
+        for (QGraphicsRectItem* block : curr_blocks_)
+        {
+            if (block->brush() != brush)
+            {
+                block->setBrush(brush);
+            }
+        }
+
+        draw_current_tetromino();
+    }
+
+    int next = engine_.next().type * GameEngine::NUM_COLORS + engine_.next().color;
+
+    if (next != drawn_next_)
+    {
+        draw_next_tetromino();
+        drawn_next_ = next;
+    }
+
+    int hold = -1;
+
+    if (!engine_.is_hold_empty())
+    {
+        hold = engine_.hold().type * GameEngine::NUM_COLORS + engine_.hold().color;
+    }
+
+    if (hold != drawn_hold_)
+    {
+        if (hold < 0)
+        {
+            hold_arena_.reset();
+        }
+        else
+        {
+            draw_hold_tetromino();
+        }
+
+        drawn_hold_ = hold;
+    }
+
+    if (engine_.points() != drawn_points_)
+    {
+        update_player_score(GameEngine::NOTHING);
+        drawn_points_ = engine_.points();
+    }
+}
+
+// Show the empty opponent view. Made when it is first needed.
+void MainWindow::show_opponent_view()
+{
+    if (opponent_view_ == NULL)
+    {
+        opponent_scene_ = new QGraphicsScene(this);
+        opponent_view_ = new QGraphicsView(opponent_scene_, ui->centralWidget);
+
+        opponent_view_->setGeometry(LEFT_MARGIN_OPPONENT_VIEW,
+                                    TOP_MARGIN_OPPONENT_VIEW,
+                                    COLUMNS * OPPONENT_SQUARE_SIDE + 2,
+                                    ROWS * OPPONENT_SQUARE_SIDE + 2);
+
+        opponent_scene_->setSceneRect(0, 0, COLUMNS * OPPONENT_SQUARE_SIDE - 1,
+                                      ROWS * OPPONENT_SQUARE_SIDE - 1);
+
+        opponent_arena_.initialize(opponent_scene_, ROWS * COLUMNS,
+                                   OPPONENT_SQUARE_SIDE, BLACK_PEN);
+    }
+
+    opponent_arena_.reset();
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        opponent_grid_.at(row).fill(NULL);
+        opponent_cells_.at(row).fill(EMPTY_CELL);
+    }
+
+    opponent_view_->show();
+}
+
+// Draw the cells of the opponent view which changed, with the moving
+// tetromino of the opponent.
+void MainWindow::draw_opponent(const GameEngine& game)
+{
+    const Board& board = game.board();
+
+    std::array<std::array<uint8_t, COLUMNS>, ROWS> cells;
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        for (int col = 0; col < COLUMNS; ++col)
+        {
+            cells.at(row).at(col) = board.is_occupied(col, row)
+                    ? board.colors.at(row).at(col) : EMPTY_CELL;
+        }
+    }
+
+    if (game.is_piece_active())
+    {
+        const Piece& piece = game.current();
+
+        for (const Coord& c : piece.squares)
+        {
+            if (c.x >= 0 && c.x < COLUMNS && c.y >= 0 && c.y < ROWS)
+            {
+                cells.at(c.y).at(c.x) = piece.color;
+            }
+        }
+    }
+
+    for (int row = 0; row < ROWS; ++row)
+    {
+        for (int col = 0; col < COLUMNS; ++col)
+        {
+            uint8_t cell = cells.at(row).at(col);
+            uint8_t& drawn = opponent_cells_.at(row).at(col);
+
+            if (cell == drawn)
+            {
+                continue;
+            }
+
+            QGraphicsRectItem*& block = opponent_grid_.at(row).at(col);
+
+            if (cell == EMPTY_CELL)
+            {
+                opponent_arena_.release(block);
+                block = NULL;
+            }
+            else if (block == NULL)
+            {
+                block = opponent_arena_.acquire(palette_brushes_.at(cell));
+                block->setPos(col * OPPONENT_SQUARE_SIDE,
+                              row * OPPONENT_SQUARE_SIDE);
+            }
+            else
+            {
+                block->setBrush(palette_brushes_.at(cell));
+            }
+
+            drawn = cell;
+        }
+    }
+}
+
+// Show who won.
+void MainWindow::finish_versus()
+{
+    int winner = session_.winner();
+
+    if (winner < 0)
+    {
+        ui->game_message_label->setText("Versus game finish. Draw.");
+    }
+    else if (winner == session_.local_player())
+    {
+        ui->game_message_label->setText("Versus game finish. You win.");
+    }
+    else
+    {
+        ui->game_message_label->setText("Versus game finish. You lose.");
+    }
+
+    leave_versus();
+}
+
+// Stop the versus game. The connection stays open so the opponent still
+// gets the last inputs, and the single player game can be played again.
+void MainWindow::leave_versus()
+{
+    versus_timer_.stop();
+    playing_timer_.stop();
+
+    versus_ = false;
+    game_running_ = false;
+
+    ui->start_game_push_button->setText("Play again");
+    ui->start_game_push_button->setEnabled(true);
+    ui->automatic_radio_button->setEnabled(true);
+    ui->manual_radio_button->setEnabled(true);
+    ui->name_edit_push_button->setEnabled(true);
+    ui->player_name_line_edit->setEnabled(true);
+}
+
+
+//*****************************************************************************
+// Functions related to playing against the bot.
+
+// The mode is used from the next game.
+void MainWindow::set_game_mode(GameEngine::Mode mode)
+{
+    game_mode_ = mode;
+
+    if (!game_started_)
+    {
+        initialize_game();
+    }
+}
+
+void MainWindow::set_bot_weights(const BotWeights& weights)
+{
+    bot_worker_.set_weights(weights);
+}
+
+void MainWindow::enable_bot()
+{
+    bot_enabled_ = true;
+    bot_worker_.start();
+
+    ui->game_message_label->setText("Start the game to play against the bot.");
+}
+
+// The program plays instead of the bot of the game.
+void MainWindow::enable_external_bot(const QString& program)
+{
+    external_bot_ = new ExternalBot(this);
+
+    if (!external_bot_->start(program))
+    {
+        delete external_bot_;
+        external_bot_ = NULL;
+
+        ui->game_message_label->setText("Cannot start the bot program.");
+        return;
+    }
+
+    connect(external_bot_, &ExternalBot::stopped, this, [this]()
+    {
+        ui->game_message_label->setText("The bot program stopped.");
+    });
+
+    bot_enabled_ = true;
+
+    ui->game_message_label->setText("Start the game to play against the bot.");
+}
+
+// The plugin is called on this thread. It is loaded again before each
+// game if the file changed.
+void MainWindow::enable_bot_plugin(const QString& file_name)
+{
+    if (!bot_plugin_.load(file_name))
+    {
+        ui->game_message_label->setText("Cannot load the bot plugin. " +
+                                        bot_plugin_.error());
+        return;
+    }
+
+    use_bot_plugin_ = true;
+    bot_enabled_ = true;
+
+    ui->game_message_label->setText("Start the game to play against the bot.");
+}
+
+// The bot gets the seed of the player so both get the same tetrominos.
+void MainWindow::begin_bot()
+{
+    if (use_bot_plugin_ && !bot_plugin_.begin_game())
+    {
+        // Without the plugin every tetromino of the bot is dropped.
+        ui->game_message_label->setText("Cannot load the bot plugin. " +
+                                        bot_plugin_.error());
+    }
+
+    bot_engine_.reset(replay_.seed, replay_.mode);
+    bot_inputs_.clear();
+    bot_next_input_ = 0;
+    bot_move_started_ = false;
+    bot_move_ready_ = false;
+
+    // A reply still coming from the last game is ignored.
+    bot_request_id_ += 1;
+    bot_waiting_ = false;
+
+    show_opponent_view();
+    draw_opponent(bot_engine_);
+
+    bot_game_ = true;
+    bot_timer_.start(BOT_INPUT_INTERVAL);
+}
+
+// Give the bot one input at a time, so it plays at a speed the player can
+// follow. The search runs on the worker thread or in the bot program and
+// this only checks if the move is ready.
+void MainWindow::bot_tick()
+{
+    TRACE_SCOPE("bot_tick");
+
+    take_bot_replies();
+
+    if (!bot_engine_.is_piece_active())
+    {
+        bot_engine_.apply(GameEngine::SPAWN);
+
+        if (bot_engine_.is_over())
+        {
+            bot_timer_.stop();
+            bot_game_ = false;
+
+            if (bot_engine_.is_completed())
+            {
+                ui->game_message_label->setText("The bot finished the race first.");
+            }
+            else
+            {
+                ui->game_message_label->setText("The bot is out. You win.");
+            }
+        }
+        else
+        {
+            bot_inputs_.clear();
+            bot_next_input_ = 0;
+            bot_move_started_ = false;
+
+            // The move asked for ahead is only used if the game is the one
+            // it was asked for.
+            if ((!bot_waiting_ && !bot_move_ready_) ||
+                    bot_request_hash_ != bot_engine_.state_hash())
+            {
+                request_bot_move(bot_engine_);
+            }
+        }
+    }
+    else if (!bot_move_started_)
+    {
+        if (bot_move_ready_)
+        {
+            start_bot_move();
+        }
+        else if (!bot_waiting_)
+        {
+            // The bot could not be asked, so drop where it is.
+            bot_engine_.apply(GameEngine::HARD_FALL);
+            bot_engine_.apply(GameEngine::GRAVITY);
+        }
+    }
+    else if (bot_next_input_ < bot_inputs_.size())
+    {
+        bot_engine_.apply(bot_inputs_.at(bot_next_input_));
+        bot_next_input_ += 1;
+    }
+    else
+    {
+        // The move ended without locking, so drop where it is.
+        bot_engine_.apply(GameEngine::HARD_FALL);
+        bot_engine_.apply(GameEngine::GRAVITY);
+    }
+
+    draw_opponent(bot_engine_);
+}
+
+// Ask the plugin, the program or the worker for the move of the moving
+// tetromino of the game. The plugin answers at once.
+void MainWindow::request_bot_move(const GameEngine& game)
+{
+    int budget_ms = game.speed() * BOT_BUDGET_PERCENT / 100;
+
+    bot_request_hash_ = game.state_hash();
+    bot_move_ready_ = false;
+
+    if (use_bot_plugin_)
+    {
+        QElapsedTimer decide_clock;
+        decide_clock.start();
+
+        BotMove move;
+        bot_plugin_.decide(game, budget_ms, move);
+
+        PerfCounters::set(PerfCounters::BOT_LATENCY_US, decide_clock.nsecsElapsed() / 1000);
+
+        bot_ready_inputs_ = move.inputs();
+        bot_move_ready_ = true;
+        bot_waiting_ = false;
+        return;
+    }
+
+    BotWorker::Request request;
+    bot_request_id_ += 1;
+    request.id = bot_request_id_;
+    request.budget_ms = budget_ms;
+    game.save_state(request.state);
+
+    if (external_bot_ != NULL)
+    {
+        bot_waiting_ = external_bot_->post(request);
+    }
+    else
+    {
+        bot_waiting_ = bot_worker_.post(request);
+    }
+}
+
+void MainWindow::take_bot_replies()
+{
+    BotWorker::Reply reply;
+
+    while (external_bot_ != NULL ? external_bot_->take(reply) : bot_worker_.take(reply))
+    {
+        if (!bot_waiting_ || reply.id != bot_request_id_)
+        {
+            continue;
+        }
+
+        bot_ready_inputs_ = reply.move.inputs();
+        bot_move_ready_ = true;
+        bot_waiting_ = false;
+
+        PerfCounters::set(PerfCounters::BOT_DEPTH, reply.depth);
+        PerfCounters::set(PerfCounters::BOT_NODES, reply.nodes);
+    }
+}
+
+// The game after the move is played on a copy the way bot_tick plays it,
+// and the next tetromino is asked for at once. The bot searches it while
+// this move is shown.
+void MainWindow::start_bot_move()
+{
+    bot_inputs_.swap(bot_ready_inputs_);
+    bot_next_input_ = 0;
+    bot_move_ready_ = false;
+    bot_move_started_ = true;
+
+    GameEngine ahead = bot_engine_;
+
+    for (GameEngine::Input input : bot_inputs_)
+    {
+        if (!ahead.is_piece_active())
+        {
+            break;
+        }
+
+        ahead.apply(input);
+    }
+
+    if (ahead.is_piece_active())
+    {
+        ahead.apply(GameEngine::HARD_FALL);
+        ahead.apply(GameEngine::GRAVITY);
+    }
+
+    ahead.apply(GameEngine::SPAWN);
+
+    if (!ahead.is_over())
+    {
+        request_bot_move(ahead);
+    }
+}
+
+
+//*****************************************************************************
+// Functions related to the perfect clear hint.
+
+void MainWindow::toggle_perfect_clear_hints()
+{
+    perfect_clear_hints_ = !perfect_clear_hints_;
+
+    ui->game_message_label->setText(perfect_clear_hints_ ? "Perfect clear hints on."
+                                                         : "Perfect clear hints off.");
+}
+
+// The solver only knows the moving, next and hold tetrominos, so the hint
+// is shown when those are enough to clear the board.
+void MainWindow::show_perfect_clear_hint()
+{
+    if (!perfect_clear_hints_ || !engine_.is_piece_active())
+    {
+        return;
+    }
+
+    PerfectClearSolver::Solution solution = perfect_clear_.solve(engine_);
+
+    if (solution.status != PerfectClearSolver::FOUND)
+    {
+        return;
+    }
+
+    const PerfectClearSolver::Step& step = solution.steps.at(0);
+
+    for (int i = 0; i < NUM_SQUARE; ++i)
+    {
+        const Coord& c = step.piece.squares.at(i);
+
+        hint_blocks_.at(i) = add_square(hint_brush_);
+        hint_blocks_.at(i)->setPos(c.x * SQUARE_SIDE, c.y * SQUARE_SIDE);
+    }
+
+    QString message = QString("Perfect clear with %1 tetrominos.")
+            .arg(solution.steps.size());
+
+    if (step.hold)
+    {
+        message += " Hold first.";
+    }
+
+    ui->game_message_label->setText(message);
+}
+
+
+//*****************************************************************************
+// Functions related to the replay viewer.
+
+// Open the replay and start playing it at normal speed. A .replay file is
+// made into an archive in memory so both kinds can seek.
+bool MainWindow::open_replay(const QString& file_name)
+{
+    std::string name = file_name.toStdString();
+    bool read = false;
+
+    viewer_bytes_.clear();
+
+    if (file_name.endsWith(".rpa"))
+    {
+        read = ReplayArchive::read(name, viewer_bytes_);
+    }
+    else
+    {
+        Replay replay;
+        read = replay.read(name) &&
+                ReplayArchive::encode(replay, ReplayArchive::DEFAULT_KEYFRAME_PIECES,
+                                      viewer_bytes_);
+    }
+
+    if (!read || !viewer_view_.open(viewer_bytes_.data(), viewer_bytes_.size()))
+    {
+        ui->game_message_label->setText("Cannot open replay.");
+        return false;
+    }
+
+    // Ticks of the pieces, found once so stepping does not play the game.
+    ReplayArchiveView::Cursor cursor;
+    GameEngine::Input input;
+
+    viewer_spawns_.clear();
+    viewer_view_.restore(0, viewer_engine_, cursor);
+
+    for (uint32_t tick = cursor.tick(); cursor.next(input); tick = cursor.tick())
+    {
+        if (input == GameEngine::SPAWN)
+        {
+            viewer_spawns_.push_back(tick);
+        }
+    }
+
+    initialize_game();
+
+    if (viewer_slider_ == NULL)
+    {
+        int top = TOP_MARGIN_PLAYING_VIEW + BORDER_DOWN_PLAYING_VIEW + 8;
+
+        viewer_slider_ = new QSlider(Qt::Horizontal, ui->centralWidget);
+        viewer_slider_->setGeometry(LEFT_MARGIN_PLAYING_VIEW, top,
+                                    BORDER_RIGHT_PLAYING_VIEW + 2, 20);
+
+        // Keys stay with the window for the controls of the viewer.
+        viewer_slider_->setFocusPolicy(Qt::NoFocus);
+
+        // Moved by the player. Values set while playing are the tick
+        // already drawn.
+        connect(viewer_slider_, &QSlider::valueChanged, this, [this](int value)
+        {
+            if (viewer_ && uint32_t(value) != viewer_tick_)
+            {
+                seek_viewer(value);
+            }
+        });
+
+        viewer_label_ = new QLabel(ui->centralWidget);
+        viewer_label_->setGeometry(LEFT_MARGIN_PLAYING_VIEW, top + 22,
+                                   BORDER_RIGHT_PLAYING_VIEW + 2, 20);
+    }
+
+    viewer_ = true;
+    viewer_slider_->setRange(0, viewer_view_.num_ticks());
+    viewer_slider_->show();
+    viewer_label_->show();
+
+    // No game controls while watching.
+    ui->start_game_push_button->setDisabled(true);
+    ui->fall_button->setDisabled(true);
+    ui->automatic_radio_button->setDisabled(true);
+    ui->manual_radio_button->setDisabled(true);
+    ui->name_edit_push_button->setDisabled(true);
+    ui->player_name_line_edit->setDisabled(true);
+
+    ui->game_message_label->setText(QFileInfo(file_name).fileName());
+
+    drawn_next_ = -1;
+    drawn_hold_ = -1;
+    drawn_points_ = -1;
+
+    viewer_speed_ = VIEWER_NORMAL_SPEED;
+    viewer_paused_ = true;
+
+    seek_viewer(0);
+    toggle_viewer_pause();
+
+    return true;
+}
+
+// Play the inputs whose time came since the last refresh and draw only the
+// state after the last one.
+void MainWindow::viewer_tick()
+{
+    TRACE_SCOPE("viewer_tick");
+
+    qint64 elapsed = std::min<qint64>(viewer_clock_.restart(), VIEWER_MAX_ELAPSED_MS);
+
+    viewer_time_ms_ += elapsed * VIEWER_SPEEDS.at(viewer_speed_);
+
+    int played = 0;
+
+    while (true)
+    {
+        if (!viewer_has_input_)
+        {
+            if (!viewer_cursor_.next(viewer_input_))
+            {
+                // End of the replay.
+                toggle_viewer_pause();
+                break;
+            }
+
+            viewer_has_input_ = true;
+        }
+
+        int input_ms = viewer_input_ms(viewer_input_);
+
+        if (input_ms > viewer_time_ms_)
+        {
+            break;
+        }
+
+        viewer_time_ms_ -= input_ms;
+        viewer_engine_.apply(viewer_input_);
+        viewer_has_input_ = false;
+        viewer_tick_ += 1;
+        played += 1;
+    }
+
+    if (played > 0)
+    {
+        PerfCounters::add(PerfCounters::SKIPPED_FRAMES, played - 1);
+        draw_viewer();
+    }
+}
+
+// Time the input takes in the game shown by the viewer.
+int MainWindow::viewer_input_ms(GameEngine::Input input) const
+{
+    if (input == GameEngine::GRAVITY)
+    {
+        return viewer_engine_.speed();
+    }
+
+    if (input == GameEngine::SPAWN)
+    {
+        return 0;
+    }
+
+    return VIEWER_KEY_MS;
+}
+
+void MainWindow::draw_viewer()
+{
+    TRACE_SCOPE("draw_viewer");
+
+    engine_ = viewer_engine_;
+    viewer_engine_.take_dirty_rows();
+
+    draw_latest_state();
+    publish_game();
+
+    viewer_slider_->setValue(viewer_tick_);
+    show_viewer_status();
+}
+
+// Speed, piece and tick below the seek bar.
+void MainWindow::show_viewer_status()
+{
+    size_t piece = std::lower_bound(viewer_spawns_.begin(), viewer_spawns_.end(),
+                                    viewer_tick_) - viewer_spawns_.begin();
+
+    QString status = QString("%1x  piece %2/%3  tick %4/%5")
+            .arg(VIEWER_SPEEDS.at(viewer_speed_))
+            .arg(piece).arg(viewer_spawns_.size())
+            .arg(viewer_tick_).arg(viewer_view_.num_ticks());
+
+    if (viewer_paused_)
+    {
+        status += "  paused";
+    }
+
+    viewer_label_->setText(status);
+}
+
+// Show the game at the tick. The whole board is drawn, since the rows
+// changed between the two ticks are not known.
+void MainWindow::seek_viewer(uint32_t tick)
+{
+    tick = std::min(tick, viewer_view_.num_ticks());
+
+    if (!viewer_view_.seek(tick, viewer_engine_, viewer_cursor_))
+    {
+        ui->game_message_label->setText("Replay is broken.");
+        return;
+    }
+
+    viewer_tick_ = tick;
+    viewer_has_input_ = false;
+    viewer_time_ms_ = 0;
+
+    viewer_engine_.set_all_rows_dirty();
+    draw_viewer();
+}
+
+// Pause and show the game just after the next or the previous tetromino
+// appeared.
+void MainWindow::step_viewer(bool forward)
+{
+    if (!viewer_paused_)
+    {
+        toggle_viewer_pause();
+    }
+
+    uint32_t tick = 0;
+
+    if (forward)
+    {
+        auto next = std::lower_bound(viewer_spawns_.begin(), viewer_spawns_.end(),
+                                     viewer_tick_);
+
+        tick = next == viewer_spawns_.end() ? viewer_view_.num_ticks() : *next + 1;
+    }
+    else if (viewer_tick_ > 1)
+    {
+        auto next = std::lower_bound(viewer_spawns_.begin(), viewer_spawns_.end(),
+                                     viewer_tick_ - 1);
+
+        tick = next == viewer_spawns_.begin() ? 0 : *(next - 1) + 1;
+    }
+
+    seek_viewer(tick);
+}
+
+void MainWindow::set_viewer_speed(int index)
+{
+    viewer_speed_ = std::max(0, std::min<int>(index, VIEWER_SPEEDS.size() - 1));
+    show_viewer_status();
+}
+
+// Pause or play the replay. Playing at the end starts it again.
+void MainWindow::toggle_viewer_pause()
+{
+    viewer_paused_ = !viewer_paused_;
+    viewer_time_ms_ = 0;
+
+    if (viewer_paused_)
+    {
+        viewer_timer_.stop();
+    }
+    else
+    {
+        if (viewer_tick_ >= viewer_view_.num_ticks())
+        {
+            seek_viewer(0);
+        }
+
+        viewer_clock_.start();
+        viewer_timer_.start(VIEWER_REFRESH_MS);
+    }
+
+    show_viewer_status();
+}
+
+// Stop watching and set up a new game.
+void MainWindow::leave_viewer()
+{
+    viewer_timer_.stop();
+    viewer_ = false;
+
+    viewer_slider_->hide();
+    viewer_label_->hide();
+
+    viewer_bytes_.clear();
+    viewer_bytes_.shrink_to_fit();
+
+    initialize_game();
+
+    ui->game_message_label->setText("Replay closed.");
+}
@@ -6,61 +6,68 @@
 #include <random>
 #include <QTimer>
 #include <QGraphicsRectItem>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QGraphicsView>
+#include <QSlider>
+#include <array>
+#include <deque>
+#include "blockarena.hh"
+#include "botplugin.hh"
+#include "botworker.hh"
+#include "externalbot.hh"
+#include "finesse.hh"
+#include "gameengine.hh"
+#include "palette.hh"
+#include "perfectclear.hh"
+#include "replay.hh"
+#include "replayarchive.hh"
+#include "rewindbuffer.hh"
+#include "spectatorserver.hh"
+#include "versuslink.hh"
+#include "versussession.hh"
 
 namespace Ui {
 class MainWindow;
 }
 
-// Coordinates of each squares in tetromino or in the grid with x axis
-// is to the right and y direction is to below.
-struct Coord
+class MainWindow : public QMainWindow
 {
-    int x = 0;
-    int y = 0;
-
-    Coord():
-        x(0), y(0)
-    {
-    }
-
-    Coord(int p_x, int p_y):
-        x(p_x), y(p_y)
-    {
-    }
-};
+    Q_OBJECT
 
-// The square in each tetromino or in the grid.
-struct Square
-{
-    // Displaying square on window.
-    QGraphicsRectItem* block = NULL;
+public:
+    explicit MainWindow(QWidget *parent = 0);
+    ~MainWindow();
+    void keyPressEvent(QKeyEvent* event) override;
+    bool eventFilter(QObject* watched, QEvent* event) override;
 
-    // Position of the square.
-    Coord pos = Coord();
-};
+    // Play against another game on the same machine. The one who hosts
+    // waits for the other to join with the same name.
+    void start_versus(bool host, const QString& name);
 
+    // Publish the game to viewers which connect to the name.
+    void start_spectator_server(const QString& name);
 
-// Tetromino information
-struct Tetromino
-{
-    int type = 0;
+    // Play the next games against a bot with the same tetrominos.
+    void enable_bot();
 
-    // Squares in tetromino.
-    std::vector<Square> squares = std::vector<Square>(4, Square());
+    // Weights of the bot, set before enable_bot.
+    void set_bot_weights(const BotWeights& weights);
 
-    // Color of tetromino.
-    QColor color = Qt::white;
-};
+    // Play the next games against a bot program instead of the bot of the
+    // game. The protocol is in externalbot.hh.
+    void enable_external_bot(const QString& program);
 
+    // Play the next games against a bot plugin with the interface of
+    // botpluginabi.h.
+    void enable_bot_plugin(const QString& file_name);
 
-class MainWindow : public QMainWindow
-{
-    Q_OBJECT
+    // Play the next games as a race.
+    void set_game_mode(GameEngine::Mode mode);
 
-public:
-    explicit MainWindow(QWidget *parent = 0);
-    ~MainWindow();
-    void keyPressEvent(QKeyEvent* event) override;
+    // Watch a .replay or .rpa file instead of playing. Returns false if
+    // the file cannot be read.
+    bool open_replay(const QString& file_name);
 
 private slots:
 
@@ -70,45 +77,35 @@ private slots:
     void clear_scene();
 
     // Functions related to status of the game.
-    void update_game();
-    void update_grid();
-    int remove_full_row();
-    void move_grid_down(int num_row_remove, int lowest_row_remove);
+    int apply_input(GameEngine::Input input);
+    void update_game(int result);
+    void draw_grid();
     void continue_game();
-    bool is_over();
     void finish_game();
+    void save_replay();
     void pause_game();
     void quit_game();
+    void save_snapshot();
+    void restore_snapshot();
+    void store_rewind_point();
+    void rewind_game();
+    void publish_game();
 
     // Function related to player information.
     void set_player_name();
-    int calculate_point(int num_row_remove, int num_turn);
-    void update_player_score(int num_row_remove);
-    void update_level();
+    void update_player_score(int result);
 
-    // Functions related to generate and display tetromino.
-    void make_new_tetromino();
-    void set_appear_position();
+    // Functions related to display tetromino.
     void make_appear();
-    void make_appear_over();
+    void show_new_tetromino();
+    void release_current_tetromino();
+    void draw_current_tetromino();
     void draw_next_tetromino();
-
-    // Functions related to condition of moving of tetromino.
-    bool can_move_down();
-    bool can_move_left();
-    bool can_move_right();
+    void draw_hold_tetromino();
 
     // Functions related to move tetromino.
     void make_drop_down_automatic();
-    void move_left();
-    void move_right();
-    void move_down();
-    void move_soft_fall();
-    void move_hard_fall();
-    bool rotation_calculation();
-    void rotate_counterclockwise();
-    bool reflect_calculation();
-    void reflect_vertical_axis();
+    void move_tetromino(GameEngine::Input input);
     void exchange_tetromino();
 
     // Functions related to button on main window.
@@ -129,6 +126,46 @@ private slots:
 
     // Function related to playing time.
     void display_playing_time();
+    void start_drop_timer();
+
+    // Functions related to the performance HUD.
+    QGraphicsRectItem* add_square(const QBrush& brush);
+    void remove_square(QGraphicsRectItem* block);
+    void toggle_hud();
+    void update_hud();
+
+    // Functions related to versus mode.
+    void receive_versus_message(int type, uint32_t tick, uint64_t value);
+    void begin_versus(uint32_t seed, int local_player);
+    void versus_tick();
+    void draw_versus(bool rolled_back);
+    void draw_latest_state();
+    void show_opponent_view();
+    void draw_opponent(const GameEngine& game);
+    void finish_versus();
+    void leave_versus();
+
+    // Functions related to playing against the bot.
+    void begin_bot();
+    void bot_tick();
+    void request_bot_move(const GameEngine& game);
+    void take_bot_replies();
+    void start_bot_move();
+
+    // Functions related to the perfect clear hint.
+    void toggle_perfect_clear_hints();
+    void show_perfect_clear_hint();
+
+    // Functions related to the replay viewer.
+    void viewer_tick();
+    int viewer_input_ms(GameEngine::Input input) const;
+    void draw_viewer();
+    void show_viewer_status();
+    void seek_viewer(uint32_t tick);
+    void step_viewer(bool forward);
+    void set_viewer_speed(int index);
+    void toggle_viewer_pause();
+    void leave_viewer();
 
 
 private:
@@ -145,8 +182,8 @@ private:
     // Position of the playing area.
     const int LEFT_MARGIN_PLAYING_VIEW = 100;
     const int TOP_MARGIN_PLAYING_VIEW = 150;
-    const int BORDER_DOWN_PLAYING_VIEW = 480;
-    const int BORDER_RIGHT_PLAYING_VIEW = 240;
+    static constexpr int BORDER_DOWN_PLAYING_VIEW = 480;
+    static constexpr int BORDER_RIGHT_PLAYING_VIEW = 240;
 
     // Position display of next tetromino.
     const int LEFT_MARGIN_NEXT_VIEW = 226;
@@ -179,128 +216,81 @@ private:
     const int BORDER_DOWN_TETRIS_LABEL = 60;
 
     // Size of a tetromino component
-    const int SQUARE_SIDE = 20;
+    static constexpr int SQUARE_SIDE = 20;
 
     // numver of square in each tetromino.
-    const int NUM_SQUARE = 4;
+    static constexpr int NUM_SQUARE = GameEngine::NUM_SQUARE;
 
     // Number of horizontal cells (places for tetromino components)
-    const int COLUMNS = BORDER_RIGHT_PLAYING_VIEW / SQUARE_SIDE;
+    static constexpr int COLUMNS = BORDER_RIGHT_PLAYING_VIEW / SQUARE_SIDE;
     // Number of vertical cells (places for tetromino components)
-    const int ROWS = BORDER_DOWN_PLAYING_VIEW / SQUARE_SIDE;
-
-    // Constants for different tetrominos and the number of them
-    enum Tetromino_kind {HORIZONTAL,
-                         LEFT_CORNER,
-                         RIGHT_CORNER,
-                         SQUARE,
-                         STEP_UP_RIGHT,
-                         PYRAMID,
-                         STEP_UP_LEFT,
-                         NUMBER_OF_TETROMINOS};
-    // From the enum values above, only the last one is needed in this template.
-    // Recall from enum type that the value of the first enumerated value is 0,
-    // the second is 1, and so on.
-    // Therefore the value of the last one is 7 at the moment.
-    // Remove those tetromino kinds above that you do not implement,
-    // whereupon the value of NUMBER_OF_TETROMINOS changes, too.
-    // You can also remove all the other values, if you do not need them,
-    // but most probably you need a constant value for NUMBER_OF_TETROMINOS.
+    static constexpr int ROWS = BORDER_DOWN_PLAYING_VIEW / SQUARE_SIDE;
 
+    static_assert(COLUMNS == GameEngine::COLUMNS, "Playing area must fit the board");
+    static_assert(ROWS == GameEngine::ROWS, "Playing area must fit the board");
 
-    //*************************************************************************
-    // For randomly selecting the next dropping tetromino
-    std::default_random_engine randomEng;
-    std::uniform_int_distribution<int> distr;
 
     //*************************************************************************
-    // Information about the shape of tetrominos when tetromino is place in the
-    // upper left corner of the grid ant x axis direction is to the right and
-    // y axis direction is to the bottom.
-
-    // Index of position int the grid of each square in each interomino.
-    const std::vector<Coord> horizotal_tetro = {Coord(0, 0), Coord(1, 0),
-                                                Coord(2, 0), Coord(3, 0)};
-
-    const std::vector<Coord> left_corner_tetro = {Coord(0, 0), Coord(0, 1),
-                                                  Coord(1, 1), Coord(2, 1)};
-
-    const std::vector<Coord> right_corner_tetro = {Coord(0, 1), Coord(1, 1),
-                                                   Coord(2, 1), Coord(2, 0)};
-
-    const std::vector<Coord> square_tetro = {Coord(0, 0), Coord(0, 1),
-                                             Coord(1, 1), Coord(1, 0)};
-
-    const std::vector<Coord> step_up_right_tetro = {Coord(0, 1), Coord(1, 1),
-                                                    Coord(1, 0), Coord(2, 0)};
+    // For randomly selecting the seed of each game.
+    std::default_random_engine randomEng;
 
-    const std::vector<Coord> pyramid_tetro = {Coord(0, 1), Coord(1, 1),
-                                              Coord(1, 0), Coord(2, 1)};
 
-    const std::vector<Coord> step_up_left_tetro = {Coord(0, 0), Coord(1, 0),
-                                                   Coord(1, 1), Coord(2, 1)};
+    //*************************************************************************
+    // Constant related to the scoreboard.
 
+    // File name to get the highest scores.
+    // Remeber to build the proram in the same folder of this file.
+    const std::string HIGHEST_SCORES_FILE = "highest_scores.txt";
 
-    // Collect all information to one place.
-    const std::vector<std::vector<Coord>> COORD_INFO = {horizotal_tetro,
-                                                left_corner_tetro, right_corner_tetro,
-                                                square_tetro, step_up_right_tetro,
-                                                pyramid_tetro, step_up_left_tetro};
+    const int HIGHEST_SCORES_DISPLAY_NUM = 3;
 
-    // Information about the outer most postion of each tetromino in each
-    // direction when the tetromino is place in the position specified in the
-    // comment above.
-    const std::vector<int> BOTTOM_INFO = {0, 1, 1, 1, 1, 1, 1};
-    const std::vector<int> LEFT_INFO = {0, 0, 0, 0, 0, 0, 0};
-    const std::vector<int> RIGHT_INFO = {3, 2, 2, 1, 2, 2, 2};
-    const std::vector<int> UP_INFO = {0, 0, 0, 0, 0, 0, 0};
+    // Folder where finished games are recorded.
+    const std::string RECORDED_GAMES_DIRECTORY = "recorded_games";
 
+    // Game which is not finished when the program is closed.
+    const std::string SAVED_GAME_FILE = "saved_game.snapshot";
 
     //*************************************************************************
-    // Information about the level in the game. There are are six levels.
-
-    // Number of levels in the game.
-    const int NUM_LEVELS = 8;
-
-    // The score player need to upgrade to the next level.
-    const std::vector<int> LEVEL_THRESHOLD = {5000, 50000, 100000, 150000, 200000,
-                                              300000, 400000, 500000};
+    // Other constant.
 
-    // Number of color of tetromino in each level.
-    int NUM_CORLOR_IN_LEVEL = 5;
+    // Border for square in tetromino and in grid.
+    const QPen BLACK_PEN = QPen(Qt::black);
 
-    // The color of tetromino is change for each level.
-    const std::vector<std::vector<QString>> COLOR_CODE_SET =
-    {{"#0444BF", "#0584F2", "#0AAFF1", "#EDF259", "#A79674"},
-    {"#04060F", "#03353E", "#0294A5", "#A79C93", "#C1403D"},
-    {"#BE3B45", "#F07995", "#F3F1F3", "#A58E87", "#BE302B"},
-    {"#A4A4BF", "#16235A", "#2A3457", "#888C46", "#F2EAED"},
-    {"#E0E8F0", "#51A2D9", "#53C0F0", "#B9E5F3", "#8A140E"},
-    {"#55D9C0", "#C7F6EC", "#107050", "#02231C", "#4DD8AD"},
-    {"#BD3E85", "#182657", "#121F40", "#D59B2D", "#8D541E"},
-    {"#C2D3DA", "#81A3A7", "#585A56", "#F1F3F2", "#272424"}};
+    // Refresh interval of the performance HUD in millisecond.
+    const int HUD_INTERVAL = 500;
 
-    // The droping speed of tetromino in the first level.
-    const int STARTING_SPEED = 650;
+    // Position display of the game of the opponent in versus mode.
+    const int LEFT_MARGIN_OPPONENT_VIEW = 700;
+    const int TOP_MARGIN_OPPONENT_VIEW = 320;
+    static constexpr int OPPONENT_SQUARE_SIDE = 10;
 
+    // Cell of the opponent view without a square.
+    static constexpr uint8_t EMPTY_CELL = 0xFF;
 
-    //*************************************************************************
-    // Constant related to the scoreboard.
+    // Time between the inputs of the bot in millisecond.
+    const int BOT_INPUT_INTERVAL = 60;
 
-    // File name to get the highest scores.
-    // Remeber to build the proram in the same folder of this file.
-    const std::string HIGHEST_SCORES_FILE = "highest_scores.txt";
+    // Time the bot searches the move of each tetromino, in percent of the
+    // time the tetromino takes to fall one row. Faster levels give the bot
+    // less time, as they give the player.
+    const int BOT_BUDGET_PERCENT = 25;
 
-    const int HIGHEST_SCORES_DISPLAY_NUM = 3;
+    // The replay viewer draws the latest state once in each refresh of the
+    // display, however many inputs were played since the last one.
+    const int VIEWER_REFRESH_MS = 16;
 
-    //*************************************************************************
-    // Other constant.
+    // Time after which a late refresh stops catching up, so a stalled
+    // window does not jump far ahead at high speeds.
+    const int VIEWER_MAX_ELAPSED_MS = 100;
 
-    // Border for square in tetromino and in grid.
-    const QPen BLACK_PEN = QPen(Qt::black);
+    // Time shown for each key of the player. Replays do not record when the
+    // keys were pressed, only the gravity has a known time.
+    const int VIEWER_KEY_MS = 50;
 
-    // Move down six square if possible in soft fall movement.
-    const int MOVE_SOFT = 6;
+    // Speeds of the replay viewer, multiples of the time of the game.
+    static constexpr std::array<double, 10> VIEWER_SPEEDS =
+        { 0.25, 0.5, 1, 2, 4, 10, 30, 100, 300, 1000 };
+    const int VIEWER_NORMAL_SPEED = 2;
 
     //*************************************************************************
 
@@ -320,38 +310,68 @@ private:
     int second_ = 0;
     int hour_ = 0;
 
+    // Time since the dropping timer was started or last timed out.
+    QElapsedTimer drop_clock_;
+
     //*******************************************
-    // Tetrominos related attributes.
+    // Game related attributes.
+
+    // Rules and state of the game.
+    GameEngine engine_;
+
+    // Inputs of the current game for recording it.
+    Replay replay_;
+
+    // False when the game was restored from a snapshot and the replay does
+    // not have the inputs from the start.
+    bool replay_complete_ = true;
 
-    // Tetromino moved by the player.
-    Tetromino curr_tetro_;
+    // Keys of the player compared with the fewest keys for each tetromino.
+    FinesseAnalyzer finesse_;
 
-    // Infomation of moved tetromino get from
-    // the information specified above.
-    int bottom_;
-    int left_;
-    int right_;
-    int up_;
+    // States after the last locks for undo.
+    RewindBuffer rewind_;
 
-    // Next tetromino droped.
-    Tetromino next_tetro_;
+    // The game was rewound. Its points do not go to the high scores and
+    // its replay claims no result.
+    bool practice_ = false;
 
-    // Hold tetromino.
-    Tetromino hold_tetro_;
+    // Viewers of the game on other displays. NULL if not published.
+    SpectatorServer* spectators_ = NULL;
+
+    //*******************************************
+    // Tetrominos related attributes.
+
+    // Squares of the moving tetromino.
+    std::array<QGraphicsRectItem*, NUM_SQUARE> curr_blocks_ = {};
+
+    // Brushes made once from Palette so drawing tetrominos
+    // does not allocate. Indexed by the palette index of the engine.
+    std::array<QBrush, GameEngine::NUM_COLORS> palette_brushes_;
+
+    // Squares showing where the moving tetromino goes for a perfect clear.
+    std::array<QGraphicsRectItem*, NUM_SQUARE> hint_blocks_ = {};
+    QBrush hint_brush_;
 
     //*******************************************
     // Attribute of the grid of playing area.
-    std::vector<std::vector<Square>> grid_;
+    std::array<std::array<QGraphicsRectItem*, COLUMNS>, ROWS> grid_ = {};
+
+    // All squares drawn in the playing area, next and hold scenes
+    // are taken from here. Reset in initialize_game.
+    BlockArena block_arena_;
+    BlockArena next_arena_;
+    BlockArena hold_arena_;
 
     //*******************************************
     // Control game related attributes.
 
     bool game_started_ = false;
     bool game_running_ = false;
-    bool game_over_ = false;
     bool play_automatic_ = true;
-    bool can_hold_ = true;
-    bool is_hold_empty_ = true;
+
+    // Mode of the next game, set from the command line.
+    GameEngine::Mode game_mode_ = GameEngine::NORMAL;
 
     //*******************************************
     // Attributes related to player.
@@ -359,16 +379,6 @@ private:
     // For storing point and update level.
     std::string player_name_ = "";
 
-    // Calculate and store points.
-    int playing_level_ = 0;
-    int playing_points_ = 0;
-    int total_lines_removed_ = 0;
-    int tetris_points_ = 0;
-    int num_turn_ = 0;
-
-    // Change by each level.
-    int playing_speed_ = 0;
-
 
     //*******************************************
     // Scoreboards related attribute.
@@ -379,6 +389,141 @@ private:
     // the second part of second element is time of playing in second.
     std::vector<std::pair<std::string, std::pair<int, int>>> score_board_;
 
+    //*******************************************
+    // Performance HUD related attributes.
+
+    QLabel* hud_label_;
+    QTimer hud_timer_;
+
+    // Counter values at the previous HUD refresh for per second rates.
+    QElapsedTimer hud_clock_;
+    int64_t hud_squares_shown_ = 0;
+    int64_t hud_squares_hidden_ = 0;
+
+    // Heap allocations counter when the last tetromino was locked.
+    int64_t allocations_at_lock_ = 0;
+
+    // Set while the playing area paint event is being timed.
+    bool timing_paint_ = false;
+
+    //*******************************************
+    // Versus mode related attributes.
+
+    bool versus_ = false;
+
+    // Both games and the rollback. engine_ is a copy of the local game
+    // made for drawing.
+    VersusSession session_;
+    VersusLink* versus_link_ = NULL;
+
+    // Set when the connection closed. The game still ends normally if the
+    // inputs of the opponent reached the end of the game.
+    bool opponent_left_ = false;
+
+    // Ticks of the session.
+    QTimer versus_timer_;
+
+    // Keys pressed but not yet given to a tick, one input per tick.
+    std::deque<GameEngine::Input> versus_inputs_;
+
+    std::vector<VersusSession::Checksum> versus_checksums_;
+
+    // Next, hold and score drawn last, to draw only what changed.
+    // -1 when nothing is drawn.
+    int drawn_next_ = -1;
+    int drawn_hold_ = -1;
+    int drawn_points_ = -1;
+
+    // Game of the opponent. Made when the first versus game starts.
+    QGraphicsScene* opponent_scene_ = NULL;
+    QGraphicsView* opponent_view_ = NULL;
+    BlockArena opponent_arena_;
+    std::array<std::array<QGraphicsRectItem*, COLUMNS>, ROWS> opponent_grid_ = {};
+
+    // Palette index drawn in each cell of the opponent view.
+    std::array<std::array<uint8_t, COLUMNS>, ROWS> opponent_cells_ = {};
+
+    //*******************************************
+    // Bot related attributes.
+
+    bool bot_enabled_ = false;
+
+    // True while the bot plays the current game.
+    bool bot_game_ = false;
+
+    // Game of the bot. Played on this thread, only the search is on the
+    // thread of bot_worker_.
+    GameEngine bot_engine_;
+    BotWorker bot_worker_;
+    QTimer bot_timer_;
+
+    // Program playing instead of the bot of the game. NULL if none.
+    ExternalBot* external_bot_ = NULL;
+
+    // Plugin playing instead of the bot of the game, if used.
+    BotPlugin bot_plugin_;
+    bool use_bot_plugin_ = false;
+
+    // Inputs of the move of the bot and the next one to give.
+    std::vector<GameEngine::Input> bot_inputs_;
+    size_t bot_next_input_ = 0;
+    bool bot_move_started_ = false;
+
+    // Move received for the last request, not started yet.
+    std::vector<GameEngine::Input> bot_ready_inputs_;
+    bool bot_move_ready_ = false;
+
+    // Id of the last request. Replies to older requests are ignored.
+    uint32_t bot_request_id_ = 0;
+    bool bot_waiting_ = false;
+
+    // Hash of the game the last request was made from.
+    uint64_t bot_request_hash_ = 0;
+
+    //*******************************************
+    // Perfect clear hint related attributes.
+
+    bool perfect_clear_hints_ = false;
+    PerfectClearSolver perfect_clear_;
+
+    //*******************************************
+    // Replay viewer related attributes.
+
+    bool viewer_ = false;
+
+    // Archive of the replay watched, and the game played from it. engine_
+    // is a copy of it made for drawing.
+    std::vector<uint8_t> viewer_bytes_;
+    ReplayArchiveView viewer_view_;
+    ReplayArchiveView::Cursor viewer_cursor_;
+    GameEngine viewer_engine_;
+
+    // Inputs given to viewer_engine_.
+    uint32_t viewer_tick_ = 0;
+
+    // Next input, taken from the cursor but not yet played because its
+    // time has not come.
+    GameEngine::Input viewer_input_ = GameEngine::SPAWN;
+    bool viewer_has_input_ = false;
+
+    // Time of the game which can still be played before the next refresh,
+    // in millisecond.
+    double viewer_time_ms_ = 0;
+
+    // Ticks of the SPAWN inputs, for stepping from piece to piece.
+    std::vector<uint32_t> viewer_spawns_;
+
+    int viewer_speed_ = 0;
+    bool viewer_paused_ = false;
+
+    QTimer viewer_timer_;
+    QElapsedTimer viewer_clock_;
+
+    // Seek bar and position below the playing area. Made when the first
+    // replay is opened.
+    QSlider* viewer_slider_ = NULL;
+    QLabel* viewer_label_ = NULL;
+
 };
 
 #endif // MAINWINDOW_HH
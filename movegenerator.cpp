@@ -0,0 +1,499 @@
+#include "movegenerator.hh"
+#include <algorithm>
+
+namespace
+{
+
+// Where the turns of every orientation are measured. Every orientation
+// turns there on an empty board without reaching the walls.
+const int REFERENCE_X = 4;
+const int REFERENCE_Y = 8;
+
+// Columns of a mask moved to the right, or to the left if negative.
+// Columns moved out of the board are lost.
+uint16_t shifted(uint16_t mask, int delta_x)
+{
+    return delta_x < 0 ? mask >> -delta_x : uint16_t(mask << delta_x);
+}
+
+// Tetromino in the orientation with the upper left corner of its box at
+// (x, y).
+Piece placed_piece(int type, int color, int orientation, int x, int y)
+{
+    const PieceSet::Orientation& o =
+            PieceSet::tetrominos().shape(type).orientations.at(orientation);
+
+    Piece piece;
+    piece.type = type;
+    piece.color = color;
+
+    for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+    {
+        piece.squares.at(i) = Coord(o.cells.at(i).x + x, o.cells.at(i).y + y);
+    }
+
+    piece.update_extent();
+
+    return piece;
+}
+
+}
+
+template <typename Rules>
+void MoveGenerator<Rules>::generate(const Board& board, int type, int color)
+{
+    num_searches_ = 0;
+    placements_.clear();
+
+    Piece appear = GameCoreBase::make_piece(type, color);
+
+    if (!GameCoreBase::is_blocked(board, appear))
+    {
+        search(board, appear, false);
+    }
+}
+
+// After a hold the held tetromino appears at the top, or the next one if
+// nothing was held.
+template <typename Rules>
+void MoveGenerator<Rules>::generate(const GameCore<Rules>& engine)
+{
+    num_searches_ = 0;
+    placements_.clear();
+
+    search(engine.board(), engine.current(), false);
+
+    if (!Rules::Hold::ENABLED || !engine.can_hold())
+    {
+        return;
+    }
+
+    const Piece& held = engine.is_hold_empty() ? engine.next() : engine.hold();
+    Piece appear = GameCoreBase::make_piece(held.type, held.color);
+
+    if (!GameCoreBase::is_blocked(engine.board(), appear))
+    {
+        search(engine.board(), appear, true);
+    }
+}
+
+template <typename Rules>
+void MoveGenerator<Rules>::inputs(const Placement& placement,
+                                  std::vector<Input>& inputs)
+{
+    path(placement, false, inputs);
+}
+
+template <typename Rules>
+void MoveGenerator<Rules>::key_inputs(const Placement& placement,
+                                      std::vector<Input>& inputs)
+{
+    path(placement, true, inputs);
+}
+
+// Follow the parents back to the start. The parents are searched again if
+// the last search had the other cost of gravity.
+template <typename Rules>
+void MoveGenerator<Rules>::path(const Placement& placement, bool free_gravity,
+                                std::vector<Input>& inputs)
+{
+    Search& search = searches_.at(placement.hold ? 1 : 0);
+
+    if (!search.has_inputs || search.free_gravity != free_gravity)
+    {
+        search_inputs(search, free_gravity);
+        search.has_inputs = true;
+        search.free_gravity = free_gravity;
+    }
+
+    inputs.clear();
+    inputs.push_back(GameCoreBase::GRAVITY);
+
+    for (int p = position(placement.orientation, placement.x, placement.y);
+         p != search.start; p = search.parents.at(p))
+    {
+        inputs.push_back(Input(search.parent_inputs.at(p)));
+    }
+
+    if (placement.hold)
+    {
+        inputs.push_back(GameCoreBase::HOLD);
+    }
+
+    std::reverse(inputs.begin(), inputs.end());
+}
+
+// An orientation fits at (x, y) if no cell of the shape moved by (x, y) is
+// occupied, so each cell clears the columns of its row of the board moved
+// back by its column. Positions which cannot
+// move down lock there with one more gravity.
+template <typename Rules>
+void MoveGenerator<Rules>::search(const Board& board, const Piece& start, bool hold)
+{
+    Search& search = searches_.at(num_searches_);
+    num_searches_ += 1;
+
+    search.type = start.type;
+    search.color = start.color;
+    search.hold = hold;
+    search.has_inputs = false;
+
+    const PieceSet::Shape& shape = PieceSet::tetrominos().shape(start.type);
+
+    for (int o = 0; o < shape.num_orientations; ++o)
+    {
+        const PieceSet::Orientation& orientation = shape.orientations.at(o);
+        uint16_t columns = (1 << (Board::COLUMNS - orientation.width + 1)) - 1;
+
+        search.fits.at(o).fill(0);
+
+        for (int y = 0; y + orientation.height <= Board::ROWS; ++y)
+        {
+            uint16_t blocked = 0;
+
+            for (int i = 0; i < shape.num_cells; ++i)
+            {
+                const Coord& c = orientation.cells.at(i);
+                blocked |= board.rows.at(y + c.y) >> c.x;
+            }
+
+            search.fits.at(o).at(y) = columns & ~blocked;
+        }
+
+        search.reached.at(o).fill(0);
+    }
+
+    int start_orientation = orientation_of(start);
+    search.start = position(start_orientation, start.left, start.up);
+    search.reached.at(start_orientation).at(start.up) = 1 << start.left;
+
+    reach(search);
+
+    for (int o = 0; o < shape.num_orientations; ++o)
+    {
+        for (int y = 0; y < Board::ROWS; ++y)
+        {
+            uint16_t below = y + 1 < Board::ROWS ? search.fits.at(o).at(y + 1) : 0;
+            uint16_t locks = search.reached.at(o).at(y) & ~below;
+
+            for (int x = 0; locks != 0; ++x, locks >>= 1)
+            {
+                if (locks & 1)
+                {
+                    Placement placement;
+                    placement.piece = placed_piece(search.type, search.color, o, x, y);
+                    placement.hold = hold;
+                    placement.orientation = o;
+                    placement.x = x;
+                    placement.y = y;
+
+                    placements_.push_back(placement);
+                }
+            }
+        }
+    }
+}
+
+// Each pass goes down the rows of every orientation: the row gets what
+// falls from the row above and spreads sideways, and the columns not
+// turned yet are turned with each kick in order. Turns can reach rows
+// already passed, so the passes go on until nothing changes.
+template <typename Rules>
+void MoveGenerator<Rules>::reach(Search& search) const
+{
+    const Turns& all_turns = turns();
+    const int num_orientations =
+            PieceSet::tetrominos().shape(search.type).num_orientations;
+
+    Masks turned = {};
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (int o = 0; o < num_orientations; ++o)
+        {
+            for (int y = 0; y < Board::ROWS; ++y)
+            {
+                uint16_t fits = search.fits.at(o).at(y);
+                uint16_t row = search.reached.at(o).at(y);
+
+                if (y > 0)
+                {
+                    row |= search.reached.at(o).at(y - 1) & fits;
+                }
+
+                if (row == 0)
+                {
+                    continue;
+                }
+
+                for (uint16_t spread = row; ; row = spread)
+                {
+                    spread = row | (((row << 1) | (row >> 1)) & fits);
+
+                    if (spread == row)
+                    {
+                        break;
+                    }
+                }
+
+                if (row != search.reached.at(o).at(y))
+                {
+                    search.reached.at(o).at(y) = row;
+                    changed = true;
+                }
+
+                uint16_t not_turned = row & ~turned.at(o).at(y);
+                turned.at(o).at(y) |= row;
+
+                for (const Turn& turn : {all_turns.rotate.at(search.type).at(o),
+                                         all_turns.reflect.at(search.type).at(o)})
+                {
+                    uint16_t left = not_turned;
+
+                    for (const Coord& kick : Rules::Rotation::KICKS)
+                    {
+                        int to_y = y + turn.delta_y + kick.y;
+                        int delta_x = turn.delta_x + kick.x;
+
+                        if (left == 0 || to_y < 0 || to_y >= Board::ROWS)
+                        {
+                            continue;
+                        }
+
+                        uint16_t& to_row = search.reached.at(turn.orientation).at(to_y);
+                        uint16_t hit = shifted(left, delta_x) &
+                                search.fits.at(turn.orientation).at(to_y);
+
+                        left &= ~shifted(hit, -delta_x);
+
+                        if (hit & ~to_row)
+                        {
+                            to_row |= hit;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The same moves as reach, one position at a time in the order the
+// positions are first reached.
+//
+// With free gravity a move costs no key if it is gravity, so the search is
+// a breadth first search with costs of zero and one. The positions below a
+// reached position are reached at once with gravity, before any position
+// which takes one more key, and the queue stays in the order of the keys.
+template <typename Rules>
+void MoveGenerator<Rules>::search_inputs(Search& search, bool free_gravity)
+{
+    const Turns& all_turns = turns();
+    const PieceSet::Shape& shape = PieceSet::tetrominos().shape(search.type);
+
+    std::array<uint16_t, NUM_POSITIONS> queue;
+    int head = 0;
+    int tail = 0;
+
+    search.parents.fill(NO_PARENT);
+
+    // Falls as far as gravity takes the position without a key.
+    auto fall = [&](int from)
+    {
+        int o = from / (Board::ROWS * Board::COLUMNS);
+        int y = from / Board::COLUMNS % Board::ROWS;
+        int x = from % Board::COLUMNS;
+
+        while (free_gravity && y + 1 < Board::ROWS && (search.fits.at(o).at(y + 1) >> x) & 1)
+        {
+            int below = position(o, x, y + 1);
+
+            if (search.parents.at(below) != NO_PARENT)
+            {
+                break;
+            }
+
+            search.parents.at(below) = from;
+            search.parent_inputs.at(below) = GameCoreBase::GRAVITY;
+            queue.at(tail++) = below;
+
+            from = below;
+            y += 1;
+        }
+    };
+
+    search.parents.at(search.start) = search.start;
+    queue.at(tail++) = search.start;
+    fall(search.start);
+
+    while (head < tail)
+    {
+        int p = queue.at(head++);
+        int o = p / (Board::ROWS * Board::COLUMNS);
+        int y = p / Board::COLUMNS % Board::ROWS;
+        int x = p % Board::COLUMNS;
+
+        auto visit = [&](int next, Input input)
+        {
+            if (next >= 0 && search.parents.at(next) == NO_PARENT)
+            {
+                search.parents.at(next) = p;
+                search.parent_inputs.at(next) = input;
+                queue.at(tail++) = next;
+                fall(next);
+            }
+        };
+
+        const auto& fits = search.fits.at(o);
+
+        if (x > 0 && (fits.at(y) >> (x - 1)) & 1)
+        {
+            visit(position(o, x - 1, y), GameCoreBase::LEFT);
+        }
+
+        if ((fits.at(y) >> (x + 1)) & 1)
+        {
+            visit(position(o, x + 1, y), GameCoreBase::RIGHT);
+        }
+
+        visit(turn(search, all_turns.rotate.at(search.type).at(o), p), GameCoreBase::ROTATE);
+        visit(turn(search, all_turns.reflect.at(search.type).at(o), p), GameCoreBase::REFLECT);
+
+        if (y + 1 >= Board::ROWS || !((fits.at(y + 1) >> x) & 1))
+        {
+            continue;
+        }
+
+        int bottom = y + 1;
+
+        while (bottom + 1 < Board::ROWS && (fits.at(bottom + 1) >> x) & 1)
+        {
+            bottom += 1;
+        }
+
+        // Soft fall goes down MOVE_SOFT rows only if all of them are free,
+        // otherwise as far as hard fall.
+        int soft = bottom;
+
+        if (y + shape.orientations.at(o).height - 1 + GameCoreBase::MOVE_SOFT < Board::ROWS &&
+                bottom >= y + GameCoreBase::MOVE_SOFT)
+        {
+            soft = y + GameCoreBase::MOVE_SOFT;
+        }
+
+        visit(position(o, x, bottom), GameCoreBase::HARD_FALL);
+        visit(position(o, x, soft), GameCoreBase::SOFT_FALL);
+        visit(position(o, x, y + 1), GameCoreBase::GRAVITY);
+    }
+}
+
+template <typename Rules>
+int MoveGenerator<Rules>::turn(const Search& search, const Turn& turn, int position) const
+{
+    int y = position / Board::COLUMNS % Board::ROWS;
+    int x = position % Board::COLUMNS;
+
+    for (const Coord& kick : Rules::Rotation::KICKS)
+    {
+        int to_x = x + turn.delta_x + kick.x;
+        int to_y = y + turn.delta_y + kick.y;
+
+        if (to_x >= 0 && to_x < Board::COLUMNS && to_y >= 0 && to_y < Board::ROWS &&
+                (search.fits.at(turn.orientation).at(to_y) >> to_x) & 1)
+        {
+            return MoveGenerator::position(turn.orientation, to_x, to_y);
+        }
+    }
+
+    return -1;
+}
+
+// The turns are the same everywhere on the board, only whether the result
+// fits differs. They are measured once with the functions of the rules on
+// an empty board, where the first kick always fits.
+template <typename Rules>
+const typename MoveGenerator<Rules>::Turns& MoveGenerator<Rules>::turns()
+{
+    static const Turns all_turns = []()
+    {
+        Turns table;
+        Board empty;
+        const Coord& first_kick = Rules::Rotation::KICKS.at(0);
+
+        for (int type = 0; type < GameCoreBase::NUMBER_OF_TETROMINOS; ++type)
+        {
+            const PieceSet::Shape& shape = PieceSet::tetrominos().shape(type);
+
+            for (int o = 0; o < shape.num_orientations; ++o)
+            {
+                Piece piece = placed_piece(type, 0, o, REFERENCE_X, REFERENCE_Y);
+                Piece rotated = piece;
+                Piece reflected = piece;
+
+                Rules::Rotation::rotate_counterclockwise(empty, rotated);
+                Rules::Rotation::reflect_vertical_axis(empty, reflected);
+
+                Turn& rotate = table.rotate.at(type).at(o);
+                rotate.orientation = orientation_of(rotated);
+                rotate.delta_x = rotated.left - piece.left - first_kick.x;
+                rotate.delta_y = rotated.up - piece.up - first_kick.y;
+
+                Turn& reflect = table.reflect.at(type).at(o);
+                reflect.orientation = orientation_of(reflected);
+                reflect.delta_x = reflected.left - piece.left - first_kick.x;
+                reflect.delta_y = reflected.up - piece.up - first_kick.y;
+            }
+        }
+
+        return table;
+    }();
+
+    return all_turns;
+}
+
+// The masks of the rows moved to the left side are the masks of one
+// orientation of the shape.
+template <typename Rules>
+int MoveGenerator<Rules>::orientation_of(const Piece& piece)
+{
+    const PieceSet::Shape& shape = PieceSet::tetrominos().shape(piece.type);
+
+    for (int i = 0; i < shape.num_orientations; ++i)
+    {
+        const PieceSet::Orientation& o = shape.orientations.at(i);
+
+        if (o.width != piece.right - piece.left + 1 || o.height != piece.height())
+        {
+            continue;
+        }
+
+        bool is_same = true;
+
+        for (int row = 0; row < o.height; ++row)
+        {
+            if ((piece.masks.at(row) >> piece.left) != o.masks.at(row))
+            {
+                is_same = false;
+                break;
+            }
+        }
+
+        if (is_same)
+        {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+
+//*****************************************************************************
+// The generators of every set of rules.
+
+template class MoveGenerator<ClassicRules>;
+template class MoveGenerator<ModernRules>;
+template class MoveGenerator<NoHoldRules>;
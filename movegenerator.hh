@@ -0,0 +1,157 @@
+#ifndef MOVEGENERATOR_HH
+#define MOVEGENERATOR_HH
+
+#include "gameengine.hh"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Finds every position where a tetromino can lock and the shortest inputs
+// which put it there, using the moves of the game: left, right, turning,
+// reflecting, gravity, soft and hard fall, and hold.
+//
+// A position is an orientation of the shape in the piece set and the upper
+// left corner of its box. For each orientation the generator keeps one bit
+// mask for each row of the board, like the rows of the board: the columns
+// where the orientation fits and the columns reached from where the
+// tetromino starts. A whole row of positions moves sideways, down or turns
+// in a few mask operations, so all reachable positions are found in a few
+// passes over the rows.
+//
+// The shortest inputs are only searched, breadth first over the single
+// positions, when they are first asked for after generating. The inputs
+// with the fewest keys are searched the same way, with the falls of gravity
+// free.
+//
+// The timer of the window also moves the tetromino down. The inputs are
+// for a game where only the player moves it, as the bots and the tools do.
+template <typename Rules>
+class MoveGenerator
+{
+public:
+    using Input = GameCoreBase::Input;
+
+    // A position where the tetromino locks.
+    struct Placement
+    {
+        // Tetromino where it locks.
+        Piece piece;
+
+        // True if the tetromino was held first, so the piece is the held or
+        // the next tetromino.
+        bool hold = false;
+
+        int orientation = 0;
+        int x = 0;
+        int y = 0;
+    };
+
+    // Placements of the tetromino of the type appearing on the board.
+    // Nothing is found if the tetromino cannot appear.
+    void generate(const Board& board, int type, int color);
+
+    // Placements of the moving tetromino of the game, and of the tetromino
+    // which comes if the moving one is held. The game must have a moving
+    // tetromino. A held tetromino which would appear on occupied cells has
+    // no placements.
+    void generate(const GameCore<Rules>& engine);
+
+    const std::vector<Placement>& placements() const { return placements_; }
+
+    // Shortest inputs which lock the tetromino at the placement from where
+    // the tetromino was, including the hold and the last gravity.
+    void inputs(const Placement& placement, std::vector<Input>& inputs);
+
+    // Inputs with the fewest keys which lock the tetromino at the placement.
+    // Gravity is not a key, as the timer gives it, so the tetromino may
+    // fall with gravity where a key would take fewer inputs.
+    void key_inputs(const Placement& placement, std::vector<Input>& inputs);
+
+private:
+    static constexpr int NUM_POSITIONS =
+            PieceSet::MAX_ORIENTATIONS * Board::ROWS * Board::COLUMNS;
+
+    // Marks the positions not found yet by the search of the inputs.
+    static constexpr uint16_t NO_PARENT = 0xFFFF;
+
+    // A bit for each column in each row of each orientation.
+    using Masks = std::array<std::array<uint16_t, Board::ROWS>, PieceSet::MAX_ORIENTATIONS>;
+
+    // Orientation after turning or reflecting and how much the corner of
+    // the box moves, before the kicks of the rotation system.
+    struct Turn
+    {
+        int orientation = 0;
+        int delta_x = 0;
+        int delta_y = 0;
+    };
+
+    // Turns of every orientation of every tetromino with the rules.
+    struct Turns
+    {
+        using Table = std::array<std::array<Turn, PieceSet::MAX_ORIENTATIONS>,
+                                 GameCoreBase::NUMBER_OF_TETROMINOS>;
+
+        Table rotate;
+        Table reflect;
+    };
+
+    // Positions of one tetromino on the board.
+    struct Search
+    {
+        int type = 0;
+        int color = 0;
+        bool hold = false;
+        int start = 0;
+
+        Masks fits = {};
+        Masks reached = {};
+
+        // Position and input which first reached each position in the
+        // search of the inputs, and if that search had free gravity.
+        bool has_inputs = false;
+        bool free_gravity = false;
+        std::array<uint16_t, NUM_POSITIONS> parents;
+        std::array<uint8_t, NUM_POSITIONS> parent_inputs;
+    };
+
+    // Find the placements of the tetromino from the piece.
+    void search(const Board& board, const Piece& start, bool hold);
+
+    // Reach the positions from the start with mask operations until
+    // nothing new is reached.
+    void reach(Search& search) const;
+
+    // Follow the parents of the search with or without free gravity.
+    void path(const Placement& placement, bool free_gravity, std::vector<Input>& inputs);
+
+    // Breadth first search of the shortest inputs of every position, or of
+    // the fewest inputs other than gravity.
+    void search_inputs(Search& search, bool free_gravity);
+
+    // Position after the turn from the position with the kicks of the
+    // rules, or -1 if it does not fit.
+    int turn(const Search& search, const Turn& turn, int position) const;
+
+    static int position(int orientation, int x, int y)
+    {
+        return (orientation * Board::ROWS + y) * Board::COLUMNS + x;
+    }
+
+    static const Turns& turns();
+
+    // Index of the orientation of the tetromino in its shape.
+    static int orientation_of(const Piece& piece);
+
+    std::array<Search, 2> searches_;
+    int num_searches_ = 0;
+
+    std::vector<Placement> placements_;
+};
+
+// The generators are compiled in movegenerator.cpp.
+extern template class MoveGenerator<ClassicRules>;
+extern template class MoveGenerator<ModernRules>;
+extern template class MoveGenerator<NoHoldRules>;
+
+#endif // MOVEGENERATOR_HH
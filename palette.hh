@@ -0,0 +1,45 @@
+#ifndef PALETTE_HH
+#define PALETTE_HH
+
+#include "gameengine.hh"
+#include <array>
+
+// Colors of the squares, as #RRGGBB. Shared by the window and the tools
+// which draw games, so every picture of a game looks the same. Indexed like
+// the palette index of the engine.
+class Palette
+{
+public:
+    // The color of tetromino is change for each level.
+    static constexpr std::array<std::array<const char*, GameEngine::NUM_COLOR_IN_LEVEL>,
+                                GameEngine::NUM_LEVELS>
+    COLOR_CODE_SET =
+    {{{"#0444BF", "#0584F2", "#0AAFF1", "#EDF259", "#A79674"},
+    {"#04060F", "#03353E", "#0294A5", "#A79C93", "#C1403D"},
+    {"#BE3B45", "#F07995", "#F3F1F3", "#A58E87", "#BE302B"},
+    {"#A4A4BF", "#16235A", "#2A3457", "#888C46", "#F2EAED"},
+    {"#E0E8F0", "#51A2D9", "#53C0F0", "#B9E5F3", "#8A140E"},
+    {"#55D9C0", "#C7F6EC", "#107050", "#02231C", "#4DD8AD"},
+    {"#BD3E85", "#182657", "#121F40", "#D59B2D", "#8D541E"},
+    {"#C2D3DA", "#81A3A7", "#585A56", "#F1F3F2", "#272424"}}};
+
+    // Garbage rows of the races.
+    static constexpr const char* GARBAGE_CODE = "#A0A0A4";
+
+    // Border of every square.
+    static constexpr const char* BORDER_CODE = "#000000";
+
+    // Color of the palette index.
+    static const char* color(int index)
+    {
+        if (index == GameEngine::GARBAGE_COLOR)
+        {
+            return GARBAGE_CODE;
+        }
+
+        return COLOR_CODE_SET.at(index / GameEngine::NUM_COLOR_IN_LEVEL)
+                .at(index % GameEngine::NUM_COLOR_IN_LEVEL);
+    }
+};
+
+#endif // PALETTE_HH
@@ -0,0 +1,147 @@
+#include "perfcounters.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+std::array<std::atomic<int64_t>, PerfCounters::NUMBER_OF_COUNTERS>
+        PerfCounters::counters_ = {};
+
+namespace
+{
+const std::array<const char*, PerfCounters::NUMBER_OF_COUNTERS> COUNTER_NAMES =
+{"scene_items", "squares_shown", "squares_hidden", "heap_allocations",
+ "pieces_locked", "allocations_last_piece", "update_game_ns", "repaints",
+ "repaint_ns", "timer_lateness_ms", "event_loop_lag_us", "rollbacks",
+ "resimulated_ticks", "bot_depth", "bot_nodes", "bot_latency_us",
+ "bot_timeouts", "skipped_frames"};
+}
+
+const char* PerfCounters::name(Counter counter)
+{
+    return COUNTER_NAMES.at(counter);
+}
+
+std::array<int64_t, PerfCounters::NUMBER_OF_COUNTERS> PerfCounters::snapshot()
+{
+    std::array<int64_t, NUMBER_OF_COUNTERS> values;
+
+    for (int i = 0; i < NUMBER_OF_COUNTERS; ++i)
+    {
+        values.at(i) = counters_.at(i).load(std::memory_order_relaxed);
+    }
+
+    return values;
+}
+
+void PerfCounters::reset()
+{
+    for (std::atomic<int64_t>& counter : counters_)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+//*****************************************************************************
+// Count every heap allocation of the program for HEAP_ALLOCATIONS. The
+// other forms of new, such as nothrow, call these. Calls of malloc are not
+// seen.
+
+void* operator new(std::size_t size)
+{
+    PerfCounters::add(PerfCounters::HEAP_ALLOCATIONS, 1);
+
+    void* p = std::malloc(size == 0 ? 1 : size);
+
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    PerfCounters::add(PerfCounters::HEAP_ALLOCATIONS, 1);
+
+    // aligned_alloc needs a size which is a multiple of the alignment.
+    std::size_t align = static_cast<std::size_t>(alignment);
+    std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+
+    void* p = std::aligned_alloc(align, rounded);
+
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
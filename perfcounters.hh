@@ -0,0 +1,72 @@
+#ifndef PERFCOUNTERS_HH
+#define PERFCOUNTERS_HH
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Registry of engine and rendering counters. Every counter is a lock free
+// atomic so the game, the performance HUD and the batch tools can update and
+// read them from any thread.
+//
+// SQUARES_SHOWN and SQUARES_HIDDEN count squares taken from and given back
+// to the block arena, which creates its scene items only once.
+//
+// HEAP_ALLOCATIONS counts the calls of the global operator new, plain and
+// aligned, of the whole program. Memory taken with malloc is not counted,
+// which includes most containers of Qt, so in the window it is a lower
+// bound. The engine and the bots only allocate with new.
+class PerfCounters
+{
+public:
+    enum Counter {SCENE_ITEMS,
+                  SQUARES_SHOWN,
+                  SQUARES_HIDDEN,
+                  HEAP_ALLOCATIONS,
+                  PIECES_LOCKED,
+                  ALLOCATIONS_LAST_PIECE,
+                  UPDATE_GAME_NS,
+                  REPAINTS,
+                  REPAINT_NS,
+                  TIMER_LATENESS_MS,
+                  EVENT_LOOP_LAG_US,
+                  ROLLBACKS,
+                  RESIMULATED_TICKS,
+                  BOT_DEPTH,
+                  BOT_NODES,
+                  BOT_LATENCY_US,
+                  BOT_TIMEOUTS,
+                  SKIPPED_FRAMES,
+                  NUMBER_OF_COUNTERS};
+
+    static void add(Counter counter, int64_t value)
+    {
+        counters_.at(counter).fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static void set(Counter counter, int64_t value)
+    {
+        counters_.at(counter).store(value, std::memory_order_relaxed);
+    }
+
+    static int64_t get(Counter counter)
+    {
+        return counters_.at(counter).load(std::memory_order_relaxed);
+    }
+
+    // Name used when the counters are printed.
+    static const char* name(Counter counter);
+
+    // Copy of all counters at once.
+    static std::array<int64_t, NUMBER_OF_COUNTERS> snapshot();
+
+    static void reset();
+
+private:
+    static_assert(std::atomic<int64_t>::is_always_lock_free,
+                  "Counters must be lock free.");
+
+    static std::array<std::atomic<int64_t>, NUMBER_OF_COUNTERS> counters_;
+};
+
+#endif // PERFCOUNTERS_HH
@@ -0,0 +1,244 @@
+#include "perfectclear.hh"
+#include "tracer.hh"
+#include <algorithm>
+#include <bitset>
+
+namespace
+{
+
+// Mixes the queue position into the board hash for the failed positions.
+const uint64_t STATE_KEY = 0x9E3779B97F4A7C15ULL;
+
+int count_squares(uint16_t row)
+{
+    return std::bitset<16>(row).count();
+}
+
+}
+
+PerfectClearSolver::PerfectClearSolver(int64_t max_nodes) :
+    max_nodes_(max_nodes)
+{
+}
+
+// The heights are tried lowest first, since a lower perfect clear needs
+// fewer tetrominos. Every height needs the same number of squares on the
+// board modulo four, so no height is possible if the first is not.
+PerfectClearSolver::Solution PerfectClearSolver::solve(const Board& board,
+        const std::vector<int>& queue, int hold, bool can_hold)
+{
+    TRACE_SCOPE("perfect clear solve");
+
+    queue_ = queue;
+    steps_.clear();
+    failed_.clear();
+    nodes_ = 0;
+    aborted_ = false;
+
+    // A hold of a tetromino after the queue adds one more depth.
+    generators_.resize(queue.size() + 2);
+
+    int stack = 0;
+
+    for (int y = 0; y < Board::ROWS; ++y)
+    {
+        if (board.rows.at(y) != 0)
+        {
+            stack = Board::ROWS - y;
+            break;
+        }
+    }
+
+    Solution solution;
+
+    for (int height = std::max(stack, 1); height <= MAX_HEIGHT && !aborted_; ++height)
+    {
+        if (search(board, height, 0, hold, can_hold, 0))
+        {
+            solution.status = FOUND;
+            solution.steps = steps_;
+            break;
+        }
+    }
+
+    if (solution.status != FOUND && aborted_)
+    {
+        solution.status = UNDECIDED;
+    }
+
+    solution.nodes = nodes_;
+
+    return solution;
+}
+
+PerfectClearSolver::Solution PerfectClearSolver::solve(const GameEngine& engine)
+{
+    std::vector<int> queue = {engine.current().type, engine.next().type};
+    int hold = engine.is_hold_empty() ? NO_HOLD : engine.hold().type;
+
+    return solve(engine.board(), queue, hold, engine.can_hold());
+}
+
+// The rows are full when the height reaches zero. The moving tetromino is
+// placed from the queue or swapped with the hold, like the hold of the
+// game: an empty hold takes the moving tetromino and the next one comes.
+bool PerfectClearSolver::search(const Board& board, int height, int index, int hold,
+                                bool can_hold, int depth)
+{
+    if (height == 0)
+    {
+        return true;
+    }
+
+    if (!can_fill(board, height, index, hold))
+    {
+        return false;
+    }
+
+    uint64_t key = board.hash ^ STATE_KEY *
+            ((((uint64_t(index) * 8 + hold + 1) * 2 + can_hold) * 8) + height);
+
+    if (failed_.count(key) != 0)
+    {
+        return false;
+    }
+
+    if (nodes_ >= max_nodes_)
+    {
+        aborted_ = true;
+        return false;
+    }
+
+    nodes_ += 1;
+
+    int size = queue_.size();
+    int moving = index < size ? queue_.at(index) : NO_HOLD;
+    bool found = false;
+
+    if (moving != NO_HOLD)
+    {
+        found = try_tetromino(board, height, moving, false, index + 1, hold, depth);
+    }
+
+    // After the queue the hold can still be swapped with a tetromino which
+    // is not known yet, which is then in the hold.
+    if (!found && !aborted_ && can_hold)
+    {
+        if (hold != NO_HOLD && hold != moving)
+        {
+            found = try_tetromino(board, height, hold, true, index + 1, moving, depth);
+        }
+        else if (hold == NO_HOLD && index + 1 < size)
+        {
+            found = try_tetromino(board, height, queue_.at(index + 1), true,
+                                  index + 2, moving, depth);
+        }
+    }
+
+    // A position cut by the node limit is not known to fail.
+    if (!found && !aborted_)
+    {
+        failed_.insert(key);
+    }
+
+    return found;
+}
+
+bool PerfectClearSolver::try_tetromino(const Board& board, int height, int type,
+                                       bool hold, int next_index, int next_hold,
+                                       int depth)
+{
+    MoveGenerator<ClassicRules>& generator = generators_.at(depth);
+    generator.generate(board, type, 0);
+
+    int top = Board::ROWS - height;
+
+    for (const MoveGenerator<ClassicRules>::Placement& placement : generator.placements())
+    {
+        const Piece& piece = placement.piece;
+
+        if (piece.up < top)
+        {
+            continue;
+        }
+
+        Board after = board;
+
+        for (const Coord& c : piece.squares)
+        {
+            after.set(c.x, c.y, piece.color);
+        }
+
+        int removed = after.remove_full_rows();
+
+        Step step;
+        step.hold = hold;
+        step.piece = piece;
+        steps_.push_back(step);
+
+        if (search(after, height - removed, next_index, next_hold, true, depth + 1))
+        {
+            return true;
+        }
+
+        steps_.pop_back();
+
+        if (aborted_)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+// Tetrominos cannot cross a column which is full in every row, also after
+// rows are removed, so each side is filled by its own tetrominos.
+bool PerfectClearSolver::can_fill(const Board& board, int height, int index,
+                                  int hold) const
+{
+    int available = std::max(0, int(queue_.size()) - index) + (hold != NO_HOLD);
+    int top = Board::ROWS - height;
+
+    uint16_t walls = Board::FULL_ROW;
+    int empty = 0;
+
+    for (int y = top; y < Board::ROWS; ++y)
+    {
+        walls &= board.rows.at(y);
+        empty += Board::COLUMNS - count_squares(board.rows.at(y));
+    }
+
+    if (empty % Piece::NUM_SQUARE != 0 || empty > available * Piece::NUM_SQUARE)
+    {
+        return false;
+    }
+
+    if (walls == 0)
+    {
+        return true;
+    }
+
+    int side = 0;
+
+    for (int x = 0; x <= Board::COLUMNS; ++x)
+    {
+        if (x == Board::COLUMNS || ((walls >> x) & 1))
+        {
+            if (side % Piece::NUM_SQUARE != 0)
+            {
+                return false;
+            }
+
+            side = 0;
+            continue;
+        }
+
+        for (int y = top; y < Board::ROWS; ++y)
+        {
+            side += !board.is_occupied(x, y);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef PERFECTCLEAR_HH
+#define PERFECTCLEAR_HH
+
+#include "gameengine.hh"
+#include "movegenerator.hh"
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+// Finds placements of the known tetrominos which remove every square from
+// the board, or proves that there are none.
+//
+// A perfect clear fills the lowest rows of the board completely, so the
+// tetrominos must stay in those rows. The heights are tried from the top
+// square of the board up, lowest first. Each tetromino is placed at every
+// position the move generator reaches, with or without hold, depth first.
+//
+// A position is given up early if the empty cells in the rows cannot be
+// filled: when the tetrominos left are too few for them, or when the
+// board is split by a column filled in every row and the empty cells on
+// one side are not a multiple of four. Positions which failed are kept in
+// a hash set by the Zobrist hash of the board, so a position reached again
+// in another order is not searched twice.
+class PerfectClearSolver
+{
+public:
+    // Hold without a tetromino.
+    static constexpr int NO_HOLD = -1;
+
+    // Highest perfect clear tried in rows.
+    static constexpr int MAX_HEIGHT = 6;
+
+    // Positions searched before the solver gives up.
+    static constexpr int64_t DEFAULT_MAX_NODES = 200000;
+
+    enum Status {FOUND,
+                 NONE,
+                 UNDECIDED};
+
+    // A tetromino where it locks.
+    struct Step
+    {
+        // True if the tetromino comes from the hold or from the queue after
+        // the moving one, which goes to the hold.
+        bool hold = false;
+        Piece piece;
+    };
+
+    struct Solution
+    {
+        // UNDECIDED if the search was stopped by the node limit.
+        Status status = NONE;
+        std::vector<Step> steps;
+        int64_t nodes = 0;
+    };
+
+    explicit PerfectClearSolver(int64_t max_nodes = DEFAULT_MAX_NODES);
+
+    // Solve with the tetrominos coming from the queue in order, the first
+    // one moving, and the one in the hold. The hold is NO_HOLD if empty.
+    Solution solve(const Board& board, const std::vector<int>& queue, int hold,
+                   bool can_hold);
+
+    // Solve with the moving, next and hold tetrominos of the game, the
+    // moving one from its appear position.
+    Solution solve(const GameEngine& engine);
+
+private:
+    // Search the rows up to the height from the position. The index is the
+    // first tetromino of the queue not placed.
+    bool search(const Board& board, int height, int index, int hold,
+                bool can_hold, int depth);
+
+    // Place the tetromino at every position in the rows and search on.
+    bool try_tetromino(const Board& board, int height, int type, bool hold,
+                       int next_index, int next_hold, int depth);
+
+    // False if the empty cells of the rows can be seen not to fill.
+    bool can_fill(const Board& board, int height, int index, int hold) const;
+
+    int64_t max_nodes_ = 0;
+    int64_t nodes_ = 0;
+    bool aborted_ = false;
+
+    std::vector<int> queue_;
+    std::vector<Step> steps_;
+
+    // Generator of each depth, so a depth does not change the placements
+    // of the depth above it. Sized before the search starts.
+    std::vector<MoveGenerator<ClassicRules>> generators_;
+
+    std::unordered_set<uint64_t> failed_;
+};
+
+#endif // PERFECTCLEAR_HH
@@ -0,0 +1,138 @@
+#include "pieceset.hh"
+#include <algorithm>
+
+namespace
+{
+
+struct Definition
+{
+    const char* name;
+    std::array<Coord, PieceSet::MAX_CELLS> cells;
+};
+
+// The cells of each tetromino in the orientation it appears in.
+const std::array<Definition, 7> TETROMINOS =
+{{
+    {"horizontal", {Coord(0, 0), Coord(1, 0), Coord(2, 0), Coord(3, 0)}},
+    {"left_corner", {Coord(0, 0), Coord(0, 1), Coord(1, 1), Coord(2, 1)}},
+    {"right_corner", {Coord(0, 1), Coord(1, 1), Coord(2, 1), Coord(2, 0)}},
+    {"square", {Coord(0, 0), Coord(0, 1), Coord(1, 1), Coord(1, 0)}},
+    {"step_up_right", {Coord(0, 1), Coord(1, 1), Coord(1, 0), Coord(2, 0)}},
+    {"pyramid", {Coord(0, 1), Coord(1, 1), Coord(1, 0), Coord(2, 1)}},
+    {"step_up_left", {Coord(0, 0), Coord(1, 0), Coord(1, 1), Coord(2, 1)}}
+}};
+
+}
+
+const PieceSet& PieceSet::tetrominos()
+{
+    static const PieceSet set = []()
+    {
+        PieceSet tetrominos;
+
+        for (const Definition& definition : TETROMINOS)
+        {
+            tetrominos.shapes_.push_back(make_shape(definition.name, definition.cells));
+        }
+
+        return tetrominos;
+    }();
+
+    return set;
+}
+
+// The cells are moved to the upper left corner. Each orientation is the
+// previous one turned counter-clockwise, (x, y) to (y, width - 1 - x), and
+// the reflections are (width - 1 - x, y) of those.
+PieceSet::Shape PieceSet::make_shape(const char* name, const std::array<Coord, MAX_CELLS>& cells)
+{
+    Shape shape;
+    int min_x = MAX_SIZE;
+    int min_y = MAX_SIZE;
+
+    for (const Coord& c : cells)
+    {
+        min_x = std::min(min_x, c.x);
+        min_y = std::min(min_y, c.y);
+    }
+
+    shape.name = name;
+    shape.num_cells = cells.size();
+    shape.num_orientations = 0;
+
+    Orientation defined;
+
+    for (int i = 0; i < shape.num_cells; ++i)
+    {
+        Coord c(cells.at(i).x - min_x, cells.at(i).y - min_y);
+
+        defined.cells.at(i) = c;
+        defined.masks.at(c.y) |= 1 << c.x;
+        defined.width = std::max(defined.width, c.x + 1);
+        defined.height = std::max(defined.height, c.y + 1);
+    }
+
+    for (int reflect = 0; reflect < 2; ++reflect)
+    {
+        Orientation turned = defined;
+
+        for (int rotations = 0; rotations < 4; ++rotations)
+        {
+            Orientation o;
+            o.width = turned.width;
+            o.height = turned.height;
+
+            for (int i = 0; i < shape.num_cells; ++i)
+            {
+                Coord c = turned.cells.at(i);
+
+                if (reflect)
+                {
+                    c.x = turned.width - 1 - c.x;
+                }
+
+                o.cells.at(i) = c;
+                o.masks.at(c.y) |= 1 << c.x;
+            }
+
+            // Keep only orientations which are different shapes.
+            bool is_new = true;
+
+            for (int j = 0; j < shape.num_orientations; ++j)
+            {
+                const Orientation& other = shape.orientations.at(j);
+
+                if (other.width == o.width && other.height == o.height &&
+                        other.masks == o.masks)
+                {
+                    is_new = false;
+                    break;
+                }
+            }
+
+            if (is_new)
+            {
+                shape.orientations.at(shape.num_orientations) = o;
+                shape.num_orientations += 1;
+            }
+
+            // Turn counter-clockwise for the next orientation.
+            Orientation next;
+            next.width = turned.height;
+            next.height = turned.width;
+
+            for (int i = 0; i < shape.num_cells; ++i)
+            {
+                const Coord& c = turned.cells.at(i);
+                next.cells.at(i) = Coord(c.y, turned.width - 1 - c.x);
+            }
+
+            turned = next;
+        }
+    }
+
+    const Orientation& appear = shape.orientations.at(0);
+    shape.spawn_x = (Board::COLUMNS - 1) / 2 - (appear.width - 1) / 2;
+
+    return shape;
+}
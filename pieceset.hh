@@ -0,0 +1,74 @@
+#ifndef PIECESET_HH
+#define PIECESET_HH
+
+#include "board.hh"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shapes of the tetrominos of the game, made from the cells of each one in
+// the orientation it appears in. Every orientation of every shape is
+// computed once: its cells, the mask of each row and its size, so testing
+// if a tetromino fits is one mask test for each of its rows.
+//
+// Only the set of the tetrominos is made. Piece, the saved states, the
+// replays and the move generator all hold four squares, so shapes of other
+// sizes could not be played.
+class PieceSet
+{
+public:
+    // Every shape has the squares of a tetromino.
+    static constexpr int MAX_CELLS = Piece::NUM_SQUARE;
+    static constexpr int MAX_SIZE = Piece::NUM_SQUARE;
+
+    static_assert(MAX_SIZE <= Board::COLUMNS && MAX_SIZE <= Board::ROWS,
+                  "Every orientation must fit in the board");
+
+    // Four turns and their reflections.
+    static constexpr int MAX_ORIENTATIONS = 8;
+
+    struct Orientation
+    {
+        // Cells from the upper left corner of the box around the shape, in
+        // the order of the table of the tetrominos.
+        std::array<Coord, MAX_CELLS> cells = {};
+
+        // Bit x of row y is set if the cell (x, y) of the box is in the shape.
+        std::array<uint16_t, MAX_SIZE> masks = {};
+
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Shape
+    {
+        std::string name = "";
+        int num_cells = 0;
+
+        // Orientation 0 is the shape as defined. The others are the
+        // different shapes after turning it counter-clockwise and
+        // reflecting it. Symmetric shapes have fewer.
+        int num_orientations = 0;
+        std::array<Orientation, MAX_ORIENTATIONS> orientations;
+
+        // Column of the left side of the box when the shape appears in the
+        // middle of the top of the board.
+        int spawn_x = 0;
+    };
+
+    int size() const { return shapes_.size(); }
+    const Shape& shape(int index) const { return shapes_.at(index); }
+
+    // Set of the tetrominos, in the order of GameEngine::Tetromino_kind.
+    // Made on the first call.
+    static const PieceSet& tetrominos();
+
+private:
+    // Compute the orientations, the masks and the spawn column of the cells.
+    static Shape make_shape(const char* name, const std::array<Coord, MAX_CELLS>& cells);
+
+    std::vector<Shape> shapes_;
+};
+
+#endif // PIECESET_HH
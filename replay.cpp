@@ -0,0 +1,320 @@
+#include "replay.hh"
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+const std::string REPLAY_HEADER = "tetris-replay 1";
+}
+
+// Start recording a new game.
+void Replay::start(uint32_t seed_value, GameEngine::Mode mode_value)
+{
+    seed = seed_value;
+    mode = mode_value;
+    inputs.clear();
+    lock_hashes.clear();
+    finesse = FinesseAnalyzer::Totals();
+    claim = Claim();
+
+    // Enough for a long game so recording does not allocate.
+    inputs.reserve(1 << 16);
+    lock_hashes.reserve(1 << 12);
+}
+
+// Record input and the hash of the state if it locked a tetromino.
+void Replay::record(GameEngine::Input input, int result, const GameEngine& engine)
+{
+    inputs.push_back(GameEngine::INPUT_LETTERS.at(input));
+
+    if (result & GameEngine::LOCKED)
+    {
+        lock_hashes.push_back(engine.state_hash());
+    }
+}
+
+// Cut the recording to the given length.
+void Replay::truncate(int num_inputs, int num_locks)
+{
+    if (num_inputs < int(inputs.size()))
+    {
+        inputs.resize(num_inputs);
+    }
+
+    if (num_locks < int(lock_hashes.size()))
+    {
+        lock_hashes.resize(num_locks);
+    }
+}
+
+// Read a replay file.
+bool Replay::read(const std::string& file_name)
+{
+    std::ifstream file;
+    file.open(file_name);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::string line = "";
+    std::getline(file, line);
+
+    if (line != REPLAY_HEADER)
+    {
+        return false;
+    }
+
+    std::string key = "";
+
+    // Seed.
+    file >> key >> seed;
+    if (!file || key != "seed")
+    {
+        return false;
+    }
+
+    // Mode of a race. Normal games have no mode line.
+    mode = GameEngine::NORMAL;
+    file >> key;
+
+    if (file && key == "mode")
+    {
+        int mode_value = 0;
+        file >> mode_value >> key;
+
+        if (!file || mode_value < 0 || mode_value >= GameEngine::NUMBER_OF_MODES)
+        {
+            return false;
+        }
+
+        mode = static_cast<GameEngine::Mode>(mode_value);
+    }
+
+    // Inputs. A game without inputs has an empty line.
+    if (!file || key != "inputs")
+    {
+        return false;
+    }
+
+    std::getline(file, line);
+    std::istringstream input_stream(line);
+    inputs.clear();
+    input_stream >> inputs;
+
+    // State hashes after each lock.
+    file >> key;
+    if (!file || key != "locks")
+    {
+        return false;
+    }
+
+    std::getline(file, line);
+    std::istringstream hash_stream(line);
+    lock_hashes.clear();
+
+    uint64_t hash = 0;
+    while (hash_stream >> std::hex >> hash)
+    {
+        lock_hashes.push_back(hash);
+    }
+
+    // Keys of the player and the result. Older replays have neither.
+    finesse = FinesseAnalyzer::Totals();
+    claim = Claim();
+
+    while (file >> key)
+    {
+        if (key == "finesse")
+        {
+            file >> finesse.pieces >> finesse.keys >> finesse.minimum_keys >> finesse.faults;
+        }
+        else if (key == "player")
+        {
+            // The name is the rest of the line after the one space written
+            // after the key. It may be empty or have spaces of its own.
+            std::getline(file, claim.player);
+
+            if (!claim.player.empty() && claim.player.at(0) == ' ')
+            {
+                claim.player.erase(0, 1);
+            }
+        }
+        else if (key == "result")
+        {
+            file >> claim.points >> claim.lines >> claim.seconds;
+            claim.present = true;
+        }
+        else
+        {
+            break;
+        }
+
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Write replay to a file.
+bool Replay::write(const std::string& file_name) const
+{
+    std::ofstream file;
+    file.open(file_name);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << REPLAY_HEADER << '\n';
+    file << "seed " << seed << '\n';
+
+    if (mode != GameEngine::NORMAL)
+    {
+        file << "mode " << mode << '\n';
+    }
+
+    file << "inputs " << inputs << '\n';
+    file << "locks";
+
+    for (uint64_t hash : lock_hashes)
+    {
+        file << ' ' << std::hex << hash;
+    }
+
+    file << std::dec << '\n';
+
+    if (finesse.pieces > 0)
+    {
+        file << "finesse " << finesse.pieces << ' ' << finesse.keys << ' ' <<
+                finesse.minimum_keys << ' ' << finesse.faults << '\n';
+    }
+
+    if (claim.present)
+    {
+        file << "player " << claim.player << '\n';
+        file << "result " << claim.points << ' ' << claim.lines << ' ' <<
+                claim.seconds << '\n';
+    }
+
+    file.close();
+
+    return !file.fail();
+}
+
+// Play the inputs again and compare state after each lock.
+bool Replay::verify(Divergence& divergence) const
+{
+    Outcome outcome;
+
+    return verify(divergence, outcome);
+}
+
+// The gravity comes from the drop timer, which starts again for each
+// tetromino at the speed of the level.
+bool Replay::verify(Divergence& divergence, Outcome& outcome) const
+{
+    GameEngine engine;
+    engine.reset(seed, mode);
+
+    outcome = Outcome();
+
+    unsigned int lock = 0;
+
+    for (unsigned int i = 0; i < inputs.size(); ++i)
+    {
+        GameEngine::Input input;
+
+        if (!GameEngine::input_from_letter(inputs.at(i), input))
+        {
+            divergence.lock = lock;
+            divergence.input = i;
+            return false;
+        }
+
+        if (input == GameEngine::GRAVITY)
+        {
+            outcome.gravity_ms += engine.speed();
+        }
+
+        if (!(engine.apply(input) & GameEngine::LOCKED))
+        {
+            continue;
+        }
+
+        uint64_t hash = engine.state_hash();
+
+        // More locks than recorded is also a divergence.
+        if (lock >= lock_hashes.size() || lock_hashes.at(lock) != hash)
+        {
+            divergence.lock = lock;
+            divergence.input = i;
+            divergence.expected = lock < lock_hashes.size() ? lock_hashes.at(lock) : 0;
+            divergence.actual = hash;
+            return false;
+        }
+
+        lock += 1;
+    }
+
+    // Fewer locks than recorded.
+    if (lock != lock_hashes.size())
+    {
+        divergence.lock = lock;
+        divergence.input = inputs.size();
+        divergence.expected = lock_hashes.at(lock);
+        divergence.actual = 0;
+        return false;
+    }
+
+    outcome.points = engine.points();
+    outcome.lines = engine.lines_removed();
+    outcome.over = engine.is_over();
+
+    return true;
+}
+
+// Store the state hashes of the current rules.
+void Replay::update_hashes()
+{
+    GameEngine engine;
+    engine.reset(seed, mode);
+
+    lock_hashes.clear();
+
+    for (char letter : inputs)
+    {
+        GameEngine::Input input;
+
+        if (GameEngine::input_from_letter(letter, input) &&
+                engine.apply(input) & GameEngine::LOCKED)
+        {
+            lock_hashes.push_back(engine.state_hash());
+        }
+    }
+}
+
+// Play all inputs.
+bool Replay::play(GameEngine& engine) const
+{
+    engine.reset(seed, mode);
+
+    for (char letter : inputs)
+    {
+        GameEngine::Input input;
+
+        if (!GameEngine::input_from_letter(letter, input))
+        {
+            return false;
+        }
+
+        engine.apply(input);
+    }
+
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef REPLAY_HH
+#define REPLAY_HH
+
+#include "finesse.hh"
+#include "gameengine.hh"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Recorded game: the seed and every input given to the GameEngine, with the
+// state hash after every lock for checking that the rules still play the
+// game the same way.
+//
+// File format, one value per line:
+//   tetris-replay 1
+//   seed <seed>
+//   mode <GameEngine::Mode of a race, only if not a normal game>
+//   inputs <key letters of the inputs>
+//   locks <state hash after each lock in hexadecimal, separated by space>
+//   finesse <pieces> <keys> <fewest keys> <faults>, only if analyzed
+//   player <name>, only with a result
+//   result <points> <lines removed> <playing seconds>, as the game showed
+class Replay
+{
+public:
+    // Where playing the inputs again first gave a different state.
+    struct Divergence
+    {
+        // Index of the lock and of the input which caused it.
+        int lock = -1;
+        int input = -1;
+
+        uint64_t expected = 0;
+        uint64_t actual = 0;
+    };
+
+    // Result of a finished game as the game showed it, which is what the
+    // high scores list. Checked against the result of playing the inputs.
+    struct Claim
+    {
+        bool present = false;
+        std::string player = "";
+        int points = 0;
+        int lines = 0;
+        int seconds = 0;
+    };
+
+    // Result of playing the inputs again.
+    struct Outcome
+    {
+        int points = 0;
+        int lines = 0;
+        bool over = false;
+
+        // Time the gravity took at the speed of each drop. The game cannot
+        // have been played faster.
+        int64_t gravity_ms = 0;
+    };
+
+    uint32_t seed = 0;
+    GameEngine::Mode mode = GameEngine::NORMAL;
+    std::string inputs = "";
+    std::vector<uint64_t> lock_hashes;
+
+    // Keys of the player compared with the fewest keys. Not used when
+    // playing the game again.
+    FinesseAnalyzer::Totals finesse;
+
+    Claim claim;
+
+    // Start recording a new game.
+    void start(uint32_t seed_value, GameEngine::Mode mode_value = GameEngine::NORMAL);
+
+    // Record an input and its result from the engine.
+    void record(GameEngine::Input input, int result, const GameEngine& engine);
+
+    // Remove the inputs and locks after the given length, when the game
+    // continues from an earlier state.
+    void truncate(int num_inputs, int num_locks);
+
+    bool read(const std::string& file_name);
+    bool write(const std::string& file_name) const;
+
+    // Play the inputs again and compare the state hash after each lock with
+    // lock_hashes. Returns false and the first divergence if they differ.
+    bool verify(Divergence& divergence) const;
+
+    // Same, and the result of the inputs for checking the claim.
+    bool verify(Divergence& divergence, Outcome& outcome) const;
+
+    // Play the inputs again and replace lock_hashes with the result.
+    void update_hashes();
+
+    // Play the inputs on the engine. Returns false if there is an unknown
+    // input letter.
+    bool play(GameEngine& engine) const;
+};
+
+#endif // REPLAY_HH
@@ -0,0 +1,512 @@
+#include "replayarchive.hh"
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+
+const char MAGIC[4] = {'T', 'R', 'P', 'A'};
+const char END_MAGIC[4] = {'T', 'R', 'P', 'E'};
+
+// Bits of the input in a run.
+const uint32_t INPUT_BITS = 4;
+const uint32_t INPUT_MASK = (1 << INPUT_BITS) - 1;
+
+static_assert(GameEngine::NUMBER_OF_INPUTS <= (1 << INPUT_BITS),
+              "Inputs must fit in the run");
+
+void put(std::vector<uint8_t>& bytes, uint64_t value, int num_bytes)
+{
+    for (int i = 0; i < num_bytes; ++i)
+    {
+        bytes.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+void put_magic(std::vector<uint8_t>& bytes, const char* magic)
+{
+    bytes.insert(bytes.end(), magic, magic + 4);
+}
+
+void put_varint(std::vector<uint8_t>& bytes, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+
+    bytes.push_back(uint8_t(value));
+}
+
+uint64_t get(const uint8_t* data, int num_bytes)
+{
+    uint64_t value = 0;
+
+    for (int i = 0; i < num_bytes; ++i)
+    {
+        value |= uint64_t(data[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+bool is_magic(const uint8_t* data, const char* magic)
+{
+    return std::equal(magic, magic + 4, data,
+                      [](char letter, uint8_t byte) { return uint8_t(letter) == byte; });
+}
+
+// Returns false if the varint does not end before the end or is longer
+// than 32 bits.
+bool get_varint(const uint8_t* data, size_t& position, size_t end, uint32_t& value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 32 && position < end; shift += 7)
+    {
+        uint8_t byte = data[position++];
+        value |= uint32_t(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
+
+//*****************************************************************************
+// Writing.
+
+// Keyframes are taken before the input which makes a piece appear, so
+// seeking to a piece starts at its keyframe. A run does not go over a
+// keyframe, so the inputs of each keyframe can be decoded alone.
+bool ReplayArchive::encode(const Replay& replay, int keyframe_pieces,
+                           std::vector<uint8_t>& bytes)
+{
+    keyframe_pieces = std::max(1, std::min(keyframe_pieces, 0xFFFF));
+
+    bytes.clear();
+    put_magic(bytes, MAGIC);
+    put(bytes, VERSION, 2);
+    put(bytes, GameEngine::STATE_SIZE, 2);
+    put(bytes, replay.seed, 4);
+    put(bytes, replay.mode, 2);
+    put(bytes, keyframe_pieces, 2);
+
+    GameEngine engine;
+    engine.reset(replay.seed, replay.mode);
+
+    GameEngine::State state;
+    std::vector<ReplayArchiveView::Keyframe> keyframes;
+    uint32_t pieces = 0;
+
+    GameEngine::Input run_input = GameEngine::SPAWN;
+    uint32_t run_length = 0;
+
+    auto end_run = [&bytes, &run_input, &run_length]()
+    {
+        if (run_length > 0)
+        {
+            put_varint(bytes, ((run_length - 1) << INPUT_BITS) | run_input);
+            run_length = 0;
+        }
+    };
+
+    auto add_keyframe = [&bytes, &engine, &state, &keyframes, &pieces](uint32_t tick)
+    {
+        ReplayArchiveView::Keyframe keyframe;
+        keyframe.offset = bytes.size();
+        keyframe.tick = tick;
+        keyframe.pieces = pieces;
+        keyframes.push_back(keyframe);
+
+        engine.save_state(state);
+        bytes.insert(bytes.end(), state.begin(), state.end());
+    };
+
+    for (uint32_t tick = 0; tick < replay.inputs.size(); ++tick)
+    {
+        GameEngine::Input input;
+
+        if (!GameEngine::input_from_letter(replay.inputs.at(tick), input))
+        {
+            return false;
+        }
+
+        if (tick == 0 || (input == GameEngine::SPAWN && pieces % keyframe_pieces == 0))
+        {
+            end_run();
+            add_keyframe(tick);
+        }
+
+        if (input != run_input)
+        {
+            end_run();
+        }
+
+        run_input = input;
+        run_length += 1;
+
+        if (input == GameEngine::SPAWN)
+        {
+            pieces += 1;
+        }
+
+        engine.apply(input);
+    }
+
+    // A game without inputs still has the keyframe of its start.
+    if (keyframes.empty())
+    {
+        add_keyframe(0);
+    }
+
+    end_run();
+
+    for (const ReplayArchiveView::Keyframe& keyframe : keyframes)
+    {
+        put(bytes, keyframe.offset, 8);
+        put(bytes, keyframe.tick, 4);
+        put(bytes, keyframe.pieces, 4);
+    }
+
+    put(bytes, keyframes.size(), 4);
+    put(bytes, replay.inputs.size(), 4);
+    put(bytes, pieces, 4);
+    put_magic(bytes, END_MAGIC);
+
+    return true;
+}
+
+bool ReplayArchive::write(const std::string& file_name, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream file;
+    file.open(file_name, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    file.close();
+
+    return !file.fail();
+}
+
+bool ReplayArchive::read(const std::string& file_name, std::vector<uint8_t>& bytes)
+{
+    std::ifstream file;
+    file.open(file_name, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    bytes.resize(size_t(file.tellg()));
+    file.seekg(0, std::ios::beg);
+
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+    return file.gcount() == std::streamsize(bytes.size());
+}
+
+//*****************************************************************************
+// Reading.
+
+// Everything the cursors and seeking rely on is checked here, so they only
+// check the inputs.
+bool ReplayArchiveView::open(const uint8_t* data, size_t size)
+{
+    data_ = NULL;
+    size_ = 0;
+
+    const size_t minimum_size = ReplayArchive::HEADER_SIZE + GameEngine::STATE_SIZE +
+            ReplayArchive::INDEX_ENTRY_SIZE + ReplayArchive::TRAILER_SIZE;
+
+    if (data == NULL || size < minimum_size || !is_magic(data, MAGIC) ||
+            !is_magic(data + size - 4, END_MAGIC))
+    {
+        return false;
+    }
+
+    if (get(data + 4, 2) != ReplayArchive::VERSION ||
+            get(data + 6, 2) != GameEngine::STATE_SIZE ||
+            get(data + 12, 2) >= GameEngine::NUMBER_OF_MODES || get(data + 14, 2) == 0)
+    {
+        return false;
+    }
+
+    const uint8_t* trailer = data + size - ReplayArchive::TRAILER_SIZE;
+    uint64_t num_keyframes = get(trailer, 4);
+
+    if (num_keyframes == 0 || num_keyframes > (size - minimum_size) /
+            ReplayArchive::INDEX_ENTRY_SIZE + 1)
+    {
+        return false;
+    }
+
+    data_ = data;
+    size_ = size;
+    seed_ = get(data + 8, 4);
+    mode_ = static_cast<GameEngine::Mode>(get(data + 12, 2));
+    keyframe_pieces_ = int(get(data + 14, 2));
+    num_keyframes_ = int(num_keyframes);
+    num_ticks_ = get(trailer + 4, 4);
+    num_pieces_ = get(trailer + 8, 4);
+    index_offset_ = size - ReplayArchive::TRAILER_SIZE -
+            num_keyframes_ * ReplayArchive::INDEX_ENTRY_SIZE;
+
+    // Keyframes in order, each with room for its state before the next.
+    // The offsets are read from the file, so one is only added to once it
+    // is known to leave room for a state before the index.
+    for (int i = 0; i < num_keyframes_; ++i)
+    {
+        Keyframe current = keyframe(i);
+        uint64_t end = i + 1 < num_keyframes_ ? keyframe(i + 1).offset : index_offset_;
+        bool in_order = i == 0 ? current.offset == ReplayArchive::HEADER_SIZE &&
+                                 current.tick == 0 :
+                                 current.tick > keyframe(i - 1).tick;
+        bool in_file = current.offset <= index_offset_ - GameEngine::STATE_SIZE &&
+                end <= index_offset_ && end >= current.offset + GameEngine::STATE_SIZE;
+
+        if (!in_order || !in_file || current.tick > num_ticks_ || current.pieces > num_pieces_)
+        {
+            data_ = NULL;
+            size_ = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ReplayArchiveView::Keyframe ReplayArchiveView::keyframe(int index) const
+{
+    const uint8_t* entry = data_ + index_offset_ + index * ReplayArchive::INDEX_ENTRY_SIZE;
+
+    Keyframe keyframe;
+    keyframe.offset = get(entry, 8);
+    keyframe.tick = get(entry + 8, 4);
+    keyframe.pieces = get(entry + 12, 4);
+
+    return keyframe;
+}
+
+// Binary search in the index where it is.
+int ReplayArchiveView::keyframe_before(uint32_t tick) const
+{
+    int low = 0;
+    int high = num_keyframes_ - 1;
+
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+
+        if (keyframe(middle).tick <= tick)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return low;
+}
+
+bool ReplayArchiveView::seek(uint32_t tick, GameEngine& engine, Cursor& cursor) const
+{
+    if (data_ == NULL || tick > num_ticks_ ||
+            !restore(keyframe_before(tick), engine, cursor))
+    {
+        return false;
+    }
+
+    GameEngine::Input input;
+
+    while (cursor.tick() < tick)
+    {
+        if (!cursor.next(input))
+        {
+            return false;
+        }
+
+        engine.apply(input);
+    }
+
+    return true;
+}
+
+bool ReplayArchiveView::restore(int keyframe, GameEngine& engine, Cursor& cursor) const
+{
+    if (data_ == NULL || keyframe < 0 || keyframe >= num_keyframes_)
+    {
+        return false;
+    }
+
+    const uint8_t* state_data = data_ + this->keyframe(keyframe).offset;
+
+    GameEngine::State state;
+    std::copy(state_data, state_data + GameEngine::STATE_SIZE, state.begin());
+
+    if (!engine.load_state(state))
+    {
+        return false;
+    }
+
+    cursor.view_ = this;
+    cursor.enter(keyframe);
+
+    return true;
+}
+
+bool ReplayArchiveView::to_replay(Replay& replay) const
+{
+    if (data_ == NULL)
+    {
+        return false;
+    }
+
+    replay.start(seed_, mode_);
+
+    Cursor cursor;
+    cursor.view_ = this;
+    cursor.enter(0);
+
+    GameEngine::Input input;
+
+    while (cursor.next(input))
+    {
+        replay.inputs.push_back(GameEngine::INPUT_LETTERS.at(input));
+    }
+
+    if (replay.inputs.size() != num_ticks_)
+    {
+        return false;
+    }
+
+    replay.update_hashes();
+
+    return true;
+}
+
+bool ReplayArchiveView::verify(Replay::Divergence& divergence) const
+{
+    GameEngine engine;
+    GameEngine expected;
+    Cursor cursor;
+    Cursor unused;
+
+    for (int i = 0; i < num_keyframes_; ++i)
+    {
+        divergence.lock = i;
+        divergence.input = keyframe(i).tick;
+        divergence.expected = 0;
+        divergence.actual = 0;
+
+        if (!restore(i, engine, cursor))
+        {
+            return false;
+        }
+
+        uint32_t end = i + 1 < num_keyframes_ ? keyframe(i + 1).tick : num_ticks_;
+        GameEngine::Input input;
+
+        while (cursor.tick() < end)
+        {
+            if (!cursor.next(input))
+            {
+                divergence.input = cursor.tick();
+                return false;
+            }
+
+            engine.apply(input);
+        }
+
+        if (i + 1 < num_keyframes_)
+        {
+            if (!restore(i + 1, expected, unused) ||
+                    expected.state_hash() != engine.state_hash())
+            {
+                divergence.lock = i + 1;
+                divergence.input = end;
+                divergence.expected = expected.state_hash();
+                divergence.actual = engine.state_hash();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Open has checked the offsets, but a keyframe without room for its state
+// still has no inputs rather than a position past the end.
+void ReplayArchiveView::Cursor::enter(int keyframe)
+{
+    Keyframe current = view_->keyframe(keyframe);
+    uint64_t end = keyframe + 1 < view_->num_keyframes_ ? view_->keyframe(keyframe + 1).offset :
+                                                          view_->index_offset_;
+
+    if (end > view_->index_offset_)
+    {
+        end = view_->index_offset_;
+    }
+
+    keyframe_ = keyframe;
+    end_ = size_t(end);
+    position_ = current.offset <= end && end - current.offset >= GameEngine::STATE_SIZE ?
+                size_t(current.offset + GameEngine::STATE_SIZE) : end_;
+    tick_ = current.tick;
+    run_left_ = 0;
+}
+
+// The inputs of a keyframe must end at the tick of the next one.
+bool ReplayArchiveView::Cursor::next(GameEngine::Input& input)
+{
+    if (view_ == NULL || tick_ >= view_->num_ticks_)
+    {
+        return false;
+    }
+
+    while (run_left_ == 0)
+    {
+        if (position_ >= end_)
+        {
+            if (keyframe_ + 1 >= view_->num_keyframes_ ||
+                    view_->keyframe(keyframe_ + 1).tick != tick_)
+            {
+                return false;
+            }
+
+            enter(keyframe_ + 1);
+            continue;
+        }
+
+        uint32_t value = 0;
+
+        if (!get_varint(view_->data_, position_, end_, value) ||
+                (value & INPUT_MASK) >= GameEngine::NUMBER_OF_INPUTS)
+        {
+            return false;
+        }
+
+        run_input_ = static_cast<GameEngine::Input>(value & INPUT_MASK);
+        run_left_ = (value >> INPUT_BITS) + 1;
+    }
+
+    input = run_input_;
+    run_left_ -= 1;
+    tick_ += 1;
+
+    return true;
+}
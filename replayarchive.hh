@@ -0,0 +1,148 @@
+#ifndef REPLAYARCHIVE_HH
+#define REPLAYARCHIVE_HH
+
+#include "gameengine.hh"
+#include "replay.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Recorded game in a binary file which can be played from any tick. A tick
+// is one input, and tick t is the game before its input t. The state of the
+// game is stored as a keyframe every few pieces, so seeking restores the
+// keyframe before the tick and plays at most that many pieces of inputs.
+//
+// The file is read where it is, so it can be mapped into memory and
+// iterated without copying. Nothing in it points to memory and every
+// integer has a fixed size and order.
+//
+// Binary file format, integers in little endian order:
+//   Header, 16 bytes:
+//     4 bytes  "TRPA"
+//     2 bytes  version
+//     2 bytes  size of the state of the engine
+//     4 bytes  seed
+//     2 bytes  GameEngine::Mode
+//     2 bytes  pieces between keyframes
+//   Keyframes, one after the other, the first at tick 0:
+//     the state written by GameEngine::save_state
+//     the inputs until the next keyframe, each run of the same input as
+//     a varint of (length of the run - 1) * 16 + input, 7 bits in a byte
+//     with the high bit set if more bytes follow
+//   Seek index, 16 bytes for each keyframe:
+//     8 bytes  offset of the keyframe in the file
+//     4 bytes  tick of the keyframe
+//     4 bytes  pieces which appeared before the keyframe
+//   Trailer, 16 bytes:
+//     4 bytes  number of keyframes
+//     4 bytes  number of ticks
+//     4 bytes  number of pieces
+//     4 bytes  "TRPE"
+class ReplayArchive
+{
+public:
+    static constexpr uint16_t VERSION = 1;
+    static constexpr int HEADER_SIZE = 16;
+    static constexpr int INDEX_ENTRY_SIZE = 16;
+    static constexpr int TRAILER_SIZE = 16;
+
+    // Pieces between keyframes when not given.
+    static constexpr int DEFAULT_KEYFRAME_PIECES = 32;
+
+    // Bytes of the archive of the replay. Returns false if the replay has
+    // an unknown input.
+    static bool encode(const Replay& replay, int keyframe_pieces, std::vector<uint8_t>& bytes);
+
+    static bool write(const std::string& file_name, const std::vector<uint8_t>& bytes);
+
+    // Whole file, for readers which do not map it.
+    static bool read(const std::string& file_name, std::vector<uint8_t>& bytes);
+};
+
+// Archive read in the memory where it is. The memory must stay while the
+// view and its cursors are used.
+class ReplayArchiveView
+{
+public:
+    struct Keyframe
+    {
+        uint64_t offset = 0;
+        uint32_t tick = 0;
+        uint32_t pieces = 0;
+    };
+
+    // Inputs in order from a tick, decoded where they are. Moves over the
+    // keyframes without looking at them.
+    class Cursor
+    {
+    public:
+        // Next input. Returns false at the end or at a broken run.
+        bool next(GameEngine::Input& input);
+
+        // Tick of the next input.
+        uint32_t tick() const { return tick_; }
+
+    private:
+        friend class ReplayArchiveView;
+
+        // Start of the keyframe and the end of its inputs.
+        void enter(int keyframe);
+
+        const ReplayArchiveView* view_ = NULL;
+        int keyframe_ = 0;
+        size_t position_ = 0;
+        size_t end_ = 0;
+        uint32_t tick_ = 0;
+
+        GameEngine::Input run_input_ = GameEngine::SPAWN;
+        uint32_t run_left_ = 0;
+    };
+
+    // Check the header, the index and the trailer. Returns false if the
+    // bytes are not an archive of this version.
+    bool open(const uint8_t* data, size_t size);
+
+    uint32_t seed() const { return seed_; }
+    GameEngine::Mode mode() const { return mode_; }
+    int keyframe_pieces() const { return keyframe_pieces_; }
+
+    uint32_t num_ticks() const { return num_ticks_; }
+    uint32_t num_pieces() const { return num_pieces_; }
+    int num_keyframes() const { return num_keyframes_; }
+
+    Keyframe keyframe(int index) const;
+
+    // Last keyframe at or before the tick.
+    int keyframe_before(uint32_t tick) const;
+
+    // Game at the tick on the engine, and the cursor at its input. Returns
+    // false if the tick is after the end or the keyframe is not valid.
+    bool seek(uint32_t tick, GameEngine& engine, Cursor& cursor) const;
+
+    // Game at the keyframe, and the cursor at its first input.
+    bool restore(int keyframe, GameEngine& engine, Cursor& cursor) const;
+
+    // Inputs as the letters of a replay.
+    bool to_replay(Replay& replay) const;
+
+    // Play the inputs of each keyframe from its state and compare the
+    // state hash with the next keyframe. Returns false and the keyframe
+    // which differs as the lock of the divergence.
+    bool verify(Replay::Divergence& divergence) const;
+
+private:
+    const uint8_t* data_ = NULL;
+    size_t size_ = 0;
+
+    uint32_t seed_ = 0;
+    GameEngine::Mode mode_ = GameEngine::NORMAL;
+    int keyframe_pieces_ = 0;
+
+    uint32_t num_ticks_ = 0;
+    uint32_t num_pieces_ = 0;
+    int num_keyframes_ = 0;
+    size_t index_offset_ = 0;
+};
+
+#endif // REPLAYARCHIVE_HH
@@ -0,0 +1,52 @@
+#include "rewindbuffer.hh"
+
+void RewindBuffer::clear()
+{
+    head_ = 0;
+    size_ = 0;
+}
+
+// Overwrite the oldest entry when the buffer is full.
+void RewindBuffer::push(const GameEngine& engine, int num_inputs, int num_locks)
+{
+    Entry& entry = entries_.at(head_);
+
+    engine.save_state(entry.state);
+    entry.num_inputs = num_inputs;
+    entry.num_locks = num_locks;
+
+    head_ = (head_ + 1) % CAPACITY;
+
+    if (size_ < CAPACITY)
+    {
+        size_ += 1;
+    }
+}
+
+int RewindBuffer::size() const
+{
+    return size_;
+}
+
+const RewindBuffer::Entry* RewindBuffer::at(int steps_back) const
+{
+    if (steps_back < 0 || steps_back >= size_)
+    {
+        return NULL;
+    }
+
+    return &entries_.at((head_ - 1 - steps_back + CAPACITY) % CAPACITY);
+}
+
+const RewindBuffer::Entry* RewindBuffer::rewind(int steps)
+{
+    if (steps < 0 || steps >= size_)
+    {
+        return NULL;
+    }
+
+    head_ = (head_ - steps + CAPACITY) % CAPACITY;
+    size_ -= steps;
+
+    return at(0);
+}
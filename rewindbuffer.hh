@@ -0,0 +1,51 @@
+#ifndef REWINDBUFFER_HH
+#define REWINDBUFFER_HH
+
+#include "gameengine.hh"
+#include <array>
+#include <cstddef>
+
+// States of the game after the last CAPACITY locks for undoing placements
+// of tetrominos. The states are kept in a ring buffer so the oldest one is
+// overwritten and the memory used does not grow during the game.
+class RewindBuffer
+{
+public:
+    static constexpr int CAPACITY = 64;
+
+    struct Entry
+    {
+        GameEngine::State state = {};
+
+        // Length of the replay when the state was taken, so the replay can
+        // be cut to continue from the state.
+        int num_inputs = 0;
+        int num_locks = 0;
+    };
+
+    void clear();
+
+    // Store the state of the game as the newest entry.
+    void push(const GameEngine& engine, int num_inputs, int num_locks);
+
+    // Number of states stored.
+    int size() const;
+
+    // Entry the given number of locks before the newest one. NULL if it is
+    // not stored any more.
+    const Entry* at(int steps_back) const;
+
+    // Remove the newest steps entries and return the entry which is then
+    // the newest one. NULL and nothing is removed if there are not enough
+    // entries.
+    const Entry* rewind(int steps);
+
+private:
+    std::array<Entry, CAPACITY> entries_;
+
+    // Index where the next entry is stored.
+    int head_ = 0;
+    int size_ = 0;
+};
+
+#endif // REWINDBUFFER_HH
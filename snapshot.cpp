@@ -0,0 +1,109 @@
+#include "snapshot.hh"
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+namespace
+{
+const char MAGIC[4] = {'T', 'S', 'N', 'P'};
+}
+
+// Take the state of the game.
+void Snapshot::take(const GameEngine& engine, uint32_t seconds)
+{
+    playing_seconds = seconds;
+    engine.save_state(state);
+}
+
+// Continue the game from the snapshot.
+bool Snapshot::restore(GameEngine& engine) const
+{
+    return engine.load_state(state);
+}
+
+// Write the snapshot with one write call.
+bool Snapshot::write(const std::string& file_name) const
+{
+    std::array<uint8_t, FILE_SIZE> bytes = {};
+
+    for (int i = 0; i < 4; ++i)
+    {
+        bytes.at(i) = MAGIC[i];
+    }
+
+    bytes.at(4) = uint8_t(VERSION);
+    bytes.at(5) = uint8_t(VERSION >> 8);
+    bytes.at(6) = uint8_t(GameEngine::STATE_SIZE);
+    bytes.at(7) = uint8_t(GameEngine::STATE_SIZE >> 8);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        bytes.at(8 + i) = uint8_t(playing_seconds >> (8 * i));
+    }
+
+    bytes.at(12) = practice ? 1 : 0;
+
+    std::copy(state.begin(), state.end(), bytes.begin() + HEADER_SIZE);
+
+    std::ofstream file;
+    file.open(file_name, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    file.close();
+
+    return !file.fail();
+}
+
+// Read the snapshot and check its header.
+bool Snapshot::read(const std::string& file_name)
+{
+    std::ifstream file;
+    file.open(file_name, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::array<uint8_t, FILE_SIZE> bytes = {};
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+    // The file must have exactly the size of this version.
+    if (file.gcount() != FILE_SIZE || file.peek() != EOF)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (bytes.at(i) != uint8_t(MAGIC[i]))
+        {
+            return false;
+        }
+    }
+
+    uint16_t version = bytes.at(4) | (bytes.at(5) << 8);
+    uint16_t state_size = bytes.at(6) | (bytes.at(7) << 8);
+
+    if (version != VERSION || state_size != GameEngine::STATE_SIZE)
+    {
+        return false;
+    }
+
+    playing_seconds = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        playing_seconds |= uint32_t(bytes.at(8 + i)) << (8 * i);
+    }
+
+    practice = (bytes.at(12) & 1) != 0;
+
+    std::copy(bytes.begin() + HEADER_SIZE, bytes.end(), state.begin());
+
+    return true;
+}
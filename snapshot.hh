@@ -0,0 +1,46 @@
+#ifndef SNAPSHOT_HH
+#define SNAPSHOT_HH
+
+#include "gameengine.hh"
+#include <cstdint>
+#include <string>
+
+// Saved game which is not finished: the state of the GameEngine, the
+// playing time and whether it is practice. Small enough to be taken after
+// every tetromino.
+//
+// Binary file format, integers in little endian order:
+//   4 bytes  "TSNP"
+//   2 bytes  version
+//   2 bytes  size of the state of the engine
+//   4 bytes  playing time in seconds
+//   4 bytes  flags, bit 0 set in practice
+//   the state written by GameEngine::save_state
+class Snapshot
+{
+public:
+    static constexpr uint16_t VERSION = 4;
+    static constexpr int HEADER_SIZE = 16;
+    static constexpr int FILE_SIZE = HEADER_SIZE + GameEngine::STATE_SIZE;
+
+    uint32_t playing_seconds = 0;
+
+    // The game was rewound, so it does not count for the high scores.
+    bool practice = false;
+    GameEngine::State state = {};
+
+    // Take the state of the game.
+    void take(const GameEngine& engine, uint32_t seconds);
+
+    // Continue the game from the snapshot. Returns false if the state
+    // is not valid.
+    bool restore(GameEngine& engine) const;
+
+    bool write(const std::string& file_name) const;
+
+    // Returns false if the file does not exist or is not a snapshot of
+    // this version.
+    bool read(const std::string& file_name);
+};
+
+#endif // SNAPSHOT_HH
@@ -0,0 +1,127 @@
+#include "spectatorserver.hh"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <algorithm>
+
+SpectatorServer::SpectatorServer(QObject* parent) :
+    QObject(parent)
+{
+    keyframe_clock_.start();
+}
+
+bool SpectatorServer::listen(const QString& name)
+{
+    server_ = new QLocalServer(this);
+
+    // Server left by a program which crashed.
+    QLocalServer::removeServer(name);
+
+    connect(server_, &QLocalServer::newConnection,
+            this, &SpectatorServer::accept_viewer);
+
+    return server_->listen(name);
+}
+
+// The messages are made once and written to every viewer. Writes are
+// buffered by the sockets and sent by the event loop, so nothing here
+// waits for a viewer.
+void SpectatorServer::publish(const GameEngine& engine)
+{
+    if (viewers_.empty())
+    {
+        // The state sent last is old when the next viewer joins.
+        keyframe_requested_ = true;
+        return;
+    }
+
+    changes_.clear();
+    keyframe_.clear();
+
+    if (keyframe_requested_ || keyframe_clock_.elapsed() >= KEYFRAME_INTERVAL)
+    {
+        encoder_.encode_keyframe(engine, keyframe_);
+
+        keyframe_requested_ = false;
+        keyframe_clock_.restart();
+
+        for (Viewer& viewer : viewers_)
+        {
+            viewer.needs_keyframe = true;
+        }
+    }
+    else
+    {
+        encoder_.encode_changes(engine, changes_);
+    }
+
+    for (Viewer& viewer : viewers_)
+    {
+        int64_t pending = viewer.socket->bytesToWrite();
+
+        if (viewer.needs_keyframe)
+        {
+            // Wait until the viewer has read most of what it was sent.
+            if (pending > MAX_PENDING_BYTES / 2)
+            {
+                continue;
+            }
+
+            if (keyframe_.empty())
+            {
+                encoder_.encode_keyframe(engine, keyframe_);
+            }
+
+            viewer.socket->write(reinterpret_cast<const char*>(keyframe_.data()),
+                                 keyframe_.size());
+            viewer.needs_keyframe = false;
+            continue;
+        }
+
+        if (changes_.empty())
+        {
+            continue;
+        }
+
+        // Skip the viewer until the next keyframe instead of letting its
+        // buffer grow.
+        if (pending + int64_t(changes_.size()) > MAX_PENDING_BYTES)
+        {
+            viewer.needs_keyframe = true;
+            continue;
+        }
+
+        viewer.socket->write(reinterpret_cast<const char*>(changes_.data()),
+                             changes_.size());
+    }
+}
+
+void SpectatorServer::accept_viewer()
+{
+    QLocalSocket* socket = server_->nextPendingConnection();
+
+    while (socket != NULL)
+    {
+        Viewer viewer;
+        viewer.socket = socket;
+        viewers_.push_back(viewer);
+
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]()
+        {
+            remove_viewer(socket);
+        });
+
+        socket = server_->nextPendingConnection();
+    }
+}
+
+void SpectatorServer::remove_viewer(QLocalSocket* socket)
+{
+    viewers_.erase(std::remove_if(viewers_.begin(), viewers_.end(),
+                                  [socket](const Viewer& viewer)
+                                  {
+                                      return viewer.socket == socket;
+                                  }),
+                   viewers_.end());
+
+    socket->deleteLater();
+}
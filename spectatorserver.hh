@@ -0,0 +1,65 @@
+#ifndef SPECTATORSERVER_HH
+#define SPECTATORSERVER_HH
+
+#include "spectatorstream.hh"
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <vector>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Publishes the game to any number of viewers over a local server. Writing
+// never waits for a viewer: a viewer which has more than MAX_PENDING_BYTES
+// not yet read skips the changes and gets a keyframe when it catches up,
+// so a slow viewer does not slow the game.
+class SpectatorServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Bytes written to a viewer but not yet sent, before it is skipped.
+    static constexpr int MAX_PENDING_BYTES = 64 * 1024;
+
+    // Time between keyframes sent to all viewers in milliseconds.
+    static constexpr int KEYFRAME_INTERVAL = 2000;
+
+    explicit SpectatorServer(QObject* parent = 0);
+
+    // Returns false if the server cannot listen.
+    bool listen(const QString& name);
+
+    // Send what changed in the game since the last call to every viewer.
+    void publish(const GameEngine& engine);
+
+private slots:
+    void accept_viewer();
+
+private:
+    struct Viewer
+    {
+        QLocalSocket* socket = NULL;
+
+        // Set when the viewer skipped changes or has just joined.
+        bool needs_keyframe = true;
+    };
+
+    void remove_viewer(QLocalSocket* socket);
+
+    QLocalServer* server_ = NULL;
+    std::vector<Viewer> viewers_;
+
+    SpectatorEncoder encoder_;
+
+    // Messages of the last publish, reused so publishing does not allocate.
+    std::vector<uint8_t> changes_;
+    std::vector<uint8_t> keyframe_;
+
+    QElapsedTimer keyframe_clock_;
+
+    // Set when the state sent last is not known by any viewer.
+    bool keyframe_requested_ = true;
+};
+
+#endif // SPECTATORSERVER_HH
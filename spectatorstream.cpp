@@ -0,0 +1,389 @@
+#include "spectatorstream.hh"
+#include <algorithm>
+
+namespace
+{
+
+// Start a message. The size of the payload is filled by end_message.
+size_t begin_message(std::vector<uint8_t>& out, Spectator::Message_type type)
+{
+    size_t start = out.size();
+
+    out.push_back(uint8_t(type));
+    out.push_back(0);
+    out.push_back(0);
+
+    return start;
+}
+
+void end_message(std::vector<uint8_t>& out, size_t start)
+{
+    size_t size = out.size() - start - Spectator::HEADER_SIZE;
+
+    out.at(start + 1) = uint8_t(size);
+    out.at(start + 2) = uint8_t(size >> 8);
+}
+
+void put_u16(std::vector<uint8_t>& out, uint16_t value)
+{
+    out.push_back(uint8_t(value));
+    out.push_back(uint8_t(value >> 8));
+}
+
+void put_u32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+uint32_t get_u32(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t(data[3]) << 24);
+}
+
+bool is_valid_piece(int type, int color)
+{
+    return type < GameEngine::NUMBER_OF_TETROMINOS && color < GameEngine::NUM_COLORS;
+}
+
+bool same_piece(const Piece& first, const Piece& second)
+{
+    if (first.type != second.type || first.color != second.color)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+    {
+        if (first.squares.at(i).x != second.squares.at(i).x ||
+                first.squares.at(i).y != second.squares.at(i).y)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+//*****************************************************************************
+// SpectatorEncoder
+
+void SpectatorEncoder::encode_keyframe(const GameEngine& engine,
+                                       std::vector<uint8_t>& out)
+{
+    GameEngine::State state;
+    engine.save_state(state);
+
+    size_t start = begin_message(out, Spectator::KEYFRAME);
+    out.insert(out.end(), state.begin(), state.end());
+    end_message(out, start);
+
+    last_ = engine;
+    has_last_ = true;
+}
+
+// Each part of the game has its own message so a moving tetromino costs
+// only a PIECE message.
+void SpectatorEncoder::encode_changes(const GameEngine& engine,
+                                      std::vector<uint8_t>& out)
+{
+    if (!has_last_)
+    {
+        encode_keyframe(engine, out);
+        return;
+    }
+
+    const Board& board = engine.board();
+    const Board& last_board = last_.board();
+
+    // Rows changed by locks and removed lines.
+    int num_rows = 0;
+
+    for (int y = 0; y < Board::ROWS; ++y)
+    {
+        if (board.rows.at(y) != last_board.rows.at(y) ||
+                board.colors.at(y) != last_board.colors.at(y))
+        {
+            num_rows += 1;
+        }
+    }
+
+    if (num_rows > 0)
+    {
+        size_t start = begin_message(out, Spectator::ROWS);
+        out.push_back(uint8_t(num_rows));
+
+        for (int y = 0; y < Board::ROWS; ++y)
+        {
+            uint16_t mask = board.rows.at(y);
+
+            if (mask == last_board.rows.at(y) &&
+                    board.colors.at(y) == last_board.colors.at(y))
+            {
+                continue;
+            }
+
+            out.push_back(uint8_t(y));
+            put_u16(out, mask);
+
+            for (int x = 0; x < Board::COLUMNS; ++x)
+            {
+                if ((mask >> x) & 1)
+                {
+                    out.push_back(board.colors.at(y).at(x));
+                }
+            }
+        }
+
+        end_message(out, start);
+    }
+
+    // Moving tetromino.
+    if (engine.is_piece_active() != last_.is_piece_active() ||
+            (engine.is_piece_active() &&
+             !same_piece(engine.current(), last_.current())))
+    {
+        size_t start = begin_message(out, Spectator::PIECE);
+        out.push_back(engine.is_piece_active());
+
+        if (engine.is_piece_active())
+        {
+            const Piece& piece = engine.current();
+
+            out.push_back(uint8_t(piece.type));
+            out.push_back(uint8_t(piece.color));
+
+            for (const Coord& c : piece.squares)
+            {
+                out.push_back(uint8_t(c.x));
+                out.push_back(uint8_t(c.y));
+            }
+        }
+
+        end_message(out, start);
+    }
+
+    // Next and hold tetrominos.
+    if (engine.next().type != last_.next().type ||
+            engine.next().color != last_.next().color ||
+            engine.is_hold_empty() != last_.is_hold_empty() ||
+            engine.hold().type != last_.hold().type ||
+            engine.hold().color != last_.hold().color)
+    {
+        size_t start = begin_message(out, Spectator::PREVIEW);
+
+        out.push_back(uint8_t(engine.next().type));
+        out.push_back(uint8_t(engine.next().color));
+        out.push_back(engine.is_hold_empty());
+        out.push_back(uint8_t(engine.hold().type));
+        out.push_back(uint8_t(engine.hold().color));
+
+        end_message(out, start);
+    }
+
+    if (engine.points() != last_.points() ||
+            engine.lines_removed() != last_.lines_removed() ||
+            engine.tetris_points() != last_.tetris_points() ||
+            engine.level() != last_.level() ||
+            engine.is_over() != last_.is_over())
+    {
+        size_t start = begin_message(out, Spectator::SCORE);
+
+        put_u32(out, engine.points());
+        put_u32(out, engine.lines_removed());
+        put_u32(out, engine.tetris_points());
+        out.push_back(uint8_t(engine.level()));
+        out.push_back(engine.is_over());
+
+        end_message(out, start);
+    }
+
+    last_ = engine;
+}
+
+
+//*****************************************************************************
+// SpectatorView
+
+// Values are checked so a broken stream cannot write outside the board.
+int SpectatorView::apply(const uint8_t* data, int size)
+{
+    if (size < Spectator::HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    int type = data[0];
+    int payload_size = data[1] | (data[2] << 8);
+    int message_size = Spectator::HEADER_SIZE + payload_size;
+
+    if (type >= Spectator::NUMBER_OF_TYPES)
+    {
+        return -1;
+    }
+
+    if (size < message_size)
+    {
+        return 0;
+    }
+
+    const uint8_t* payload = data + Spectator::HEADER_SIZE;
+
+    if (type == Spectator::KEYFRAME)
+    {
+        GameEngine::State state;
+        GameEngine engine;
+
+        if (payload_size != GameEngine::STATE_SIZE)
+        {
+            return -1;
+        }
+
+        std::copy(payload, payload + payload_size, state.begin());
+
+        if (!engine.load_state(state))
+        {
+            return -1;
+        }
+
+        board = engine.board();
+        current = engine.current();
+        next = engine.next();
+        hold = engine.hold();
+        piece_active = engine.is_piece_active();
+        hold_empty = engine.is_hold_empty();
+        points = engine.points();
+        lines_removed = engine.lines_removed();
+        tetris_points = engine.tetris_points();
+        level = engine.level();
+        game_over = engine.is_over();
+
+        has_keyframe = true;
+        return message_size;
+    }
+
+    if (!has_keyframe)
+    {
+        return message_size;
+    }
+
+    if (type == Spectator::ROWS)
+    {
+        if (payload_size < 1)
+        {
+            return -1;
+        }
+
+        int offset = 1;
+
+        for (int i = 0; i < payload[0]; ++i)
+        {
+            if (offset + 3 > payload_size)
+            {
+                return -1;
+            }
+
+            int y = payload[offset];
+            uint16_t mask = payload[offset + 1] | (payload[offset + 2] << 8);
+            offset += 3;
+
+            if (y >= Board::ROWS || (mask & ~Board::FULL_ROW) != 0)
+            {
+                return -1;
+            }
+
+            std::array<uint8_t, Board::COLUMNS> row_colors = {};
+
+            for (int x = 0; x < Board::COLUMNS; ++x)
+            {
+                if (!((mask >> x) & 1))
+                {
+                    continue;
+                }
+
+                if (offset >= payload_size ||
+                        payload[offset] >= GameEngine::NUM_COLORS)
+                {
+                    return -1;
+                }
+
+                row_colors.at(x) = payload[offset];
+                offset += 1;
+            }
+
+            board.copy_row(y, mask, row_colors);
+        }
+    }
+    else if (type == Spectator::PIECE)
+    {
+        if (payload_size < 1)
+        {
+            return -1;
+        }
+
+        piece_active = payload[0];
+
+        if (piece_active)
+        {
+            if (payload_size != 3 + 2 * Piece::NUM_SQUARE)
+            {
+                return -1;
+            }
+
+            if (!is_valid_piece(payload[1], payload[2]))
+            {
+                return -1;
+            }
+
+            current.type = payload[1];
+            current.color = payload[2];
+
+            for (int i = 0; i < Piece::NUM_SQUARE; ++i)
+            {
+                Coord& c = current.squares.at(i);
+                c.x = int8_t(payload[3 + 2 * i]);
+                c.y = int8_t(payload[4 + 2 * i]);
+
+                // Squares may be above the board after a turn.
+                if (c.x < 0 || c.x >= Board::COLUMNS ||
+                        c.y < -Piece::NUM_SQUARE || c.y >= Board::ROWS)
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+    else if (type == Spectator::PREVIEW)
+    {
+        if (payload_size != 5 || !is_valid_piece(payload[0], payload[1]) ||
+                !is_valid_piece(payload[3], payload[4]))
+        {
+            return -1;
+        }
+
+        next.type = payload[0];
+        next.color = payload[1];
+        hold_empty = payload[2];
+        hold.type = payload[3];
+        hold.color = payload[4];
+    }
+    else if (type == Spectator::SCORE)
+    {
+        if (payload_size != 14)
+        {
+            return -1;
+        }
+
+        points = get_u32(payload);
+        lines_removed = get_u32(payload + 4);
+        tetris_points = get_u32(payload + 8);
+        level = payload[12];
+        game_over = payload[13];
+    }
+
+    return message_size;
+}
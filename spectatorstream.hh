@@ -0,0 +1,76 @@
+#ifndef SPECTATORSTREAM_HH
+#define SPECTATORSTREAM_HH
+
+#include "gameengine.hh"
+#include <cstdint>
+#include <vector>
+
+// Stream of a game for spectators: a keyframe with the whole state and
+// then only what changed. Both the game and the viewers use these classes
+// so they agree on the format.
+//
+// Every message is, integers in little endian order:
+//   1 byte   type
+//   2 bytes  size of the payload
+//   payload
+//
+// Payloads:
+//   KEYFRAME  the state written by GameEngine::save_state
+//   ROWS      1 byte count, then for each row: 1 byte y, 2 bytes mask and
+//             the palette index of each occupied cell
+//   PIECE     1 byte active, and if active: type, color and x, y of the
+//             squares, 1 byte each. y is signed since squares may be above
+//             the board
+//   PREVIEW   type and color of next, 1 byte hold empty, type and color
+//             of hold
+//   SCORE     4 bytes points, lines and tetris points, 1 byte level and
+//             1 byte game over
+namespace Spectator
+{
+enum Message_type {KEYFRAME, ROWS, PIECE, PREVIEW, SCORE, NUMBER_OF_TYPES};
+
+static constexpr int HEADER_SIZE = 3;
+}
+
+// Makes the messages of a game. Remembers the state sent last and compares
+// with it, so the game does not need to report its changes.
+class SpectatorEncoder
+{
+public:
+    // Append the whole state. Following changes are compared with it.
+    void encode_keyframe(const GameEngine& engine, std::vector<uint8_t>& out);
+
+    // Append messages for what changed since the last call. Appends a
+    // keyframe if nothing was sent yet.
+    void encode_changes(const GameEngine& engine, std::vector<uint8_t>& out);
+
+private:
+    GameEngine last_;
+    bool has_last_ = false;
+};
+
+// Game as a viewer sees it, made from the messages.
+class SpectatorView
+{
+public:
+    Board board;
+    Piece current;
+    Piece next;
+    Piece hold;
+    bool piece_active = false;
+    bool hold_empty = true;
+    int points = 0;
+    int lines_removed = 0;
+    int tetris_points = 0;
+    int level = 0;
+    bool game_over = false;
+
+    // Changes are ignored until the first keyframe.
+    bool has_keyframe = false;
+
+    // Apply the first message of the bytes. Returns the size of the
+    // message, 0 if it has not arrived completely or -1 if it is not valid.
+    int apply(const uint8_t* data, int size);
+};
+
+#endif // SPECTATORSTREAM_HH
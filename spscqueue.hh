@@ -0,0 +1,61 @@
+#ifndef SPSCQUEUE_HH
+#define SPSCQUEUE_HH
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Queue between exactly one producer thread and one consumer thread.
+// Neither side ever waits for the other: push fails when the queue is
+// full and pop fails when it is empty.
+//
+// The producer only writes tail_ and the consumer only writes head_, so
+// no locks are needed. The indexes are on their own cache lines so the
+// threads do not slow each other down.
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+public:
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "Capacity must be a power of two");
+
+    // Called by the producer. Returns false if the queue is full.
+    bool push(const T& value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail - head_.load(std::memory_order_acquire) == CAPACITY)
+        {
+            return false;
+        }
+
+        items_[tail & (CAPACITY - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Called by the consumer. Returns false if the queue is empty.
+    bool pop(T& value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = items_[head & (CAPACITY - 1)];
+        head_.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+private:
+    std::array<T, CAPACITY> items_;
+
+    alignas(64) std::atomic<size_t> head_ {0};
+    alignas(64) std::atomic<size_t> tail_ {0};
+};
+
+#endif // SPSCQUEUE_HH
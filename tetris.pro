@@ -4,13 +4,15 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = hanoi
 TEMPLATE = app
 
+CONFIG += c++17
+
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which has been marked as deprecated (the exact warnings
 # depend on your compiler). Please consult the documentation of the
@@ -24,14 +26,29 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 
 SOURCES += \
+        blockarena.cpp \
+        botplugin.cpp \
+        externalbot.cpp \
         main.cpp \
-        mainwindow.cpp
+        mainwindow.cpp \
+        perfcounters.cpp \
+        spectatorserver.cpp \
+        versuslink.cpp
 
 HEADERS += \
-        mainwindow.hh
+        blockarena.hh \
+        botplugin.hh \
+        botpluginabi.h \
+        externalbot.hh \
+        mainwindow.hh \
+        perfcounters.hh \
+        spectatorserver.hh \
+        versuslink.hh
 
 FORMS += \
         mainwindow.ui
 
+include(engine.pri)
+
 
 
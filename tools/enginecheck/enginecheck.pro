@@ -0,0 +1,16 @@
+# Checks of the engine which the golden replays do not cover.
+
+TARGET = enginecheck
+TEMPLATE = app
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+SOURCES += \
+        main.cpp \
+        ../../perfcounters.cpp
+
+HEADERS += \
+        ../../perfcounters.hh
+
+include(../../engine.pri)
@@ -0,0 +1,517 @@
+// Engine self check.
+//
+// Checks of the engine which the golden replays do not cover. Each check
+// prints one line and the program fails if any check fails.
+//
+//   allocations  seeded games of every set of rules and every mode are
+//                played with random inputs, and after the first game no
+//                move, lock or rewind may call new
+//   states       the state after every input of random games is saved and
+//                loaded again to the same state hash
+//   garbage      garbage rows with the empty cell outside the board are
+//                ignored
+//   finesse      tetrominos dropped straight down, with a fall or with
+//                gravity, are not faults, and ones moved back and forth are
+//   turns        states with the points taken away by many turns, below
+//                zero, load again
+//   damaged      states with squares of a tetromino too far apart do not
+//                load, and a state with any byte changed which loads saves
+//                as it loaded
+//   names        replays with names of the player which are empty or have
+//                spaces read back with the same name and result
+//   archive      archives with offsets of keyframes past the index, or so
+//                large that adding the size of a state wraps, do not open
+//
+// Usage:
+//   enginecheck [--games <n>] [--seed <n>]
+
+#include "finesse.hh"
+#include "gameengine.hh"
+#include "perfcounters.hh"
+#include "replay.hh"
+#include "replayarchive.hh"
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Options
+{
+    int games = 200;
+    uint32_t seed = 1;
+};
+
+// Random input of a player, biased to moves which keep the game going.
+GameEngine::Input random_input(std::mt19937& random)
+{
+    static constexpr std::array<GameEngine::Input, 12> INPUTS =
+    {GameEngine::LEFT, GameEngine::RIGHT, GameEngine::ROTATE, GameEngine::REFLECT,
+     GameEngine::SOFT_FALL, GameEngine::HARD_FALL, GameEngine::HOLD,
+     GameEngine::GRAVITY, GameEngine::GRAVITY, GameEngine::GRAVITY,
+     GameEngine::LEFT, GameEngine::RIGHT};
+
+    return INPUTS.at(random() % INPUTS.size());
+}
+
+// Play random games and count the calls of new after the first one. The
+// state after every lock is loaded again, as the rewind of the game does.
+// Returns the number of inputs which allocated.
+template <typename Rules>
+int count_allocating_inputs(const Options& options, GameCoreBase::Mode mode,
+                            int& inputs_played)
+{
+    std::mt19937 random(options.seed);
+    GameCore<Rules> game;
+    typename GameCore<Rules>::State state;
+
+    int allocating = 0;
+
+    for (int g = 0; g <= options.games; ++g)
+    {
+        game.reset(random(), mode);
+
+        while (!game.is_over())
+        {
+            GameEngine::Input input = game.is_piece_active() ? random_input(random)
+                                                             : GameEngine::SPAWN;
+
+            int64_t before = PerfCounters::get(PerfCounters::HEAP_ALLOCATIONS);
+
+            int result = game.apply(input);
+
+            if (result & GameEngine::LOCKED)
+            {
+                game.save_state(state);
+                game.load_state(state);
+            }
+
+            // The first game warms up the tables which are made on first
+            // use.
+            if (g == 0)
+            {
+                continue;
+            }
+
+            inputs_played += 1;
+
+            if (PerfCounters::get(PerfCounters::HEAP_ALLOCATIONS) != before)
+            {
+                if (allocating == 0)
+                {
+                    printf("  input %c allocated in game %d\n",
+                           GameEngine::INPUT_LETTERS.at(input), g);
+                }
+
+                allocating += 1;
+            }
+        }
+    }
+
+    return allocating;
+}
+
+template <typename Rules>
+bool check_allocations(const Options& options, const char* rules_name)
+{
+    bool passed = true;
+
+    for (int mode = 0; mode < GameCoreBase::NUMBER_OF_MODES; ++mode)
+    {
+        int inputs = 0;
+        int allocating = count_allocating_inputs<Rules>(
+                    options, static_cast<GameCoreBase::Mode>(mode), inputs);
+
+        printf("%s allocations %s mode %d: %d of %d inputs allocated\n",
+               allocating == 0 ? "passed" : "FAILED", rules_name, mode,
+               allocating, inputs);
+
+        passed = passed && allocating == 0;
+    }
+
+    return passed;
+}
+
+// Save and load the state after every input of random games.
+template <typename Rules>
+bool check_states(const Options& options, const char* rules_name)
+{
+    std::mt19937 random(options.seed);
+    GameCore<Rules> game;
+    GameCore<Rules> loaded;
+    typename GameCore<Rules>::State state;
+
+    int checked = 0;
+    int failed = 0;
+
+    for (int g = 0; g < options.games; ++g)
+    {
+        game.reset(random(), static_cast<GameCoreBase::Mode>(g % GameCoreBase::NUMBER_OF_MODES));
+        game.save_state(state);
+
+        while (true)
+        {
+            checked += 1;
+
+            if (!loaded.load_state(state) || loaded.state_hash() != game.state_hash())
+            {
+                if (failed == 0)
+                {
+                    printf("  state %d of game %d did not load\n", checked, g);
+                }
+
+                failed += 1;
+            }
+
+            if (game.is_over())
+            {
+                break;
+            }
+
+            game.apply(game.is_piece_active() ? random_input(random) : GameEngine::SPAWN);
+            game.save_state(state);
+        }
+    }
+
+    printf("%s states %s: %d of %d states did not load\n",
+           failed == 0 ? "passed" : "FAILED", rules_name, failed, checked);
+
+    return failed == 0;
+}
+
+// Change the squares and random bytes of saved states. Best run with the
+// undefined behaviour sanitizer.
+bool check_damaged_states(const Options& options)
+{
+    std::mt19937 random(options.seed);
+    GameEngine game;
+    GameEngine loaded;
+    GameEngine::State state;
+    GameEngine::State saved;
+
+    game.reset(options.seed);
+    game.apply(GameEngine::SPAWN);
+    game.apply(GameEngine::HOLD);
+    game.save_state(state);
+
+    // The squares of the three tetrominos come after the rows and the
+    // colors of the board.
+    const int pieces_offset = GameCoreBase::ROWS * 2 + GameCoreBase::ROWS * GameCoreBase::COLUMNS;
+    int rejected = 0;
+
+    for (int piece = 0; piece < 3; ++piece)
+    {
+        for (int square = 0; square < GameCoreBase::NUM_SQUARE; ++square)
+        {
+            GameEngine::State damaged = state;
+            damaged.at(pieces_offset + piece * GameCoreBase::PIECE_STATE_SIZE + 3 + 2 * square) =
+                    GameCoreBase::ROWS - 4;
+
+            rejected += loaded.load_state(damaged) ? 0 : 1;
+        }
+    }
+
+    int changed = 0;
+
+    for (int i = 0; i < options.games * 100; ++i)
+    {
+        GameEngine::State damaged = state;
+        damaged.at(random() % damaged.size()) = uint8_t(random());
+
+        if (!loaded.load_state(damaged))
+        {
+            continue;
+        }
+
+        loaded.save_state(saved);
+
+        if (!game.load_state(saved) || game.state_hash() != loaded.state_hash())
+        {
+            changed += 1;
+        }
+    }
+
+    bool passed = rejected == 3 * GameCoreBase::NUM_SQUARE && changed == 0;
+
+    printf("%s damaged: %d of %d tetrominos rejected, %d states changed when saved\n",
+           passed ? "passed" : "FAILED", rejected, 3 * GameCoreBase::NUM_SQUARE, changed);
+
+    return passed;
+}
+
+// Write and read a replay with each name in a temporary file.
+bool check_names()
+{
+    static const std::array<const char*, 5> NAMES =
+    {"", " ", "   ", " leading and trailing ", "result 1 2 3"};
+
+    std::string file_name =
+            (std::filesystem::temp_directory_path() / "enginecheck.replay").string();
+    int same = 0;
+
+    for (const char* name : NAMES)
+    {
+        Replay written;
+        written.start(1);
+        written.claim.present = true;
+        written.claim.player = name;
+        written.claim.points = 123;
+        written.claim.lines = 4;
+        written.claim.seconds = 60;
+
+        Replay read;
+
+        if (written.write(file_name) && read.read(file_name) && read.claim.present &&
+                read.claim.player == written.claim.player &&
+                read.claim.points == written.claim.points &&
+                read.claim.lines == written.claim.lines &&
+                read.claim.seconds == written.claim.seconds)
+        {
+            same += 1;
+        }
+        else
+        {
+            printf("  name \"%s\" read as \"%s\"\n", name, read.claim.player.c_str());
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::remove(file_name, error);
+
+    bool passed = same == int(NAMES.size());
+
+    printf("%s names: %d of %zu names read back\n", passed ? "passed" : "FAILED",
+           same, NAMES.size());
+
+    return passed;
+}
+
+// Change the offset of each keyframe of the archive of a random game.
+bool check_archive(const Options& options)
+{
+    std::mt19937 random(options.seed);
+    GameEngine game;
+    Replay replay;
+
+    game.reset(options.seed);
+    replay.start(options.seed);
+
+    while (!game.is_over() && replay.inputs.size() < 2000)
+    {
+        GameEngine::Input input = game.is_piece_active() ? random_input(random)
+                                                         : GameEngine::SPAWN;
+        game.apply(input);
+        replay.inputs.push_back(GameEngine::INPUT_LETTERS.at(input));
+    }
+
+    std::vector<uint8_t> bytes;
+    ReplayArchiveView view;
+
+    if (!ReplayArchive::encode(replay, 1, bytes) || !view.open(bytes.data(), bytes.size()))
+    {
+        printf("FAILED archive: the archive of the game did not open\n");
+        return false;
+    }
+
+    const int num_keyframes = view.num_keyframes();
+    const uint64_t index_offset = bytes.size() - ReplayArchive::TRAILER_SIZE -
+            uint64_t(num_keyframes) * ReplayArchive::INDEX_ENTRY_SIZE;
+    const std::array<uint64_t, 4> OFFSETS =
+    {index_offset - GameEngine::STATE_SIZE + 1, index_offset, ~uint64_t(0),
+     ~uint64_t(0) - GameEngine::STATE_SIZE + 2};
+
+    int rejected = 0;
+    int changed = 0;
+
+    for (int i = 1; i < num_keyframes; ++i)
+    {
+        for (uint64_t offset : OFFSETS)
+        {
+            std::vector<uint8_t> damaged = bytes;
+
+            for (int b = 0; b < 8; ++b)
+            {
+                damaged.at(index_offset + i * ReplayArchive::INDEX_ENTRY_SIZE + b) =
+                        uint8_t(offset >> (8 * b));
+            }
+
+            changed += 1;
+            rejected += view.open(damaged.data(), damaged.size()) ? 0 : 1;
+        }
+    }
+
+    bool passed = num_keyframes > 1 && rejected == changed;
+
+    printf("%s archive: %d of %d offsets rejected in %d keyframes\n",
+           passed ? "passed" : "FAILED", rejected, changed, num_keyframes);
+
+    return passed;
+}
+
+// Faults of six tetrominos each played with the same keys, and gravity
+// until they lock.
+FinesseAnalyzer::Totals finesse_totals(const std::vector<GameEngine::Input>& keys)
+{
+    GameEngine game;
+    FinesseAnalyzer finesse;
+
+    game.reset(1, GameCoreBase::NORMAL);
+    finesse.reset();
+
+    for (int piece = 0; piece < 6 && !game.is_over(); ++piece)
+    {
+        finesse.record(GameEngine::SPAWN, game.apply(GameEngine::SPAWN), game);
+
+        for (GameEngine::Input input : keys)
+        {
+            finesse.record(input, game.apply(input), game);
+        }
+
+        while (game.is_piece_active())
+        {
+            finesse.record(GameEngine::GRAVITY, game.apply(GameEngine::GRAVITY), game);
+        }
+    }
+
+    return finesse.totals();
+}
+
+bool check_finesse()
+{
+    FinesseAnalyzer::Totals hard = finesse_totals({GameEngine::HARD_FALL});
+    FinesseAnalyzer::Totals waited = finesse_totals({});
+    FinesseAnalyzer::Totals moved = finesse_totals({GameEngine::LEFT, GameEngine::RIGHT,
+                                                    GameEngine::HARD_FALL});
+
+    bool passed = hard.pieces == 6 && hard.faults == 0 && hard.keys == 6 &&
+            waited.pieces == 6 && waited.faults == 0 && waited.keys == 0 &&
+            moved.pieces == 6 && moved.faults == 6;
+
+    printf("%s finesse: %d, %d and %d faults of 6 tetrominos dropped, waited and moved\n",
+           passed ? "passed" : "FAILED", hard.faults, waited.faults, moved.faults);
+
+    return passed;
+}
+
+// Turn each tetromino many times before dropping it, which costs points,
+// and save and load the state after every input.
+bool check_turns()
+{
+    GameEngine game;
+    GameEngine loaded;
+    GameEngine::State state;
+
+    game.reset(1, GameCoreBase::NORMAL);
+
+    int checked = 0;
+    int failed = 0;
+
+    for (int piece = 0; piece < 5 && !game.is_over(); ++piece)
+    {
+        std::vector<GameEngine::Input> inputs(22, GameEngine::ROTATE);
+        inputs.insert(inputs.begin(), GameEngine::SPAWN);
+        inputs.push_back(GameEngine::HARD_FALL);
+        inputs.push_back(GameEngine::GRAVITY);
+
+        for (GameEngine::Input input : inputs)
+        {
+            game.apply(input);
+            game.save_state(state);
+            checked += 1;
+
+            if (!loaded.load_state(state) || loaded.state_hash() != game.state_hash())
+            {
+                failed += 1;
+            }
+        }
+    }
+
+    bool passed = failed == 0 && game.points() < 0;
+
+    printf("%s turns: %d of %d states did not load, %d points\n",
+           passed ? "passed" : "FAILED", failed, checked, game.points());
+
+    return passed;
+}
+
+// Garbage with a column outside the board must not change the game.
+bool check_garbage()
+{
+    GameEngine game;
+    game.reset(1, GameCoreBase::NORMAL);
+    game.apply(GameEngine::SPAWN);
+
+    uint64_t hash = game.state_hash();
+    int ignored = 0;
+
+    for (int column : {-1, GameCoreBase::COLUMNS, 16, 31, -2147483647 - 1, 2147483647})
+    {
+        if (game.add_garbage(2, column) == GameEngine::NOTHING && game.state_hash() == hash)
+        {
+            ignored += 1;
+        }
+    }
+
+    bool passed = ignored == 6 && game.add_garbage(2, 0) == GameEngine::MOVED;
+
+    printf("%s garbage: %d of 6 columns outside the board ignored\n",
+           passed ? "passed" : "FAILED", ignored);
+
+    return passed;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--games" && i + 1 < argc)
+        {
+            options.games = atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            options.seed = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: enginecheck [--games <n>] [--seed <n>]\n");
+            return 2;
+        }
+    }
+
+    if (options.games <= 0)
+    {
+        fprintf(stderr, "--games must be positive\n");
+        return 2;
+    }
+
+    bool passed = true;
+
+    passed = check_allocations<ClassicRules>(options, "classic") && passed;
+    passed = check_allocations<ModernRules>(options, "modern") && passed;
+    passed = check_allocations<NoHoldRules>(options, "no hold") && passed;
+
+    passed = check_states<ClassicRules>(options, "classic") && passed;
+    passed = check_states<ModernRules>(options, "modern") && passed;
+    passed = check_states<NoHoldRules>(options, "no hold") && passed;
+
+    passed = check_garbage() && passed;
+    passed = check_turns() && passed;
+    passed = check_finesse() && passed;
+    passed = check_damaged_states(options) && passed;
+    passed = check_names() && passed;
+    passed = check_archive(options) && passed;
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+// Golden replay regression check.
+//
+// Plays every recorded game through the GameEngine and compares the state
+// hash after every lock with the hashes stored in the replay. Reports the
+// first diverging lock of each replay. Replays are checked in parallel on
+// all cores.
+//
+// Usage:
+//   replaycheck [--threads <n>] [--update] [--archive <pieces>]
+//               <replay files, archives or directories>
+//   replaycheck --generate <count> <directory>
+//
+// --update rewrites the stored hashes after an intended rule change.
+// --archive writes each replay which passed as a replay archive with a
+// keyframe every <pieces> pieces, next to the replay. Archives are checked
+// by playing from each keyframe to the next.
+// --generate writes randomly played games for the corpus.
+
+#include "replay.hh"
+#include "replayarchive.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct Job
+{
+    std::string file_name = "";
+    Replay replay;
+    bool loaded = false;
+    bool passed = false;
+    Replay::Divergence divergence;
+
+    // Replay archive instead of a replay.
+    bool is_archive = false;
+    std::vector<uint8_t> archive;
+    ReplayArchiveView view;
+};
+
+bool is_archive_file(const std::string& file_name)
+{
+    return std::filesystem::path(file_name).extension() == ".rpa";
+}
+
+// Archive of the replay next to it, with the extension .rpa.
+bool write_archive(const Job& job, int keyframe_pieces)
+{
+    std::filesystem::path path(job.file_name);
+    path.replace_extension(".rpa");
+
+    std::vector<uint8_t> bytes;
+
+    return ReplayArchive::encode(job.replay, keyframe_pieces, bytes) &&
+            ReplayArchive::write(path.string(), bytes);
+}
+
+// Collect replay files from the arguments.
+void collect_files(const std::string& path, std::vector<std::string>& files)
+{
+    if (std::filesystem::is_directory(path))
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(path))
+        {
+            if (entry.path().extension() == ".replay" ||
+                    entry.path().extension() == ".rpa")
+            {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    else
+    {
+        files.push_back(path);
+    }
+}
+
+// Play a random game: each tetromino is turned, reflected and moved to a
+// random column and then dropped.
+Replay generate_game(uint32_t seed, int max_locks)
+{
+    std::mt19937 random(seed);
+
+    Replay replay;
+    replay.start(seed);
+
+    GameEngine engine;
+    engine.reset(seed);
+
+    auto give = [&replay, &engine](GameEngine::Input input)
+    {
+        int result = engine.apply(input);
+        replay.record(input, result, engine);
+        return result;
+    };
+
+    for (int lock = 0; lock < max_locks && !engine.is_over(); ++lock)
+    {
+        give(GameEngine::SPAWN);
+
+        if (random() % 8 == 0)
+        {
+            give(GameEngine::HOLD);
+        }
+
+        for (int turn = random() % 4; turn > 0; --turn)
+        {
+            give(GameEngine::ROTATE);
+        }
+
+        if (random() % 4 == 0)
+        {
+            give(GameEngine::REFLECT);
+        }
+
+        int shift = int(random() % 11) - 5;
+        for (int i = 0; i < std::abs(shift); ++i)
+        {
+            give(shift < 0 ? GameEngine::LEFT : GameEngine::RIGHT);
+
+            if (random() % 6 == 0)
+            {
+                give(GameEngine::GRAVITY);
+            }
+        }
+
+        give(random() % 3 == 0 ? GameEngine::SOFT_FALL : GameEngine::HARD_FALL);
+
+        while (engine.is_piece_active())
+        {
+            give(GameEngine::GRAVITY);
+        }
+    }
+
+    return replay;
+}
+
+int generate(int count, const std::string& directory)
+{
+    std::filesystem::create_directories(directory);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Replay replay = generate_game(1000 + i, 400);
+
+        char name[64];
+        snprintf(name, sizeof(name), "/game_%03d.replay", i);
+
+        if (!replay.write(directory + name))
+        {
+            fprintf(stderr, "Can not write %s%s\n", directory.c_str(), name);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> files;
+    bool update = false;
+    int archive_pieces = 0;
+    unsigned int num_threads = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--generate" && i + 2 < argc)
+        {
+            return generate(atoi(argv[i + 1]), argv[i + 2]);
+        }
+        else if (arg == "--update")
+        {
+            update = true;
+        }
+        else if (arg == "--archive" && i + 1 < argc)
+        {
+            archive_pieces = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            num_threads = atoi(argv[++i]);
+        }
+        else
+        {
+            collect_files(arg, files);
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+
+    if (files.empty())
+    {
+        fprintf(stderr, "Usage: replaycheck [--threads <n>] [--update] [--archive <pieces>]\n"
+                        "                   <replays>\n"
+                        "       replaycheck --generate <count> <directory>\n");
+        return 2;
+    }
+
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+
+    // Read all files first so the timing only covers the simulation.
+    std::vector<Job> jobs(files.size());
+    for (unsigned int i = 0; i < files.size(); ++i)
+    {
+        Job& job = jobs.at(i);
+        job.file_name = files.at(i);
+        job.is_archive = is_archive_file(job.file_name);
+
+        if (job.is_archive)
+        {
+            job.loaded = ReplayArchive::read(job.file_name, job.archive) &&
+                    job.view.open(job.archive.data(), job.archive.size());
+        }
+        else
+        {
+            job.loaded = job.replay.read(job.file_name);
+        }
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::atomic<unsigned int> next_job(0);
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < num_threads; ++t)
+    {
+        workers.emplace_back([&jobs, &next_job, update]()
+        {
+            for (unsigned int i = next_job++; i < jobs.size(); i = next_job++)
+            {
+                Job& job = jobs.at(i);
+
+                if (!job.loaded)
+                {
+                    continue;
+                }
+
+                if (job.is_archive)
+                {
+                    job.passed = job.view.verify(job.divergence);
+                }
+                else if (update)
+                {
+                    job.replay.update_hashes();
+                    job.passed = true;
+                }
+                else
+                {
+                    job.passed = job.replay.verify(job.divergence);
+                }
+            }
+        });
+    }
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - begin).count();
+
+    // Report.
+    int failed = 0;
+    size_t total_locks = 0;
+
+    for (Job& job : jobs)
+    {
+        total_locks += job.replay.lock_hashes.size();
+
+        if (!job.loaded)
+        {
+            printf("%s: can not read replay\n", job.file_name.c_str());
+            failed += 1;
+        }
+        else if (job.is_archive)
+        {
+            if (!job.passed)
+            {
+                printf("%s: keyframe %d (input %d) differs: expected %016llx, got %016llx\n",
+                       job.file_name.c_str(), job.divergence.lock, job.divergence.input,
+                       (unsigned long long)job.divergence.expected,
+                       (unsigned long long)job.divergence.actual);
+                failed += 1;
+            }
+        }
+        else if (update)
+        {
+            if (!job.replay.write(job.file_name))
+            {
+                printf("%s: can not write replay\n", job.file_name.c_str());
+                failed += 1;
+            }
+        }
+        else if (!job.passed)
+        {
+            printf("%s: diverged at lock %d (input %d): expected %016llx, got %016llx\n",
+                   job.file_name.c_str(), job.divergence.lock, job.divergence.input,
+                   (unsigned long long)job.divergence.expected,
+                   (unsigned long long)job.divergence.actual);
+            failed += 1;
+        }
+        else if (archive_pieces > 0 && !write_archive(job, archive_pieces))
+        {
+            printf("%s: can not write archive\n", job.file_name.c_str());
+            failed += 1;
+        }
+    }
+
+    printf("%zu replays, %zu locks, %d failed, %u threads, %.0f replays/s\n",
+           jobs.size(), total_locks, failed, num_threads,
+           seconds > 0 ? jobs.size() / seconds : 0.0);
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+# Plays recorded games again and checks the state after each lock.
+
+TARGET = replaycheck
+TEMPLATE = app
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+SOURCES += \
+        main.cpp
+
+include(../../engine.pri)
@@ -0,0 +1,757 @@
+// Replay export.
+//
+// Draws replays without a window, with the squares, colors and layout of
+// the playing area, next and hold views of the game. A game can be written
+// as PNG frames or as raw frames to a pipe for a video encoder, and many
+// games as thumbnail strips.
+//
+// The frames are drawn on all cores. They are split in chunks, and each
+// chunk starts from the keyframe of the replay archive before its first
+// frame, so no chunk waits for the game to be played up to it. Raw frames
+// are still written in order.
+//
+// Usage:
+//   replayexport --frames <directory> [options] <replay>
+//   replayexport --raw [options] <replay>
+//   replayexport --thumbnails <count> [--threads <n>] <replays or directories>
+//
+// Options:
+//   --fps <n>          frames in a second of the video, 60 by default
+//   --speed <x>        seconds of the game in a second of the video
+//   --start <seconds>  time of the game of the first frame
+//   --length <seconds> time of the game to export
+//   --threads <n>      threads drawing frames, all cores by default
+//
+// Replays are .replay files or .rpa archives. Like the replay viewer of the
+// game, gravity takes the time of the level and every key 50 ms, since
+// replays do not record when keys were pressed. For example
+//
+//   replayexport --raw --speed 4 game.replay |
+//       ffmpeg -f rawvideo -pix_fmt rgb24 -s 322x552 -r 60 -i - game.mp4
+
+#include "palette.hh"
+#include "pieceset.hh"
+#include "replay.hh"
+#include "replayarchive.hh"
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Sizes and places of the views of the window, relative to the next view.
+const int SQUARE_SIDE = 20;
+
+const int PLAYING_LEFT = 0;
+const int PLAYING_TOP = 70;
+const int PLAYING_WIDTH = GameEngine::COLUMNS * SQUARE_SIDE;
+const int PLAYING_HEIGHT = GameEngine::ROWS * SQUARE_SIDE;
+
+const int NEXT_LEFT = 126;
+const int NEXT_TOP = 0;
+const int NEXT_WIDTH = 114;
+const int NEXT_HEIGHT = 60;
+
+const int HOLD_LEFT = 250;
+const int HOLD_TOP = 70;
+const int HOLD_WIDTH = 70;
+const int HOLD_HEIGHT = 60;
+
+// Each view has a border of one pixel around its scene.
+const int FRAME_WIDTH = HOLD_LEFT + HOLD_WIDTH + 2;
+const int FRAME_HEIGHT = PLAYING_TOP + PLAYING_HEIGHT + 2;
+
+// Playing area of a thumbnail.
+const int THUMBNAIL_SQUARE_SIDE = 6;
+const int THUMBNAIL_WIDTH = GameEngine::COLUMNS * THUMBNAIL_SQUARE_SIDE + 2;
+const int THUMBNAIL_HEIGHT = GameEngine::ROWS * THUMBNAIL_SQUARE_SIDE + 2;
+const int THUMBNAIL_GAP = 4;
+
+const char* const WINDOW_CODE = "#EFEFEF";
+const char* const VIEW_CODE = "#FFFFFF";
+const char* const VIEW_BORDER_CODE = "#A0A0A0";
+
+// Time of a key, as in the replay viewer of the game.
+const int KEY_MS = 50;
+
+// Frames drawn by a thread at a time. Raw frames of at most two chunks for
+// each thread are kept before they are written.
+const int CHUNK_FRAMES = 60;
+const int CHUNKS_PER_THREAD = 2;
+
+struct Options
+{
+    std::string frames_directory = "";
+    bool raw = false;
+    int thumbnails = 0;
+
+    double fps = 60;
+    double speed = 1;
+    double start_s = 0;
+    double length_s = -1;
+    int num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+};
+
+// Time the input takes in the game, as in the replay viewer of the game.
+int input_ms(const GameEngine& game, GameEngine::Input input)
+{
+    if (input == GameEngine::GRAVITY)
+    {
+        return game.speed();
+    }
+
+    if (input == GameEngine::SPAWN)
+    {
+        return 0;
+    }
+
+    return KEY_MS;
+}
+
+// Replay as an archive, so any part of it can be started from a keyframe.
+bool load_archive(const std::string& file_name, std::vector<uint8_t>& bytes,
+                  ReplayArchiveView& view)
+{
+    bool read = false;
+
+    if (std::filesystem::path(file_name).extension() == ".rpa")
+    {
+        read = ReplayArchive::read(file_name, bytes);
+    }
+    else
+    {
+        Replay replay;
+        read = replay.read(file_name) &&
+                ReplayArchive::encode(replay, ReplayArchive::DEFAULT_KEYFRAME_PIECES, bytes);
+    }
+
+    return read && view.open(bytes.data(), bytes.size());
+}
+
+// Collect replay files from the arguments.
+void collect_files(const std::string& path, std::vector<std::string>& files)
+{
+    if (std::filesystem::is_directory(path))
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(path))
+        {
+            if (entry.path().extension() == ".replay" ||
+                    entry.path().extension() == ".rpa")
+            {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    else
+    {
+        files.push_back(path);
+    }
+}
+
+
+//*****************************************************************************
+// Drawing.
+
+// Brushes made once from Palette, indexed by the palette index.
+struct Brushes
+{
+    Brushes()
+    {
+        for (int index = 0; index < GameEngine::NUM_COLORS; ++index)
+        {
+            squares.at(index) = QBrush(QColor(Palette::color(index)));
+        }
+    }
+
+    std::array<QBrush, GameEngine::NUM_COLORS> squares;
+    QPen border = QPen(QColor(Palette::BORDER_CODE));
+    QPen view_border = QPen(QColor(VIEW_BORDER_CODE));
+    QBrush view = QBrush(QColor(VIEW_CODE));
+};
+
+// Empty view with its border. The scene starts inside the border.
+void draw_view(QPainter& painter, const Brushes& brushes, int left, int top,
+               int width, int height)
+{
+    painter.setPen(brushes.view_border);
+    painter.setBrush(brushes.view);
+    painter.drawRect(left, top, width + 1, height + 1);
+}
+
+// Square with the black border of the squares of the scene.
+void draw_square(QPainter& painter, const Brushes& brushes, double x, double y,
+                 double side, int color)
+{
+    painter.setPen(brushes.border);
+    painter.setBrush(brushes.squares.at(color));
+    painter.drawRect(QRectF(x, y, side, side));
+}
+
+// Grid and moving tetromino with the scene at left, top.
+void draw_board(QPainter& painter, const Brushes& brushes, const GameEngine& game,
+                int left, int top, int side)
+{
+    const Board& board = game.board();
+
+    for (int row = 0; row < GameEngine::ROWS; ++row)
+    {
+        for (int col = 0; col < GameEngine::COLUMNS; ++col)
+        {
+            if (board.is_occupied(col, row))
+            {
+                draw_square(painter, brushes, left + col * side, top + row * side,
+                            side, board.colors.at(row).at(col));
+            }
+        }
+    }
+
+    if (game.is_piece_active())
+    {
+        const Piece& piece = game.current();
+
+        for (const Coord& c : piece.squares)
+        {
+            draw_square(painter, brushes, left + c.x * side, top + c.y * side,
+                        side, piece.color);
+        }
+    }
+}
+
+// Tetromino in the next or hold view, placed as the window places it.
+void draw_preview(QPainter& painter, const Brushes& brushes, const Piece& piece,
+                  int left, int top, double scale, double side, int x, int y)
+{
+    const PieceSet::Orientation& orientation =
+            PieceSet::tetrominos().shape(piece.type).orientations.at(0);
+
+    for (int i = 0; i < GameEngine::NUM_SQUARE; ++i)
+    {
+        const Coord& c = orientation.cells.at(i);
+
+        draw_square(painter, brushes, left + c.x * SQUARE_SIDE / scale + x,
+                    top + c.y * SQUARE_SIDE / scale + y, side, piece.color);
+    }
+}
+
+void draw_frame(QImage& image, const Brushes& brushes, const GameEngine& game)
+{
+    image.fill(QColor(WINDOW_CODE));
+
+    QPainter painter(&image);
+
+    draw_view(painter, brushes, PLAYING_LEFT, PLAYING_TOP, PLAYING_WIDTH, PLAYING_HEIGHT);
+    draw_board(painter, brushes, game, PLAYING_LEFT + 1, PLAYING_TOP + 1, SQUARE_SIDE);
+
+    draw_view(painter, brushes, NEXT_LEFT, NEXT_TOP, NEXT_WIDTH, NEXT_HEIGHT);
+
+    draw_preview(painter, brushes, game.next(), NEXT_LEFT + 1, NEXT_TOP + 1,
+                 1, SQUARE_SIDE / 1.2, 30, 10);
+
+    draw_view(painter, brushes, HOLD_LEFT, HOLD_TOP, HOLD_WIDTH, HOLD_HEIGHT);
+
+    if (!game.is_hold_empty())
+    {
+        draw_preview(painter, brushes, game.hold(), HOLD_LEFT + 1, HOLD_TOP + 1,
+                     1.4, SQUARE_SIDE / 2, 10, 15);
+    }
+}
+
+
+//*****************************************************************************
+// Frames.
+
+// Time of the game at each keyframe, found by playing the game once. Frames
+// of any time are then drawn from the keyframe before it.
+struct Timeline
+{
+    std::vector<int64_t> keyframe_ms;
+    int64_t end_ms = 0;
+};
+
+bool make_timeline(const ReplayArchiveView& view, Timeline& timeline)
+{
+    GameEngine game;
+    ReplayArchiveView::Cursor cursor;
+
+    if (!view.restore(0, game, cursor))
+    {
+        return false;
+    }
+
+    timeline.keyframe_ms.assign(view.num_keyframes(), 0);
+
+    int keyframe = 1;
+    int64_t time_ms = 0;
+    GameEngine::Input input;
+
+    while (true)
+    {
+        if (keyframe < view.num_keyframes() && cursor.tick() == view.keyframe(keyframe).tick)
+        {
+            timeline.keyframe_ms.at(keyframe) = time_ms;
+            keyframe += 1;
+        }
+
+        if (!cursor.next(input))
+        {
+            break;
+        }
+
+        time_ms += input_ms(game, input);
+        game.apply(input);
+    }
+
+    timeline.end_ms = time_ms;
+
+    return keyframe == view.num_keyframes() && cursor.tick() == view.num_ticks();
+}
+
+// Frames of one game drawn by chunks on all threads.
+class FrameExport
+{
+public:
+    FrameExport(const ReplayArchiveView& view, const Timeline& timeline,
+                const Options& options);
+
+    int num_frames() const { return num_frames_; }
+
+    // Draw all frames. Returns false if a frame could not be written.
+    bool run();
+
+private:
+    // Draw the frames of the chunk, from the keyframe before its first one.
+    bool draw_chunk(int chunk, std::vector<QImage>& images);
+
+    bool write_raw(const QImage& image);
+
+    double frame_time_ms(int frame) const { return start_ms_ + frame * frame_ms_; }
+
+    const ReplayArchiveView& view_;
+    const Timeline& timeline_;
+    const Options& options_;
+    Brushes brushes_;
+
+    double start_ms_ = 0;
+    double frame_ms_ = 0;
+    int num_frames_ = 0;
+    int num_chunks_ = 0;
+
+    // Chunks drawn and not yet written, in order for raw frames.
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<std::vector<QImage>> chunks_;
+    std::vector<char> chunk_done_;
+    int next_chunk_ = 0;
+    int written_chunks_ = 0;
+    bool failed_ = false;
+};
+
+FrameExport::FrameExport(const ReplayArchiveView& view, const Timeline& timeline,
+                         const Options& options) :
+    view_(view), timeline_(timeline), options_(options)
+{
+    start_ms_ = std::max(0.0, options.start_s * 1000);
+    frame_ms_ = 1000 * options.speed / options.fps;
+
+    double end_ms = timeline.end_ms;
+
+    if (options.length_s >= 0)
+    {
+        end_ms = std::min(end_ms, start_ms_ + options.length_s * 1000);
+    }
+
+    if (end_ms >= start_ms_)
+    {
+        num_frames_ = int((end_ms - start_ms_) / frame_ms_) + 1;
+    }
+
+    num_chunks_ = (num_frames_ + CHUNK_FRAMES - 1) / CHUNK_FRAMES;
+
+    chunks_.resize(num_chunks_);
+    chunk_done_.assign(num_chunks_, 0);
+}
+
+bool FrameExport::draw_chunk(int chunk, std::vector<QImage>& images)
+{
+    int first = chunk * CHUNK_FRAMES;
+    int last = std::min(num_frames_, first + CHUNK_FRAMES);
+
+    // Last keyframe at or before the first frame.
+    int keyframe = int(std::upper_bound(timeline_.keyframe_ms.begin(),
+                                        timeline_.keyframe_ms.end(),
+                                        int64_t(frame_time_ms(first))) -
+                       timeline_.keyframe_ms.begin()) - 1;
+
+    GameEngine game;
+    ReplayArchiveView::Cursor cursor;
+
+    if (!view_.restore(std::max(keyframe, 0), game, cursor))
+    {
+        return false;
+    }
+
+    int64_t time_ms = timeline_.keyframe_ms.at(std::max(keyframe, 0));
+    GameEngine::Input input = GameEngine::SPAWN;
+    bool has_input = false;
+
+    for (int frame = first; frame < last; ++frame)
+    {
+        // Play every input which ends by the time of the frame.
+        double frame_ms = frame_time_ms(frame);
+
+        while (has_input || cursor.next(input))
+        {
+            has_input = true;
+
+            int ms = input_ms(game, input);
+
+            if (time_ms + ms > frame_ms)
+            {
+                break;
+            }
+
+            time_ms += ms;
+            game.apply(input);
+            has_input = false;
+        }
+
+        QImage image(FRAME_WIDTH, FRAME_HEIGHT, QImage::Format_RGB888);
+        draw_frame(image, brushes_, game);
+
+        if (options_.raw)
+        {
+            images.push_back(std::move(image));
+        }
+        else
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "frame_%06d.png", frame);
+
+            std::filesystem::path path = std::filesystem::path(options_.frames_directory) / name;
+
+            if (!image.save(QString::fromStdString(path.string()), "PNG"))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Rows of the image without the padding at the end of each line.
+bool FrameExport::write_raw(const QImage& image)
+{
+    for (int y = 0; y < image.height(); ++y)
+    {
+        if (fwrite(image.constScanLine(y), 3, image.width(), stdout) != size_t(image.width()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FrameExport::run()
+{
+    int num_threads = options_.num_threads;
+
+    // A thread takes a chunk only when few enough chunks wait to be
+    // written, so raw frames do not fill the memory.
+    int window = num_threads * CHUNKS_PER_THREAD;
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < num_threads; ++t)
+    {
+        workers.emplace_back([this, window]()
+        {
+            while (true)
+            {
+                int chunk = 0;
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+
+                    changed_.wait(lock, [this, window]()
+                    {
+                        return failed_ || !options_.raw ||
+                                next_chunk_ < written_chunks_ + window;
+                    });
+
+                    if (failed_ || next_chunk_ >= num_chunks_)
+                    {
+                        return;
+                    }
+
+                    chunk = next_chunk_++;
+                }
+
+                std::vector<QImage> images;
+                bool drawn = draw_chunk(chunk, images);
+
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                chunks_.at(chunk) = std::move(images);
+                chunk_done_.at(chunk) = 1;
+                failed_ = failed_ || !drawn;
+                changed_.notify_all();
+            }
+        });
+    }
+
+    // Chunks are written here in order as soon as they are drawn.
+    for (int chunk = 0; chunk < num_chunks_; ++chunk)
+    {
+        std::vector<QImage> images;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            changed_.wait(lock, [this, chunk]()
+            {
+                return failed_ || chunk_done_.at(chunk);
+            });
+
+            if (failed_)
+            {
+                break;
+            }
+
+            images.swap(chunks_.at(chunk));
+        }
+
+        bool written = true;
+
+        for (const QImage& image : images)
+        {
+            written = written && write_raw(image);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        written_chunks_ = chunk + 1;
+        failed_ = failed_ || !written;
+        changed_.notify_all();
+    }
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    fflush(stdout);
+
+    return !failed_;
+}
+
+
+//*****************************************************************************
+// Thumbnails.
+
+// Playing area at evenly spaced ticks, the last one at the end of the game,
+// side by side in <file>.png.
+bool write_thumbnails(const std::string& file_name, int count, const Brushes& brushes)
+{
+    std::vector<uint8_t> bytes;
+    ReplayArchiveView view;
+
+    if (!load_archive(file_name, bytes, view))
+    {
+        return false;
+    }
+
+    QImage strip(count * THUMBNAIL_WIDTH + (count + 1) * THUMBNAIL_GAP,
+                 THUMBNAIL_HEIGHT + 2 * THUMBNAIL_GAP, QImage::Format_RGB888);
+    strip.fill(QColor(WINDOW_CODE));
+
+    QPainter painter(&strip);
+    GameEngine game;
+    ReplayArchiveView::Cursor cursor;
+
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t tick = uint32_t(uint64_t(view.num_ticks()) * (i + 1) / count);
+
+        if (!view.seek(tick, game, cursor))
+        {
+            return false;
+        }
+
+        int left = THUMBNAIL_GAP + i * (THUMBNAIL_WIDTH + THUMBNAIL_GAP);
+
+        draw_view(painter, brushes, left, THUMBNAIL_GAP, THUMBNAIL_WIDTH - 2,
+                  THUMBNAIL_HEIGHT - 2);
+        draw_board(painter, brushes, game, left + 1, THUMBNAIL_GAP + 1,
+                   THUMBNAIL_SQUARE_SIDE);
+    }
+
+    painter.end();
+
+    return strip.save(QString::fromStdString(file_name + ".png"), "PNG");
+}
+
+// Strips of the games on all threads. Returns the number which failed.
+int export_thumbnails(const std::vector<std::string>& files, const Options& options)
+{
+    std::atomic<unsigned int> next_file(0);
+    std::atomic<int> failed(0);
+    std::mutex output_mutex;
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < options.num_threads; ++t)
+    {
+        workers.emplace_back([&files, &options, &next_file, &failed, &output_mutex]()
+        {
+            Brushes brushes;
+
+            for (unsigned int i = next_file++; i < files.size(); i = next_file++)
+            {
+                bool written = write_thumbnails(files.at(i), options.thumbnails, brushes);
+
+                if (!written)
+                {
+                    failed += 1;
+                }
+
+                std::lock_guard<std::mutex> lock(output_mutex);
+
+                fprintf(stderr, "%s %s.png\n", written ? "wrote" : "failed",
+                        files.at(i).c_str());
+            }
+        });
+    }
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    return failed;
+}
+
+// Frames of one game. Returns the exit code.
+int export_frames(const std::string& file_name, const Options& options)
+{
+    std::vector<uint8_t> bytes;
+    ReplayArchiveView view;
+    Timeline timeline;
+
+    if (!load_archive(file_name, bytes, view) || !make_timeline(view, timeline))
+    {
+        fprintf(stderr, "Can not read %s\n", file_name.c_str());
+        return 1;
+    }
+
+    if (!options.raw)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(options.frames_directory, error);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    FrameExport frames(view, timeline, options);
+
+    if (!frames.run())
+    {
+        fprintf(stderr, "Can not write the frames of %s\n", file_name.c_str());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - begin).count();
+
+    // The size is printed for the options of the encoder.
+    fprintf(stderr, "%d frames of %dx%d, %.1f s of the game, %.0f frames/s\n",
+            frames.num_frames(), FRAME_WIDTH, FRAME_HEIGHT, timeline.end_ms / 1000.0,
+            seconds > 0 ? frames.num_frames() / seconds : 0.0);
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--frames" && i + 1 < argc)
+        {
+            options.frames_directory = argv[++i];
+        }
+        else if (arg == "--raw")
+        {
+            options.raw = true;
+        }
+        else if (arg == "--thumbnails" && i + 1 < argc)
+        {
+            options.thumbnails = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--fps" && i + 1 < argc)
+        {
+            options.fps = atof(argv[++i]);
+        }
+        else if (arg == "--speed" && i + 1 < argc)
+        {
+            options.speed = atof(argv[++i]);
+        }
+        else if (arg == "--start" && i + 1 < argc)
+        {
+            options.start_s = atof(argv[++i]);
+        }
+        else if (arg == "--length" && i + 1 < argc)
+        {
+            options.length_s = atof(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            options.num_threads = atoi(argv[++i]);
+        }
+        else
+        {
+            collect_files(arg, files);
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+
+    bool frames = options.raw || !options.frames_directory.empty();
+
+    if (files.empty() || frames == (options.thumbnails > 0) ||
+            (frames && files.size() != 1) || options.fps <= 0 || options.speed <= 0 ||
+            options.num_threads <= 0)
+    {
+        fprintf(stderr, "Usage: replayexport --frames <directory> [options] <replay>\n"
+                        "       replayexport --raw [options] <replay>\n"
+                        "       replayexport --thumbnails <count> [--threads <n>] <replays>\n"
+                        "Options: --fps <n> --speed <x> --start <seconds> --length <seconds>\n"
+                        "         --threads <n>\n");
+        return 2;
+    }
+
+    if (frames)
+    {
+        return export_frames(files.front(), options);
+    }
+
+    return export_thumbnails(files, options) == 0 ? 0 : 1;
+}
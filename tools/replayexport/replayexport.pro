@@ -0,0 +1,14 @@
+# Draws replays as video frames and thumbnail strips without a window.
+
+TARGET = replayexport
+TEMPLATE = app
+
+QT = core gui
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle
+
+SOURCES += \
+        main.cpp
+
+include(../../engine.pri)
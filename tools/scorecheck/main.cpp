@@ -0,0 +1,312 @@
+// High score check.
+//
+// Plays the replays of submitted games again and checks the result each
+// one claims. The game must end where the replay ends, the points and the
+// lines removed must be those of the inputs, and the playing time cannot
+// be shorter than the time the gravity of the inputs took. The replays are
+// checked on all cores and each result is printed as soon as it is known.
+// The verified games are then ranked like the high scores of the game:
+// more points first, then less time. A game submitted more than once is
+// ranked once.
+//
+// Usage:
+//   scorecheck [--threads <n>] [--top <n>] [--scores <file>]
+//              <replay files or directories>
+//
+// --scores writes the verified games in the format of the high scores file
+// of the game, so the game shows only verified scores.
+
+#include "replay.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+
+// Timers of the game may fire this much early, and the playing time is
+// counted in whole seconds.
+const int TIMER_TOLERANCE_PERCENT = 5;
+const int TIME_TOLERANCE_MS = 1000;
+
+struct Entry
+{
+    std::string file_name = "";
+    bool verified = false;
+    std::string reason = "";
+
+    Replay::Claim claim;
+
+    // Same for the same game submitted twice.
+    size_t game_key = 0;
+};
+
+// Collect replay files from the arguments.
+void collect_files(const std::string& path, std::vector<std::string>& files)
+{
+    if (std::filesystem::is_directory(path))
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(path))
+        {
+            if (entry.path().extension() == ".replay")
+            {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    else
+    {
+        files.push_back(path);
+    }
+}
+
+// Fill the entry and return true if the claim is the result of the inputs.
+bool check(Entry& entry)
+{
+    Replay replay;
+
+    if (!replay.read(entry.file_name))
+    {
+        entry.reason = "can not read replay";
+        return false;
+    }
+
+    entry.claim = replay.claim;
+    entry.game_key = std::hash<std::string>()(replay.inputs) ^ replay.seed;
+
+    if (!replay.claim.present)
+    {
+        entry.reason = "no result";
+        return false;
+    }
+
+    Replay::Divergence divergence;
+    Replay::Outcome outcome;
+    char reason[128];
+
+    if (!replay.verify(divergence, outcome))
+    {
+        snprintf(reason, sizeof(reason), "diverged at lock %d (input %d)",
+                 divergence.lock, divergence.input);
+        entry.reason = reason;
+        return false;
+    }
+
+    if (!outcome.over)
+    {
+        entry.reason = "game did not end";
+        return false;
+    }
+
+    if (outcome.points != replay.claim.points || outcome.lines != replay.claim.lines)
+    {
+        snprintf(reason, sizeof(reason), "claims %d points %d lines, played %d points %d lines",
+                 replay.claim.points, replay.claim.lines, outcome.points, outcome.lines);
+        entry.reason = reason;
+        return false;
+    }
+
+    int64_t fastest_ms = outcome.gravity_ms * (100 - TIMER_TOLERANCE_PERCENT) / 100 -
+            TIME_TOLERANCE_MS;
+
+    if (int64_t(replay.claim.seconds) * 1000 < fastest_ms)
+    {
+        snprintf(reason, sizeof(reason), "claims %d s, the gravity alone took %lld s",
+                 replay.claim.seconds, (long long)(outcome.gravity_ms / 1000));
+        entry.reason = reason;
+        return false;
+    }
+
+    return true;
+}
+
+// The order of the high scores of the game.
+bool ranks_before(const Entry& first, const Entry& second)
+{
+    if (first.claim.points != second.claim.points)
+    {
+        return first.claim.points > second.claim.points;
+    }
+
+    return first.claim.seconds < second.claim.seconds;
+}
+
+// Names with a comma would break the lines of the high scores file.
+std::string score_name(const std::string& player)
+{
+    std::string name = player;
+    std::replace(name.begin(), name.end(), ',', ' ');
+
+    return name;
+}
+
+bool write_scores(const std::string& file_name, const std::vector<const Entry*>& ranked)
+{
+    std::ofstream file;
+    file.open(file_name);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    for (const Entry* entry : ranked)
+    {
+        file << score_name(entry->claim.player) << ',' << entry->claim.points << ','
+             << entry->claim.seconds << '\n';
+    }
+
+    file.close();
+
+    return !file.fail();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> files;
+    std::string scores = "";
+    int top = 10;
+    unsigned int num_threads = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            num_threads = atoi(argv[++i]);
+        }
+        else if (arg == "--top" && i + 1 < argc)
+        {
+            top = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--scores" && i + 1 < argc)
+        {
+            scores = argv[++i];
+        }
+        else
+        {
+            collect_files(arg, files);
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+
+    if (files.empty())
+    {
+        fprintf(stderr, "Usage: scorecheck [--threads <n>] [--top <n>] [--scores <file>]\n"
+                        "                  <replays>\n");
+        return 2;
+    }
+
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    // Each thread reads its replays too, so the files are read in
+    // parallel.
+    std::vector<Entry> entries(files.size());
+    std::atomic<unsigned int> next_entry(0);
+    std::mutex output_mutex;
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < num_threads; ++t)
+    {
+        workers.emplace_back([&files, &entries, &next_entry, &output_mutex]()
+        {
+            for (unsigned int i = next_entry++; i < entries.size(); i = next_entry++)
+            {
+                Entry& entry = entries.at(i);
+                entry.file_name = files.at(i);
+                entry.verified = check(entry);
+
+                std::lock_guard<std::mutex> lock(output_mutex);
+
+                if (entry.verified)
+                {
+                    printf("verified %s: %s %d points %d lines %d s\n",
+                           entry.file_name.c_str(), entry.claim.player.c_str(),
+                           entry.claim.points, entry.claim.lines, entry.claim.seconds);
+                }
+                else
+                {
+                    printf("rejected %s: %s\n", entry.file_name.c_str(),
+                           entry.reason.c_str());
+                }
+            }
+        });
+    }
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - begin).count();
+
+    // Verified games in the order of the files, so the first submission
+    // of a game is the one kept.
+    std::vector<const Entry*> ranked;
+    std::unordered_set<size_t> games;
+    int rejected = 0;
+    int duplicates = 0;
+
+    for (const Entry& entry : entries)
+    {
+        if (!entry.verified)
+        {
+            rejected += 1;
+        }
+        else if (!games.insert(entry.game_key).second)
+        {
+            duplicates += 1;
+        }
+        else
+        {
+            ranked.push_back(&entry);
+        }
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Entry* first, const Entry* second)
+    {
+        return ranks_before(*first, *second);
+    });
+
+    printf("%zu replays, %zu verified, %d duplicates, %d rejected, %u threads, "
+           "%.0f replays/s\n", entries.size(), ranked.size(), duplicates, rejected,
+           num_threads, seconds > 0 ? entries.size() / seconds : 0.0);
+
+    for (int i = 0; i < std::min<int>(top, ranked.size()); ++i)
+    {
+        const Replay::Claim& claim = ranked.at(i)->claim;
+
+        printf("%3d. %-20s %8d points %5d lines %02d:%02d:%02d\n", i + 1,
+               claim.player.empty() ? "No name" : claim.player.c_str(), claim.points,
+               claim.lines, claim.seconds / 3600, claim.seconds / 60 % 60,
+               claim.seconds % 60);
+    }
+
+    if (!scores.empty() && !write_scores(scores, ranked))
+    {
+        fprintf(stderr, "Can not write %s\n", scores.c_str());
+        return 1;
+    }
+
+    return rejected == 0 ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+# Checks the results of submitted games by playing their replays again.
+
+TARGET = scorecheck
+TEMPLATE = app
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+SOURCES += \
+        main.cpp
+
+include(../../engine.pri)
@@ -0,0 +1,125 @@
+// Spectator viewer.
+//
+// Connects to a game started with --spectate <name> and draws the board,
+// the moving tetromino and the score in the terminal. Any number of
+// viewers can watch the same game.
+//
+// Usage:
+//   spectator <name>
+
+#include "spectatorstream.hh"
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QByteArray>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+
+// Draw the whole view from the top of the terminal.
+void draw(const SpectatorView& view)
+{
+    std::string text = "\x1b[H";
+
+    text += "score " + std::to_string(view.points) +
+            "  lines " + std::to_string(view.lines_removed) +
+            "  level " + std::to_string(view.level + 1) +
+            (view.game_over ? "  GAME OVER" : "") + "\x1b[K\n";
+
+    for (int y = 0; y < Board::ROWS; ++y)
+    {
+        std::string row(Board::COLUMNS, '.');
+
+        for (int x = 0; x < Board::COLUMNS; ++x)
+        {
+            if (view.board.is_occupied(x, y))
+            {
+                row.at(x) = '#';
+            }
+        }
+
+        if (view.piece_active)
+        {
+            for (const Coord& c : view.current.squares)
+            {
+                if (c.y == y)
+                {
+                    row.at(c.x) = '@';
+                }
+            }
+        }
+
+        text += "|" + row + "|\n";
+    }
+
+    std::fputs(text.c_str(), stdout);
+    std::fflush(stdout);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    if (argc != 2)
+    {
+        std::fprintf(stderr, "usage: spectator <name>\n");
+        return 2;
+    }
+
+    QLocalSocket socket;
+    SpectatorView view;
+    QByteArray received;
+
+    QObject::connect(&socket, &QLocalSocket::readyRead, [&]()
+    {
+        received.append(socket.readAll());
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(received.constData());
+        int offset = 0;
+
+        for (;;)
+        {
+            int size = view.apply(data + offset, received.size() - offset);
+
+            if (size < 0)
+            {
+                std::fprintf(stderr, "Stream is not valid.\n");
+                application.exit(1);
+                return;
+            }
+
+            if (size == 0)
+            {
+                break;
+            }
+
+            offset += size;
+        }
+
+        received.remove(0, offset);
+
+        if (view.has_keyframe)
+        {
+            draw(view);
+        }
+    });
+
+    QObject::connect(&socket, &QLocalSocket::disconnected,
+                     &application, &QCoreApplication::quit);
+
+    socket.connectToServer(QString::fromLocal8Bit(argv[1]));
+
+    if (!socket.waitForConnected(3000))
+    {
+        std::fprintf(stderr, "Cannot connect to %s.\n", argv[1]);
+        return 1;
+    }
+
+    // Clear the terminal once.
+    std::fputs("\x1b[2J", stdout);
+
+    return application.exec();
+}
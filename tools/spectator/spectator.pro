@@ -0,0 +1,14 @@
+# Draws a game published with --spectate in the terminal.
+
+TARGET = spectator
+TEMPLATE = app
+
+QT = core network
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+SOURCES += \
+        main.cpp
+
+include(../../engine.pri)
@@ -0,0 +1,1002 @@
+// Tournament between bots.
+//
+// Each round plays a block of seeded games, and every bot in the round
+// plays the same seeds, so it gets the same tetrominos as its opponents.
+// The games of a bot do not depend on its opponent, so a pairing compares
+// the two games of each seed: the bot which placed more tetrominos wins,
+// and when both lasted as long, the one with more points. A pairing of n
+// games costs n games of each bot, and each bot plays each seed once
+// whatever the number of opponents.
+//
+// Round robin pairs every bot with every other bot in each round. Swiss
+// pairs the bots with close scores which met least, and with an odd number
+// of bots one sits the round out, in turn.
+//
+// The games of a round are played in parallel on all cores. Each move has
+// the budget and the grace on the CPU clock of its thread, and a move over
+// them drops the tetromino like a late move in the game. Bot programs run
+// in their own process, so their moves are limited by the clock instead.
+//
+// Bots:
+//   <name>=search[:<weights file>]   the bot of the game
+//   <name>=greedy[:<weights file>]   best board score, without searching
+//   <name>=plugin:<library>          a bot plugin, see botpluginabi.h
+//   <name>=program:<program>         a bot program, see externalbot.hh
+// Each thread has its own instance of every bot, so a plugin must keep its
+// state in the state it creates.
+//
+// The games are played with the rules of the game unless --rules chooses
+// another set of gamerules.hh. The bots search with the moves of the rules.
+//
+// Usage:
+//   tournament --bot <bot> --bot <bot> [--bot <bot> ...]
+//              [--format round-robin|swiss] [--rounds <n>] [--games <n>]
+//              [--pieces <n>] [--budget <ms>] [--grace <ms>] [--seed <n>]
+//              [--rules classic|modern|nohold] [--threads <n>]
+
+#include "botplugin.hh"
+#include "botsearch.hh"
+#include "botweights.hh"
+#include "movegenerator.hh"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const char PROTOCOL_HEADER[] = "tetris-bot 1\n";
+
+// Time a bot program has to start, and to quit after its input is closed.
+const int START_WAIT_MS = 3000;
+const int EXIT_WAIT_MS = 500;
+
+// Table of the search bot, the same as in the game.
+const int TABLE_SIZE_LOG2 = 16;
+
+enum Format {ROUND_ROBIN, SWISS};
+
+// Fixed for a tournament.
+struct Settings
+{
+    Format format = ROUND_ROBIN;
+    int rounds = 10;
+    int games = 100;
+    int pieces = 500;
+    int budget_ms = 10;
+    int grace_ms = 20;
+    uint32_t seed = 1;
+    RulesName rules = CLASSIC_RULES;
+};
+
+struct BotSpec
+{
+    enum Kind {SEARCH, GREEDY, PLUGIN, PROGRAM};
+
+    std::string name = "";
+    Kind kind = SEARCH;
+    std::string argument = "";
+    BotWeights weights;
+};
+
+// One game of one bot.
+struct Outcome
+{
+    int pieces = 0;
+    int points = 0;
+    int lines = 0;
+    int timeouts = 0;
+    double cpu_ms = 0;
+};
+
+// Games of a pairing from the side of one bot.
+struct Tally
+{
+    int wins = 0;
+    int draws = 0;
+    int losses = 0;
+
+    int games() const { return wins + draws + losses; }
+    double score() const { return wins + draws / 2.0; }
+};
+
+// Games of one bot over the tournament.
+struct Totals
+{
+    Tally tally;
+    int64_t games = 0;
+    int64_t pieces = 0;
+    int64_t points = 0;
+    int64_t timeouts = 0;
+    double cpu_ms = 0;
+};
+
+//*****************************************************************************
+// Bots.
+
+// Move of a bot. LATE if a bot program did not answer in time.
+enum Decision {MOVE, DROP, LATE};
+
+// A bot playing games with the rules.
+template <typename Rules>
+class Player
+{
+public:
+    virtual ~Player() = default;
+
+    // Prepare for a new game. Returns false if the bot cannot play.
+    virtual bool begin_game() = 0;
+
+    // Move of the moving tetromino.
+    virtual Decision decide(const GameCore<Rules>& engine, int budget_ms,
+                            BotMove& move) = 0;
+};
+
+template <typename Rules>
+class SearchPlayer : public Player<Rules>
+{
+public:
+    explicit SearchPlayer(const BotWeights& weights) :
+        search_(TABLE_SIZE_LOG2)
+    {
+        search_.set_weights(weights);
+    }
+
+    bool begin_game() override { return true; }
+
+    Decision decide(const GameCore<Rules>& engine, int budget_ms, BotMove& move) override
+    {
+        move = search_.search(engine, budget_ms).move;
+        return MOVE;
+    }
+
+private:
+    BotSearchCore<Rules> search_;
+};
+
+// The player of the tuner.
+template <typename Rules>
+class GreedyPlayer : public Player<Rules>
+{
+public:
+    explicit GreedyPlayer(const BotWeights& weights) :
+        weights_(weights)
+    {
+    }
+
+    bool begin_game() override { return true; }
+
+    Decision decide(const GameCore<Rules>& engine, int, BotMove& move) override
+    {
+        generator_.generate(engine);
+
+        const typename MoveGenerator<Rules>::Placement* best = NULL;
+        int best_score = BotSearch::LOSS;
+
+        for (const auto& placement : generator_.placements())
+        {
+            int score = BotSearch::evaluate_placement(engine.board(), placement.piece,
+                                                      weights_);
+
+            if (best == NULL || score > best_score)
+            {
+                best = &placement;
+                best_score = score;
+            }
+        }
+
+        if (best == NULL)
+        {
+            return DROP;
+        }
+
+        // The path of the generator has the hold, the move only the rest.
+        generator_.inputs(*best, move.path);
+        move.hold = best->hold;
+
+        if (move.hold && !move.path.empty() && move.path.front() == GameEngine::HOLD)
+        {
+            move.path.erase(move.path.begin());
+        }
+
+        return MOVE;
+    }
+
+private:
+    BotWeights weights_;
+    MoveGenerator<Rules> generator_;
+};
+
+template <typename Rules>
+class PluginPlayer : public Player<Rules>
+{
+public:
+    explicit PluginPlayer(const std::string& file_name)
+    {
+        loaded_ = plugin_.load(QString::fromStdString(file_name));
+    }
+
+    bool begin_game() override
+    {
+        return loaded_ && plugin_.begin_game();
+    }
+
+    Decision decide(const GameCore<Rules>& engine, int budget_ms, BotMove& move) override
+    {
+        return plugin_.decide(engine, budget_ms, move) ? MOVE : DROP;
+    }
+
+    QString error() const { return plugin_.error(); }
+
+private:
+    BotPlugin plugin_;
+    bool loaded_ = false;
+};
+
+// Same protocol as ExternalBot, but each piece waits for its move, since
+// the games of the tournament do not show the moves. A move which comes
+// after its piece was given up is skipped by its id.
+template <typename Rules>
+class ProgramPlayer : public Player<Rules>
+{
+public:
+    // The grace is the time over the budget before a move is given up.
+    ProgramPlayer(const std::string& program, int grace_ms) :
+        grace_ms_(grace_ms)
+    {
+        process_.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        process_.start(QString::fromStdString(program), QStringList());
+
+        if (process_.waitForStarted(START_WAIT_MS))
+        {
+            process_.write(PROTOCOL_HEADER);
+        }
+    }
+
+    // Closing the input asks the program to quit. It is killed if it does
+    // not.
+    ~ProgramPlayer()
+    {
+        if (process_.state() == QProcess::NotRunning)
+        {
+            return;
+        }
+
+        process_.closeWriteChannel();
+
+        if (!process_.waitForFinished(EXIT_WAIT_MS))
+        {
+            process_.kill();
+            process_.waitForFinished(EXIT_WAIT_MS);
+        }
+    }
+
+    bool begin_game() override
+    {
+        return process_.state() == QProcess::Running;
+    }
+
+    Decision decide(const GameCore<Rules>& engine, int budget_ms, BotMove& move) override;
+
+private:
+    QProcess process_;
+    int grace_ms_ = 0;
+    uint32_t id_ = 0;
+};
+
+template <typename Rules>
+Decision ProgramPlayer<Rules>::decide(const GameCore<Rules>& engine, int budget_ms,
+                                      BotMove& move)
+{
+    if (process_.state() != QProcess::Running)
+    {
+        return DROP;
+    }
+
+    id_ += 1;
+
+    char line[64 + Board::ROWS * 3];
+    int length = snprintf(line, sizeof(line), "piece %u %d %d %d %c %d ",
+                          id_, budget_ms, engine.current().type, engine.next().type,
+                          engine.is_hold_empty() ? '-' : char('0' + engine.hold().type),
+                          engine.can_hold() ? 1 : 0);
+
+    for (uint16_t row : engine.board().rows)
+    {
+        length += snprintf(line + length, sizeof(line) - length, "%03x", row);
+    }
+
+    line[length++] = '\n';
+    process_.write(line, length);
+
+    QElapsedTimer clock;
+    clock.start();
+
+    int limit_ms = budget_ms + grace_ms_;
+
+    while (clock.elapsed() <= limit_ms)
+    {
+        if (!process_.canReadLine())
+        {
+            process_.waitForReadyRead(std::max<int>(1, limit_ms - clock.elapsed()));
+            continue;
+        }
+
+        QList<QByteArray> parts = process_.readLine().trimmed().split(' ');
+        bool valid = false;
+
+        if (parts.size() != 3 || parts.at(0) != "move" ||
+                parts.at(1).toUInt(&valid) != id_ || !valid)
+        {
+            continue;
+        }
+
+        if (parts.at(2) == "-")
+        {
+            return DROP;
+        }
+
+        for (char letter : parts.at(2))
+        {
+            GameEngine::Input input;
+
+            if (!GameEngine::input_from_letter(letter, input) || input == GameEngine::SPAWN)
+            {
+                move.path.clear();
+                return DROP;
+            }
+
+            move.path.push_back(input);
+        }
+
+        return MOVE;
+    }
+
+    return LATE;
+}
+
+template <typename Rules>
+std::unique_ptr<Player<Rules>> make_player(const BotSpec& spec, const Settings& settings)
+{
+    switch (spec.kind)
+    {
+    case BotSpec::SEARCH:
+        return std::unique_ptr<Player<Rules>>(new SearchPlayer<Rules>(spec.weights));
+    case BotSpec::GREEDY:
+        return std::unique_ptr<Player<Rules>>(new GreedyPlayer<Rules>(spec.weights));
+    case BotSpec::PLUGIN:
+        return std::unique_ptr<Player<Rules>>(new PluginPlayer<Rules>(spec.argument));
+    case BotSpec::PROGRAM:
+        return std::unique_ptr<Player<Rules>>(
+                    new ProgramPlayer<Rules>(spec.argument, settings.grace_ms));
+    }
+
+    return NULL;
+}
+
+// A bot which cannot start is found before the games, not as a bot which
+// loses every game.
+template <typename Rules>
+bool can_play(const BotSpec& spec, const Settings& settings)
+{
+    std::unique_ptr<Player<Rules>> player = make_player<Rules>(spec, settings);
+
+    if (!player->begin_game())
+    {
+        PluginPlayer<Rules>* plugin = dynamic_cast<PluginPlayer<Rules>*>(player.get());
+
+        fprintf(stderr, "Bot %s can not play. %s\n", spec.name.c_str(),
+                plugin != NULL ? plugin->error().toStdString().c_str() : "");
+        return false;
+    }
+
+    return true;
+}
+
+// Parse <name>=<kind>[:<argument>].
+bool parse_bot(const std::string& text, BotSpec& spec)
+{
+    size_t equals = text.find('=');
+
+    if (equals == std::string::npos || equals == 0)
+    {
+        return false;
+    }
+
+    spec.name = text.substr(0, equals);
+
+    std::string kind = text.substr(equals + 1);
+    size_t colon = kind.find(':');
+
+    if (colon != std::string::npos)
+    {
+        spec.argument = kind.substr(colon + 1);
+        kind = kind.substr(0, colon);
+    }
+
+    if (kind == "search" || kind == "greedy")
+    {
+        spec.kind = kind == "search" ? BotSpec::SEARCH : BotSpec::GREEDY;
+        return spec.argument.empty() || spec.weights.read(spec.argument);
+    }
+    else if (kind == "plugin" && !spec.argument.empty())
+    {
+        spec.kind = BotSpec::PLUGIN;
+        return true;
+    }
+    else if (kind == "program" && !spec.argument.empty())
+    {
+        spec.kind = BotSpec::PROGRAM;
+        return true;
+    }
+
+    return false;
+}
+
+//*****************************************************************************
+// Games.
+
+// CPU time of the calling thread.
+double thread_cpu_ms()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1e6;
+}
+
+// A bot which cannot play drops every tetromino.
+template <typename Rules>
+Outcome play_game(Player<Rules>& player, uint32_t seed, const Settings& settings)
+{
+    Outcome outcome;
+
+    GameCore<Rules> engine;
+    engine.reset(seed);
+
+    bool playing = player.begin_game();
+
+    for (int piece = 0; piece < settings.pieces; ++piece)
+    {
+        engine.apply(GameEngine::SPAWN);
+
+        if (engine.is_over())
+        {
+            break;
+        }
+
+        BotMove move;
+        Decision decision = DROP;
+
+        if (playing)
+        {
+            double begin = thread_cpu_ms();
+            decision = player.decide(engine, settings.budget_ms, move);
+            double used = thread_cpu_ms() - begin;
+
+            outcome.cpu_ms += used;
+
+            if (decision == MOVE && used > settings.budget_ms + settings.grace_ms)
+            {
+                decision = LATE;
+            }
+        }
+
+        if (decision == LATE)
+        {
+            outcome.timeouts += 1;
+        }
+
+        if (decision != MOVE)
+        {
+            move = BotMove();
+        }
+
+        for (GameEngine::Input input : move.inputs())
+        {
+            engine.apply(input);
+        }
+
+        // The path ends with the lock, this is only in case it did not.
+        while (engine.is_piece_active())
+        {
+            engine.apply(GameEngine::GRAVITY);
+        }
+
+        outcome.pieces += 1;
+    }
+
+    outcome.points = engine.points();
+    outcome.lines = engine.lines_removed();
+
+    return outcome;
+}
+
+// Positive if the first game is better.
+int compare(const Outcome& first, const Outcome& second)
+{
+    if (first.pieces != second.pieces)
+    {
+        return first.pieces > second.pieces ? 1 : -1;
+    }
+
+    if (first.points != second.points)
+    {
+        return first.points > second.points ? 1 : -1;
+    }
+
+    return 0;
+}
+
+// Games of the bots on the seeds of the round, outcome of bot b on game g
+// at b * games + g. Each job is one game, taken by the threads in order
+// of the seeds, so the games of a slow bot spread over the threads.
+template <typename Rules>
+std::vector<Outcome> play_round(const std::vector<BotSpec>& bots,
+                                const std::vector<int>& playing, uint32_t first_seed,
+                                const Settings& settings, unsigned int num_threads)
+{
+    std::vector<Outcome> outcomes(bots.size() * settings.games);
+
+    int num_jobs = int(playing.size()) * settings.games;
+    std::atomic<int> next_job(0);
+    std::vector<QThread*> workers;
+
+    // The threads are QThreads, since bot programs need the events of
+    // QProcess.
+    for (unsigned int t = 0; t < num_threads; ++t)
+    {
+        workers.push_back(QThread::create([&bots, &playing, &outcomes, &next_job,
+                                           &settings, first_seed, num_jobs]()
+        {
+            std::vector<std::unique_ptr<Player<Rules>>> players(bots.size());
+
+            for (int i = next_job++; i < num_jobs; i = next_job++)
+            {
+                int bot = playing.at(i % playing.size());
+                int game = i / int(playing.size());
+
+                if (players.at(bot) == NULL)
+                {
+                    players.at(bot) = make_player<Rules>(bots.at(bot), settings);
+                }
+
+                outcomes.at(bot * settings.games + game) =
+                        play_game(*players.at(bot), first_seed + game, settings);
+            }
+        }));
+
+        workers.back()->start();
+    }
+
+    for (QThread* worker : workers)
+    {
+        worker->wait();
+        delete worker;
+    }
+
+    return outcomes;
+}
+
+// Games of the round with the rules of the settings.
+std::vector<Outcome> play_round_with_rules(const std::vector<BotSpec>& bots,
+                                           const std::vector<int>& playing,
+                                           uint32_t first_seed, const Settings& settings,
+                                           unsigned int num_threads)
+{
+    switch (settings.rules)
+    {
+    case MODERN_RULES:
+        return play_round<ModernRules>(bots, playing, first_seed, settings, num_threads);
+
+    case NO_HOLD_RULES:
+        return play_round<NoHoldRules>(bots, playing, first_seed, settings, num_threads);
+
+    default:
+        return play_round<ClassicRules>(bots, playing, first_seed, settings, num_threads);
+    }
+}
+
+//*****************************************************************************
+// Pairings and standings.
+
+double score_rate(const Tally& tally)
+{
+    return tally.games() > 0 ? tally.score() / tally.games() : 0.5;
+}
+
+// Half width of the 95% confidence interval of the score rate, from the
+// spread of the scores of the games.
+double confidence(const Tally& tally)
+{
+    int games = tally.games();
+
+    if (games < 2)
+    {
+        return 1;
+    }
+
+    double mean = score_rate(tally);
+    double squares = (tally.wins + tally.draws / 4.0) / games;
+    double variance = std::max(0.0, squares - mean * mean) * games / (games - 1);
+
+    return 1.96 * std::sqrt(variance / games);
+}
+
+// Bots from the best score rate to the worst.
+std::vector<int> ranking(const std::vector<Totals>& totals)
+{
+    std::vector<int> order(totals.size());
+
+    for (int i = 0; i < int(order.size()); ++i)
+    {
+        order.at(i) = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&totals](int first, int second)
+    {
+        return score_rate(totals.at(first).tally) > score_rate(totals.at(second).tally);
+    });
+
+    return order;
+}
+
+// Each bot in order of the standings meets the unpaired bot below it which
+// it met least, the closest one first. With an odd number of bots, the
+// lowest bot of those which played the most games sits out.
+std::vector<std::pair<int, int>> swiss_pairings(
+        const std::vector<Totals>& totals, const std::vector<std::vector<Tally>>& pairs)
+{
+    std::vector<int> order = ranking(totals);
+    std::vector<bool> paired(order.size(), false);
+    std::vector<std::pair<int, int>> pairings;
+
+    if (order.size() % 2 == 1)
+    {
+        int out = int(order.size()) - 1;
+
+        for (int i = out - 1; i >= 0; --i)
+        {
+            if (totals.at(order.at(i)).games > totals.at(order.at(out)).games)
+            {
+                out = i;
+            }
+        }
+
+        paired.at(out) = true;
+    }
+
+    for (int i = 0; i < int(order.size()); ++i)
+    {
+        if (paired.at(i))
+        {
+            continue;
+        }
+
+        int best = -1;
+
+        for (int j = i + 1; j < int(order.size()); ++j)
+        {
+            if (!paired.at(j) && (best < 0 ||
+                    pairs.at(order.at(i)).at(order.at(j)).games() <
+                    pairs.at(order.at(i)).at(order.at(best)).games()))
+            {
+                best = j;
+            }
+        }
+
+        if (best < 0)
+        {
+            break;
+        }
+
+        paired.at(i) = true;
+        paired.at(best) = true;
+        pairings.emplace_back(order.at(i), order.at(best));
+    }
+
+    return pairings;
+}
+
+std::vector<std::pair<int, int>> round_robin_pairings(int num_bots)
+{
+    std::vector<std::pair<int, int>> pairings;
+
+    for (int i = 0; i < num_bots; ++i)
+    {
+        for (int j = i + 1; j < num_bots; ++j)
+        {
+            pairings.emplace_back(i, j);
+        }
+    }
+
+    return pairings;
+}
+
+void add_result(Tally& tally, int result)
+{
+    if (result > 0)
+    {
+        tally.wins += 1;
+    }
+    else if (result < 0)
+    {
+        tally.losses += 1;
+    }
+    else
+    {
+        tally.draws += 1;
+    }
+}
+
+void print_standings(const std::vector<BotSpec>& bots, const std::vector<Totals>& totals,
+                     const std::vector<std::vector<Tally>>& pairs)
+{
+    printf("\n%-4s %-16s %7s %7s %8s %8s %9s %8s %9s\n", "Rank", "Bot", "Played",
+           "Score", "95% CI", "W/D/L", "Pieces", "Points", "Late");
+
+    std::vector<int> order = ranking(totals);
+
+    for (int rank = 0; rank < int(order.size()); ++rank)
+    {
+        const Totals& bot = totals.at(order.at(rank));
+        double games = std::max<int64_t>(bot.games, 1);
+        std::string record = std::to_string(bot.tally.wins) + "/" +
+                std::to_string(bot.tally.draws) + "/" + std::to_string(bot.tally.losses);
+
+        printf("%-4d %-16s %7d %6.1f%% %7.1f%% %8s %9.1f %8.0f %9lld\n", rank + 1,
+               bots.at(order.at(rank)).name.c_str(), bot.tally.games(),
+               100 * score_rate(bot.tally), 100 * confidence(bot.tally), record.c_str(),
+               bot.pieces / games, bot.points / games, (long long)bot.timeouts);
+    }
+
+    // Score of the bot of the row against the bot of the column.
+    printf("\n%-16s", "");
+
+    for (int column : order)
+    {
+        printf(" %8.8s", bots.at(column).name.c_str());
+    }
+
+    printf("\n");
+
+    for (int row : order)
+    {
+        printf("%-16s", bots.at(row).name.c_str());
+
+        for (int column : order)
+        {
+            const Tally& tally = pairs.at(row).at(column);
+
+            if (row == column || tally.games() == 0)
+            {
+                printf(" %8s", "-");
+            }
+            else
+            {
+                printf(" %7.1f%%", 100 * score_rate(tally));
+            }
+        }
+
+        printf("\n");
+    }
+
+    printf("\nCPU per move:");
+
+    for (int bot : order)
+    {
+        int64_t moves = std::max<int64_t>(totals.at(bot).pieces, 1);
+        printf(" %s %.2f ms", bots.at(bot).name.c_str(), totals.at(bot).cpu_ms / moves);
+    }
+
+    printf("\n");
+}
+
+void print_usage()
+{
+    fprintf(stderr, "Usage: tournament --bot <name>=<kind>[:<argument>] --bot ...\n"
+                    "                  [--format round-robin|swiss] [--rounds <n>] [--games <n>]\n"
+                    "                  [--pieces <n>] [--budget <ms>] [--grace <ms>] [--seed <n>]\n"
+                    "                  [--rules classic|modern|nohold] [--threads <n>]\n"
+                    "Kinds: search[:<weights>] greedy[:<weights>] plugin:<library>"
+                    " program:<program>\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    Settings settings;
+    std::vector<BotSpec> bots;
+    unsigned int num_threads = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            print_usage();
+            return 2;
+        }
+
+        std::string value = argv[++i];
+
+        if (arg == "--bot")
+        {
+            BotSpec spec;
+
+            if (!parse_bot(value, spec))
+            {
+                fprintf(stderr, "Can not use bot %s\n", value.c_str());
+                return 2;
+            }
+
+            bots.push_back(spec);
+        }
+        else if (arg == "--format")
+        {
+            if (value != "round-robin" && value != "swiss")
+            {
+                print_usage();
+                return 2;
+            }
+
+            settings.format = value == "swiss" ? SWISS : ROUND_ROBIN;
+        }
+        else if (arg == "--rounds")
+        {
+            settings.rounds = std::max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--games")
+        {
+            settings.games = std::max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--pieces")
+        {
+            settings.pieces = std::max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--budget")
+        {
+            settings.budget_ms = std::max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--grace")
+        {
+            settings.grace_ms = std::max(0, atoi(value.c_str()));
+        }
+        else if (arg == "--seed")
+        {
+            settings.seed = strtoul(value.c_str(), NULL, 10);
+        }
+        else if (arg == "--rules")
+        {
+            if (!rules_from_name(value.c_str(), settings.rules))
+            {
+                print_usage();
+                return 2;
+            }
+        }
+        else if (arg == "--threads")
+        {
+            num_threads = atoi(value.c_str());
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    if (bots.size() < 2)
+    {
+        print_usage();
+        return 2;
+    }
+
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+
+    // Starting a bot does not depend on the rules.
+    for (const BotSpec& spec : bots)
+    {
+        if (!can_play<ClassicRules>(spec, settings))
+        {
+            return 1;
+        }
+    }
+
+    int num_bots = int(bots.size());
+    std::vector<Totals> totals(num_bots);
+    std::vector<std::vector<Tally>> pairs(num_bots, std::vector<Tally>(num_bots));
+
+    printf("%d bots, %s, %d rounds of %d games of %d tetrominos with the %s rules, "
+           "%d ms a move, %u threads\n", num_bots,
+           settings.format == SWISS ? "swiss" : "round robin", settings.rounds,
+           settings.games, settings.pieces, RULES_NAMES.at(settings.rules),
+           settings.budget_ms, num_threads);
+
+    for (int round = 0; round < settings.rounds; ++round)
+    {
+        std::vector<std::pair<int, int>> pairings = settings.format == SWISS ?
+                    swiss_pairings(totals, pairs) : round_robin_pairings(num_bots);
+
+        // Only the bots of a pairing play. A bot sitting out plays nothing.
+        std::vector<int> playing;
+
+        for (int bot = 0; bot < num_bots; ++bot)
+        {
+            for (const auto& pairing : pairings)
+            {
+                if (pairing.first == bot || pairing.second == bot)
+                {
+                    playing.push_back(bot);
+                    break;
+                }
+            }
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+
+        uint32_t first_seed = settings.seed + uint32_t(round) * settings.games;
+        std::vector<Outcome> outcomes = play_round_with_rules(bots, playing, first_seed,
+                                                              settings, num_threads);
+
+        double seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin).count();
+
+        for (int bot : playing)
+        {
+            Totals& total = totals.at(bot);
+
+            for (int game = 0; game < settings.games; ++game)
+            {
+                const Outcome& outcome = outcomes.at(bot * settings.games + game);
+
+                total.games += 1;
+                total.pieces += outcome.pieces;
+                total.points += outcome.points;
+                total.timeouts += outcome.timeouts;
+                total.cpu_ms += outcome.cpu_ms;
+            }
+        }
+
+        for (const auto& pairing : pairings)
+        {
+            for (int game = 0; game < settings.games; ++game)
+            {
+                int result = compare(outcomes.at(pairing.first * settings.games + game),
+                                     outcomes.at(pairing.second * settings.games + game));
+
+                add_result(pairs.at(pairing.first).at(pairing.second), result);
+                add_result(pairs.at(pairing.second).at(pairing.first), -result);
+                add_result(totals.at(pairing.first).tally, result);
+                add_result(totals.at(pairing.second).tally, -result);
+            }
+        }
+
+        printf("Round %d: %zu pairings, %d games in %.1f s, %.0f games/s\n", round + 1,
+               pairings.size(), int(playing.size()) * settings.games, seconds,
+               seconds > 0 ? playing.size() * settings.games / seconds : 0.0);
+        fflush(stdout);
+    }
+
+    print_standings(bots, totals, pairs);
+
+    return 0;
+}
@@ -0,0 +1,19 @@
+# Plays bots against each other on the same seeds and ranks them.
+
+TARGET = tournament
+TEMPLATE = app
+
+QT = core
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle
+
+SOURCES += \
+        main.cpp \
+        ../../botplugin.cpp
+
+HEADERS += \
+        ../../botplugin.hh \
+        ../../botpluginabi.h
+
+include(../../engine.pri)
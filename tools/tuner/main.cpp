@@ -0,0 +1,573 @@
+// Tuning of the weights of the bot.
+//
+// Cross-entropy method: each iteration samples weights around a mean, plays
+// the same seeded games with every sample on all cores and moves the mean
+// to the average of the best samples. The spread shrinks to the spread of
+// the best samples, but not below a floor, so the search keeps looking.
+//
+// Every sample plays the same seeds, so the difference of two samples is
+// the difference of their weights, not of their tetrominos. The games are
+// played by a bot which places each tetromino, with hold, where the board
+// score is best, without searching deeper. It is thousands of times faster
+// than the search of the game and its weights carry over.
+//
+// The games are played with the rules of the game unless --rules chooses
+// another set of gamerules.hh.
+//
+// The state is written to the checkpoint after each iteration, and a run
+// with the same checkpoint continues from it with the settings it was
+// started with. The best weights found are written after each iteration
+// too, in the file the game reads with --bot-weights.
+//
+// Usage:
+//   tuner [--threads <n>] [--games <n>] [--pieces <n>] [--population <n>]
+//         [--elites <n>] [--iterations <n>] [--seed <n>]
+//         [--rules classic|modern|nohold] [--checkpoint <file>]
+//         [--output <file>]
+
+#include "botsearch.hh"
+#include "botweights.hh"
+#include "movegenerator.hh"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const std::string CHECKPOINT_HEADER = "tetris-tuner 2";
+
+// Checkpoints of runs before the rules could be chosen, with the classic
+// rules.
+const std::string CLASSIC_CHECKPOINT_HEADER = "tetris-tuner 1";
+
+// Smallest spread of a weight, so the search does not stop early.
+const double MIN_DEVIATION = 10;
+
+using Vector = std::array<double, BotWeights::NUMBER_OF_WEIGHTS>;
+
+// Fixed for a run. Kept in the checkpoint.
+struct Settings
+{
+    int games = 200;
+    int pieces = 500;
+    int population = 32;
+    int elites = 8;
+    uint32_t seed = 1;
+    RulesName rules = CLASSIC_RULES;
+};
+
+// Everything needed to continue a run.
+struct State
+{
+    Settings settings;
+    int iteration = 0;
+
+    Vector mean = {};
+    Vector deviation = {};
+
+    double best_score = -1;
+    BotWeights best;
+};
+
+BotWeights round_weights(const Vector& values)
+{
+    BotWeights weights;
+
+    for (int i = 0; i < BotWeights::NUMBER_OF_WEIGHTS; ++i)
+    {
+        weights.values.at(i) = int(std::lround(values.at(i)));
+    }
+
+    return weights;
+}
+
+// The search starts from the hand tuned weights with half of each as the
+// spread.
+State initial_state(const Settings& settings)
+{
+    State state;
+    state.settings = settings;
+
+    BotWeights defaults;
+
+    for (int i = 0; i < BotWeights::NUMBER_OF_WEIGHTS; ++i)
+    {
+        state.mean.at(i) = defaults.values.at(i);
+        state.deviation.at(i) = std::max(std::abs(defaults.values.at(i)) / 2.0,
+                                         MIN_DEVIATION);
+    }
+
+    state.best = defaults;
+
+    return state;
+}
+
+bool read_checkpoint(const std::string& file_name, State& state)
+{
+    std::ifstream file;
+    file.open(file_name);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::string line = "";
+    std::getline(file, line);
+
+    if (line != CHECKPOINT_HEADER && line != CLASSIC_CHECKPOINT_HEADER)
+    {
+        return false;
+    }
+
+    State read;
+    Settings& settings = read.settings;
+    std::string key = "";
+
+    file >> key >> settings.games;
+    file >> key >> settings.pieces;
+    file >> key >> settings.population;
+    file >> key >> settings.elites;
+    file >> key >> settings.seed;
+
+    if (line == CHECKPOINT_HEADER)
+    {
+        std::string name = "";
+        file >> key >> name;
+
+        if (!rules_from_name(name.c_str(), settings.rules))
+        {
+            return false;
+        }
+    }
+
+    file >> key >> read.iteration;
+    file >> key >> read.best_score;
+
+    for (int i = 0; i < BotWeights::NUMBER_OF_WEIGHTS; ++i)
+    {
+        file >> key >> read.mean.at(i) >> read.deviation.at(i)
+             >> read.best.values.at(i);
+
+        if (key != BotWeights::NAMES.at(i))
+        {
+            return false;
+        }
+    }
+
+    if (file.fail())
+    {
+        return false;
+    }
+
+    state = read;
+
+    return true;
+}
+
+// Written to a temporary file which then replaces the checkpoint, so a run
+// stopped while writing keeps the last checkpoint.
+bool write_checkpoint(const std::string& file_name, const State& state)
+{
+    std::string temporary = file_name + ".tmp";
+
+    std::ofstream file;
+    file.open(temporary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    const Settings& settings = state.settings;
+
+    file << CHECKPOINT_HEADER << '\n';
+    file << "games " << settings.games << '\n';
+    file << "pieces " << settings.pieces << '\n';
+    file << "population " << settings.population << '\n';
+    file << "elites " << settings.elites << '\n';
+    file << "seed " << settings.seed << '\n';
+    file << "rules " << RULES_NAMES.at(settings.rules) << '\n';
+    file << "iteration " << state.iteration << '\n';
+    file << "best_score " << state.best_score << '\n';
+
+    for (int i = 0; i < BotWeights::NUMBER_OF_WEIGHTS; ++i)
+    {
+        file << BotWeights::NAMES.at(i) << ' ' << state.mean.at(i) << ' '
+             << state.deviation.at(i) << ' ' << state.best.values.at(i) << '\n';
+    }
+
+    file.close();
+
+    if (file.fail())
+    {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, file_name, error);
+
+    return !error;
+}
+
+// Points of a game where each tetromino goes to the placement with the
+// best board score.
+template <typename Rules>
+int play_game(const BotWeights& weights, uint32_t seed, int max_pieces,
+              MoveGenerator<Rules>& generator, std::vector<GameEngine::Input>& path)
+{
+    GameCore<Rules> engine;
+    engine.reset(seed);
+
+    for (int piece = 0; piece < max_pieces; ++piece)
+    {
+        engine.apply(GameEngine::SPAWN);
+
+        if (engine.is_over())
+        {
+            break;
+        }
+
+        generator.generate(engine);
+
+        const typename MoveGenerator<Rules>::Placement* best = NULL;
+        int best_score = BotSearch::LOSS;
+
+        for (const auto& placement : generator.placements())
+        {
+            int score = BotSearch::evaluate_placement(engine.board(), placement.piece,
+                                                      weights);
+
+            if (best == NULL || score > best_score)
+            {
+                best = &placement;
+                best_score = score;
+            }
+        }
+
+        if (best == NULL)
+        {
+            break;
+        }
+
+        generator.inputs(*best, path);
+
+        for (GameEngine::Input input : path)
+        {
+            engine.apply(input);
+        }
+
+        // The path ends with the lock, this is only in case it did not.
+        while (engine.is_piece_active())
+        {
+            engine.apply(GameEngine::GRAVITY);
+        }
+    }
+
+    return engine.points();
+}
+
+// Play the jobs a thread takes, each one game of one sample.
+template <typename Rules>
+void play_jobs(const std::vector<BotWeights>& samples, const Settings& settings,
+               std::vector<int>& points, std::atomic<int>& next_job)
+{
+    MoveGenerator<Rules> generator;
+    std::vector<GameEngine::Input> path;
+
+    for (int i = next_job++; i < int(points.size()); i = next_job++)
+    {
+        const BotWeights& weights = samples.at(i / settings.games);
+        uint32_t seed = settings.seed + i % settings.games;
+
+        points.at(i) = play_game(weights, seed, settings.pieces, generator, path);
+    }
+}
+
+// Average points of each sample over the seeds. Each job is one game of
+// one sample, taken by the threads in order, so all threads stay busy
+// until the last few games.
+std::vector<double> score_samples(const std::vector<BotWeights>& samples,
+                                  const Settings& settings, unsigned int num_threads)
+{
+    int num_jobs = int(samples.size()) * settings.games;
+    std::vector<int> points(num_jobs);
+    std::atomic<int> next_job(0);
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < num_threads; ++t)
+    {
+        workers.emplace_back([&samples, &settings, &points, &next_job]()
+        {
+            switch (settings.rules)
+            {
+            case MODERN_RULES:
+                play_jobs<ModernRules>(samples, settings, points, next_job);
+                break;
+
+            case NO_HOLD_RULES:
+                play_jobs<NoHoldRules>(samples, settings, points, next_job);
+                break;
+
+            default:
+                play_jobs<ClassicRules>(samples, settings, points, next_job);
+                break;
+            }
+        });
+    }
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    std::vector<double> scores(samples.size(), 0);
+
+    for (int i = 0; i < num_jobs; ++i)
+    {
+        scores.at(i / settings.games) += points.at(i);
+    }
+
+    for (double& score : scores)
+    {
+        score /= settings.games;
+    }
+
+    return scores;
+}
+
+// The first sample is the mean itself, so a good mean is not lost to
+// unlucky samples. The random numbers depend only on the seed and the
+// iteration, so a continued run samples what the stopped run would have.
+std::vector<BotWeights> sample(const State& state)
+{
+    std::mt19937 random(state.settings.seed * 7919u + state.iteration);
+    std::normal_distribution<double> normal(0, 1);
+
+    std::vector<BotWeights> samples;
+    samples.push_back(round_weights(state.mean));
+
+    while (int(samples.size()) < state.settings.population)
+    {
+        Vector values;
+
+        for (int i = 0; i < BotWeights::NUMBER_OF_WEIGHTS; ++i)
+        {
+            values.at(i) = state.mean.at(i) + state.deviation.at(i) * normal(random);
+        }
+
+        samples.push_back(round_weights(values));
+    }
+
+    return samples;
+}
+
+// Move the mean and the spread to those of the best samples.
+void update(State& state, const std::vector<BotWeights>& samples,
+            const std::vector<double>& scores)
+{
+    std::vector<int> order(samples.size());
+
+    for (int i = 0; i < int(order.size()); ++i)
+    {
+        order.at(i) = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&scores](int first, int second)
+    {
+        return scores.at(first) > scores.at(second);
+    });
+
+    int elites = std::min<int>(state.settings.elites, order.size());
+
+    for (int w = 0; w < BotWeights::NUMBER_OF_WEIGHTS; ++w)
+    {
+        double sum = 0;
+
+        for (int i = 0; i < elites; ++i)
+        {
+            sum += samples.at(order.at(i)).values.at(w);
+        }
+
+        double mean = sum / elites;
+        double squares = 0;
+
+        for (int i = 0; i < elites; ++i)
+        {
+            double difference = samples.at(order.at(i)).values.at(w) - mean;
+            squares += difference * difference;
+        }
+
+        state.mean.at(w) = mean;
+        state.deviation.at(w) = std::max(std::sqrt(squares / elites), MIN_DEVIATION);
+    }
+
+    if (scores.at(order.at(0)) > state.best_score)
+    {
+        state.best_score = scores.at(order.at(0));
+        state.best = samples.at(order.at(0));
+    }
+
+    state.iteration += 1;
+}
+
+void print_weights(const char* label, const BotWeights& weights)
+{
+    printf("  %-5s", label);
+
+    for (int i = 0; i < BotWeights::NUMBER_OF_WEIGHTS; ++i)
+    {
+        printf(" %s %d", BotWeights::NAMES.at(i), weights.values.at(i));
+    }
+
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    int iterations = 50;
+    std::string checkpoint = "tuner.checkpoint";
+    std::string output = "tuner.weights";
+    unsigned int num_threads = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Usage: tuner [--threads <n>] [--games <n>] [--pieces <n>]\n"
+                            "             [--population <n>] [--elites <n>] [--iterations <n>]\n"
+                            "             [--seed <n>] [--rules classic|modern|nohold]\n"
+                            "             [--checkpoint <file>] [--output <file>]\n");
+            return 2;
+        }
+
+        std::string value = argv[++i];
+
+        if (arg == "--threads")
+        {
+            num_threads = atoi(value.c_str());
+        }
+        else if (arg == "--games")
+        {
+            settings.games = std::max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--pieces")
+        {
+            settings.pieces = std::max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--population")
+        {
+            settings.population = std::max(2, atoi(value.c_str()));
+        }
+        else if (arg == "--elites")
+        {
+            settings.elites = std::max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--iterations")
+        {
+            iterations = atoi(value.c_str());
+        }
+        else if (arg == "--seed")
+        {
+            settings.seed = strtoul(value.c_str(), NULL, 10);
+        }
+        else if (arg == "--rules")
+        {
+            if (!rules_from_name(value.c_str(), settings.rules))
+            {
+                fprintf(stderr, "Unknown rules %s\n", value.c_str());
+                return 2;
+            }
+        }
+        else if (arg == "--checkpoint")
+        {
+            checkpoint = value;
+        }
+        else if (arg == "--output")
+        {
+            output = value;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+
+    State state = initial_state(settings);
+
+    if (read_checkpoint(checkpoint, state))
+    {
+        printf("Continuing %s from iteration %d\n", checkpoint.c_str(), state.iteration);
+    }
+    else if (std::filesystem::exists(checkpoint))
+    {
+        fprintf(stderr, "Can not read checkpoint %s\n", checkpoint.c_str());
+        return 1;
+    }
+
+    const Settings& run = state.settings;
+
+    printf("%d games of %d tetrominos with the %s rules, %d samples, %d best kept, "
+           "%u threads\n", run.games, run.pieces, RULES_NAMES.at(run.rules),
+           run.population, run.elites, num_threads);
+
+    while (state.iteration < iterations)
+    {
+        auto begin = std::chrono::steady_clock::now();
+
+        std::vector<BotWeights> samples = sample(state);
+        std::vector<double> scores = score_samples(samples, run, num_threads);
+
+        double seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin).count();
+
+        update(state, samples, scores);
+
+        printf("Iteration %d: mean weights %.0f points, samples %.0f to %.0f, %.0f games/s\n",
+               state.iteration, scores.at(0),
+               *std::min_element(scores.begin(), scores.end()),
+               *std::max_element(scores.begin(), scores.end()),
+               seconds > 0 ? samples.size() * run.games / seconds : 0.0);
+        print_weights("mean", round_weights(state.mean));
+        print_weights("best", state.best);
+        fflush(stdout);
+
+        if (!write_checkpoint(checkpoint, state))
+        {
+            fprintf(stderr, "Can not write checkpoint %s\n", checkpoint.c_str());
+            return 1;
+        }
+
+        if (!state.best.write(output))
+        {
+            fprintf(stderr, "Can not write weights %s\n", output.c_str());
+            return 1;
+        }
+    }
+
+    printf("Best weights %.0f points, written to %s\n", state.best_score, output.c_str());
+
+    return 0;
+}
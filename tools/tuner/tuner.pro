@@ -0,0 +1,12 @@
+# Tunes the weights of the bot by playing games with sampled weights.
+
+TARGET = tuner
+TEMPLATE = app
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+SOURCES += \
+        main.cpp
+
+include(../../engine.pri)
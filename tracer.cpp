@@ -0,0 +1,139 @@
+#include "tracer.hh"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+std::atomic<bool> Tracer::enabled_(false);
+
+Tracer& Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+// Start recording events.
+void Tracer::start(const std::string& file_name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    file_name_ = file_name;
+    origin_ns_ = now_ns();
+    dropped_events_ = 0;
+    events_.clear();
+    events_.reserve(1 << 16);
+
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+// Stop recording and write all events to the file in Chrome Trace Event
+// format. Timestamps are in microseconds with nanosecond decimals.
+bool Tracer::stop()
+{
+    if (!is_enabled())
+    {
+        return true;
+    }
+
+    enabled_.store(false, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::ofstream file;
+    file.open(file_name_);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+    bool first = true;
+    char line[256];
+
+    // Names of the threads.
+    for (const std::pair<uint32_t, std::string>& thread : thread_names_)
+    {
+        snprintf(line, sizeof(line),
+                 "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+                 "\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",\n", thread.first, thread.second.c_str());
+
+        file << line;
+        first = false;
+    }
+
+    // Spans as complete events.
+    for (const Event& event : events_)
+    {
+        uint64_t ts = event.begin_ns - origin_ns_;
+
+        snprintf(line, sizeof(line),
+                 "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":\"%s\","
+                 "\"ts\":%llu.%03llu,\"dur\":%llu.%03llu}",
+                 first ? "" : ",\n", event.thread_id, event.name,
+                 (unsigned long long)(ts / 1000), (unsigned long long)(ts % 1000),
+                 (unsigned long long)(event.duration_ns / 1000),
+                 (unsigned long long)(event.duration_ns % 1000));
+
+        file << line;
+        first = false;
+    }
+
+    file << "\n],\"otherData\":{\"dropped_events\":" << dropped_events_ << "}}\n";
+    file.close();
+
+    events_.clear();
+    events_.shrink_to_fit();
+
+    return true;
+}
+
+// Give a name to the calling thread in the trace.
+void Tracer::set_thread_name(const char* name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_names_.push_back(std::make_pair(current_thread_id(), std::string(name)));
+}
+
+// Store one span.
+void Tracer::record(const char* name, uint64_t begin_ns, uint64_t end_ns)
+{
+    uint32_t thread_id = current_thread_id();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Recording may have stopped while the span was open.
+    if (!is_enabled() || begin_ns < origin_ns_)
+    {
+        return;
+    }
+
+    if (events_.size() >= MAX_EVENTS)
+    {
+        dropped_events_ += 1;
+        return;
+    }
+
+    Event event;
+    event.name = name;
+    event.begin_ns = begin_ns;
+    event.duration_ns = end_ns - begin_ns;
+    event.thread_id = thread_id;
+
+    events_.push_back(event);
+}
+
+uint64_t Tracer::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Small thread number, given in order of the first traced event.
+uint32_t Tracer::current_thread_id()
+{
+    static std::atomic<uint32_t> next_id(1);
+    thread_local uint32_t id = next_id.fetch_add(1);
+    return id;
+}
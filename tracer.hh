@@ -0,0 +1,99 @@
+#ifndef TRACER_HH
+#define TRACER_HH
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records scoped spans and writes them as Chrome Trace Event JSON, which can
+// be opened in chrome://tracing or ui.perfetto.dev.
+// Recording is off until start() is called. While it is off a span costs one
+// relaxed atomic load.
+class Tracer
+{
+public:
+    static Tracer& instance();
+
+    // Start recording. The events are written to file_name by stop().
+    void start(const std::string& file_name);
+
+    // Stop recording and write the recorded events to the file.
+    // Returns false if the file could not be written.
+    bool stop();
+
+    static bool is_enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Name shown for the calling thread in the trace viewer.
+    void set_thread_name(const char* name);
+
+    // Add one complete span. Times are from now_ns().
+    void record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+    // Monotonic clock in nanoseconds.
+    static uint64_t now_ns();
+
+private:
+    Tracer() = default;
+
+    struct Event
+    {
+        // Span names are string literals so only the pointer is stored.
+        const char* name = nullptr;
+        uint64_t begin_ns = 0;
+        uint64_t duration_ns = 0;
+        uint32_t thread_id = 0;
+    };
+
+    static uint32_t current_thread_id();
+
+    // Upper limit of stored events so a long session can not use
+    // all memory. Events after the limit are counted and dropped.
+    static const size_t MAX_EVENTS = 1 << 22;
+
+    static std::atomic<bool> enabled_;
+
+    std::mutex mutex_;
+    std::string file_name_ = "";
+    uint64_t origin_ns_ = 0;
+    uint64_t dropped_events_ = 0;
+    std::vector<Event> events_;
+    std::vector<std::pair<uint32_t, std::string>> thread_names_;
+};
+
+// Span which lasts until the end of the enclosing scope.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name):
+        name_(name), begin_ns_(Tracer::is_enabled() ? Tracer::now_ns() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (begin_ns_ != 0)
+        {
+            Tracer::instance().record(name_, begin_ns_, Tracer::now_ns());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t begin_ns_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Trace the rest of the current scope under the given name.
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#endif // TRACER_HH
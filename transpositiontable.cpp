@@ -0,0 +1,119 @@
+#include "transpositiontable.hh"
+
+namespace
+{
+// Layout of the data word.
+const int DEPTH_SHIFT = 32;
+const int GENERATION_SHIFT = 40;
+}
+
+TranspositionTable::TranspositionTable(int size_log2):
+    buckets_(new Bucket[size_t(1) << size_log2]),
+    mask_((uint64_t(1) << size_log2) - 1),
+    generation_(0)
+{
+    clear();
+}
+
+// Look for the key in its bucket.
+bool TranspositionTable::probe(uint64_t key, Entry& entry) const
+{
+    const Bucket& bucket = buckets_[key & mask_];
+
+    for (const Slot& slot : bucket.entries)
+    {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+        if ((check ^ data) == key && data != 0)
+        {
+            entry = unpack(data);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Store to the slot of the same key, an empty slot or the slot with the
+// least valuable entry.
+void TranspositionTable::store(uint64_t key, const Entry& entry)
+{
+    Bucket& bucket = buckets_[key & mask_];
+
+    // The highest bit is always set so a stored entry is never zero,
+    // which marks an empty slot.
+    uint8_t generation = generation_.load(std::memory_order_relaxed) | 0x80;
+
+    Slot* replace = &bucket.entries[0];
+    int replace_value = 1 << 30;
+
+    for (Slot& slot : bucket.entries)
+    {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+        if (data == 0 || (check ^ data) == key)
+        {
+            replace = &slot;
+            break;
+        }
+
+        // Entries of earlier searches are worth less than any entry of
+        // the current one.
+        int value = (data >> DEPTH_SHIFT) & 0xFF;
+        if (uint8_t(data >> GENERATION_SHIFT) != generation)
+        {
+            value -= 256;
+        }
+
+        if (value < replace_value)
+        {
+            replace = &slot;
+            replace_value = value;
+        }
+    }
+
+    uint64_t data = pack(entry, generation);
+
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::new_search()
+{
+    generation_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TranspositionTable::clear()
+{
+    for (uint64_t i = 0; i <= mask_; ++i)
+    {
+        for (Slot& slot : buckets_[i].entries)
+        {
+            slot.data.store(0, std::memory_order_relaxed);
+            slot.check.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t TranspositionTable::capacity() const
+{
+    return (mask_ + 1) * BUCKET_SIZE;
+}
+
+uint64_t TranspositionTable::pack(const Entry& entry, uint8_t generation)
+{
+    return uint64_t(uint32_t(entry.score)) |
+            (uint64_t(entry.depth) << DEPTH_SHIFT) |
+            (uint64_t(generation) << GENERATION_SHIFT);
+}
+
+TranspositionTable::Entry TranspositionTable::unpack(uint64_t data)
+{
+    Entry entry;
+    entry.score = int32_t(uint32_t(data));
+    entry.depth = uint8_t(data >> DEPTH_SHIFT);
+
+    return entry;
+}
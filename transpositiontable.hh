@@ -0,0 +1,79 @@
+#ifndef TRANSPOSITIONTABLE_HH
+#define TRANSPOSITIONTABLE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Cache of evaluated positions shared by the search threads of the bots.
+// Many input orders lead to the same position, so the evaluation found for
+// a Zobrist hash is stored and looked up before the position is searched
+// again. No move is stored: the positions of the search average over the
+// tetromino which comes next, so they have no single best move, and the
+// search has no cutoffs which trying a move first would help.
+//
+// The size is fixed when the table is made. Each bucket fills one cache
+// line with four entries. A full bucket replaces the entry with the lowest
+// depth, entries of earlier searches first.
+//
+// No locks are used. An entry is two 64-bit words, the data and the key
+// xored with the data. A probe checks that the key matches after xoring the
+// words back, so an entry torn by two threads writing at the same time is
+// not a hit.
+class TranspositionTable
+{
+public:
+    // Result stored for a position.
+    struct Entry
+    {
+        int32_t score = 0;
+
+        // How many tetrominos ahead the score was searched.
+        uint8_t depth = 0;
+    };
+
+    // Table with 2^size_log2 buckets.
+    explicit TranspositionTable(int size_log2);
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // Find the entry of the position. Returns false if there is none.
+    bool probe(uint64_t key, Entry& entry) const;
+
+    // Store the result of the position.
+    void store(uint64_t key, const Entry& entry);
+
+    // Start a new search. Entries of earlier searches are replaced first.
+    void new_search();
+
+    // Remove all entries. Not safe while other threads use the table.
+    void clear();
+
+    // Number of entries the table can hold.
+    size_t capacity() const;
+
+private:
+    static constexpr int BUCKET_SIZE = 4;
+
+    struct Slot
+    {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+    };
+
+    struct alignas(64) Bucket
+    {
+        Slot entries[BUCKET_SIZE];
+    };
+
+    static uint64_t pack(const Entry& entry, uint8_t generation);
+    static Entry unpack(uint64_t data);
+
+    std::unique_ptr<Bucket[]> buckets_;
+    uint64_t mask_;
+
+    std::atomic<uint8_t> generation_;
+};
+
+#endif // TRANSPOSITIONTABLE_HH
@@ -0,0 +1,114 @@
+#include "versuslink.hh"
+#include <QLocalServer>
+#include <QLocalSocket>
+
+VersusLink::VersusLink(QObject* parent) :
+    QObject(parent)
+{
+}
+
+// Only one player can join, so the server stops listening after it.
+bool VersusLink::host(const QString& name)
+{
+    server_ = new QLocalServer(this);
+
+    // Server left by a program which crashed.
+    QLocalServer::removeServer(name);
+
+    connect(server_, &QLocalServer::newConnection,
+            this, &VersusLink::accept_connection);
+
+    return server_->listen(name);
+}
+
+void VersusLink::join(const QString& name)
+{
+    QLocalSocket* socket = new QLocalSocket(this);
+
+    connect(socket, &QLocalSocket::connected,
+            this, &VersusLink::connected);
+
+    use_socket(socket);
+    socket->connectToServer(name);
+}
+
+// Write the message at once so the input delay stays small.
+void VersusLink::send(Message_type type, uint32_t tick, uint64_t value)
+{
+    if (socket_ == NULL)
+    {
+        return;
+    }
+
+    char bytes[MESSAGE_SIZE];
+    bytes[0] = char(type);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        bytes[1 + i] = char(tick >> (8 * i));
+    }
+
+    for (int i = 0; i < 8; ++i)
+    {
+        bytes[5 + i] = char(value >> (8 * i));
+    }
+
+    socket_->write(bytes, MESSAGE_SIZE);
+    socket_->flush();
+}
+
+void VersusLink::accept_connection()
+{
+    QLocalSocket* socket = server_->nextPendingConnection();
+
+    if (socket == NULL || socket_ != NULL)
+    {
+        return;
+    }
+
+    server_->close();
+
+    use_socket(socket);
+    emit connected();
+}
+
+// Messages may arrive split, so the bytes are kept until a whole message
+// is received.
+void VersusLink::read_messages()
+{
+    received_.append(socket_->readAll());
+
+    int offset = 0;
+
+    for (; offset + MESSAGE_SIZE <= received_.size(); offset += MESSAGE_SIZE)
+    {
+        const uint8_t* bytes =
+                reinterpret_cast<const uint8_t*>(received_.constData() + offset);
+
+        uint32_t tick = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            tick |= uint32_t(bytes[1 + i]) << (8 * i);
+        }
+
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            value |= uint64_t(bytes[5 + i]) << (8 * i);
+        }
+
+        emit message_received(bytes[0], tick, value);
+    }
+
+    received_.remove(0, offset);
+}
+
+void VersusLink::use_socket(QLocalSocket* socket)
+{
+    socket_ = socket;
+
+    connect(socket_, &QLocalSocket::readyRead,
+            this, &VersusLink::read_messages);
+    connect(socket_, &QLocalSocket::disconnected,
+            this, &VersusLink::disconnected);
+}
@@ -0,0 +1,57 @@
+#ifndef VERSUSLINK_HH
+#define VERSUSLINK_HH
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Connection between two games on the same machine in versus mode. One
+// side hosts a local server and the other joins it by name.
+//
+// All messages have the same size, integers in little endian order:
+//   1 byte   type
+//   4 bytes  tick
+//   8 bytes  value: the seed, the input or the checksum
+class VersusLink : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Message_type {HELLO, INPUT, CHECKSUM};
+
+    static constexpr int MESSAGE_SIZE = 13;
+
+    explicit VersusLink(QObject* parent = 0);
+
+    // Wait for the other player. Returns false if the server cannot listen.
+    bool host(const QString& name);
+
+    // Connect to the player who hosts.
+    void join(const QString& name);
+
+    void send(Message_type type, uint32_t tick, uint64_t value);
+
+signals:
+    void connected();
+    void message_received(int type, uint32_t tick, uint64_t value);
+    void disconnected();
+
+private slots:
+    void accept_connection();
+    void read_messages();
+
+private:
+    void use_socket(QLocalSocket* socket);
+
+    QLocalServer* server_ = NULL;
+    QLocalSocket* socket_ = NULL;
+
+    // Bytes of a message which has not arrived completely.
+    QByteArray received_;
+};
+
+#endif // VERSUSLINK_HH
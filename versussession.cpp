@@ -0,0 +1,323 @@
+#include "versussession.hh"
+#include <algorithm>
+
+// Start both games from the seed.
+void VersusSession::start(uint32_t seed, int local_player)
+{
+    for (Player& player : frame_)
+    {
+        player.engine.reset(seed);
+        player.gravity_ms = 0;
+        player.over_tick = 0;
+    }
+
+    for (auto& inputs : inputs_)
+    {
+        inputs.fill(NO_INPUT);
+    }
+
+    // A tick which is never reached marks an empty checksum.
+    Checksum empty;
+    empty.tick = UINT32_MAX;
+    local_checksums_.fill(empty);
+    remote_checksums_.fill(empty);
+    new_checksums_.clear();
+
+    local_player_ = local_player;
+    current_tick_ = 0;
+    remote_tick_ = 0;
+    rollback_tick_ = -1;
+    final_tick_ = 0;
+    desync_tick_ = -1;
+    num_rollbacks_ = 0;
+}
+
+// The remote input is predicted to be none unless it has already arrived.
+bool VersusSession::advance(uint8_t local_input)
+{
+    if (is_finished() || current_tick_ >= remote_tick_ + MAX_ROLLBACK)
+    {
+        return false;
+    }
+
+    std::array<uint8_t, NUM_PLAYERS>& inputs = inputs_.at(current_tick_ % RING);
+    inputs.at(local_player_) = is_player_input(local_input) ? local_input
+                                                            : NO_INPUT;
+
+    if (current_tick_ >= remote_tick_)
+    {
+        inputs.at(remote_player()) = NO_INPUT;
+    }
+
+    simulate_tick();
+    make_checksums();
+
+    return true;
+}
+
+// Mark a rollback if the input differs from the one the tick was
+// simulated with.
+void VersusSession::add_remote_input(uint32_t tick, uint8_t input)
+{
+    if (tick != remote_tick_)
+    {
+        return;
+    }
+
+    if (!is_player_input(input))
+    {
+        input = NO_INPUT;
+    }
+
+    uint8_t& slot = inputs_.at(tick % RING).at(remote_player());
+
+    if (tick < current_tick_ && slot != input
+            && (rollback_tick_ < 0 || tick < rollback_tick_))
+    {
+        rollback_tick_ = tick;
+    }
+
+    slot = input;
+    remote_tick_ = tick + 1;
+}
+
+// Restore the state before the mispredicted tick and simulate up to the
+// current tick again with the known inputs.
+int VersusSession::synchronize()
+{
+    int resimulated = 0;
+
+    if (rollback_tick_ >= 0)
+    {
+        uint32_t end_tick = current_tick_;
+
+        current_tick_ = uint32_t(rollback_tick_);
+        frame_ = states_.at(current_tick_ % RING);
+        rollback_tick_ = -1;
+
+        while (current_tick_ < end_tick)
+        {
+            simulate_tick();
+            resimulated += 1;
+        }
+
+        num_rollbacks_ += 1;
+    }
+
+    make_checksums();
+
+    return resimulated;
+}
+
+void VersusSession::add_remote_checksum(const Checksum& checksum)
+{
+    remote_checksums_.at(checksum.tick % RING) = checksum;
+    compare_checksum(checksum.tick);
+}
+
+void VersusSession::take_checksums(std::vector<Checksum>& checksums)
+{
+    checksums.insert(checksums.end(), new_checksums_.begin(),
+                     new_checksums_.end());
+    new_checksums_.clear();
+}
+
+const GameEngine& VersusSession::engine(int player) const
+{
+    return frame_.at(player).engine;
+}
+
+GameEngine& VersusSession::engine(int player)
+{
+    return frame_.at(player).engine;
+}
+
+uint32_t VersusSession::confirmed_tick() const
+{
+    return std::min(current_tick_, remote_tick_);
+}
+
+// Both sides see the same confirmed state, so they agree on the end.
+bool VersusSession::is_finished() const
+{
+    if (rollback_tick_ >= 0)
+    {
+        return false;
+    }
+
+    const Frame& frame = confirmed_frame();
+
+    return frame.at(0).engine.is_over() || frame.at(1).engine.is_over();
+}
+
+// The game which ended first loses. The confirmed ticks of the two sides
+// may differ, so the tick where a game ended decides and not only which
+// games are over.
+int VersusSession::winner() const
+{
+    const Frame& frame = confirmed_frame();
+    const Player& first = frame.at(0);
+    const Player& second = frame.at(1);
+
+    if (first.engine.is_over() && second.engine.is_over())
+    {
+        if (first.over_tick == second.over_tick)
+        {
+            return -1;
+        }
+
+        return first.over_tick < second.over_tick ? 1 : 0;
+    }
+
+    if (first.engine.is_over())
+    {
+        return 1;
+    }
+
+    if (second.engine.is_over())
+    {
+        return 0;
+    }
+
+    return -1;
+}
+
+//*****************************************************************************
+// Simulation
+
+// A new tetromino appears at the start of the tick after the previous one
+// locked, then the input is applied and the gravity drops the tetromino at
+// the speed of the level.
+void VersusSession::step(Player& player, uint8_t input, uint32_t tick)
+{
+    GameEngine& engine = player.engine;
+
+    if (engine.is_over())
+    {
+        return;
+    }
+
+    if (!engine.is_piece_active())
+    {
+        engine.apply(GameEngine::SPAWN);
+        player.gravity_ms = 0;
+    }
+
+    if (input != NO_INPUT && !engine.is_over())
+    {
+        int result = engine.apply(GameEngine::Input(input));
+
+        if (result & GameEngine::SPAWNED)
+        {
+            player.gravity_ms = 0;
+        }
+    }
+
+    if (engine.is_piece_active())
+    {
+        player.gravity_ms += TICK_MS;
+
+        if (player.gravity_ms >= engine.speed())
+        {
+            player.gravity_ms -= engine.speed();
+            engine.apply(GameEngine::GRAVITY);
+        }
+    }
+
+    if (engine.is_over())
+    {
+        player.over_tick = tick;
+    }
+}
+
+bool VersusSession::is_player_input(uint8_t input)
+{
+    return input >= GameEngine::LEFT && input <= GameEngine::HOLD;
+}
+
+// The state after the last confirmed tick is the state at the start of the
+// next one.
+const VersusSession::Frame& VersusSession::confirmed_frame() const
+{
+    uint32_t tick = confirmed_tick();
+
+    if (tick == current_tick_)
+    {
+        return frame_;
+    }
+
+    return states_.at(tick % RING);
+}
+
+void VersusSession::simulate_tick()
+{
+    states_.at(current_tick_ % RING) = frame_;
+
+    const std::array<uint8_t, NUM_PLAYERS>& inputs
+            = inputs_.at(current_tick_ % RING);
+
+    for (int i = 0; i < NUM_PLAYERS; ++i)
+    {
+        step(frame_.at(i), inputs.at(i), current_tick_);
+    }
+
+    current_tick_ += 1;
+}
+
+uint64_t VersusSession::frame_hash(const Frame& frame)
+{
+    uint64_t hash = 0;
+
+    for (const Player& player : frame)
+    {
+        hash = hash * 0x100000001B3ULL ^ player.engine.state_hash();
+        hash = hash * 0x100000001B3ULL ^ uint64_t(player.gravity_ms);
+    }
+
+    return hash;
+}
+
+// Hash the ticks which became final. A tick is final when the inputs of
+// both players are known and no rollback to it or before it is pending.
+void VersusSession::make_checksums()
+{
+    uint32_t end_tick = confirmed_tick();
+
+    if (rollback_tick_ >= 0)
+    {
+        end_tick = std::min(end_tick, uint32_t(rollback_tick_));
+    }
+
+    for (uint32_t tick = final_tick_; tick < end_tick; ++tick)
+    {
+        if (tick % CHECKSUM_INTERVAL != 0)
+        {
+            continue;
+        }
+
+        const Frame& after = tick + 1 == current_tick_
+                ? frame_ : states_.at((tick + 1) % RING);
+
+        Checksum checksum;
+        checksum.tick = tick;
+        checksum.hash = frame_hash(after);
+
+        local_checksums_.at(tick % RING) = checksum;
+        new_checksums_.push_back(checksum);
+        compare_checksum(tick);
+    }
+
+    final_tick_ = std::max(final_tick_, end_tick);
+}
+
+void VersusSession::compare_checksum(uint32_t tick)
+{
+    const Checksum& local = local_checksums_.at(tick % RING);
+    const Checksum& remote = remote_checksums_.at(tick % RING);
+
+    if (local.tick == tick && remote.tick == tick && local.hash != remote.hash
+            && desync_tick_ < 0)
+    {
+        desync_tick_ = tick;
+    }
+}
@@ -0,0 +1,156 @@
+#ifndef VERSUSSESSION_HH
+#define VERSUSSESSION_HH
+
+#include "gameengine.hh"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Two games played head-to-head in lockstep ticks. Both sides simulate both
+// games from the same seed and only the inputs are exchanged, one per
+// player per tick.
+//
+// The inputs of the remote player are not waited for. The remote player is
+// predicted to give no input, and when its real input arrives and differs
+// from the prediction, the games are restored to the state before that tick
+// and the ticks in between are simulated again (rollback). At most
+// MAX_ROLLBACK ticks are predicted. After that the local game waits for the
+// remote inputs.
+//
+// Every CHECKSUM_INTERVAL ticks both sides hash the state after a tick where
+// all inputs are known, and exchange the hashes to detect desyncs.
+class VersusSession
+{
+public:
+    static constexpr int NUM_PLAYERS = 2;
+
+    // Length of one tick in milliseconds.
+    static constexpr int TICK_MS = 16;
+
+    // Ticks which can be predicted before waiting for the remote inputs.
+    static constexpr int MAX_ROLLBACK = 48;
+
+    // Ticks between state checksums.
+    static constexpr int CHECKSUM_INTERVAL = 30;
+
+    // Input value of a tick without input.
+    static constexpr uint8_t NO_INPUT = 0xFF;
+
+    struct Checksum
+    {
+        uint32_t tick = 0;
+        uint64_t hash = 0;
+    };
+
+    // Start both games from the seed. Player 0 is the one who hosts.
+    void start(uint32_t seed, int local_player);
+
+    // Simulate the next tick with the local input. Returns false and does
+    // nothing if the remote inputs are too far behind.
+    bool advance(uint8_t local_input);
+
+    // Input of the remote player for a tick. Inputs must arrive in order of
+    // the ticks.
+    void add_remote_input(uint32_t tick, uint8_t input);
+
+    // Roll back and simulate again if a remote input was mispredicted.
+    // Returns the number of ticks simulated again.
+    int synchronize();
+
+    // Checksum of the remote game for a tick.
+    void add_remote_checksum(const Checksum& checksum);
+
+    // Checksums made since the last call, to be sent to the remote side.
+    void take_checksums(std::vector<Checksum>& checksums);
+
+    // Tick where the checksums differed, or -1.
+    int64_t desync_tick() const { return desync_tick_; }
+
+    // Game of a player at the current tick.
+    const GameEngine& engine(int player) const;
+    GameEngine& engine(int player);
+
+    int local_player() const { return local_player_; }
+    int remote_player() const { return 1 - local_player_; }
+
+    // Next tick to simulate.
+    uint32_t current_tick() const { return current_tick_; }
+
+    // Ticks before this have the inputs of both players.
+    uint32_t confirmed_tick() const;
+
+    // True when a game is over in a tick with all inputs known.
+    bool is_finished() const;
+
+    // Player who won, or -1 if both games ended in the same tick.
+    int winner() const;
+
+    int num_rollbacks() const { return num_rollbacks_; }
+
+private:
+    // Size of the rings of inputs and states.
+    static constexpr int RING = 64;
+    static_assert(RING > MAX_ROLLBACK + 1, "Ring must hold the rollback window");
+
+    // Game of one player and the time since the tetromino last dropped.
+    struct Player
+    {
+        GameEngine engine;
+        int gravity_ms = 0;
+
+        // Tick where the game of the player ended.
+        uint32_t over_tick = 0;
+    };
+
+    using Frame = std::array<Player, NUM_PLAYERS>;
+
+    // Simulate one tick of one player.
+    static void step(Player& player, uint8_t input, uint32_t tick);
+
+    // Inputs which players can give. Dropping and new tetrominos come from
+    // the ticks.
+    static bool is_player_input(uint8_t input);
+
+    // State after all ticks with inputs of both players.
+    const Frame& confirmed_frame() const;
+
+    // Simulate current_tick_ and store the state after it.
+    void simulate_tick();
+
+    // Hash of the state after a tick.
+    static uint64_t frame_hash(const Frame& frame);
+
+    void make_checksums();
+    void compare_checksum(uint32_t tick);
+
+    Frame frame_;
+
+    // State at the start of each tick in the ring.
+    std::array<Frame, RING> states_;
+
+    // Inputs of each tick in the ring. Remote inputs of ticks after
+    // remote_tick_ are predictions.
+    std::array<std::array<uint8_t, NUM_PLAYERS>, RING> inputs_;
+
+    // Checksums of the ticks, local and remote.
+    std::array<Checksum, RING> local_checksums_;
+    std::array<Checksum, RING> remote_checksums_;
+    std::vector<Checksum> new_checksums_;
+
+    int local_player_ = 0;
+    uint32_t current_tick_ = 0;
+
+    // Number of ticks with the remote input known.
+    uint32_t remote_tick_ = 0;
+
+    // Earliest tick where a prediction was wrong, or -1.
+    int64_t rollback_tick_ = -1;
+
+    // Ticks before this are final and have a checksum if they need one.
+    uint32_t final_tick_ = 0;
+
+    int64_t desync_tick_ = -1;
+    int num_rollbacks_ = 0;
+};
+
+#endif // VERSUSSESSION_HH
@@ -0,0 +1,97 @@
+#ifndef ZOBRIST_HH
+#define ZOBRIST_HH
+
+#include <array>
+#include <cstdint>
+
+// Zobrist keys for hashing positions in the search of the bots. A position
+// is hashed by xoring together a random key for every occupied cell, every
+// square of the moving tetromino and its type, and the hold state. Keys
+// can be xored in and out when the position changes, so the hash of the
+// board is updated when a tetromino is locked and rows are removed instead
+// of being calculated again.
+class Zobrist
+{
+public:
+    // Largest board the keys are made for.
+    static constexpr int MAX_ROWS = 32;
+    static constexpr int MAX_COLUMNS = 16;
+
+    // Number of tetromino types and the hold states.
+    static constexpr int NUM_TYPES = 8;
+
+    // Key of an occupied cell in the board.
+    static uint64_t cell(int x, int y)
+    {
+        return KEYS[CELL_KEYS + y * MAX_COLUMNS + x];
+    }
+
+    // Key of a square of the moving tetromino.
+    static uint64_t piece_cell(int x, int y)
+    {
+        return KEYS[PIECE_CELL_KEYS + y * MAX_COLUMNS + x];
+    }
+
+    static uint64_t piece_type(int type)
+    {
+        return KEYS[PIECE_TYPE_KEYS + type];
+    }
+
+    // Key of the hold tetromino. An empty hold has its own key.
+    static uint64_t hold(int type, bool is_empty, bool can_hold)
+    {
+        return KEYS[HOLD_KEYS + (is_empty ? NUM_TYPES - 1 : type)] ^
+                (can_hold ? KEYS[CAN_HOLD_KEY] : 0);
+    }
+
+    // Xor of the cell keys of a row with the mask of occupied columns.
+    static uint64_t row(int y, uint32_t mask)
+    {
+        uint64_t hash = 0;
+
+        for (int x = 0; mask != 0; ++x, mask >>= 1)
+        {
+            if (mask & 1)
+            {
+                hash ^= cell(x, y);
+            }
+        }
+
+        return hash;
+    }
+
+private:
+    // Position of each group of keys in KEYS.
+    static constexpr int CELL_KEYS = 0;
+    static constexpr int PIECE_CELL_KEYS = CELL_KEYS + MAX_ROWS * MAX_COLUMNS;
+    static constexpr int PIECE_TYPE_KEYS = PIECE_CELL_KEYS + MAX_ROWS * MAX_COLUMNS;
+    static constexpr int HOLD_KEYS = PIECE_TYPE_KEYS + NUM_TYPES;
+    static constexpr int CAN_HOLD_KEY = HOLD_KEYS + NUM_TYPES;
+    static constexpr int NUM_KEYS = CAN_HOLD_KEY + 1;
+
+    // Keys made with splitmix64 at compile time so they are the same in
+    // every build.
+    static constexpr std::array<uint64_t, NUM_KEYS> make_keys()
+    {
+        std::array<uint64_t, NUM_KEYS> keys = {};
+        uint64_t state = 0x5EED5EED5EED5EEDull;
+
+        for (int i = 0; i < NUM_KEYS; ++i)
+        {
+            state += 0x9E3779B97F4A7C15ull;
+
+            uint64_t key = state;
+            key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+            key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+            keys[i] = key ^ (key >> 31);
+        }
+
+        return keys;
+    }
+
+    static const std::array<uint64_t, NUM_KEYS> KEYS;
+};
+
+inline constexpr std::array<uint64_t, Zobrist::NUM_KEYS> Zobrist::KEYS = Zobrist::make_keys();
+
+#endif // ZOBRIST_HH